@@ -44,6 +44,9 @@
 
 #include "mne_rt_server.h"
 
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_constants.h>
+
 #include <stdlib.h>
 
 //=============================================================================================================
@@ -77,11 +80,11 @@ void FiffStreamServer::comClist(Command p_command)
 {
     //ToDo JSON
     QString t_sOutput("");
-    t_sOutput.append("\tID\tAlias\r\n");
+    t_sOutput.append("\tID\tAlias\tSent\tDropped\r\n");
     QMap<qint32, FiffStreamThread*>::iterator i;
     for (i = this->m_qClientList.begin(); i != this->m_qClientList.end(); ++i)
     {
-        QString str = QString("\t%1\t%2\r\n").arg(i.key()).arg(i.value()->getAlias());
+        QString str = QString("\t%1\t%2\t%3\t%4\r\n").arg(i.key()).arg(i.value()->getAlias()).arg(i.value()->getNumSentPackets()).arg(i.value()->getNumDroppedPackets());
         t_sOutput.append(str);
     }
     t_sOutput.append("\n");
@@ -159,6 +162,78 @@ void FiffStreamServer::comStopAll(Command p_command)
 
 //=============================================================================================================
 
+void FiffStreamServer::comShmem(Command p_command)
+{
+    qint32 t_id = -1;
+    QString t_sOutput("");
+    QString t_sAlias(p_command.pValues()[p_command.pNames().indexOf("id")].toString());
+    bool t_bEnable = p_command.pValues()[p_command.pNames().indexOf("enable")].toInt() != 0;
+    t_sOutput.append(parseToId(t_sAlias,t_id));
+
+    if(t_id != -1)
+        emit sharedMemoryFiffStreamClient(t_id, t_bEnable);
+
+    if(p_command.isJson())
+    {
+        //
+        //create JSON object holding the key of the ring
+        //
+        bool t_bUsingSharedMemory = t_id != -1 && t_bEnable && getClient(t_id)->isUsingSharedMemory();
+
+        QJsonObject t_qJsonObjectRoot;
+        t_qJsonObjectRoot.insert("id", QJsonValue((double)t_id));
+        t_qJsonObjectRoot.insert("shmem", QJsonValue(t_bUsingSharedMemory));
+        if(t_bUsingSharedMemory)
+            t_qJsonObjectRoot.insert("key", QJsonValue(getClient(t_id)->getSharedMemoryKey()));
+        QJsonDocument p_qJsonDocument(t_qJsonObjectRoot);
+
+        qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["shmem"].reply(p_qJsonDocument.toJson());
+        return;
+    }
+
+    if(t_id != -1)
+    {
+        QString str;
+        if(!t_bEnable)
+            str = QString("\tFiffStreamClient (ID: %1) receives raw buffers via TCP\r\n\n").arg(t_id);
+        else if(getClient(t_id)->isUsingSharedMemory())
+            str = QString("\tFiffStreamClient (ID: %1) receives raw buffers via shared memory '%2'\r\n\n").arg(t_id).arg(getClient(t_id)->getSharedMemoryKey());
+        else
+            str = QString("\twarning: could not create shared memory for FiffStreamClient (ID: %1)\r\n\n").arg(t_id);
+        t_sOutput.append(str);
+    }
+    qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["shmem"].reply(t_sOutput);
+}
+
+//=============================================================================================================
+
+void FiffStreamServer::comDatatype(Command p_command)
+{
+    qint32 t_id = -1;
+    QString t_sOutput("");
+    QString t_sAlias(p_command.pValues()[p_command.pNames().indexOf("id")].toString());
+    fiff_int_t t_iDataType = p_command.pValues()[p_command.pNames().indexOf("type")].toInt();
+    t_sOutput.append(parseToId(t_sAlias,t_id));
+
+    if(t_id != -1)
+    {
+        if(t_iDataType == FIFFT_FLOAT || t_iDataType == FIFFT_SHORT || t_iDataType == FIFFT_INT || t_iDataType == FIFFT_MNE_DELTA_VARINT)
+        {
+            emit rawDataTypeFiffStreamClient(t_id, t_iDataType);
+
+            QString str = QString("\tFiffStreamClient (ID: %1) receives raw buffers of data type %2\r\n\n").arg(t_id).arg(t_iDataType);
+            t_sOutput.append(str);
+        }
+        else
+        {
+            t_sOutput.append(QString("\twarning: data type %1 is not supported\r\n\n").arg(t_iDataType));
+        }
+    }
+    qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["datatype"].reply(t_sOutput);
+}
+
+//=============================================================================================================
+
 void FiffStreamServer::connectCommands()
 {
     //Connect slots
@@ -169,6 +244,8 @@ void FiffStreamServer::connectCommands()
     QObject::connect(&t_pMNERTServer->getCommandManager()["start"], &Command::executed, this, &FiffStreamServer::comStart);
     QObject::connect(&t_pMNERTServer->getCommandManager()["stop"], &Command::executed, this, &FiffStreamServer::comStop);
     QObject::connect(&t_pMNERTServer->getCommandManager()["stop-all"], &Command::executed, this, &FiffStreamServer::comStopAll);
+    QObject::connect(&t_pMNERTServer->getCommandManager()["shmem"], &Command::executed, this, &FiffStreamServer::comShmem);
+    QObject::connect(&t_pMNERTServer->getCommandManager()["datatype"], &Command::executed, this, &FiffStreamServer::comDatatype);
 
 //    t_pMNERTServer->getCommandManager().connectSlot(QString("clist"), this, &FiffStreamServer::comClist);
 //    t_pMNERTServer->getCommandManager().connectSlot(QString("measinfo"), this, &FiffStreamServer::comMeasinfo);
@@ -348,14 +425,50 @@ QByteArray FiffStreamServer::parseToId(QString& p_sRawId, qint32& p_iParsedId)
 
 void FiffStreamServer::forwardMeasInfo(qint32 ID, const FiffInfo& p_fiffInfo)
 {
+    m_vecCals.resize(p_fiffInfo.chs.size());
+    for(qint32 k = 0; k < p_fiffInfo.chs.size(); ++k) {
+        m_vecCals[k] = p_fiffInfo.chs[k].range * p_fiffInfo.chs[k].cal;
+    }
+
     emit remitMeasInfo(ID, p_fiffInfo);
 }
 
 //=============================================================================================================
-//ToDo increase preformance --> try inline
+
 void FiffStreamServer::forwardRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
 {
+    if(m_qClientList.isEmpty() || !m_pMatRawData) {
+        return;
+    }
+
     emit remitRawBuffer(m_pMatRawData);
+
+    QList<fiff_int_t> t_qListDataTypes;
+    QMap<qint32, FiffStreamThread*>::const_iterator i;
+    for (i = m_qClientList.constBegin(); i != m_qClientList.constEnd(); ++i) {
+        if(!i.value()->isUsingSharedMemory() && !t_qListDataTypes.contains(i.value()->getRawDataType())) {
+            t_qListDataTypes.append(i.value()->getRawDataType());
+        }
+    }
+
+    //Quantization needs the calibrations of all channels
+    bool t_bCanQuantize = m_vecCals.cols() == m_pMatRawData->rows() && (m_vecCals.array() > 0.0).all();
+
+    //Encode once per data type, all clients of this type share the same packet
+    for(fiff_int_t t_iDataType : t_qListDataTypes) {
+        QSharedPointer<QByteArray> t_pPacket(new QByteArray);
+        t_pPacket->reserve(16 + 4 * m_pMatRawData->size());
+
+        FiffStream t_FiffStreamOut(t_pPacket.data(), QIODevice::WriteOnly);
+        //Buffers which can not be quantized, e.g. with samples which are not finite, are sent as floats
+        if(t_iDataType == FIFFT_FLOAT
+           || !t_bCanQuantize
+           || !t_FiffStreamOut.write_raw_buffer(m_pMatRawData->cast<double>(), m_vecCals, t_iDataType)) {
+            t_FiffStreamOut.write_float(FIFF_DATA_BUFFER, m_pMatRawData->data(), m_pMatRawData->rows()*m_pMatRawData->cols());
+        }
+
+        emit remitRawPacket(t_pPacket, t_iDataType);
+    }
 }
 
 //=============================================================================================================
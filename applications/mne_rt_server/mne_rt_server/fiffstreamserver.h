@@ -50,6 +50,7 @@
 
 #include <QStringList>
 #include <QTcpServer>
+#include <QSharedPointer>
 
 //=============================================================================================================
 // DEFINE NAMESPACE RTSERVER
@@ -108,6 +109,15 @@ public:
 
 //public slots: --> in Qt 5 not anymore declared as slot
     void forwardMeasInfo(qint32 ID, const FIFFLIB::FiffInfo& p_fiffInfo);
+
+    //=========================================================================================================
+    /**
+     * Encodes the raw buffer once into a FIFF_DATA_BUFFER tag and broadcasts the immutable packet to all
+     * FiffStreamThreads. A packet is encoded once per data type requested by the clients. Clients using the
+     * shared memory transport receive the raw buffer itself.
+     *
+     * @param[in] m_pMatRawData  The raw buffer.
+     */
     void forwardRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData);
 
 signals:
@@ -117,8 +127,13 @@ signals:
     void stopMeasFiffStreamClient(qint32 ID);
 
     void remitMeasInfo(qint32 ID, const FIFFLIB::FiffInfo& p_fiffInfo);
+    void remitRawPacket(QSharedPointer<const QByteArray>, FIFFLIB::fiff_int_t);
     void remitRawBuffer(QSharedPointer<Eigen::MatrixXf>);
 
+    void sharedMemoryFiffStreamClient(qint32 ID, bool bEnable);
+
+    void rawDataTypeFiffStreamClient(qint32 ID, FIFFLIB::fiff_int_t type);
+
     void closeFiffStreamServer();
 
 protected:
@@ -166,10 +181,27 @@ private:
      */
     void comStopAll(COMMUNICATIONLIB::Command p_command);
 
+    //=========================================================================================================
+    /**
+     * Switches the raw buffer transport of a client running on the same host to a shared memory ring
+     *
+     * @param[in] p_command  The shmem command.
+     */
+    void comShmem(COMMUNICATIONLIB::Command p_command);
+
+    //=========================================================================================================
+    /**
+     * Sets the data type raw buffers are sent with to a client (float or quantized integers)
+     *
+     * @param[in] p_command  The datatype command.
+     */
+    void comDatatype(COMMUNICATIONLIB::Command p_command);
+
     QByteArray parseToId(QString& p_sRawId, qint32& p_iParsedId);
 
     QMap<qint32, FiffStreamThread*> m_qClientList;
     qint32                          m_iNextClientId;
+    Eigen::RowVectorXd              m_vecCals;          /**< Quantization steps (range * cal) of the channels of the last forwarded measurement info. */
 };
 
 //=============================================================================================================
@@ -51,6 +51,7 @@
 
 #include <utils/ioutils.h>
 #include <fiff/fiff_constants.h>
+#include <fiff/fiff_stream.h>
 #include <fiff/fiff_tag.h>
 
 //=============================================================================================================
@@ -59,6 +60,12 @@
 
 #include <QtNetwork>
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_QUEUED_BYTES 33554432       /**< Queued bytes per client above which raw data packets are dropped (32 MB). */
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -66,6 +73,7 @@
 using namespace UTILSLIB;
 using namespace RTSERVER;
 using namespace FIFFLIB;
+using namespace COMMUNICATIONLIB;
 
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -76,6 +84,11 @@ FiffStreamThread::FiffStreamThread(qint32 id, int socketDescriptor, QObject *par
 , m_iDataClientId(id)
 , m_sDataClientAlias(QString(""))
 , m_iSocketDescriptor(socketDescriptor)
+, m_iQueuedBytes(0)
+, m_iPacketOffset(0)
+, m_iNumDroppedPackets(0)
+, m_iNumSentPackets(0)
+, m_iRawDataType(FIFFT_FLOAT)
 , m_bIsSendingRawBuffer(false)
 , m_bIsRunning(false)
 {
@@ -92,6 +105,9 @@ FiffStreamThread::~FiffStreamThread()
 
     m_bIsRunning = false;
     QThread::wait();
+
+    //Wakes up a client waiting on the ring
+    m_pSharedMemoryRing.clear();
 }
 
 //=============================================================================================================
@@ -102,10 +118,12 @@ void FiffStreamThread::startMeas(qint32 ID)
     {
         qDebug() << "Activate raw buffer sending.";
 
-        m_qMutex.lock();
-        // ToDo send start meas
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QByteArray t_blockData;
+        FiffStream t_FiffStreamOut(&t_blockData, QIODevice::WriteOnly);
         t_FiffStreamOut.start_block(FIFFB_RAW_DATA);
+
+        m_qMutex.lock();
+        enqueueControlBlock(t_blockData);
         m_bIsSendingRawBuffer = true;
         m_qMutex.unlock();
     }
@@ -120,9 +138,12 @@ void FiffStreamThread::stopMeas(qint32 ID)
     {
         qDebug() << "stop raw buffer sending.";
 
-        m_qMutex.lock();
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QByteArray t_blockData;
+        FiffStream t_FiffStreamOut(&t_blockData, QIODevice::WriteOnly);
         t_FiffStreamOut.end_block(FIFFB_RAW_DATA);
+
+        m_qMutex.lock();
+        enqueueControlBlock(t_blockData);
         m_bIsSendingRawBuffer = false;
         m_qMutex.unlock();
     }
@@ -167,24 +188,146 @@ void FiffStreamThread::parseCommand(FiffTag::SPtr p_pTag)
 
 //=============================================================================================================
 
+void FiffStreamThread::sendRawPacket(QSharedPointer<const QByteArray> p_pPacket, fiff_int_t p_iDataType)
+{
+    QMutexLocker locker(&m_qMutex);
+
+    if(!m_bIsSendingRawBuffer || m_pSharedMemoryRing || !p_pPacket || p_iDataType != m_iRawDataType) {
+        return;
+    }
+
+    //Backpressure: do not let a slow client accumulate an unbounded amount of data
+    if(m_iQueuedBytes + p_pPacket->size() > MAX_QUEUED_BYTES) {
+        ++m_iNumDroppedPackets;
+        return;
+    }
+
+    m_qPacketQueue.enqueue(p_pPacket);
+    m_iQueuedBytes += p_pPacket->size();
+}
+
+//=============================================================================================================
+
 void FiffStreamThread::sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
 {
-    if(m_bIsSendingRawBuffer)
+    QMutexLocker locker(&m_qMutex);
+
+    if(!m_bIsSendingRawBuffer || !m_pSharedMemoryRing || !m_pMatRawData) {
+        return;
+    }
+
+    if(m_pSharedMemoryRing->fits(*m_pMatRawData)) {
+        if(m_pSharedMemoryRing->write(*m_pMatRawData)) {
+            ++m_iNumSentPackets;
+        } else {
+            ++m_iNumDroppedPackets;
+        }
+        return;
+    }
+
+    //The buffer is too large for a slot, send it through the socket
+    QSharedPointer<QByteArray> t_pPacket(new QByteArray);
+    t_pPacket->reserve(16 + 4 * m_pMatRawData->size());
+    FiffStream t_FiffStreamOut(t_pPacket.data(), QIODevice::WriteOnly);
+    t_FiffStreamOut.write_float(FIFF_DATA_BUFFER, m_pMatRawData->data(), m_pMatRawData->rows()*m_pMatRawData->cols());
+
+    //The redirect entry is only written if the packet is queued, otherwise the client would wait for it
+    if(m_iQueuedBytes + t_pPacket->size() > MAX_QUEUED_BYTES || !m_pSharedMemoryRing->writeRedirect()) {
+        ++m_iNumDroppedPackets;
+        return;
+    }
+
+    m_qPacketQueue.enqueue(t_pPacket);
+    m_iQueuedBytes += t_pPacket->size();
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::setSharedMemory(qint32 ID, bool bEnable)
+{
+    if(ID != m_iDataClientId) {
+        return;
+    }
+
+    QMutexLocker locker(&m_qMutex);
+
+    if(!bEnable) {
+        m_pSharedMemoryRing.clear();
+        return;
+    }
+
+    if(m_pSharedMemoryRing) {
+        return;
+    }
+
+    RtSharedMemoryRing::SPtr pRing(new RtSharedMemoryRing(RtSharedMemoryRing::keyForClient(m_iDataClientId,
+                                                                                           RtSharedMemoryRing::createToken())));
+    if(pRing->create()) {
+        m_pSharedMemoryRing = pRing;
+    }
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::setRawDataType(qint32 ID, fiff_int_t type)
+{
+    if(ID == m_iDataClientId)
     {
-//        qDebug() << "Send RawBuffer to client";
+        QMutexLocker locker(&m_qMutex);
+        m_iRawDataType = type;
+    }
+}
 
-        m_qMutex.lock();
+//=============================================================================================================
 
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
-        t_FiffStreamOut.write_float(FIFF_DATA_BUFFER,m_pMatRawData->data(),m_pMatRawData->rows()*m_pMatRawData->cols());
+fiff_int_t FiffStreamThread::getRawDataType()
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_iRawDataType;
+}
 
-        m_qMutex.unlock();
+//=============================================================================================================
+
+bool FiffStreamThread::isUsingSharedMemory()
+{
+    QMutexLocker locker(&m_qMutex);
+    return !m_pSharedMemoryRing.isNull();
+}
+
+//=============================================================================================================
 
+QString FiffStreamThread::getSharedMemoryKey()
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_pSharedMemoryRing ? m_pSharedMemoryRing->key() : QString();
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::enqueueControlBlock(const QByteArray& p_blockData)
+{
+    if(p_blockData.isEmpty()) {
+        return;
     }
-//    else
-//    {
-//        qDebug() << "Send RawBuffer is not activated";
-//    }
+
+    m_qPacketQueue.enqueue(QSharedPointer<const QByteArray>(new QByteArray(p_blockData)));
+    m_iQueuedBytes += p_blockData.size();
+}
+
+//=============================================================================================================
+
+qint64 FiffStreamThread::getNumDroppedPackets()
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_iNumDroppedPackets;
+}
+
+//=============================================================================================================
+
+qint64 FiffStreamThread::getNumSentPackets()
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_iNumSentPackets;
 }
 
 //=============================================================================================================
@@ -212,9 +355,8 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 {
     if(ID == m_iDataClientId)
     {
-        m_qMutex.lock();
-
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QByteArray t_blockData;
+        FiffStream t_FiffStreamOut(&t_blockData, QIODevice::WriteOnly);
 
 //        qint32 init_info[2];
 //        init_info[0] = FIFF_MNE_RT_CLIENT_ID;
@@ -225,6 +367,9 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 //FiffStream::start_writing_raw
 
         p_fiffInfo.writeToStream(&t_FiffStreamOut);
+
+        m_qMutex.lock();
+        enqueueControlBlock(t_blockData);
         m_qMutex.unlock();
 
 //        qDebug() << "MeasInfo Blocksize: " << m_qSendBlock.size();
@@ -235,9 +380,14 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 
 void FiffStreamThread::writeClientId()
 {
-    FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+    QByteArray t_blockData;
+    FiffStream t_FiffStreamOut(&t_blockData, QIODevice::WriteOnly);
 
     t_FiffStreamOut.write_int(FIFF_MNE_RT_CLIENT_ID, &m_iDataClientId);
+
+    m_qMutex.lock();
+    enqueueControlBlock(t_blockData);
+    m_qMutex.unlock();
 }
 
 //=============================================================================================================
@@ -286,8 +436,14 @@ void FiffStreamThread::run()
 
     connect(t_pParentServer, &FiffStreamServer::remitMeasInfo,
             this, &FiffStreamThread::sendMeasurementInfo);
+    connect(t_pParentServer, &FiffStreamServer::remitRawPacket,
+            this, &FiffStreamThread::sendRawPacket);
     connect(t_pParentServer, &FiffStreamServer::remitRawBuffer,
             this, &FiffStreamThread::sendRawBuffer);
+    connect(t_pParentServer, &FiffStreamServer::sharedMemoryFiffStreamClient,
+            this, &FiffStreamThread::setSharedMemory);
+    connect(t_pParentServer, &FiffStreamServer::rawDataTypeFiffStreamClient,
+            this, &FiffStreamThread::setRawDataType);
     connect(t_pParentServer, &FiffStreamServer::startMeasFiffStreamClient,
             this, &FiffStreamThread::startMeas);
     connect(t_pParentServer, &FiffStreamServer::stopMeasFiffStreamClient,
@@ -312,26 +468,33 @@ void FiffStreamThread::run()
     while(t_qTcpSocket.state() != QAbstractSocket::UnconnectedState && m_bIsRunning)
     {
         //
-        // Write available data
+        // Write available data. The lock is not held while writing, so new packets can be queued meanwhile.
         //
         m_qMutex.lock();
-        qint32 t_iBlockSize = m_qSendBlock.size();
-//        qDebug() << "data available" << t_iBlockSize;
-        if(t_iBlockSize > 0)
+        while(!m_qPacketQueue.isEmpty())
         {
-            qint32 t_iBytesWritten = t_qTcpSocket.write(m_qSendBlock);
-//            qDebug() << ++i<< "[wrote bytes] " << t_iBytesWritten;
+            QSharedPointer<const QByteArray> t_pPacket = m_qPacketQueue.head();
+            m_qMutex.unlock();
+
+            qint64 t_iBytesWritten = t_qTcpSocket.write(t_pPacket->constData() + m_iPacketOffset,
+                                                        t_pPacket->size() - m_iPacketOffset);
             t_qTcpSocket.waitForBytesWritten();
-            if(t_iBytesWritten == t_iBlockSize)
-            {
-                m_qSendBlock.clear();
+
+            m_qMutex.lock();
+            if(t_iBytesWritten < 0) {
+                break;
             }
-            else
-            {
-                //we have to store bytes which were not written to the socket, due to writing limit
-                //m_qSendBlock = m_qSendBlock.mid(t_iBytesWritten, t_iBlockSize-t_iBytesWritten);
-                m_qSendBlock.remove(0,t_iBytesWritten); //higher performance then mid
+
+            //we have to keep bytes which were not written to the socket, due to writing limit
+            m_iPacketOffset += t_iBytesWritten;
+            if(m_iPacketOffset < t_pPacket->size()) {
+                break;
             }
+
+            m_qPacketQueue.dequeue();
+            m_iQueuedBytes -= t_pPacket->size();
+            m_iPacketOffset = 0;
+            ++m_iNumSentPackets;
         }
         m_qMutex.unlock();
 
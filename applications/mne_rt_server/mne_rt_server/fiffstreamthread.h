@@ -44,6 +44,7 @@
 
 #include <fiff/fiff_stream.h>
 #include <fiff/fiff_info.h>
+#include <communication/rtSharedMemory/rtsharedmemoryring.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -53,6 +54,7 @@
 #include <QTcpSocket>
 #include <QMutex>
 #include <QSharedPointer>
+#include <QQueue>
 
 //=============================================================================================================
 // DEFINE NAMESPACE RTSERVER
@@ -80,6 +82,47 @@ public:
 
     inline QString getAlias();
 
+    //=========================================================================================================
+    /**
+     * Returns the number of raw data packets which were dropped, because the client did not keep up.
+     *
+     * @return the number of dropped packets.
+     */
+    qint64 getNumDroppedPackets();
+
+    //=========================================================================================================
+    /**
+     * Returns the number of raw data packets which were completely written to the client socket.
+     *
+     * @return the number of sent packets.
+     */
+    qint64 getNumSentPackets();
+
+    //=========================================================================================================
+    /**
+     * Returns whether raw buffers are sent through the shared memory ring instead of the socket.
+     *
+     * @return true if the shared memory transport is used.
+     */
+    bool isUsingSharedMemory();
+
+    //=========================================================================================================
+    /**
+     * Returns the key of the shared memory ring. It contains a random session token and is only handed to the
+     * client in the reply of the shmem command.
+     *
+     * @return the key, empty if the shared memory transport is not used.
+     */
+    QString getSharedMemoryKey();
+
+    //=========================================================================================================
+    /**
+     * Returns the data type raw buffers are sent with to the client.
+     *
+     * @return FIFFT_FLOAT, FIFFT_SHORT, FIFFT_INT or FIFFT_MNE_DELTA_VARINT.
+     */
+    FIFFLIB::fiff_int_t getRawDataType();
+
 //    void deactivateRawBufferSending();
 
     void parseCommand(QSharedPointer<FIFFLIB::FiffTag> p_pTag);
@@ -98,7 +141,15 @@ private:
     int m_iSocketDescriptor;
 
     QMutex m_qMutex;
-    QByteArray m_qSendBlock;
+
+    QQueue<QSharedPointer<const QByteArray> > m_qPacketQueue;   /**< Packets waiting to be written to the socket. Raw data packets are shared between all clients. */
+    qint64 m_iQueuedBytes;                                      /**< Number of bytes in the packet queue. */
+    qint64 m_iPacketOffset;                                     /**< Number of bytes of the head packet which were already written. */
+    qint64 m_iNumDroppedPackets;                                /**< Number of raw data packets dropped because of backpressure. */
+    qint64 m_iNumSentPackets;                                   /**< Number of raw data packets written to the socket or the shared memory ring. */
+
+    COMMUNICATIONLIB::RtSharedMemoryRing::SPtr m_pSharedMemoryRing; /**< The local shared memory transport, if requested by the client. */
+    FIFFLIB::fiff_int_t m_iRawDataType;                         /**< The data type raw buffers are sent with. */
 
     bool m_bIsSendingRawBuffer;
 
@@ -110,7 +161,51 @@ private:
 
     void sendMeasurementInfo(qint32 ID, const FIFFLIB::FiffInfo& p_fiffInfo);
 
+    //=========================================================================================================
+    /**
+     * Queues an already encoded raw data packet. The packet is shared between all clients and never modified.
+     * If the client does not keep up, i.e. too many bytes are queued, the packet is dropped.
+     *
+     * @param[in] p_pPacket      The encoded FIFF_DATA_BUFFER tag.
+     * @param[in] p_iDataType    The data type the packet was encoded for. Packets of other types are ignored.
+     */
+    void sendRawPacket(QSharedPointer<const QByteArray> p_pPacket, FIFFLIB::fiff_int_t p_iDataType);
+
+    //=========================================================================================================
+    /**
+     * Writes the raw buffer into the shared memory ring, if the shared memory transport is used. If the ring is
+     * full, the buffer is dropped. A buffer which does not fit into a slot is sent through the socket, a redirect
+     * entry in the ring tells the client to read it from there.
+     *
+     * @param[in] m_pMatRawData  The raw buffer.
+     */
     void sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData);
+
+    //=========================================================================================================
+    /**
+     * Switches the raw buffer transport between the socket and a shared memory ring.
+     *
+     * @param[in] ID         The client id.
+     * @param[in] bEnable    Whether to use the shared memory ring.
+     */
+    void setSharedMemory(qint32 ID, bool bEnable);
+
+    //=========================================================================================================
+    /**
+     * Sets the data type raw buffers are sent with.
+     *
+     * @param[in] ID         The client id.
+     * @param[in] type       FIFFT_FLOAT, FIFFT_SHORT, FIFFT_INT or FIFFT_MNE_DELTA_VARINT.
+     */
+    void setRawDataType(qint32 ID, FIFFLIB::fiff_int_t type);
+
+    //=========================================================================================================
+    /**
+     * Queues a control block (tags other than raw data). Control blocks are never dropped.
+     *
+     * @param[in] p_blockData  The encoded tags.
+     */
+    void enqueueControlBlock(const QByteArray& p_blockData);
     //void readToBuffer1();
 //    void readProc(QTcpSocket& p_qTcpSocket);
 };
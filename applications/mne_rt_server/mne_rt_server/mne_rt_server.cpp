@@ -72,6 +72,7 @@ MNERTServer::MNERTServer()
 {
     qRegisterMetaType<Eigen::MatrixXf>("MatrixXf");
     qRegisterMetaType<QSharedPointer<Eigen::MatrixXf> >("QSharedPointer<Eigen::MatrixXf>");
+    qRegisterMetaType<QSharedPointer<const QByteArray> >("QSharedPointer<const QByteArray>");
 
     //
     // init mne_rt_server
@@ -311,6 +312,19 @@ void MNERTServer::init()
             "           \"description\": \"Prints and sends all available connectors.\","
             "           \"parameters\": {}"
             "        },"
+            "       \"datatype\": {"
+            "           \"description\": \"Sets the data type of the raw buffers sent to the specified FiffStreamClient: 4 float, 2 int16, 3 int32, 100 delta coded int32. Integer samples are quantized with the channel calibrations.\","
+            "           \"parameters\": {"
+            "               \"id\": {"
+            "                   \"description\": \"ID/Alias\","
+            "                   \"type\": \"QString\" "
+            "               },"
+            "               \"type\": {"
+            "                   \"description\": \"FIFF data type\","
+            "                   \"type\": \"int\" "
+            "               }"
+            "           }"
+            "        },"
             "       \"help\": {"
             "           \"description\": \"Prints and sends this list.\","
             "           \"parameters\": {}"
@@ -333,6 +347,19 @@ void MNERTServer::init()
             "               }"
             "           }"
             "        },"
+            "       \"shmem\": {"
+            "           \"description\": \"Sends the raw buffers of the specified FiffStreamClient on the same host through shared memory (enable 1) or TCP (enable 0).\","
+            "           \"parameters\": {"
+            "               \"enable\": {"
+            "                   \"description\": \"Use shared memory\","
+            "                   \"type\": \"int\" "
+            "               },"
+            "               \"id\": {"
+            "                   \"description\": \"ID/Alias\","
+            "                   \"type\": \"QString\" "
+            "               }"
+            "           }"
+            "        },"
             "       \"start\": {"
             "           \"description\": \"Adds specified FiffStreamClient to raw data buffer receivers. If acquisition is not already started, it is triggered.\","
             "           \"parameters\": {"
@@ -65,6 +65,7 @@ FtConnector::FtConnector()
 ,m_iNumChannels(0)
 ,m_iPort(1972)
 ,m_bNewData(false)
+,m_bWaitPending(false)
 ,m_fSampleFreq(0)
 ,m_sAddress("127.0.0.1")
 ,m_pSocket(Q_NULLPTR)
@@ -120,6 +121,12 @@ bool FtConnector::getHeader()
 {
     qInfo() << "[FtConnector::getHeader] Attempting to get header...";
 
+    //Collect the response of a pipelined WAIT_DAT request before asking for the header
+    if(m_bWaitPending) {
+        qint32 iNumSamples;
+        receiveWaitResponse(iNumSamples);
+    }
+
     m_pSocket->readAll(); //Ensure receiving buffer is empty
 
     // Defining parameters to send a get header message to buffer
@@ -130,75 +137,38 @@ bool FtConnector::getHeader()
     // Send request to buffer
     sendRequest(messagedef);
 
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < sizeof (messagedef_t)) {
-        m_pSocket->waitForReadyRead(10);
-    }
-
     //Parse return message from buffer
-    QBuffer msgBuffer;
-    prepBuffer(msgBuffer, sizeof (messagedef_t));
-    int bufsize = parseMessageDef(msgBuffer);
+    messagedef_t response;
+    if(!receiveMessageDef(response)) {
+        return false;
+    }
 
-    if (bufsize == 0) {
+    if (response.bufsize == 0) {
         qInfo() << "[FtConnector::getHeader] No header data found";
         return false;
     }
 
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < bufsize) {
-        m_pSocket->waitForReadyRead(10);
+    //Parse header info from buffer
+    headerdef_t headerdef;
+    if(!readExact(reinterpret_cast<char*>(&headerdef), sizeof (headerdef_t))) { // if implementing header chunks: change from sizeof (headerdef) to bufsize
+        return false;
     }
 
-    //Parse header info from buffer
-    QBuffer hdrBuffer;
-    prepBuffer(hdrBuffer, sizeof (headerdef_t)); // if implementing header chunks: change from sizeof (headerdef) to bufsize
-    parseHeaderDef(hdrBuffer);
+    //Wait for the header chunks, they are read by parseNeuromagHeader
+    while(m_pSocket->bytesAvailable() < response.bufsize - qint64(sizeof (headerdef_t))) {
+        if(!m_pSocket->waitForReadyRead(RESPONSE_TIMEOUT)) {
+            break;
+        }
+    }
 
-    return true;
+    return parseHeaderDef(headerdef);
 }
 
 //=============================================================================================================
 
-bool FtConnector::parseHeaderDef(QBuffer &readBuffer)
+bool FtConnector::parseHeaderDef(const headerdef_t &headerdef)
 {
-    //Start parsing header parameters
     qInfo() << "[FtConnector::parseHeaderDef] Got header data. Parsing...";
-    headerdef_t headerdef;
-
-    //Get nchans, int32
-    char c_chans[sizeof(headerdef.nchans)];
-    readBuffer.read(c_chans, sizeof(headerdef.nchans));
-    std::memcpy(&headerdef.nchans, c_chans, sizeof(headerdef.nchans));
-
-    //Get nsamples, int32
-    char c_samples[sizeof(headerdef.nsamples)];
-    readBuffer.read(c_samples, sizeof(headerdef.nsamples));
-    std::memcpy(&headerdef.nsamples, c_samples, sizeof(headerdef.nsamples));
-
-    //Get nevents, int32
-    char c_events[sizeof(headerdef.nevents)];
-    readBuffer.read(c_events, sizeof(headerdef.nevents));
-    std::memcpy(&headerdef.nevents, c_events, sizeof(headerdef.nevents));
-
-    //Get fsample, float
-    char c_freqsamp[sizeof(headerdef.fsample)];
-    readBuffer.read(c_freqsamp, sizeof(headerdef.fsample));
-    std::memcpy(&headerdef.fsample, c_freqsamp, sizeof(headerdef.fsample));
-
-    //Get data_type, int32
-    char c_datatype[sizeof(headerdef.data_type)];
-    readBuffer.read(c_datatype, sizeof(headerdef.data_type));
-    std::memcpy(&headerdef.data_type, c_datatype, sizeof(headerdef.data_type));
-
-    //Get bufsize, int32
-    char c_bufsize[sizeof(headerdef.bufsize)];
-    readBuffer.read(c_bufsize, sizeof(headerdef.bufsize));
-    std::memcpy(&headerdef.bufsize, c_bufsize, sizeof(headerdef.bufsize));
-
-//        char c_[sizeof(headerdef.)];
-//        readBuffer.read(c_, sizeof(headerdef.));
-//        std::memcpy(&headerdef., c_, sizeof(headerdef.));
 
     //Save paramerters
     m_iNumChannels = headerdef.nchans;
@@ -209,7 +179,7 @@ bool FtConnector::parseHeaderDef(QBuffer &readBuffer)
 
     qInfo() << "[FtConnector::parseHeaderDef] Got header parameters.";
 
-    if (m_iDataType != 9) {
+    if (m_iDataType <= DATATYPE_CHAR || m_iDataType > DATATYPE_FLOAT64) {
         qCritical() << "Data type not supported. Plugin will not behave correctly.";
     }
 
@@ -218,26 +188,10 @@ bool FtConnector::parseHeaderDef(QBuffer &readBuffer)
 
 //=============================================================================================================
 
-int FtConnector::parseMessageDef(QBuffer &readBuffer)
+bool FtConnector::receiveMessageDef(messagedef_t &messagedef)
 {
-    messagedef_t response;
-
-    //Get version, int16
-    char c_version[sizeof(response.version)];
-    readBuffer.read(c_version, sizeof(response.version));
-    std::memcpy(&response.version, c_version, sizeof(response.version));
-
-    //Get command, int16
-    char c_command[sizeof(response.command)];
-    readBuffer.read(c_command, sizeof(response.command));
-    std::memcpy(&response.command, c_command, sizeof(response.command));
-
-    //Get bufsize, int32
-    char c_buffsize[sizeof(response.bufsize)];
-    readBuffer.read(c_buffsize, sizeof(response.bufsize));
-    std::memcpy(&response.bufsize, c_buffsize, sizeof(response.bufsize));
-
-    return response.bufsize;
+    //messagedef_t has no padding and is sent in native byte order, read it in one go
+    return readExact(reinterpret_cast<char*>(&messagedef), sizeof (messagedef_t));
 }
 
 //=============================================================================================================
@@ -255,14 +209,22 @@ void FtConnector::sendRequest(messagedef_t &messagedef)
 
 bool FtConnector::getData()
 {
-    m_iNumNewSamples = totalBuffSamples();
+    //Keep one WAIT_DAT request in flight
+    if(!m_bWaitPending) {
+        sendWaitRequest(m_iNumSamples);
+    }
 
-    if (m_iNumNewSamples == m_iNumSamples) {
+    qint32 iNumBuffSamples;
+    if(!receiveWaitResponse(iNumBuffSamples)) {
+        return false;
+    }
+
+    if (iNumBuffSamples <= m_iNumSamples) {
         // no new unread data in buffer
         return false;
     }
 
-    m_pSocket->readAll(); //Ensure receiving buffer is empty
+    m_iNumNewSamples = iNumBuffSamples;
 
     // Get data message + data selection params
     messagedef_t messagedef;
@@ -276,37 +238,18 @@ bool FtConnector::getData()
     sendRequest(messagedef);
     sendDataSel(datasel);
 
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < sizeof (messagedef_t)) {
-        m_pSocket->waitForReadyRead(10);
-    }
-
-    //Parse return message from buffer
-    QBuffer msgBuffer;
-    prepBuffer(msgBuffer, sizeof (messagedef_t));
-    int bufsize = parseMessageDef(msgBuffer);
-
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < bufsize) {
-        m_pSocket->waitForReadyRead(10);
-    }
+    //Queue the next WAIT_DAT right behind GET_DAT, the buffer answers it while we parse this block
+    sendWaitRequest(m_iNumNewSamples);
+    m_pSocket->flush();
 
-    //Parse return data def from buffer
-    QBuffer datadefBuffer;
-    prepBuffer(datadefBuffer, sizeof (datadef_t));
-    bufsize = parseDataDef(datadefBuffer);
+    bool bReceived = receiveData();
 
-    //Parse actual data from buffer
-    QBuffer datasampBuffer;
-    prepBuffer(datasampBuffer, bufsize);
-    parseData(datasampBuffer, bufsize);
-
-    //update sample tracking
+    //update sample tracking, a block that could not be received is skipped instead of requested again
     m_iNumSamples = m_iNumNewSamples;
 
     //echoStatus();
 
-    return true;
+    return bReceived;
 }
 
 //=============================================================================================================
@@ -340,38 +283,67 @@ void FtConnector::prepBuffer(QBuffer &buffer,
 
 //=============================================================================================================
 
-int FtConnector::parseDataDef(QBuffer &dataBuffer)
+bool FtConnector::receiveData()
 {
-    datadef_t datadef;
-
-    //Get nchans, int32
-    char c_chans[sizeof(datadef.nchans)];
-    dataBuffer.read(c_chans, sizeof(datadef.nchans));
-    std::memcpy(&datadef.nchans, c_chans, sizeof(datadef.nchans));
-
-    //Get nsamples, int32
-    char c_nsamples[sizeof(datadef.nsamples)];
-    dataBuffer.read(c_nsamples, sizeof(datadef.nsamples));
-    std::memcpy(&datadef.nsamples, c_nsamples, sizeof(datadef.nsamples));
+    messagedef_t response;
+    if(!receiveMessageDef(response)) {
+        return false;
+    }
 
-    //Get data_type, int32
-    char c_datatype[sizeof(datadef.data_type)];
-    dataBuffer.read(c_datatype, sizeof(datadef.data_type));
-    std::memcpy(&datadef.data_type, c_datatype, sizeof(datadef.data_type));
+    if(response.command != GET_OK || response.bufsize < qint32(sizeof (datadef_t))) {
+        qWarning() << "[FtConnector::receiveData] Buffer did not return data.";
+        m_pSocket->read(response.bufsize);
+        return false;
+    }
 
-    //Get bufsize, int32
-    char c_bufsize[sizeof(datadef.bufsize)];
-    dataBuffer.read(c_bufsize, sizeof(datadef.bufsize));
-    std::memcpy(&datadef.bufsize, c_bufsize, sizeof(datadef.bufsize));
+    datadef_t datadef;
+    if(!readExact(reinterpret_cast<char*>(&datadef), sizeof (datadef_t))) {
+        return false;
+    }
 
 //    if(datadef.nchans != m_iNumChannels) {
 //        qWarning() << "Data has different number of channels than expected.";
 //        return false;
 //    }
 
+    //Never size a read after an unchecked datadef, a corrupt header would allocate or read past the payload
+    int iWordSize = wordSize(datadef.data_type);
+    if(iWordSize == 0
+       || datadef.nchans <= 0
+       || datadef.nsamples < 0
+       || datadef.bufsize < 0
+       || datadef.bufsize != qint64(datadef.nchans) * datadef.nsamples * iWordSize
+       || datadef.bufsize != response.bufsize - qint64(sizeof (datadef_t))) {
+        qWarning() << "[FtConnector::receiveData] Data definition not supported or not matching the received message.";
+        //The pipeline is out of sync now, drop whatever is left
+        m_pSocket->readAll();
+        m_bWaitPending = false;
+        return false;
+    }
+
     m_iMsgSamples = datadef.nsamples;
 
-    return datadef.bufsize;
+    if(datadef.data_type == DATATYPE_FLOAT64) {
+        //Layout matches a column major matrix, read straight into it
+        m_matEmit.resize(datadef.nchans, datadef.nsamples);
+        if(!readExact(reinterpret_cast<char*>(m_matEmit.data()), datadef.bufsize)) {
+            return false;
+        }
+    } else {
+        m_baPayload.resize(datadef.bufsize);
+        if(!readExact(m_baPayload.data(), datadef.bufsize)) {
+            return false;
+        }
+
+        if(!convertSamples(m_baPayload.constData(), m_baPayload.size(), datadef.data_type, datadef.nchans, datadef.nsamples, m_matEmit)) {
+            return false;
+        }
+    }
+
+    //flag new data
+    m_bNewData = true;
+
+    return m_bNewData;
 }
 
 //=============================================================================================================
@@ -401,49 +373,90 @@ void FtConnector::echoStatus()
 
 int FtConnector::totalBuffSamples()
 {
-    m_pSocket->readAll(); //Ensure receiving buffer is empty
+    if(!m_bWaitPending) {
+        sendWaitRequest(m_iNumSamples);
+    }
+
+    qint32 iNumSamp = m_iNumSamples;
+    receiveWaitResponse(iNumSamp);
 
+    return iNumSamp;
+}
+
+//=============================================================================================================
+
+void FtConnector::sendWaitRequest(qint32 iThreshold)
+{
     messagedef_t messagedef;
     messagedef.bufsize = sizeof(samples_events_t) + sizeof (qint32);
     messagedef.command = WAIT_DAT;
 
     //Set threshold to return more than number samples read.
     samples_events_t threshold;
-    threshold.nsamples = m_iNumSamples;
+    threshold.nsamples = iThreshold;
     threshold.nevents = 0xFFFFFFFF;
 
     // timeout for waiting in milliseconds
-    qint32 timeout = 20;
+    qint32 timeout = WAIT_TIMEOUT;
 
     sendRequest(messagedef);
     sendSampleEvents(threshold);
     m_pSocket->write(reinterpret_cast<char*>(&timeout), sizeof (qint32));
 
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < sizeof (messagedef_t)) {
-        m_pSocket->waitForReadyRead(10);
+    m_bWaitPending = true;
+}
+
+//=============================================================================================================
+
+bool FtConnector::receiveWaitResponse(qint32 &iNumSamples)
+{
+    m_bWaitPending = false;
+
+    messagedef_t response;
+    if(!receiveMessageDef(response)) {
+        return false;
     }
 
-    //Parse return message from buffer
-    QBuffer msgBuffer;
-    prepBuffer(msgBuffer, sizeof (messagedef_t));
-    parseMessageDef(msgBuffer);
+    if(response.command != WAIT_OK || response.bufsize != qint32(sizeof (samples_events_t))) {
+        qWarning() << "[FtConnector::receiveWaitResponse] Buffer did not accept WAIT_DAT request.";
+        m_pSocket->read(response.bufsize);
+        return false;
+    }
 
-    //Waiting for response.
-    while(m_pSocket->bytesAvailable() < sizeof (samples_events_t)) {
-        m_pSocket->waitForReadyRead(10);
+    samples_events_t sampevents;
+    if(!readExact(reinterpret_cast<char*>(&sampevents), sizeof (samples_events_t))) {
+        return false;
     }
 
-    qint32 iNumSamp;
+    iNumSamples = sampevents.nsamples;
+
+    return true;
+}
+
+//=============================================================================================================
 
-    QBuffer sampeventsBuffer;
-    prepBuffer(sampeventsBuffer, sizeof(samples_events_t));
+bool FtConnector::readExact(char* pData,
+                            qint64 iNumBytes)
+{
+    qint64 iNumRead = 0;
+
+    while(iNumRead < iNumBytes) {
+        if(m_pSocket->bytesAvailable() == 0 && !m_pSocket->waitForReadyRead(RESPONSE_TIMEOUT)) {
+            qWarning() << "[FtConnector::readExact] Timed out waiting for buffer response.";
+            //The pipeline is out of sync now, drop whatever arrives late
+            m_pSocket->readAll();
+            m_bWaitPending = false;
+            return false;
+        }
 
-    char cSamps[sizeof(iNumSamp)];
-    sampeventsBuffer.read(cSamps, sizeof(iNumSamp));
-    std::memcpy(&iNumSamp, cSamps, sizeof(iNumSamp));
+        qint64 iRead = m_pSocket->read(pData + iNumRead, iNumBytes - iNumRead);
+        if(iRead < 0) {
+            return false;
+        }
+        iNumRead += iRead;
+    }
 
-    return iNumSamp;
+    return true;
 }
 
 //=============================================================================================================
@@ -456,43 +469,82 @@ void FtConnector::sendSampleEvents(samples_events_t &threshold)
 
 //=============================================================================================================
 
-bool FtConnector::parseData(QBuffer &datasampBuffer,
-                            int bufsize)
+int FtConnector::wordSize(qint32 iDataType)
 {
-    //start interpreting data as float instead of char
-    QByteArray dataArray = datasampBuffer.readAll();
-    float* fdata = (float*) dataArray.data();
-
-//TODO: Implement receiving other types of data
-//    switch (m_iDataType) {
-//        case DATATYPE_FLOAT32:
-//            auto data = reinterpret_cast<float*>(dataArray.data(), bufsize);
-//            qDebug() << "*** Would you look at that, we're all the way here ***";
-//            qDebug() << "Data sample:";
-
-//            for (int i = 0; i < 10 ; i++) {
-//                qDebug() << data[i];
-//            }
-//            break;
-//    }
+    switch (iDataType) {
+        case DATATYPE_UINT8:
+        case DATATYPE_INT8:
+            return 1;
+        case DATATYPE_UINT16:
+        case DATATYPE_INT16:
+            return 2;
+        case DATATYPE_UINT32:
+        case DATATYPE_INT32:
+        case DATATYPE_FLOAT32:
+            return 4;
+        case DATATYPE_UINT64:
+        case DATATYPE_INT64:
+        case DATATYPE_FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
 
-    //format data into eigen matrix to pass up
-    Eigen::MatrixXf matData;
-    matData.resize(m_iNumChannels, m_iMsgSamples);
+//=============================================================================================================
 
-    int count = 0;
-    for (int i = 0; i < int (m_iMsgSamples); i++) {
-        for (int j = 0; j < int (m_iNumChannels); j++) {
-            matData(j,i) = fdata[count];
-            count++;
-        }
+bool FtConnector::convertSamples(const char* pData,
+                                 qint64 iNumBytes,
+                                 qint32 iDataType,
+                                 int iNumChannels,
+                                 int iNumSamples,
+                                 Eigen::MatrixXd& matData)
+{
+    int iWordSize = wordSize(iDataType);
+    if(iWordSize == 0
+       || iNumChannels < 0
+       || iNumSamples < 0
+       || iNumBytes != qint64(iNumChannels) * iNumSamples * iWordSize) {
+        return false;
     }
 
-    //store and flag new data
-    m_pMatEmit = new Eigen::MatrixXd(matData.cast<double>());
-    m_bNewData = true;
+    //Samples are sent with channels varying fastest, which is the column major layout of a nchans x nsamples matrix
+    switch (iDataType) {
+        case DATATYPE_UINT8:
+            matData = Eigen::Map<const Eigen::Matrix<quint8, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const quint8*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_UINT16:
+            matData = Eigen::Map<const Eigen::Matrix<quint16, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const quint16*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_UINT32:
+            matData = Eigen::Map<const Eigen::Matrix<quint32, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const quint32*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_UINT64:
+            matData = Eigen::Map<const Eigen::Matrix<quint64, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const quint64*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_INT8:
+            matData = Eigen::Map<const Eigen::Matrix<qint8, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const qint8*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_INT16:
+            matData = Eigen::Map<const Eigen::Matrix<qint16, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const qint16*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_INT32:
+            matData = Eigen::Map<const Eigen::Matrix<qint32, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const qint32*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_INT64:
+            matData = Eigen::Map<const Eigen::Matrix<qint64, Eigen::Dynamic, Eigen::Dynamic> >(reinterpret_cast<const qint64*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_FLOAT32:
+            matData = Eigen::Map<const Eigen::MatrixXf>(reinterpret_cast<const float*>(pData), iNumChannels, iNumSamples).cast<double>();
+            break;
+        case DATATYPE_FLOAT64:
+            matData = Eigen::Map<const Eigen::MatrixXd>(reinterpret_cast<const double*>(pData), iNumChannels, iNumSamples);
+            break;
+        default:
+            return false;
+    }
 
-    return m_bNewData;
+    return true;
 }
 
 //=============================================================================================================
@@ -500,8 +552,6 @@ bool FtConnector::parseData(QBuffer &datasampBuffer,
 void FtConnector::resetEmitData()
 {
     m_bNewData = false;
-    delete m_pMatEmit;
-    m_pMatEmit = Q_NULLPTR;
 }
 
 //=============================================================================================================
@@ -516,9 +566,9 @@ bool FtConnector::disconnect()
 
 //=============================================================================================================
 
-Eigen::MatrixXd FtConnector::getMatrix()
+const Eigen::MatrixXd& FtConnector::getMatrix()
 {
-    return *m_pMatEmit;
+    return m_matEmit;
 }
 
 //=============================================================================================================
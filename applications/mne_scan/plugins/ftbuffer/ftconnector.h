@@ -98,6 +98,21 @@ namespace FTBUFFERPLUGIN
 #define PUT_DAT_NORESPONSE (qint16)0x0502 /* decimal 1282 */
 #define PUT_EVT_NORESPONSE (qint16)0x0503 /* decimal 1283 */
 
+#define DATATYPE_CHAR    (qint32)0
+#define DATATYPE_UINT8   (qint32)1
+#define DATATYPE_UINT16  (qint32)2
+#define DATATYPE_UINT32  (qint32)3
+#define DATATYPE_UINT64  (qint32)4
+#define DATATYPE_INT8    (qint32)5
+#define DATATYPE_INT16   (qint32)6
+#define DATATYPE_INT32   (qint32)7
+#define DATATYPE_INT64   (qint32)8
+#define DATATYPE_FLOAT32 (qint32)9
+#define DATATYPE_FLOAT64 (qint32)10
+
+#define WAIT_TIMEOUT     (qint32)20     /* ms the buffer waits for new samples before answering WAIT_DAT */
+#define RESPONSE_TIMEOUT 5000           /* ms we wait for a response of the buffer */
+
 //=============================================================================================================
 // STRUCT DEFINITIONS
 //=============================================================================================================
@@ -188,9 +203,11 @@ public:
 
     //=========================================================================================================
     /**
-     * equests and receives data from buffer, parses it, and stores it in m_pMatEmit
+     * Requests and receives data from buffer, parses it, and stores it in m_matEmit.
+     * Requests are pipelined: one WAIT_DAT request is always kept in flight, so the buffer already waits for the
+     * next samples while the current block is received and parsed.
      *
-     * @return true if successful, false if unsuccessful
+     * @return true if new data was received, false otherwise
      */
     bool getData();
 
@@ -238,11 +255,12 @@ public:
 
     //=========================================================================================================
     /**
-     * Returns member m_pMatEmit, newest buffer data formatted as an Eigen MatrixXd
+     * Returns member m_matEmit, newest buffer data formatted as an Eigen MatrixXd. The matrix is reused for the
+     * next block, copy it if it is needed after the next call to getData.
      *
-     * @return returns m_pMatEmit
+     * @return returns m_matEmit
      */
-    Eigen::MatrixXd getMatrix();
+    const Eigen::MatrixXd& getMatrix();
 
     //=========================================================================================================
     /**
@@ -254,7 +272,7 @@ public:
 
     //=========================================================================================================
     /**
-     * Sets m_bNewData to false, deletes m_pMatEmit
+     * Sets m_bNewData to false. m_matEmit is kept to receive the next block without reallocation.
      */
     void resetEmitData();
 
@@ -272,6 +290,38 @@ public:
      */
     void catchUpToBuffer();
 
+    //=========================================================================================================
+    /**
+     * Returns the size of a single sample of a FieldTrip data type.
+     *
+     * @param[in] iDataType     FieldTrip data type, see DATATYPE_xxx.
+     *
+     * @return the number of bytes per sample, 0 if the data type is not supported
+     */
+    static int wordSize(qint32 iDataType);
+
+    //=========================================================================================================
+    /**
+     * Converts sample data as sent by the buffer (channels varying fastest) to a nchans x nsamples matrix.
+     * The conversion is a single vectorized cast, matData is only reallocated if its size changes.
+     *
+     * @param[in] pData         Sample data.
+     * @param[in] iNumBytes     Number of bytes in pData.
+     * @param[in] iDataType     FieldTrip data type of the samples, see DATATYPE_xxx.
+     * @param[in] iNumChannels  Number of channels.
+     * @param[in] iNumSamples   Number of samples.
+     * @param[out] matData      The converted samples.
+     *
+     * @return true if successful, false if the data type is not supported or iNumBytes does not match the
+     *         number of channels and samples
+     */
+    static bool convertSamples(const char* pData,
+                               qint64 iNumBytes,
+                               qint32 iDataType,
+                               int iNumChannels,
+                               int iNumSamples,
+                               Eigen::MatrixXd& matData);
+
 private:
     //=========================================================================================================
     /**
@@ -299,45 +349,62 @@ private:
 
     //=========================================================================================================
     /**
-     * Parses headerdef message and saves parameters(channels, frequency, datatype, newsamples)
+     * Sends a WAIT_DAT request. The buffer answers once it holds more than iThreshold samples or after
+     * WAIT_TIMEOUT ms.
      *
-     * @param[in] readBuffer    QBuffer with return headerdef_t data from buffer
+     * @param[in] iThreshold    Number of samples the buffer has to exceed.
+     */
+    void sendWaitRequest(qint32 iThreshold);
+
+    //=========================================================================================================
+    /**
+     * Receives the response to the pending WAIT_DAT request.
+     *
+     * @param[out] iNumSamples  Total number of samples in the buffer.
      *
      * @return true if successful, false if unsuccessful
      */
-    bool parseHeaderDef(QBuffer &readBuffer);
+    bool receiveWaitResponse(qint32 &iNumSamples);
 
     //=========================================================================================================
     /**
-     * Parses messadef and returns bufsize
+     * Receives the response to a GET_DAT request and converts the samples directly into m_matEmit
      *
-     * @param[in] readBuffer    QBuffer with return messagedef_t data from buffer
+     * @return true if successful, false if unsuccessful
+     */
+    bool receiveData();
+
+    //=========================================================================================================
+    /**
+     * Receives a messagedef response
      *
-     * @return returns messagedef_t.bufsize
+     * @param[out] messagedef   The received messagedef.
+     *
+     * @return true if successful, false if unsuccessful
      */
-    int parseMessageDef(QBuffer &readBuffer);
+    bool receiveMessageDef(messagedef_t &messagedef);
 
     //=========================================================================================================
     /**
-     * Parses datadef and returns bufsize
+     * Reads exactly iNumBytes from the socket, waiting for them to arrive if necessary.
      *
-     * @param[in] dataBuffer    QBuffer with return datadef_t data from buffer
+     * @param[out] pData        Where to store the read bytes.
+     * @param[in] iNumBytes     How many bytes to read from socket.
      *
-     * @return returns datadef_t.bufsize
+     * @return true if successful, false if the bytes did not arrive within RESPONSE_TIMEOUT
      */
-    int parseDataDef(QBuffer &dataBuffer);
+    bool readExact(char* pData,
+                   qint64 iNumBytes);
 
     //=========================================================================================================
     /**
-     * Parses sample data received from buffer, formates it and saves it to m_pMatEmit;
+     * Saves the parameters of a headerdef received from the buffer (channels, frequency, datatype, newsamples)
      *
-     * @param[in] datasampBuffer    QBuffer with return data from buffer
-     * @param[in] bufsize           Buffer size of sample data
+     * @param[in] headerdef     Headerdef received from the buffer.
      *
      * @return true if successful, false if unsuccessful
      */
-    bool parseData(QBuffer &datasampBuffer,
-                   int bufsize);
+    bool parseHeaderDef(const headerdef_t &headerdef);
 
     //=========================================================================================================
     /**
@@ -366,6 +433,7 @@ private:
     int                                     m_iPort;                                /**< Port where the ft bufferis found */
 
     bool                                    m_bNewData;                             /**< Indicate whether we've received new data */
+    bool                                    m_bWaitPending;                         /**< Indicate whether a WAIT_DAT request is in flight */
 
     float                                   m_fSampleFreq;                          /**< Sampling frequency of data in the buffer */
 
@@ -373,7 +441,9 @@ private:
 
     QTcpSocket*                             m_pSocket;                              /**< Socket that manages the connection to the ft buffer */
 
-    Eigen::MatrixXd*                        m_pMatEmit;                             /**< Container to format data to tansmit to FtBuffProducer */
+    QByteArray                              m_baPayload;                            /**< Reused receive buffer for sample data that needs conversion */
+
+    Eigen::MatrixXd                         m_matEmit;                              /**< Container to format data to tansmit to FtBuffProducer */
 };
 
 }//namespace end bracket
@@ -272,14 +272,6 @@ void NeuronalConnectivity::updateSource(SCMEASLIB::Measurement::SPtr pMeasuremen
 
             m_iBlockSize = pRTSE->getValue().first()->data.cols() - iZeroIdx;
 
-            // Check row and colum integrity and restart if necessary
-            if(m_connectivitySettings.size() != 0) {
-                if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                    m_connectivitySettings.clearAllData();
-                    m_pRtConnectivity->restart();
-                }
-            }
-
             // No copy necessary since we do a deep copy in connectivity settings before the measurement
             // overwrites the matrix
             m_connectivitySettings.append(pRTSE->getValue()[i]->data.block(0,
@@ -288,14 +280,10 @@ void NeuronalConnectivity::updateSource(SCMEASLIB::Measurement::SPtr pMeasuremen
                                                                            pRTSE->getValue()[i]->data.cols() - iZeroIdx));
         }
 
-        //Pop data from buffer
-        if(m_connectivitySettings.size() >= m_iNumberAverages) {
-            m_pRtConnectivity->restart();
-            m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
-        }
-
+        // Only send the new trials. The sliding trial window is kept by the real-time connectivity worker.
         m_timer.restart();
-        m_pRtConnectivity->append(m_connectivitySettings);
+        m_pRtConnectivity->append(m_connectivitySettings, m_iNumberAverages);
+        m_connectivitySettings.clearAllData();
     }
 }
 
@@ -340,14 +328,6 @@ void NeuronalConnectivity::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement
                 const MatrixXd& t_mat = pRTMSA->getMultiSampleArray()[i];
                 m_iBlockSize = pRTMSA->getMultiSampleArray()[i].cols();
 
-                // Check row and colum integrity and restart if necessary
-                if(m_connectivitySettings.size() != 0) {
-                    if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                        m_connectivitySettings.clearAllData();
-                        m_pRtConnectivity->restart();
-                    }
-                }
-
                 data.resize(m_vecPicks.cols(), t_mat.cols());
 
                 for(qint32 j = 0; j < m_vecPicks.cols(); ++j) {
@@ -357,14 +337,10 @@ void NeuronalConnectivity::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement
                 m_connectivitySettings.append(data);
             }
 
-            //Pop data from buffer
-            if(m_connectivitySettings.size() > m_iNumberAverages) {
-                m_pRtConnectivity->restart();
-                m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
-            }
-
+            // Only send the new trials. The sliding trial window is kept by the real-time connectivity worker.
             m_timer.restart();
-            m_pRtConnectivity->append(m_connectivitySettings);
+            m_pRtConnectivity->append(m_connectivitySettings, m_iNumberAverages);
+            m_connectivitySettings.clearAllData();
         }
     }
 }
@@ -423,14 +399,6 @@ void NeuronalConnectivity::updateRTEV(SCMEASLIB::Measurement::SPtr pMeasurement)
 
                     m_iBlockSize = t_mat.cols();
 
-                    // Check row and colum integrity and restart if necessary
-                    if(m_connectivitySettings.size() != 0) {
-                        if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                            m_connectivitySettings.clearAllData();
-                            m_pRtConnectivity->restart();
-                        }
-                    }
-
                     MatrixXd data;
                     data.resize(m_vecPicks.cols(), t_mat.cols());
 
@@ -440,14 +408,10 @@ void NeuronalConnectivity::updateRTEV(SCMEASLIB::Measurement::SPtr pMeasurement)
 
                     m_connectivitySettings.append(data);
 
-                    //Pop data from buffer
-                    if(m_connectivitySettings.size() > m_iNumberAverages) {
-                        m_pRtConnectivity->restart();
-                        m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
-                    }
-
+                    // Only send the new trial. The sliding trial window is kept by the real-time connectivity worker.
                     m_timer.restart();
-                    m_pRtConnectivity->append(m_connectivitySettings);
+                    m_pRtConnectivity->append(m_connectivitySettings, m_iNumberAverages);
+                    m_connectivitySettings.clearAllData();
 
                     break;
                 }
@@ -542,8 +506,7 @@ void NeuronalConnectivity::run()
 void NeuronalConnectivity::onNewConnectivityResultAvailable(const QList<Network>& connectivityResults,
                                                             const ConnectivitySettings& connectivitySettings)
 {
-    m_connectivitySettings = connectivitySettings;
-    m_connectivitySettings.setConnectivityMethods(m_sConnectivityMethods);
+    Q_UNUSED(connectivitySettings)
 
     for(int i = 0; i < connectivityResults.size(); ++i) {
         m_pCircularBuffer->push(connectivityResults.at(i));
@@ -561,8 +524,8 @@ void NeuronalConnectivity::onMetricChanged(const QString& sMetric)
     m_sConnectivityMethods = QStringList() << sMetric;
     m_connectivitySettings.setConnectivityMethods(m_sConnectivityMethods);
     if(m_pRtConnectivity && this->isRunning()) {
-        m_pRtConnectivity->restart();
-        m_pRtConnectivity->append(m_connectivitySettings);
+        // Recompute the current trial window with the new metric
+        m_pRtConnectivity->append(m_connectivitySettings, m_iNumberAverages);
     }
 }
 
@@ -589,6 +552,7 @@ void NeuronalConnectivity::onTriggerTypeChanged(const QString& triggerType)
 {
     if(triggerType != m_sAvrType) {
         m_connectivitySettings.clearAllData();
+        m_pRtConnectivity->restart();
         m_sAvrType = triggerType;
     }
 }
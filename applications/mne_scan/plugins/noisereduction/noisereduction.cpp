@@ -87,6 +87,10 @@ NoiseReduction::NoiseReduction()
 , m_bFilterActivated(false)
 , m_bProjActivated(false)
 , m_bCompActivated(false)
+, m_bSpatialOperatorActive(false)
+, m_bPostFilterOperatorActive(false)
+, m_bSpatialOperatorDense(false)
+, m_bPostFilterOperatorDense(false)
 , m_sCurrentSystem("VectorView")
 , m_iMaxFilterLength(1)
 , m_pCircularBuffer(QSharedPointer<IOBUFFER::CircularBuffer_Matrix_double>::create(40))
@@ -198,16 +202,10 @@ void NoiseReduction::update(SCMEASLIB::Measurement::SPtr pMeasurement)
             m_pFiffInfo = pRTMSA->info();
 
             //Init the multiplication matrices
-            m_matSparseProjMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
-            m_matSparseCompMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
             m_matSparseSpharaMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
-            m_matSparseProjCompMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
             m_matSparseFull = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
 
-            m_matSparseProjMult.setIdentity();
-            m_matSparseCompMult.setIdentity();
             m_matSparseSpharaMult.setIdentity();
-            m_matSparseProjCompMult.setIdentity();
             m_matSparseFull.setIdentity();
 
             //Init output
@@ -305,6 +303,7 @@ void NoiseReduction::setSpharaActive(bool state)
 {
     m_mutex.lock();
     m_bSpharaActive = state;
+    updateSpatialOperator();
     m_mutex.unlock();
 }
 
@@ -339,22 +338,26 @@ void NoiseReduction::run()
         // Get the current data
         if(m_pCircularBuffer->pop(matData)) {
             m_mutex.lock();
-            //Do SSP's and compensators here
-            if(m_bCompActivated) {
-                if(m_bProjActivated) {
-                    //Comp + Proj
-                    matData = m_matSparseProjCompMult * matData;
-                } else {
-                    //Comp
-                    matData = m_matSparseCompMult * matData;
-                }
-            } else {
-                if(m_bProjActivated) {
-                    //Proj
-                    matData = m_matSparseProjMult * matData;
+            //Bad channels can change without notification
+            if(m_lOperatorBads != m_pFiffInfo->bads) {
+                //The bad channels are excluded from the SSP's as well
+                m_projOperator.updateProjection(m_lProjs, m_pFiffInfo->ch_names, m_pFiffInfo->bads);
+                updateSpatialOperator();
+            }
+
+            //Do compensators and SSP's here, the projector is applied in its low-rank form
+            if((m_bCompActivated || m_bProjActivated) && m_projOperator.getNumChannels() == matData.rows()) {
+                matData = m_projOperator.apply(matData, m_bProjActivated, m_bCompActivated);
+            }
+
+            //Do bad channel masking and SPHARA here with one multiplication
+            if(m_bSpatialOperatorActive && m_matSparseFull.cols() == matData.rows()) {
+                if(m_bSpatialOperatorDense) {
+                    m_matDataSpatial.noalias() = m_matSpatialOperator * matData;
                 } else {
-                    //None - Raw
+                    m_matDataSpatial.noalias() = m_matSparseFull * matData;
                 }
+                matData.swap(m_matDataSpatial);
             }
 
             //Do temporal filtering here
@@ -367,14 +370,14 @@ void NoiseReduction::run()
                                                      list);
             }
 
-            //Do SPHARA here
-            if(m_bSpharaActive) {
-                //Set bad channels to zero so they do not get smeared into
-                for(int i = 0; i < m_pFiffInfo->bads.size(); ++i) {
-                    matData.row(m_pFiffInfo->ch_names.indexOf(m_pFiffInfo->bads.at(i))).setZero();
+            //Do SPHARA here in case it could not be merged into the spatial operator
+            if(m_bPostFilterOperatorActive && m_matSparsePostFilter.cols() == matData.rows()) {
+                if(m_bPostFilterOperatorDense) {
+                    m_matDataSpatial.noalias() = m_matPostFilterOperator * matData;
+                } else {
+                    m_matDataSpatial.noalias() = m_matSparsePostFilter * matData;
                 }
-
-                matData = m_matSparseSpharaMult * matData;
+                matData.swap(m_matDataSpatial);
             }
 
     //        //Common average
@@ -425,43 +428,11 @@ void NoiseReduction::updateProjection(const QList<FIFFLIB::FiffProj>& projs)
             }
         }
 
-        MatrixXd matProj;
-        FiffProj::make_projector(projs, m_pFiffInfo->ch_names, matProj, m_pFiffInfo->bads);
-
-        //set columns of matrix to zero depending on bad channels indexes
-        for(qint32 j = 0; j < m_pFiffInfo->bads.size(); ++j) {
-            int index = m_pFiffInfo->ch_names.indexOf(m_pFiffInfo->bads.at(j));
-            if(index >= 0 && index<m_pFiffInfo->ch_names.size()) {
-                matProj.col(index).setZero();
-            }
-        }
-
-        // Make proj sparse
-        qint32 nchan = this->m_pFiffInfo->nchan;
-        qint32 i, k;
-
-        typedef Eigen::Triplet<double> T;
-        std::vector<T> tripletList;
-        tripletList.reserve(nchan);
-
-        tripletList.clear();
-        tripletList.reserve(matProj.rows()*matProj.cols());
-        for(i = 0; i < matProj.rows(); ++i) {
-            for(k = 0; k < matProj.cols(); ++k) {
-                if(matProj(i,k) != 0) {
-                    tripletList.push_back(T(i, k, matProj(i,k)));
-                }
-            }
-        }
-
-        m_matSparseProjMult = SparseMatrix<double>(matProj.rows(),matProj.cols());
-        if(tripletList.size() > 0)
-            m_matSparseProjMult.setFromTriplets(tripletList.begin(), tripletList.end());
-
-        //Create full multiplication matrix
-        m_matSparseProjCompMult = m_matSparseProjMult * m_matSparseCompMult;
+        //The operator is only rebuilt if the active projectors or the bad channels changed
+        m_lProjs = projs;
+        m_projOperator.updateProjection(m_lProjs, m_pFiffInfo->ch_names, m_pFiffInfo->bads);
 
-        m_matSparseFull = m_matSparseProjMult * m_matSparseCompMult;
+        updateSpatialOperator();
         m_mutex.unlock();
     }
 }
@@ -473,6 +444,8 @@ void NoiseReduction::updateCompensator(int to)
     // Update the compensator
     if(m_pFiffInfo)
     {
+        QMutexLocker locker(&m_mutex);
+
         if(to == 0) {
             m_bCompActivated = false;
         } else {
@@ -483,41 +456,12 @@ void NoiseReduction::updateCompensator(int to)
 //        qDebug()<<"from"<<from;
 //        qDebug()<<"m_bCompActivated"<<m_bCompActivated;
 
-        FiffCtfComp newComp;
-        this->m_pFiffInfo->make_compensator(0, to, newComp);//Do this always from 0 since we always read new raw data, we never actually perform a multiplication on already existing data
+        //Do this always from 0 since we always read new raw data, we never actually perform a multiplication on already existing data
+        m_projOperator.updateCompensator(*m_pFiffInfo, to);
 
         this->m_pFiffInfo->set_current_comp(to);
-        MatrixXd matComp = newComp.data->data;
-
-        //
-        // Make proj sparse
-        //
-        qint32 nchan = this->m_pFiffInfo->nchan;
-        qint32 i, k;
-
-        typedef Eigen::Triplet<double> T;
-        std::vector<T> tripletList;
-        tripletList.reserve(nchan);
-
-        tripletList.clear();
-        tripletList.reserve(matComp.rows()*matComp.cols());
-        for(i = 0; i < matComp.rows(); ++i) {
-            for(k = 0; k < matComp.cols(); ++k) {
-                if(matComp(i,k) != 0) {
-                    tripletList.push_back(T(i, k, matComp(i,k)));
-                }
-            }
-        }
-
-        m_matSparseCompMult = SparseMatrix<double>(matComp.rows(),matComp.cols());
-        if(tripletList.size() > 0) {
-            m_matSparseCompMult.setFromTriplets(tripletList.begin(), tripletList.end());
-        }
-
-        //Create full multiplication matrix
-        m_matSparseProjCompMult = m_matSparseProjMult * m_matSparseCompMult;
 
-        m_matSparseFull = m_matSparseProjMult * m_matSparseCompMult;
+        updateSpatialOperator();
     }
 }
 
@@ -546,6 +490,8 @@ void NoiseReduction::setFilterChannelType(QString sType)
             }
         }
     }
+
+    updateSpatialOperator();
     m_mutex.unlock();
 }
 
@@ -567,7 +513,10 @@ void NoiseReduction::setFilter(const FilterData& filterData)
 
 void NoiseReduction::setFilterActive(bool state)
 {
+    m_mutex.lock();
     m_bFilterActivated = state;
+    updateSpatialOperator();
+    m_mutex.unlock();
 }
 
 //=============================================================================================================
@@ -703,7 +652,94 @@ void NoiseReduction::createSpharaOperator()
     //Create full multiplication matrix
     m_matSparseSpharaMult = matSparseSpharaMultFirst * matSparseSpharaMultSecond;
 
-    m_matSparseFull = m_matSparseProjMult * m_matSparseCompMult;
+    updateSpatialOperator();
 
     m_mutex.unlock();
 }
+
+//=============================================================================================================
+
+void NoiseReduction::updateSpatialOperator()
+{
+    if(!m_pFiffInfo) {
+        return;
+    }
+
+    int iNChannels = m_pFiffInfo->chs.size();
+    m_lOperatorBads = m_pFiffInfo->bads;
+
+    //Set bad channels to zero so they do not get smeared into by SPHARA
+    SparseMatrix<double> matPostFilter(iNChannels, iNChannels);
+
+    if(m_bSpharaActive) {
+        VectorXd vecBadMask = VectorXd::Ones(iNChannels);
+
+        for(int i = 0; i < m_lOperatorBads.size(); ++i) {
+            int iIdx = m_pFiffInfo->ch_names.indexOf(m_lOperatorBads.at(i));
+            if(iIdx >= 0 && iIdx < iNChannels) {
+                vecBadMask[iIdx] = 0.0;
+            }
+        }
+
+        matPostFilter = m_matSparseSpharaMult * vecBadMask.asDiagonal();
+    } else {
+        matPostFilter.setIdentity();
+    }
+
+    //The post filter operator can be moved in front of the filter if it only mixes channels which are either all
+    //filtered or all unfiltered, since all channels are delayed equally by the filter
+    bool bCommutesWithFilter = true;
+
+    if(m_bFilterActivated && m_bSpharaActive) {
+        VectorXi vecIsFiltered = VectorXi::Zero(iNChannels);
+        for(int i = 0; i < m_lFilterChannelList.cols(); ++i) {
+            if(m_lFilterChannelList[i] < iNChannels) {
+                vecIsFiltered[m_lFilterChannelList[i]] = 1;
+            }
+        }
+
+        for(int k = 0; k < matPostFilter.outerSize() && bCommutesWithFilter; ++k) {
+            for(SparseMatrix<double>::InnerIterator it(matPostFilter,k); it; ++it) {
+                if(vecIsFiltered[it.row()] != vecIsFiltered[it.col()]) {
+                    bCommutesWithFilter = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    m_bSpatialOperatorActive = m_bSpharaActive && bCommutesWithFilter;
+    m_bPostFilterOperatorActive = m_bSpharaActive && !bCommutesWithFilter;
+
+    if(m_bSpatialOperatorActive) {
+        m_matSparseFull = matPostFilter;
+    } else {
+        m_matSparseFull.resize(0,0);
+    }
+
+    if(m_bPostFilterOperatorActive) {
+        m_matSparsePostFilter = matPostFilter;
+    } else {
+        m_matSparsePostFilter.resize(0,0);
+    }
+
+    //The dense product is only faster once a considerable part of the operator is filled
+    double dTotal = qMax(1.0, double(iNChannels) * double(iNChannels));
+
+    m_bSpatialOperatorDense = m_bSpatialOperatorActive
+                              && m_matSparseFull.nonZeros() / dTotal > SPATIAL_OPERATOR_DENSE_FILL;
+    m_bPostFilterOperatorDense = m_bPostFilterOperatorActive
+                                 && m_matSparsePostFilter.nonZeros() / dTotal > SPATIAL_OPERATOR_DENSE_FILL;
+
+    if(m_bSpatialOperatorDense) {
+        m_matSpatialOperator = MatrixXd(m_matSparseFull);
+    } else {
+        m_matSpatialOperator.resize(0,0);
+    }
+
+    if(m_bPostFilterOperatorDense) {
+        m_matPostFilterOperator = MatrixXd(m_matSparsePostFilter);
+    } else {
+        m_matPostFilterOperator.resize(0,0);
+    }
+}
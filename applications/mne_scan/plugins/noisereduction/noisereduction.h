@@ -45,18 +45,27 @@
 #include <utils/generics/circularbuffer.h>
 #include <utils/filterTools/filterdata.h>
 #include <fiff/fiff_proj.h>
+#include <fiff/fiff_proj_operator.h>
 #include <scShared/Interfaces/IAlgorithm.h>
 
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
+#include <QStringList>
+
 //=============================================================================================================
 // EIGEN INCLUDES
 //=============================================================================================================
 
 #include <Eigen/SparseCore>
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define SPATIAL_OPERATOR_DENSE_FILL     0.25    /**< Fill ratio of a spatial operator above which it is applied as dense matrix. */
+
 //=============================================================================================================
 // FORWARD DECLARATIONS
 //=============================================================================================================
@@ -218,6 +227,14 @@ protected:
      */
     void createSpharaOperator();
 
+    //=========================================================================================================
+    /**
+     * Creates the bad channel mask and SPHARA operator, which is applied before the temporal filter right after the
+     * compensator and projector. If the filter is active and the SPHARA operator mixes filtered with unfiltered
+     * channels, it is applied after the filter instead. m_mutex needs to be locked.
+     */
+    void updateSpatialOperator();
+
 private:
     QMutex                          m_mutex;                                    /**< The threads mutex.*/
 
@@ -225,6 +242,10 @@ private:
     bool                            m_bSpharaActive;                            /**< Flag whether thread is running.*/
     bool                            m_bProjActivated;                           /**< Projections activated */
     bool                            m_bFilterActivated;                         /**< Projections activated */
+    bool                            m_bSpatialOperatorActive;                   /**< Whether m_matSpatialOperator needs to be applied */
+    bool                            m_bPostFilterOperatorActive;                /**< Whether m_matPostFilterOperator needs to be applied */
+    bool                            m_bSpatialOperatorDense;                    /**< Whether the spatial operator is applied as dense m_matSpatialOperator instead of m_matSparseFull */
+    bool                            m_bPostFilterOperatorDense;                 /**< Whether the post filter operator is applied as dense m_matPostFilterOperator instead of m_matSparsePostFilter */
 
     int                             m_iNBaseFctsFirst;                          /**< The number of grad/inner base functions to use for calculating the sphara opreator.*/
     int                             m_iNBaseFctsSecond;                         /**< The number of grad/outer base functions to use for calculating the sphara opreator.*/
@@ -243,10 +264,17 @@ private:
     Eigen::VectorXi                 m_vecIndicesFirstEEG;                       /**< The indices of the channels to pick for the second SPHARA operator in case of an EEG system.*/
 
     Eigen::SparseMatrix<double>     m_matSparseSpharaMult;                      /**< The final sparse SPHARA operator .*/
-    Eigen::SparseMatrix<double>     m_matSparseProjCompMult;                    /**< The final sparse projection + compensator operator.*/
-    Eigen::SparseMatrix<double>     m_matSparseProjMult;                        /**< The final sparse SSP projector */
-    Eigen::SparseMatrix<double>     m_matSparseCompMult;                        /**< The final sparse compensator matrix */
-    Eigen::SparseMatrix<double>     m_matSparseFull;                            /**< The final sparse full multiplication matrix  */
+    FIFFLIB::FiffProjOperator       m_projOperator;                             /**< The cached SSP projector and compensator */
+
+    Eigen::SparseMatrix<double>     m_matSparseFull;                            /**< The bad channel mask and SPHARA operator applied before filtering.*/
+
+    Eigen::SparseMatrix<double>     m_matSparsePostFilter;                      /**< The bad channel mask and SPHARA operator in case it cannot be applied before filtering.*/
+
+    Eigen::MatrixXd                 m_matSpatialOperator;                       /**< Dense version of m_matSparseFull. Only set if its fill ratio exceeds SPATIAL_OPERATOR_DENSE_FILL.*/
+    Eigen::MatrixXd                 m_matPostFilterOperator;                    /**< Dense version of m_matSparsePostFilter. Only set if its fill ratio exceeds SPATIAL_OPERATOR_DENSE_FILL.*/
+    Eigen::MatrixXd                 m_matDataSpatial;                           /**< Reused result buffer for the spatial operators.*/
+    QStringList                     m_lOperatorBads;                            /**< The bad channels the spatial operators were created with.*/
+    QList<FIFFLIB::FiffProj>        m_lProjs;                                   /**< The projectors last selected in the projector view.*/
 
     Eigen::MatrixXd                 m_matSpharaVVGradLoaded;                    /**< The loaded VectorView gradiometer basis functions.*/
     Eigen::MatrixXd                 m_matSpharaVVMagLoaded;                     /**< The loaded VectorView magnetometer basis functions.*/
@@ -104,6 +104,7 @@ RtcMne::RtcMne()
 , m_pCircularEvokedBuffer(CircularBuffer<FIFFLIB::FiffEvoked>::SPtr::create(40))
 , m_bEvokedInput(false)
 , m_bRawInput(false)
+, m_bChannelMapWarned(false)
 {
 }
 
@@ -417,6 +418,7 @@ void RtcMne::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement)
         m_qMutex.lock();
         if(!m_pFiffInfoInput) {
             m_pFiffInfoInput = pRTMSA->info();
+            m_bChannelMapWarned = false;
             m_iNumAverages = 1;
             m_bRawInput = true;
         }
@@ -427,14 +429,19 @@ void RtcMne::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement)
         }
 
         if(this->isRunning()) {
-            // Check for artifacts
-            QMap<QString,double> mapReject;
-            mapReject.insert("eog", 150e-06);
+            // Check for artifacts. Recreate the per channel thresholds only if the channels or the bad channels changed.
+            if(m_vecArtifactThresholds.rows() != m_pFiffInfoInput->chs.size() || m_lArtifactThresholdBads != m_pFiffInfoInput->bads) {
+                QMap<QString,double> mapReject;
+                mapReject.insert("eog", 150e-06);
+
+                m_vecArtifactThresholds = MNEEpochDataList::makeArtifactThresholds(*m_pFiffInfoInput,
+                                                                                   mapReject);
+                m_lArtifactThresholdBads = m_pFiffInfoInput->bads;
+            }
 
             for(qint32 i = 0; i < pRTMSA->getMultiSampleArray().size(); ++i) {
                 bool bArtifactDetected = MNEEpochDataList::checkForArtifact(pRTMSA->getMultiSampleArray()[i],
-                                                                            *m_pFiffInfoInput,
-                                                                            mapReject);
+                                                                            m_vecArtifactThresholds);
 
                 if(!bArtifactDetected) {
                     // Please note that we do not need a copy here since this function will block until
@@ -497,6 +504,7 @@ void RtcMne::updateRTE(SCMEASLIB::Measurement::SPtr pMeasurement)
             for(int i = 0; i < pFiffEvokedSet->evoked.size(); ++i) {
                 if(pFiffEvokedSet->evoked.at(i).comment == m_sAvrType) {
                     m_pFiffInfoInput = QSharedPointer<FiffInfo>(new FiffInfo(pFiffEvokedSet->evoked.at(i).info));
+                    m_bChannelMapWarned = false;
                     break;
                 }
             }
@@ -536,11 +544,14 @@ void RtcMne::updateInvOp(const MNEInverseOperator& invOp)
     QMutexLocker locker(&m_qMutex);
 
     m_invOp = invOp;
+    m_vecChannelMap.resize(0);
+    m_bChannelMapWarned = false;
 
     double snr = 1.0;
     double lambda2 = 1.0 / pow(snr, 2); //ToDo estimate lambda using covariance
 
     m_pMinimumNorm = MinimumNorm::SPtr(new MinimumNorm(m_invOp, lambda2, m_sMethod));
+    m_pMinimumNorm->setSinglePrecision(true);
 
     //Set up the inverse according to the parameters
     // Use 1 nave here because in case of evoked data as input the minimum norm will always be updated when the source estimate is calculated (see run method).
@@ -559,6 +570,7 @@ void RtcMne::onMethodChanged(const QString& method)
         double snr = 1.0;
         double lambda2 = 1.0 / pow(snr, 2); //ToDo estimate lambda using covariance
         m_pMinimumNorm = MinimumNorm::SPtr(new MinimumNorm(m_invOp, lambda2, m_sMethod));
+        m_pMinimumNorm->setSinglePrecision(true);
 
         // Set up the inverse according to the parameters.
         // Use 1 nave here because in case of evoked data as input the minimum norm will always be updated when the source estimate is calculated (see run method).
@@ -592,6 +604,34 @@ void RtcMne::onTimePointValueChanged(int iTimePointMs)
 
 //=============================================================================================================
 
+bool RtcMne::updateChannelMap()
+{
+    if(!m_pFiffInfoInput || !m_invOp.noise_cov) {
+        return false;
+    }
+
+    const QStringList& lChNames = m_invOp.noise_cov.constData()->names;
+    m_vecChannelMap.resize(lChNames.size());
+
+    for(int j = 0; j < lChNames.size(); ++j) {
+        m_vecChannelMap[j] = m_pFiffInfoInput->ch_names.indexOf(lChNames.at(j));
+
+        if(m_vecChannelMap[j] < 0) {
+            //run() retries with every block, so only warn once
+            if(!m_bChannelMapWarned) {
+                qWarning() << "RtcMne::updateChannelMap - Channel" << lChNames.at(j) << "of the inverse operator is not present in the input data.";
+                m_bChannelMapWarned = true;
+            }
+            m_vecChannelMap.resize(0);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
 void RtcMne::run()
 {
     // Wait for fiff info and minimum norm instance
@@ -614,8 +654,10 @@ void RtcMne::run()
     FiffEvoked evoked;
     MatrixXd matData;
     MatrixXd matDataResized;
+    MatrixXf matDataPicked;
     qint32 j;
     int iTimePointSps = 0;
+    int iFirstCol, iNumberCols;
     float tmin, tstep;
     MNESourceEstimate sourceEstimate;
     bool bEvokedInput = false;
@@ -634,19 +676,33 @@ void RtcMne::run()
             if(((skip_count % m_iDownSample) == 0)) {
                 // Get the current raw data
                 if(m_pCircularMatrixBuffer->pop(matData)) {
-                    //Pick the same channels as in the inverse operator
                     m_qMutex.lock();
-                    matDataResized.resize(m_invOp.noise_cov->names.size(), matData.cols());
 
-                    for(j = 0; j < m_invOp.noise_cov->names.size(); ++j) {
-                        matDataResized.row(j) = matData.row(m_pFiffInfoInput->ch_names.indexOf(m_invOp.noise_cov->names.at(j)));
+                    if(m_vecChannelMap.size() == 0 && !updateChannelMap()) {
+                        m_qMutex.unlock();
+                        continue;
+                    }
+
+                    //Only the displayed time point needs to be computed. Use the full block if it is not part of this block.
+                    if(iTimePointSps < matData.cols() && iTimePointSps >= 0) {
+                        iFirstCol = iTimePointSps;
+                        iNumberCols = 1;
+                    } else {
+                        iFirstCol = 0;
+                        iNumberCols = matData.cols();
+                    }
+
+                    //Pick the same channels as in the inverse operator. The kernel is applied in single precision.
+                    matDataPicked.resize(m_vecChannelMap.size(), iNumberCols);
+
+                    for(j = 0; j < m_vecChannelMap.size(); ++j) {
+                        matDataPicked.row(j) = matData.row(m_vecChannelMap[j]).segment(iFirstCol, iNumberCols).cast<float>();
                     }
 
-                    tmin = 0.0f;
                     tstep = 1.0f / m_pFiffInfoInput->sfreq;
+                    tmin = iFirstCol * tstep;
 
-                    //TODO: Add picking here. See evoked part as input.
-                    sourceEstimate = m_pMinimumNorm->calculateInverse(matDataResized,
+                    sourceEstimate = m_pMinimumNorm->calculateInverse(matDataPicked,
                                                                       tmin,
                                                                       tstep,
                                                                       true);
@@ -655,13 +711,6 @@ void RtcMne::run()
 
                     if(!sourceEstimate.isEmpty()) {
                         //qInfo() << QDateTime::currentDateTime().toString("hh:mm:ss.z") << m_iBlockNumberProcessed++ << "MNE Processed";
-                        if(iTimePointSps < sourceEstimate.data.cols() && iTimePointSps >= 0) {
-                            sourceEstimate = sourceEstimate.reduce(iTimePointSps,1);
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        } else {
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        }
-
                         m_pRTSEOutput->data()->setValue(sourceEstimate);
                     }
                 }
@@ -678,6 +727,12 @@ void RtcMne::run()
     //                    QElapsedTimer time;
     //                    time.start();
 
+                    //Only the displayed time point needs to be computed
+                    if(iTimePointSps < evoked.data.cols() && iTimePointSps >= 0) {
+                        evoked.data = evoked.data.col(iTimePointSps).eval();
+                        evoked.times = evoked.times.segment(iTimePointSps, 1).eval();
+                    }
+
                     m_qMutex.lock();
                     sourceEstimate = m_pMinimumNorm->calculateInverse(evoked);
                     m_qMutex.unlock();
@@ -685,13 +740,7 @@ void RtcMne::run()
                     if(!sourceEstimate.isEmpty()) {
                         //qInfo() << time.elapsed() << m_iBlockNumberProcessed << "MNE Time";
                         //qInfo() << QDateTime::currentDateTime().toString("hh:mm:ss.z") << m_iBlockNumberProcessed++ << "MNE Processed";
-
-                        if(iTimePointSps < sourceEstimate.data.cols() && iTimePointSps >= 0) {
-                            sourceEstimate = sourceEstimate.reduce(iTimePointSps,1);
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        } else {
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        }
+                        m_pRTSEOutput->data()->setValue(sourceEstimate);
                     }
                 } else {
                     m_pCircularEvokedBuffer->pop(evoked);
@@ -226,6 +226,15 @@ protected:
      */
     void onTimePointValueChanged(int iTimePointMs);
 
+    //=========================================================================================================
+    /**
+     * Looks up the row of each inverse operator channel in the input data once. Missing channels are only reported
+     * once per inverse operator and input info. m_qMutex needs to be locked.
+     *
+     * @return true if all inverse operator channels are present in the input data, false otherwise.
+     */
+    bool updateChannelMap();
+
     virtual void run();
 
     QSharedPointer<SCSHAREDLIB::PluginInputData<SCMEASLIB::RealTimeMultiSampleArray> >      m_pRTMSAInput;              /**< The RealTimeMultiSampleArray input.*/
@@ -267,6 +276,11 @@ protected:
 
     MNELIB::MNEInverseOperator      m_invOp;                    /**< The inverse operator. */
 
+    Eigen::VectorXi                 m_vecChannelMap;            /**< The row in the input data of each inverse operator channel. Empty if it needs to be updated. */
+    bool                            m_bChannelMapWarned;        /**< Whether missing inverse operator channels were already reported for the current inverse operator and input info. */
+    Eigen::VectorXd                 m_vecArtifactThresholds;    /**< The per channel peak-to-peak thresholds used to reject raw data blocks. */
+    QStringList                     m_lArtifactThresholdBads;   /**< The bad channels m_vecArtifactThresholds was created for. */
+
 signals:
     void responsibleTriggerTypesChanged(const QStringList& lResponsibleTriggerTypes);
 
@@ -0,0 +1,464 @@
+//=============================================================================================================
+/**
+ * @file     recordingwriter.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Definition of the RecordingWriter class.
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "recordingwriter.h"
+
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_info.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QDebug>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace WRITETOFILEPLUGIN;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+RecordingWriter::RecordingWriter(int iStagingBufferSize,
+                                 int iNumberStagingBuffers,
+                                 bool bPrepareNextFile,
+                                 QObject* parent)
+: QThread(parent)
+, m_iStagingBufferSize(iStagingBufferSize)
+, m_iNumberStagingBuffers(iNumberStagingBuffers)
+, m_iNumberBuffers(0)
+, m_bPrepareNextFile(bPrepareNextFile)
+, m_bRecording(false)
+, m_iRecordingId(0)
+, m_dLastWriteLatency(0.0)
+, m_dMaxWriteLatency(0.0)
+, m_iSplitCount(0)
+{
+}
+
+//=============================================================================================================
+
+RecordingWriter::~RecordingWriter()
+{
+    stopRecording();
+
+    if(isRunning()) {
+        requestInterruption();
+        m_jobAvailable.wakeAll();
+        wait();
+    }
+}
+
+//=============================================================================================================
+
+bool RecordingWriter::startRecording(const QString& sFileName,
+                                     const FiffInfo& fiffInfo)
+{
+    QMutexLocker locker(&m_stagingMutex);
+
+    if(m_bRecording) {
+        qWarning() << "RecordingWriter::startRecording - A recording is already running.";
+        return false;
+    }
+
+    //Allocate the staging buffers up front so the first seconds of the recording do not allocate
+    m_queueMutex.lock();
+    while(m_iNumberBuffers < m_iNumberStagingBuffers) {
+        m_lFreeBuffers.append(allocateStagingBuffer());
+        ++m_iNumberBuffers;
+    }
+    m_dLastWriteLatency = 0.0;
+    m_dMaxWriteLatency = 0.0;
+    m_queueMutex.unlock();
+
+    Job job;
+    job.type = StartJob;
+    job.sFileName = sFileName;
+    job.pFiffInfo = QSharedPointer<FiffInfo>(new FiffInfo(fiffInfo));
+    job.iRecordingId = ++m_iRecordingId;
+    enqueue(job);
+
+    m_bRecording = true;
+
+    return true;
+}
+
+//=============================================================================================================
+
+void RecordingWriter::writeRawBuffer(const MatrixXd& matData)
+{
+    QMutexLocker locker(&m_stagingMutex);
+
+    if(!m_bRecording) {
+        return;
+    }
+
+    if(!m_pStagingStream) {
+        acquireStagingBuffer();
+    }
+
+    m_pStagingStream->write_raw_buffer(matData);
+
+    if(m_baStaging.size() >= m_iStagingBufferSize || m_stagingTimer.elapsed() >= STAGING_FLUSH_MSECS) {
+        flushStagingBuffer();
+    }
+}
+
+//=============================================================================================================
+
+void RecordingWriter::stopRecording()
+{
+    QMutexLocker locker(&m_stagingMutex);
+
+    if(!m_bRecording) {
+        return;
+    }
+
+    flushStagingBuffer();
+
+    Job job;
+    job.type = FinishJob;
+    enqueue(job);
+
+    m_bRecording = false;
+}
+
+//=============================================================================================================
+
+int RecordingWriter::getQueueDepth() const
+{
+    QMutexLocker locker(&m_queueMutex);
+    return m_queueJobs.size();
+}
+
+//=============================================================================================================
+
+double RecordingWriter::getLastWriteLatency() const
+{
+    QMutexLocker locker(&m_queueMutex);
+    return m_dLastWriteLatency;
+}
+
+//=============================================================================================================
+
+double RecordingWriter::getMaxWriteLatency() const
+{
+    QMutexLocker locker(&m_queueMutex);
+    return m_dMaxWriteLatency;
+}
+
+//=============================================================================================================
+
+bool RecordingWriter::isRecording() const
+{
+    QMutexLocker locker(&m_stagingMutex);
+    return m_bRecording;
+}
+
+//=============================================================================================================
+
+void RecordingWriter::run()
+{
+    forever {
+        m_queueMutex.lock();
+
+        while(m_queueJobs.isEmpty() && !isInterruptionRequested()) {
+            m_jobAvailable.wait(&m_queueMutex, 100);
+        }
+
+        //Only quit once all queued data was written
+        if(m_queueJobs.isEmpty()) {
+            m_queueMutex.unlock();
+
+            //Queue the staged data of a running recording and finish its file before quitting
+            if(isRecording()) {
+                stopRecording();
+                continue;
+            }
+
+            break;
+        }
+
+        Job job = m_queueJobs.dequeue();
+        m_queueMutex.unlock();
+
+        switch(job.type) {
+            case StartJob: {
+                finishFile();
+
+                m_pFiffInfo = job.pFiffInfo;
+                m_iSplitCount = 0;
+                m_sBaseFileName = job.sFileName;
+                m_sBaseFileName.remove("_raw.fif");
+
+                m_pFileOut = QSharedPointer<QFile>(new QFile(job.sFileName));
+                m_pOutfid = startFile(m_pFileOut, true);
+
+                if(!m_pOutfid) {
+                    m_pFileOut.clear();
+                    abortRecording(job.iRecordingId);
+                    emit recordingFailed(job.sFileName);
+                }
+                break;
+            }
+
+            case DataJob: {
+                if(m_pOutfid) {
+                    if(m_pOutfid->device()->pos() + job.baData.size() > MAX_DATA_LEN) {
+                        splitFile();
+                    }
+
+                    QElapsedTimer timer;
+                    timer.start();
+                    m_pOutfid->writeRawData(job.baData.constData(), job.baData.size());
+                    double dLatency = timer.nsecsElapsed() / 1000000.0;
+
+                    if(m_bPrepareNextFile && !m_pNextOutfid && m_pOutfid->device()->pos() > PREPARE_NEXT_FILE_RATIO * MAX_DATA_LEN) {
+                        prepareNextFile();
+                    }
+
+                    m_queueMutex.lock();
+                    m_dLastWriteLatency = dLatency;
+                    m_dMaxWriteLatency = qMax(m_dMaxWriteLatency, dLatency);
+                    m_queueMutex.unlock();
+                }
+
+                //Recycle the staging buffer. Drop our reference while locked so the buffer is not shared once it is reused.
+                m_queueMutex.lock();
+                m_lFreeBuffers.append(job.baData);
+                job.baData.clear();
+                m_queueMutex.unlock();
+                break;
+            }
+
+            case FinishJob: {
+                finishFile();
+                break;
+            }
+        }
+    }
+
+    finishFile();
+}
+
+//=============================================================================================================
+
+void RecordingWriter::enqueue(const Job& job)
+{
+    QMutexLocker locker(&m_queueMutex);
+    m_queueJobs.enqueue(job);
+    m_jobAvailable.wakeOne();
+}
+
+//=============================================================================================================
+
+void RecordingWriter::abortRecording(int iRecordingId)
+{
+    QMutexLocker locker(&m_stagingMutex);
+
+    if(!m_bRecording || m_iRecordingId != iRecordingId) {
+        return;
+    }
+
+    m_bRecording = false;
+
+    //Staged data has nowhere to go, queued data jobs are recycled without being written
+    if(m_pStagingStream) {
+        m_pStagingStream.clear();
+
+        QMutexLocker queueLocker(&m_queueMutex);
+        m_lFreeBuffers.append(m_baStaging);
+        m_baStaging.clear();
+    }
+}
+
+//=============================================================================================================
+
+void RecordingWriter::flushStagingBuffer()
+{
+    if(!m_pStagingStream) {
+        return;
+    }
+
+    //Close the staging stream before handing the buffer over
+    m_pStagingStream.clear();
+
+    if(m_baStaging.isEmpty()) {
+        QMutexLocker locker(&m_queueMutex);
+        m_lFreeBuffers.append(m_baStaging);
+        m_baStaging.clear();
+        return;
+    }
+
+    Job job;
+    job.type = DataJob;
+    job.baData = m_baStaging;
+    m_baStaging.clear();
+    enqueue(job);
+}
+
+//=============================================================================================================
+
+void RecordingWriter::acquireStagingBuffer()
+{
+    m_queueMutex.lock();
+
+    if(!m_lFreeBuffers.isEmpty()) {
+        m_baStaging = m_lFreeBuffers.takeLast();
+    } else {
+        //Never drop data: if the disk falls behind, keep more data in memory
+        qWarning() << "RecordingWriter::acquireStagingBuffer - All" << m_iNumberBuffers << "staging buffers are queued. Allocating an additional one.";
+        m_baStaging = allocateStagingBuffer();
+        ++m_iNumberBuffers;
+    }
+
+    m_queueMutex.unlock();
+
+    //The reserved capacity is kept when resizing to zero
+    m_baStaging.resize(0);
+    m_pStagingStream = FiffStream::SPtr(new FiffStream(&m_baStaging, QIODevice::WriteOnly));
+    m_stagingTimer.start();
+}
+
+//=============================================================================================================
+
+QByteArray RecordingWriter::allocateStagingBuffer() const
+{
+    //Leave room for the block which crosses the size limit
+    QByteArray baBuffer;
+    baBuffer.reserve(m_iStagingBufferSize + m_iStagingBufferSize / 4);
+
+    return baBuffer;
+}
+
+//=============================================================================================================
+
+FiffStream::SPtr RecordingWriter::startFile(QSharedPointer<QFile> pFile,
+                                            bool bResetRange)
+{
+    RowVectorXd cals;
+    MatrixXi sel;
+    FiffStream::SPtr pOutfid = FiffStream::start_writing_raw(*pFile,
+                                                             *m_pFiffInfo,
+                                                             cals,
+                                                             sel,
+                                                             bResetRange);
+
+    if(pOutfid) {
+        fiff_int_t first = 0;
+        pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
+    } else {
+        qWarning() << "RecordingWriter::startFile - Could not start writing to" << pFile->fileName();
+    }
+
+    return pOutfid;
+}
+
+//=============================================================================================================
+
+void RecordingWriter::prepareNextFile()
+{
+    QString sNextFileName = QString("%1-%2_raw.fif").arg(m_sBaseFileName).arg(m_iSplitCount + 1);
+
+    m_pNextFileOut = QSharedPointer<QFile>(new QFile(sNextFileName));
+    m_pNextOutfid = startFile(m_pNextFileOut, false);
+}
+
+//=============================================================================================================
+
+void RecordingWriter::splitFile()
+{
+    if(!m_pNextOutfid) {
+        prepareNextFile();
+
+        if(!m_pNextOutfid) {
+            qWarning() << "RecordingWriter::splitFile - Could not create the next file. Continuing with the current one.";
+            m_pNextFileOut.clear();
+            return;
+        }
+    }
+
+    ++m_iSplitCount;
+
+    //Write the link to the next file
+    qint32 data;
+    m_pOutfid->start_block(FIFFB_REF);
+    data = FIFFV_ROLE_NEXT_FILE;
+    m_pOutfid->write_int(FIFF_REF_ROLE,&data);
+    m_pOutfid->write_string(FIFF_REF_FILE_NAME, m_pNextFileOut->fileName());
+    m_pOutfid->write_id(FIFF_REF_FILE_ID);//ToDo meas_id
+    data = m_iSplitCount - 1;
+    m_pOutfid->write_int(FIFF_REF_FILE_NUM, &data);
+    m_pOutfid->end_block(FIFFB_REF);
+
+    //finish file
+    m_pOutfid->finish_writing_raw();
+
+    //continue with the next file
+    m_pFileOut = m_pNextFileOut;
+    m_pOutfid = m_pNextOutfid;
+    m_pNextFileOut.clear();
+    m_pNextOutfid.clear();
+}
+
+//=============================================================================================================
+
+void RecordingWriter::finishFile()
+{
+    if(m_pOutfid) {
+        m_pOutfid->finish_writing_raw();
+        m_pOutfid.clear();
+        m_pFileOut.clear();
+    }
+
+    if(m_pNextOutfid) {
+        m_pNextOutfid->close();
+        m_pNextOutfid.clear();
+        m_pNextFileOut->remove();
+        m_pNextFileOut.clear();
+    }
+}
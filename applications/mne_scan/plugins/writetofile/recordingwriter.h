@@ -0,0 +1,327 @@
+//=============================================================================================================
+/**
+ * @file     recordingwriter.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Contains the declaration of the RecordingWriter class.
+ *
+ */
+
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "writetofile_global.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QThread>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QFile>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// FORWARD DECLARATIONS
+//=============================================================================================================
+
+namespace FIFFLIB{
+    class FiffInfo;
+    class FiffStream;
+}
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_DATA_LEN                2000000000L     /**< Maximum size of one recording file in bytes before it is split. */
+#define STAGING_BUFFER_SIZE         16777216        /**< Size in bytes after which a staging buffer is handed to the writer thread. */
+#define STAGING_BUFFER_COUNT        4               /**< Number of staging buffers which are allocated when a recording starts. */
+#define STAGING_FLUSH_MSECS         1000            /**< Maximum time in milliseconds data is kept in a staging buffer. */
+#define PREPARE_NEXT_FILE_RATIO     0.9             /**< Fraction of MAX_DATA_LEN after which the next split file is prepared. */
+
+//=============================================================================================================
+// DEFINE NAMESPACE WRITETOFILEPLUGIN
+//=============================================================================================================
+
+namespace WRITETOFILEPLUGIN
+{
+
+//=============================================================================================================
+// WRITETOFILEPLUGIN FORWARD DECLARATIONS
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS RecordingWriter
+ *
+ * @brief The RecordingWriter class serializes incoming data blocks into staging buffers and writes them to fiff
+ *        files from its own thread. Splitting into multiple files also happens in this thread, so a slow disk
+ *        never blocks the caller of writeRawBuffer.
+ */
+class WRITETOFILESHARED_EXPORT RecordingWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    typedef QSharedPointer<RecordingWriter> SPtr;              /**< Shared pointer type for RecordingWriter. */
+    typedef QSharedPointer<const RecordingWriter> ConstSPtr;   /**< Const shared pointer type for RecordingWriter. */
+
+    //=========================================================================================================
+    /**
+     * Constructs a RecordingWriter.
+     *
+     * @param[in] iStagingBufferSize     Size in bytes after which a staging buffer is handed to the writer thread.
+     * @param[in] iNumberStagingBuffers  Number of staging buffers which are allocated when a recording starts.
+     * @param[in] bPrepareNextFile       Whether to create the next split file before the current one is full.
+     * @param[in] parent                 The parent QObject.
+     */
+    RecordingWriter(int iStagingBufferSize = STAGING_BUFFER_SIZE,
+                    int iNumberStagingBuffers = STAGING_BUFFER_COUNT,
+                    bool bPrepareNextFile = true,
+                    QObject* parent = Q_NULLPTR);
+
+    //=========================================================================================================
+    /**
+     * Destroys the RecordingWriter. Waits until all queued data was written.
+     */
+    ~RecordingWriter();
+
+    //=========================================================================================================
+    /**
+     * Starts a new recording. The file is created by the writer thread.
+     *
+     * @param[in] sFileName      The file name of the recording. Split files get the suffix -<number>_raw.fif.
+     * @param[in] fiffInfo       The measurement info to write.
+     *
+     * @return true if the recording was started, false if a recording is already running.
+     */
+    bool startRecording(const QString& sFileName,
+                        const FIFFLIB::FiffInfo& fiffInfo);
+
+    //=========================================================================================================
+    /**
+     * Serializes a data block into the current staging buffer. Never blocks on the disk. If all staging buffers are
+     * still queued, a new one is allocated instead of dropping data.
+     *
+     * @param[in] matData        The data block to write.
+     */
+    void writeRawBuffer(const Eigen::MatrixXd& matData);
+
+    //=========================================================================================================
+    /**
+     * Stops the current recording. The remaining data is written and the file is finished by the writer thread.
+     */
+    void stopRecording();
+
+    //=========================================================================================================
+    /**
+     * Returns the number of staging buffers and file operations waiting for the writer thread.
+     *
+     * @return The queue depth.
+     */
+    int getQueueDepth() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the time the last staging buffer took to be written to the device.
+     *
+     * @return The latency in milliseconds.
+     */
+    double getLastWriteLatency() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the longest time a staging buffer took to be written to the device during the current recording.
+     *
+     * @return The latency in milliseconds.
+     */
+    double getMaxWriteLatency() const;
+
+    //=========================================================================================================
+    /**
+     * Returns whether a recording is running. A recording whose file could not be created is stopped by the
+     * writer thread.
+     *
+     * @return true if a recording is running.
+     */
+    bool isRecording() const;
+
+signals:
+    //=========================================================================================================
+    /**
+     * Emitted from the writer thread if the file of a recording could not be created. The recording was stopped.
+     *
+     * @param[in] sFileName      The file name of the failed recording.
+     */
+    void recordingFailed(const QString& sFileName);
+
+protected:
+    //=========================================================================================================
+    /**
+     * The writer thread. Processes the queued jobs until an interruption is requested and the queue is empty.
+     * A recording which is still running when the thread is interrupted is stopped and its staged data written.
+     */
+    virtual void run();
+
+private:
+    //=========================================================================================================
+    /**
+     * The type of work the writer thread needs to do.
+     */
+    enum JobType {
+        StartJob,
+        DataJob,
+        FinishJob
+    };
+
+    //=========================================================================================================
+    /**
+     * One queued unit of work for the writer thread.
+     */
+    struct Job {
+        JobType                             type;               /**< The job type. */
+        QByteArray                          baData;             /**< The serialized tags of a DataJob. */
+        QString                             sFileName;          /**< The file name of a StartJob. */
+        QSharedPointer<FIFFLIB::FiffInfo>   pFiffInfo;          /**< The measurement info of a StartJob. */
+        int                                 iRecordingId;       /**< The recording a StartJob belongs to. */
+    };
+
+    //=========================================================================================================
+    /**
+     * Queues a job and wakes up the writer thread.
+     *
+     * @param[in] job            The job to queue.
+     */
+    void enqueue(const Job& job);
+
+    //=========================================================================================================
+    /**
+     * Stops a recording whose file could not be created and recycles its staging buffer. Does nothing if another
+     * recording was started in the meantime. Only called from the writer thread.
+     *
+     * @param[in] iRecordingId   The recording to stop.
+     */
+    void abortRecording(int iRecordingId);
+
+    //=========================================================================================================
+    /**
+     * Hands the current staging buffer to the writer thread. m_stagingMutex needs to be locked.
+     */
+    void flushStagingBuffer();
+
+    //=========================================================================================================
+    /**
+     * Takes a free staging buffer or allocates a new one and opens the staging stream on it.
+     * m_stagingMutex needs to be locked.
+     */
+    void acquireStagingBuffer();
+
+    //=========================================================================================================
+    /**
+     * Allocates a staging buffer with enough capacity that it does not need to grow while being filled.
+     *
+     * @return The empty staging buffer.
+     */
+    QByteArray allocateStagingBuffer() const;
+
+    //=========================================================================================================
+    /**
+     * Creates and starts a fiff file and writes the measurement info to it. Only called from the writer thread.
+     *
+     * @param[in] pFile          The file to write to.
+     * @param[in] bResetRange    Whether to reset the channel ranges (only for the first file).
+     *
+     * @return The fiff stream to write the data to.
+     */
+    QSharedPointer<FIFFLIB::FiffStream> startFile(QSharedPointer<QFile> pFile,
+                                                  bool bResetRange);
+
+    //=========================================================================================================
+    /**
+     * Creates the next split file ahead of time. Only called from the writer thread.
+     */
+    void prepareNextFile();
+
+    //=========================================================================================================
+    /**
+     * Links the current file to the next split file, finishes it and continues with the next file.
+     * Only called from the writer thread.
+     */
+    void splitFile();
+
+    //=========================================================================================================
+    /**
+     * Finishes the current file and removes a prepared but unused split file. Only called from the writer thread.
+     */
+    void finishFile();
+
+    int                                     m_iStagingBufferSize;   /**< Size in bytes after which a staging buffer is handed to the writer thread. */
+    int                                     m_iNumberStagingBuffers;/**< Number of staging buffers which are allocated when a recording starts. */
+    int                                     m_iNumberBuffers;       /**< Number of staging buffers allocated so far. */
+    bool                                    m_bPrepareNextFile;     /**< Whether to create the next split file before the current one is full. */
+    bool                                    m_bRecording;           /**< Whether a recording is running. Guarded by m_stagingMutex. */
+    int                                     m_iRecordingId;         /**< Counts the started recordings. Guarded by m_stagingMutex. */
+
+    mutable QMutex                          m_stagingMutex;         /**< Guards the staging buffer and stream. */
+    QByteArray                              m_baStaging;            /**< The staging buffer currently being filled. */
+    QSharedPointer<FIFFLIB::FiffStream>     m_pStagingStream;       /**< The stream serializing tags into m_baStaging. */
+    QElapsedTimer                           m_stagingTimer;         /**< Time since the staging buffer received its first data. */
+
+    mutable QMutex                          m_queueMutex;           /**< Guards the job queue, the free buffers and the latency counters. */
+    QWaitCondition                          m_jobAvailable;         /**< Wakes up the writer thread. */
+    QQueue<Job>                             m_queueJobs;            /**< Jobs waiting for the writer thread. */
+    QList<QByteArray>                       m_lFreeBuffers;         /**< Staging buffers which were written and can be reused. */
+    double                                  m_dLastWriteLatency;    /**< Time the last staging buffer took to be written in milliseconds. */
+    double                                  m_dMaxWriteLatency;     /**< Longest write time of a staging buffer in milliseconds. */
+
+    // The following members are only accessed from the writer thread
+    QSharedPointer<FIFFLIB::FiffInfo>       m_pFiffInfo;            /**< The measurement info of the current recording. */
+    QString                                 m_sBaseFileName;        /**< The file name of the recording without the _raw.fif suffix. */
+    int                                     m_iSplitCount;          /**< The number of split files written so far. */
+    QSharedPointer<QFile>                   m_pFileOut;             /**< The file currently written to. */
+    QSharedPointer<FIFFLIB::FiffStream>     m_pOutfid;              /**< The fiff stream currently written to. */
+    QSharedPointer<QFile>                   m_pNextFileOut;         /**< The prepared next split file. */
+    QSharedPointer<FIFFLIB::FiffStream>     m_pNextOutfid;          /**< The fiff stream of the prepared next split file. */
+};
+} // NAMESPACE
+
+#endif // RECORDINGWRITER_H
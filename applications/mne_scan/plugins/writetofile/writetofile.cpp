@@ -37,12 +37,13 @@
 //=============================================================================================================
 
 #include "writetofile.h"
+#include "recordingwriter.h"
 
 #include "FormFiles/writetofilesetupwidget.h"
 
 #include <disp/viewers/projectsettingsview.h>
 #include <scMeas/realtimemultisamplearray.h>
-#include <fiff/fiff_stream.h>
+#include <fiff/fiff_info.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -73,7 +74,7 @@ WriteToFile::WriteToFile()
 , m_bWriteToFile(false)
 , m_bUseRecordTimer(false)
 , m_iRecordingMSeconds(5*60*1000)
-, m_iSplitCount(0)
+, m_pRecordingWriter(RecordingWriter::SPtr(new RecordingWriter()))
 , m_pCircularBuffer(CircularBuffer_Matrix_double::SPtr(new CircularBuffer_Matrix_double(40)))
 {
     m_pActionRecordFile = new QAction(QIcon(":/images/record.png"), tr("Start Recording"),this);
@@ -82,6 +83,10 @@ WriteToFile::WriteToFile()
             this, &WriteToFile::toggleRecordingFile);
     addPluginAction(m_pActionRecordFile);
 
+    //The recording writer reports from its own thread, handle it in the thread of this plugin's controls
+    connect(m_pRecordingWriter.data(), &RecordingWriter::recordingFailed,
+            this, &WriteToFile::onRecordingFailed, Qt::QueuedConnection);
+
     //Init timers
     if(!m_pRecordTimer) {
         m_pRecordTimer = QSharedPointer<QTimer>(new QTimer(this));
@@ -135,6 +140,7 @@ void WriteToFile::unload()
 
 bool WriteToFile::start()
 {
+    m_pRecordingWriter->start();
     QThread::start();
 
     return true;
@@ -147,6 +153,11 @@ bool WriteToFile::stop()
     requestInterruption();
     wait();
 
+    //Wait until the writer thread wrote all queued and staged data
+    m_pRecordingWriter->stopRecording();
+    m_pRecordingWriter->requestInterruption();
+    m_pRecordingWriter->wait();
+
     m_bPluginControlWidgetsInit = false;
 
     return true;
@@ -257,6 +268,10 @@ void WriteToFile::initPluginControlWidgets()
             m_pUpdateTimeInfoTimer = QSharedPointer<QTimer>(new QTimer(this));
             connect(m_pUpdateTimeInfoTimer.data(), &QTimer::timeout, [=]() {
                     pProjectSettingsView->setRecordingElapsedTime(m_recordingStartedTime.elapsed());
+                    m_pActionRecordFile->setStatusTip(tr("Stop Recording - Write queue: %1, Last write: %2 ms, Max write: %3 ms")
+                                                      .arg(m_pRecordingWriter->getQueueDepth())
+                                                      .arg(m_pRecordingWriter->getLastWriteLatency(), 0, 'f', 1)
+                                                      .arg(m_pRecordingWriter->getMaxWriteLatency(), 0, 'f', 1));
             });
         }
 
@@ -269,29 +284,15 @@ void WriteToFile::initPluginControlWidgets()
 void WriteToFile::run()
 {
     MatrixXd matData;
-    qint32 size = 0;
 
     while(!isInterruptionRequested()) {
         if(m_pCircularBuffer) {
             //pop matrix
             if(m_pCircularBuffer->pop(matData)) {
-                //Write raw data to fif file
-                m_mutex.lock();
+                //Stage raw data. The recording writer writes it to the fif file and splits the file from its own thread.
                 if(m_bWriteToFile) {
-                    size += matData.rows()*matData.cols() * 4;
-
-                    if(size > MAX_DATA_LEN) {
-                        size = 0;
-                        this->splitRecordingFile();
-                    }
-
-                    if(m_pOutfid) {
-                        m_pOutfid->write_raw_buffer(matData);
-                    }
-                } else {
-                    size = 0;
+                    m_pRecordingWriter->writeRawBuffer(matData);
                 }
-                m_mutex.unlock();
             }
         }
     }
@@ -334,21 +335,16 @@ void WriteToFile::toggleRecordingFile()
 {
     //Setup writing to file
     if(m_bWriteToFile) {
-        m_mutex.lock();
-        m_pOutfid->finish_writing_raw();
-        m_mutex.unlock();
-
         m_bWriteToFile = false;
-        m_iSplitCount = 0;
+        m_pRecordingWriter->stopRecording();
 
         //Stop record timer
         m_pRecordTimer->stop();
         m_pBlinkingRecordButtonTimer->stop();
         m_pActionRecordFile->setIcon(QIcon(":/images/record.png"));
+        m_pActionRecordFile->setStatusTip(tr("Start Recording"));
         m_pUpdateTimeInfoTimer->stop();
     } else {
-        m_iSplitCount = 0;
-
         if(!m_pFiffInfo) {
             QMessageBox msgBox;
             msgBox.setText("FiffInfo missing!");
@@ -368,9 +364,8 @@ void WriteToFile::toggleRecordingFile()
                 return;
         }
 
-        //Initiate the stream for writing to the fif file
-        m_qFileOut.setFileName(m_sRecordFileName);
-        if(m_qFileOut.exists()) {
+        //Check the file for writing to the fif file
+        if(QFile::exists(m_sRecordFileName)) {
             QMessageBox msgBox;
             msgBox.setText("The file you want to write already exists.");
             msgBox.setInformativeText("Do you want to overwrite this file?");
@@ -387,15 +382,10 @@ void WriteToFile::toggleRecordingFile()
             m_pFiffInfo->projs[i].active = false;
         }
 
-        //Start/Prepare writing process. Actual writing is done in run() method.
-        m_mutex.lock();
-        RowVectorXd cals;
-        m_pOutfid = FiffStream::start_writing_raw(m_qFileOut,
-                                                  *m_pFiffInfo,
-                                                  cals);
-        fiff_int_t first = 0;
-        m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
-        m_mutex.unlock();
+        //Start writing process. Data is staged in run() and written by the recording writer thread.
+        if(!m_pRecordingWriter->startRecording(m_sRecordFileName, *m_pFiffInfo)) {
+            return;
+        }
 
         m_bWriteToFile = true;
 
@@ -412,38 +402,18 @@ void WriteToFile::toggleRecordingFile()
 
 //=============================================================================================================
 
-void WriteToFile::splitRecordingFile()
+void WriteToFile::onRecordingFailed(const QString& sFileName)
 {
-    //qDebug() << "Split recording file";
-    ++m_iSplitCount;
-    QString nextFileName = m_sRecordFileName.remove("_raw.fif");
-    nextFileName += QString("-%1_raw.fif").arg(m_iSplitCount);
-
-    //Write the link to the next file
-    qint32 data;
-    m_pOutfid->start_block(FIFFB_REF);
-    data = FIFFV_ROLE_NEXT_FILE;
-    m_pOutfid->write_int(FIFF_REF_ROLE,&data);
-    m_pOutfid->write_string(FIFF_REF_FILE_NAME, nextFileName);
-    m_pOutfid->write_id(FIFF_REF_FILE_ID);//ToDo meas_id
-    data = m_iSplitCount - 1;
-    m_pOutfid->write_int(FIFF_REF_FILE_NUM, &data);
-    m_pOutfid->end_block(FIFFB_REF);
-
-    //finish file
-    m_pOutfid->finish_writing_raw();
-
-    //start next file
-    m_qFileOut.setFileName(nextFileName);
-    RowVectorXd cals;
-    MatrixXi sel;
-    m_pOutfid = FiffStream::start_writing_raw(m_qFileOut,
-                                              *m_pFiffInfo,
-                                              cals,
-                                              sel,
-                                              false);
-    fiff_int_t first = 0;
-    m_pOutfid->write_int(FIFF_FIRST_SAMPLE, &first);
+    //The writer keeps recording if a new recording was started in the meantime
+    if(m_bWriteToFile && !m_pRecordingWriter->isRecording()) {
+        toggleRecordingFile();
+    }
+
+    QMessageBox msgBox;
+    msgBox.setText("The recording could not be started.");
+    msgBox.setInformativeText(QString("Could not write to %1.").arg(sFileName));
+    msgBox.setWindowFlags(Qt::WindowStaysOnTopHint);
+    msgBox.exec();
 }
 
 //=============================================================================================================
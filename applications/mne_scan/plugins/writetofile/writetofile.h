@@ -65,15 +65,12 @@
 
 namespace FIFFLIB{
     class FiffInfo;
-    class FiffStream;
 }
 
 namespace SCMEASLIB{
     class RealTimeMultiSampleArray;
 }
 
-#define MAX_DATA_LEN    2000000000L
-
 //=============================================================================================================
 // DEFINE NAMESPACE WRITETOFILEPLUGIN
 //=============================================================================================================
@@ -85,6 +82,8 @@ namespace WRITETOFILEPLUGIN
 // WRITETOFILEPLUGIN FORWARD DECLARATIONS
 //=============================================================================================================
 
+class RecordingWriter;
+
 //=============================================================================================================
 /**
  * DECLARE CLASS WriteToFile
@@ -177,9 +176,11 @@ private:
 
     //=========================================================================================================
     /**
-     * Determines current file. And starts a new one.
+     * Stops the recording state if the recording writer could not create the recording file and informs the user.
+     *
+     * @param[in] sFileName   the file name of the failed recording.
      */
-    void splitRecordingFile();
+    void onRecordingFailed(const QString& sFileName);
 
     //=========================================================================================================
     /**
@@ -191,19 +192,15 @@ private:
     bool                                    m_bUseRecordTimer;              /**< Flag whether to use data recording timer.*/
 
     qint16                                  m_iBlinkStatus;                 /**< The blink status of the recording button.*/
-    qint32                                  m_iSplitCount;                  /**< File split count */
     int                                     m_iRecordingMSeconds;           /**< Recording length in mseconds.*/
 
-    QMutex                                  m_mutex;                        /**< The threads mutex.*/
-
     QSharedPointer<FIFFLIB::FiffInfo>       m_pFiffInfo;                    /**< Fiff measurement info.*/
-    QSharedPointer<FIFFLIB::FiffStream>     m_pOutfid;                      /**< FiffStream to write to.*/
+    QSharedPointer<RecordingWriter>         m_pRecordingWriter;             /**< Writes the recorded data to file from its own thread.*/
 
     QSharedPointer<QTimer>                  m_pUpdateTimeInfoTimer;         /**< timer to control remaining time. */
     QSharedPointer<QTimer>                  m_pBlinkingRecordButtonTimer;   /**< timer to control blinking recording button. */
     QSharedPointer<QTimer>                  m_pRecordTimer;                 /**< timer to control recording time. */
 
-    QFile                                   m_qFileOut;                     /**< QFile for writing to fif file.*/
     QString                                 m_sRecordFileName;              /**< Current record file. */
     QTime                                   m_recordingStartedTime;         /**< The time when the recording started.*/
 
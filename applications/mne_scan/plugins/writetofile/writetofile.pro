@@ -82,11 +82,13 @@ CONFIG(debug, debug|release) {
 
 SOURCES += \
         writetofile.cpp \
+        recordingwriter.cpp \
         FormFiles/writetofilesetupwidget.cpp \
 
 HEADERS += \
         writetofile.h\
         writetofile_global.h \
+        recordingwriter.h \
         FormFiles/writetofilesetupwidget.h \
 
 FORMS += \
@@ -75,6 +75,7 @@ SOURCES += \
     rtCommand/commandmanager.cpp \
     rtCommand/commandparser.cpp \
     rtCommand/rawcommand.cpp \
+    rtSharedMemory/rtsharedmemoryring.cpp \
 
 HEADERS +=  \
     communication_global.h \
@@ -85,6 +86,7 @@ HEADERS +=  \
     rtCommand/commandmanager.h \
     rtCommand/commandparser.h \
     rtCommand/rawcommand.h \
+    rtSharedMemory/rtsharedmemoryring.h \
 
 INCLUDEPATH += $${EIGEN_INCLUDE_DIR}
 INCLUDEPATH += $${MNE_INCLUDE_DIR}
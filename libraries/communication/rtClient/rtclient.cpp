@@ -42,6 +42,12 @@
 #include "rtcmdclient.h"
 #include "rtdataclient.h"
 
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QHostAddress>
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -154,6 +160,18 @@ void RtClient::run()
 //    t_cmdClient.waitForDataAvailable(1000);
 //    qDebug() << t_cmdClient.readAvailableData();
 
+    // use the shared memory transport if mne_rt_server runs on the same host
+    if(t_cmdClient.hasCommand("shmem")
+       && (m_sRtServerHostName.compare("localhost", Qt::CaseInsensitive) == 0 || QHostAddress(m_sRtServerHostName).isLoopback()))
+    {
+        // the key of the ring contains a session token and is only part of the reply
+        QString t_sKey = t_cmdClient.requestSharedMemory(clientId, true);
+
+        // fall back to TCP if the ring is not available
+        if(t_sKey.isEmpty() || !t_dataClient.attachSharedMemory(t_sKey))
+            t_cmdClient.requestSharedMemory(clientId, false);
+    }
+
     // read meas info
     t_cmdClient["measinfo"].pValues()[0].setValue(clientId);
     t_cmdClient["measinfo"].send();
@@ -291,6 +291,37 @@ qint32 RtCmdClient::requestConnectors(QMap<qint32, QString> &p_qMapConnectors)
     return p_iActiveId;
 }
 
+//=============================================================================================================
+
+QString RtCmdClient::requestSharedMemory(qint32 p_id, bool p_bEnable)
+{
+    //Send
+    Command& t_commandShmem = m_commandManager["shmem"];
+    t_commandShmem.pValues()[t_commandShmem.pNames().indexOf("id")].setValue(QString::number(p_id));
+    t_commandShmem.pValues()[t_commandShmem.pNames().indexOf("enable")].setValue(p_bEnable ? 1 : 0);
+    t_commandShmem.send();
+
+    //Receive
+    m_qMutex.lock();
+    QByteArray t_sJsonShmem = m_sAvailableData.toUtf8();
+    m_qMutex.unlock();
+
+    //Parse
+    QJsonParseError error;
+    QJsonDocument t_jsonDocumentOrigin = QJsonDocument::fromJson(t_sJsonShmem, &error);
+
+    if (error.error == QJsonParseError::NoError)
+    {
+        if(t_jsonDocumentOrigin.isObject() && t_jsonDocumentOrigin.object().value(QString("shmem")).toBool())
+            return t_jsonDocumentOrigin.object().value(QString("key")).toString();
+
+        return QString();
+    }
+
+    qCritical() << "Unable to parse JSON response: " << error.errorString();
+    return QString();
+}
+
 ////=============================================================================================================
 
 //void RtCmdClient::requestMeasInfo(qint32 p_id)
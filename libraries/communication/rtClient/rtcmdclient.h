@@ -156,6 +156,17 @@ public:
      */
     qint32 requestConnectors(QMap<qint32, QString> &p_qMapConnectors);
 
+    //=========================================================================================================
+    /**
+     * Switches the raw buffer transport of a FiffStreamClient at mne_rt_server between a shared memory ring and TCP.
+     *
+     * @param[in] p_id       the id of the FiffStreamClient.
+     * @param[in] p_bEnable  whether to use the shared memory ring.
+     *
+     * @return the key of the shared memory ring, empty if the raw buffers are sent via TCP.
+     */
+    QString requestSharedMemory(qint32 p_id, bool p_bEnable);
+
     //=========================================================================================================
     /**
      * Wait for ready read until data are available.
@@ -41,6 +41,20 @@
 #include "rtdataclient.h"
 #include <fiff/fiff_file.h>
 
+#include <utils/ioutils.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtEndian>
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define RT_DATA_CLIENT_SHM_WAIT_MSECS 10     /**< Maximal time in msecs the socket is not checked while waiting on the shared memory ring. */
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -48,6 +62,7 @@
 using namespace COMMUNICATIONLIB;
 using namespace FIFFLIB;
 using namespace Eigen;
+using namespace UTILSLIB;
 
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -56,6 +71,17 @@ using namespace Eigen;
 RtDataClient::RtDataClient(QObject *parent)
 : QTcpSocket(parent)
 , m_clientID(-1)
+, m_iHeaderReceived(0)
+, m_iTagKind(-1)
+, m_iTagType(0)
+, m_iTagSize(0)
+, m_iTagNext(0)
+, m_pPayload(Q_NULLPTR)
+, m_iPayloadReceived(0)
+, m_bPayloadToMatrix(false)
+, m_bTagReady(false)
+, m_iNumChannels(-1)
+, m_iPendingSocketBuffers(0)
 {
     getClientId();
 }
@@ -73,6 +99,14 @@ void RtDataClient::disconnectFromHost()
 {
     QTcpSocket::disconnectFromHost();
     m_clientID = -1;
+
+    detachSharedMemory();
+
+    //Drop a partially received tag
+    m_iHeaderReceived = 0;
+    m_bTagReady = false;
+    m_pPayload = Q_NULLPTR;
+    m_pDecodedTag.clear();
 }
 
 //=============================================================================================================
@@ -88,11 +122,9 @@ qint32 RtDataClient::getClientId()
         QString t_sCommand("");
         t_fiffStream.write_rt_command(1, t_sCommand);
 
-        this->waitForReadyRead(100);
         // ID is send as answer
         FiffTag::SPtr t_pTag;
-        t_fiffStream.read_tag(t_pTag);
-        if (t_pTag->kind == FIFF_MNE_RT_CLIENT_ID)
+        if (readNextTag(t_pTag, 100) && t_pTag->kind == FIFF_MNE_RT_CLIENT_ID)
             m_clientID = *t_pTag->toInt();
     }
     return m_clientID;
@@ -107,14 +139,14 @@ FiffInfo::SPtr RtDataClient::readInfo()
     bool t_bReadMeasBlockEnd = false;
     QString col_names, row_names;
 
-    FiffStream t_fiffStream(this);
     //
     // Find the start
     //
     FiffTag::SPtr t_pTag;
     while(!t_bReadMeasBlockStart)
     {
-        t_fiffStream.read_rt_tag(t_pTag);
+        if(!readNextTag(t_pTag))
+            return p_pFiffInfo;
         if(t_pTag->kind == FIFF_BLOCK_START && *(t_pTag->toInt()) == FIFFB_MEAS_INFO)
         {
             printf("FIFF_BLOCK_START FIFFB_MEAS_INFO\n");
@@ -131,7 +163,8 @@ FiffInfo::SPtr RtDataClient::readInfo()
 
     while(!t_bReadMeasBlockEnd)
     {
-        t_fiffStream.read_rt_tag(t_pTag);
+        if(!readNextTag(t_pTag))
+            return p_pFiffInfo;
         //
         //  megacq parameters
         //
@@ -139,7 +172,8 @@ FiffInfo::SPtr RtDataClient::readInfo()
         {
             while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_DACQ_PARS)
             {
-                t_fiffStream.read_rt_tag(t_pTag);
+                if(!readNextTag(t_pTag))
+                    return p_pFiffInfo;
                 if(t_pTag->kind == FIFF_DACQ_PARS)
                     p_pFiffInfo->acq_pars = t_pTag->toString();
                 else if(t_pTag->kind == FIFF_DACQ_STIM)
@@ -169,7 +203,8 @@ FiffInfo::SPtr RtDataClient::readInfo()
         {
             while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_ISOTRAK)
             {
-                t_fiffStream.read_rt_tag(t_pTag);
+                if(!readNextTag(t_pTag))
+                    return p_pFiffInfo;
 
                 if(t_pTag->kind == FIFF_DIG_POINT)
                     p_pFiffInfo->dig.append(t_pTag->toDigPoint());
@@ -182,14 +217,16 @@ FiffInfo::SPtr RtDataClient::readInfo()
         {
             while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_PROJ)
             {
-                t_fiffStream.read_rt_tag(t_pTag);
+                if(!readNextTag(t_pTag))
+                    return p_pFiffInfo;
                 if(t_pTag->kind == FIFF_BLOCK_START && *(t_pTag->toInt()) == FIFFB_PROJ_ITEM)
                 {
                     FiffProj proj;
                     qint32 countProj = p_pFiffInfo->projs.size();
                     while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_PROJ_ITEM)
                     {
-                        t_fiffStream.read_rt_tag(t_pTag);
+                        if(!readNextTag(t_pTag))
+                            return p_pFiffInfo;
                         switch (t_pTag->kind)
                         {
                         case FIFF_NAME: // First proj -> Proj is created
@@ -235,14 +272,16 @@ FiffInfo::SPtr RtDataClient::readInfo()
         {
             while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_MNE_CTF_COMP)
             {
-                t_fiffStream.read_rt_tag(t_pTag);
+                if(!readNextTag(t_pTag))
+                    return p_pFiffInfo;
                 if(t_pTag->kind == FIFF_BLOCK_START && *(t_pTag->toInt()) == FIFFB_MNE_CTF_COMP_DATA)
                 {
                     FiffCtfComp comp;
                     qint32 countComp = p_pFiffInfo->comps.size();
                     while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_MNE_CTF_COMP_DATA)
                     {
-                        t_fiffStream.read_rt_tag(t_pTag);
+                        if(!readNextTag(t_pTag))
+                            return p_pFiffInfo;
                         switch (t_pTag->kind)
                         {
                         case FIFF_MNE_CTF_COMP_KIND: //First comp -> create comp
@@ -298,7 +337,8 @@ FiffInfo::SPtr RtDataClient::readInfo()
         {
             while(t_pTag->kind != FIFF_BLOCK_END || *(t_pTag->toInt()) != FIFFB_MNE_BAD_CHANNELS)
             {
-                t_fiffStream.read_rt_tag(t_pTag);
+                if(!readNextTag(t_pTag))
+                    return p_pFiffInfo;
                 if(t_pTag->kind == FIFF_MNE_CH_NAME_LIST)
                     p_pFiffInfo->bads = FiffStream::split_name_list(t_pTag->data());
             }
@@ -368,6 +408,13 @@ FiffInfo::SPtr RtDataClient::readInfo()
     for (qint32 c = 0; c < p_pFiffInfo->nchan; ++c)
         p_pFiffInfo->ch_names << p_pFiffInfo->chs[c].ch_name;
 
+    m_iNumChannels = p_pFiffInfo->nchan;
+
+    m_vecCals.resize(p_pFiffInfo->chs.size());
+    for(qint32 k = 0; k < p_pFiffInfo->chs.size(); ++k) {
+        m_vecCals[k] = p_pFiffInfo->chs[k].range * p_pFiffInfo->chs[k].cal;
+    }
+
     return p_pFiffInfo;
 }
 
@@ -375,25 +422,287 @@ FiffInfo::SPtr RtDataClient::readInfo()
 
 void RtDataClient::readRawBuffer(qint32 p_nChannels, MatrixXf& data, fiff_int_t& kind)
 {
-//        data = [];
+    m_iNumChannels = p_nChannels;
 
-    FiffStream t_fiffStream(this);
-    //
-    // Find the start
-    //
-    FiffTag::SPtr t_pTag;
+    if(m_pSharedMemoryRing && readSharedMemoryBuffer(data, kind)) {
+        return;
+    }
+
+    if(!waitForTag()) {
+        kind = -1;
+        return;
+    }
+
+    takeRawBuffer(data, kind);
+}
 
-    t_fiffStream.read_rt_tag(t_pTag);
+//=============================================================================================================
+
+bool RtDataClient::readSharedMemoryBuffer(MatrixXf& data, fiff_int_t& kind)
+{
+    //Keep the ring alive, even if it is detached meanwhile
+    RtSharedMemoryRing::SPtr pRing = m_pSharedMemoryRing;
+
+    forever {
+        //Raw buffers which do not fit into a slot and control tags, e.g. the block end, arrive on the socket.
+        //Entries of the ring which were written before have to be read first.
+        bool bTagReady = decodeTag();
+
+        if(!bTagReady || m_iPendingSocketBuffers == 0) {
+            bool bRedirected = false;
+            if(pRing->tryRead(data, &bRedirected)) {
+                if(!bRedirected) {
+                    kind = FIFF_DATA_BUFFER;
+                    return true;
+                }
 
-    kind = t_pTag->kind;
+                ++m_iPendingSocketBuffers;
+                continue;
+            }
+        }
+
+        if(bTagReady) {
+            if(m_iTagKind == FIFF_DATA_BUFFER && m_iPendingSocketBuffers > 0) {
+                --m_iPendingSocketBuffers;
+            }
 
-    if(kind == FIFF_DATA_BUFFER)
+            takeRawBuffer(data, kind);
+            return true;
+        }
+
+        if(pRing->isClosed()) {
+            //The ring was closed by mne_rt_server, continue with the socket
+            detachSharedMemory();
+            return false;
+        }
+
+        if(this->state() == QAbstractSocket::UnconnectedState) {
+            kind = -1;
+            return true;
+        }
+
+        if(!this->waitForReadyRead(0)) {
+            pRing->waitForData(RT_DATA_CLIENT_SHM_WAIT_MSECS);
+        }
+    }
+}
+
+//=============================================================================================================
+
+void RtDataClient::takeRawBuffer(MatrixXf& data, fiff_int_t& kind)
+{
+    kind = m_iTagKind;
+
+    if(m_bPayloadToMatrix)
+    {
+        //No copy, the previous buffer of the caller is reused for the next raw buffer
+        data.swap(m_matDecodeBuffer);
+    }
+    else if(kind == FIFF_DATA_BUFFER && m_pDecodedTag->toFloat() && m_iNumChannels > 0)
     {
-        qint32 nSamples = (t_pTag->size()/4)/p_nChannels;
-        data = MatrixXf(Map< MatrixXf >(t_pTag->toFloat(), p_nChannels, nSamples));
+        qint32 nSamples = (m_pDecodedTag->size()/4)/m_iNumChannels;
+        data = MatrixXf(Map< MatrixXf >(m_pDecodedTag->toFloat(), m_iNumChannels, nSamples));
+    }
+    else if(kind == FIFF_DATA_BUFFER && m_iNumChannels > 0)
+    {
+        //Quantized samples
+        bool t_bDecoded = true;
+        switch(m_iTagType) {
+        case FIFFT_SHORT:
+            data = Map< MatrixShort >(m_pDecodedTag->toShort(), m_iNumChannels, (m_pDecodedTag->size()/2)/m_iNumChannels).cast<float>();
+            break;
+        case FIFFT_INT:
+            data = Map< MatrixXi >(m_pDecodedTag->toInt(), m_iNumChannels, (m_pDecodedTag->size()/4)/m_iNumChannels).cast<float>();
+            break;
+        case FIFFT_MNE_DELTA_VARINT:
+            t_bDecoded = FiffStream::decode_delta_varint(m_pDecodedTag->data(), m_pDecodedTag->size(), m_matQuantBuffer)
+                         && m_matQuantBuffer.rows() == m_iNumChannels;
+            if(t_bDecoded) {
+                data = m_matQuantBuffer.cast<float>();
+            }
+            break;
+        default:
+            t_bDecoded = false;
+        }
+
+        if(!t_bDecoded) {
+            qWarning("RtDataClient::readRawBuffer - Could not decode raw buffer of type %d.", m_iTagType);
+            kind = -1;
+        } else if(m_vecCals.size() != data.rows()) {
+            //Without the calibrations the samples would be returned as unscaled quantization steps
+            qWarning("RtDataClient::readRawBuffer - Quantized raw buffer with %d channels, but %d calibrations are known. Read the measurement info first.",
+                     int(data.rows()), int(m_vecCals.size()));
+            kind = -1;
+        } else {
+            data.array().colwise() *= m_vecCals.array();
+        }
     }
 //        else
 //            data = tag.data;
+
+    releaseTag();
+}
+
+//=============================================================================================================
+
+bool RtDataClient::attachSharedMemory(const QString& sKey)
+{
+    if(sKey.isEmpty()) {
+        return false;
+    }
+
+    RtSharedMemoryRing::SPtr pRing(new RtSharedMemoryRing(sKey));
+    if(!pRing->attach()) {
+        return false;
+    }
+
+    m_pSharedMemoryRing = pRing;
+    m_iPendingSocketBuffers = 0;
+
+    return true;
+}
+
+//=============================================================================================================
+
+void RtDataClient::detachSharedMemory()
+{
+    if(m_pSharedMemoryRing) {
+        m_pSharedMemoryRing->wakeUp();
+        m_pSharedMemoryRing.clear();
+    }
+}
+
+//=============================================================================================================
+
+bool RtDataClient::decodeTag()
+{
+    if(m_bTagReady) {
+        return true;
+    }
+
+    //
+    // Tag header
+    //
+    if(m_iHeaderReceived < 16)
+    {
+        qint64 t_iRead = this->read(m_pTagHeader + m_iHeaderReceived, 16 - m_iHeaderReceived);
+        if(t_iRead <= 0) {
+            return false;
+        }
+
+        m_iHeaderReceived += t_iRead;
+        if(m_iHeaderReceived < 16) {
+            return false;
+        }
+
+        const uchar* t_pHeader = reinterpret_cast<const uchar*>(m_pTagHeader);
+        m_iTagKind = qFromBigEndian<qint32>(t_pHeader);
+        m_iTagType = qFromBigEndian<qint32>(t_pHeader + 4);
+        m_iTagSize = qMax(qFromBigEndian<qint32>(t_pHeader + 8), 0);
+        m_iTagNext = qFromBigEndian<qint32>(t_pHeader + 12);
+        m_iPayloadReceived = 0;
+
+        //Raw data buffers are assembled directly in the reused matrix
+        m_bPayloadToMatrix = m_iTagKind == FIFF_DATA_BUFFER
+                             && m_iTagType == FIFFT_FLOAT
+                             && m_iNumChannels > 0
+                             && m_iTagSize > 0
+                             && m_iTagSize % (4 * m_iNumChannels) == 0;
+
+        if(m_bPayloadToMatrix) {
+            //Resizing is a no-op if the block size did not change
+            m_matDecodeBuffer.resize(m_iNumChannels, m_iTagSize / (4 * m_iNumChannels));
+            m_pPayload = reinterpret_cast<char*>(m_matDecodeBuffer.data());
+        } else {
+            m_pDecodedTag = FiffTag::SPtr(new FiffTag());
+            m_pDecodedTag->kind = m_iTagKind;
+            m_pDecodedTag->type = m_iTagType;
+            m_pDecodedTag->resize(m_iTagSize);
+            m_pDecodedTag->next = m_iTagNext;
+            m_pPayload = m_pDecodedTag->data();
+        }
+    }
+
+    //
+    // Tag payload
+    //
+    if(m_iPayloadReceived < m_iTagSize)
+    {
+        qint64 t_iRead = this->read(m_pPayload + m_iPayloadReceived, m_iTagSize - m_iPayloadReceived);
+        if(t_iRead > 0) {
+            m_iPayloadReceived += t_iRead;
+        }
+        if(m_iPayloadReceived < m_iTagSize) {
+            return false;
+        }
+    }
+
+    if(m_bPayloadToMatrix) {
+        #if NATIVE_ENDIAN == FIFFV_LITTLE_ENDIAN
+        float* t_pData = m_matDecodeBuffer.data();
+        for(qint64 i = 0; i < m_matDecodeBuffer.size(); ++i) {
+            IOUtils::swap_floatp(t_pData + i);
+        }
+        #endif
+    } else if(m_iTagSize > 0) {
+        FiffTag::convert_tag_data(m_pDecodedTag, FIFFV_BIG_ENDIAN, FIFFV_NATIVE_ENDIAN);
+    }
+
+    m_iHeaderReceived = 0;
+    m_pPayload = Q_NULLPTR;
+    m_bTagReady = true;
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool RtDataClient::waitForTag(int iMsecs)
+{
+    //waitForReadyRead returns as soon as new bytes arrived, there is no fixed polling interval
+    while(!decodeTag())
+    {
+        if(!this->waitForReadyRead(iMsecs)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool RtDataClient::readNextTag(FiffTag::SPtr& p_pTag, int iMsecs)
+{
+    if(!waitForTag(iMsecs)) {
+        return false;
+    }
+
+    if(m_bPayloadToMatrix)
+    {
+        p_pTag = FiffTag::SPtr(new FiffTag());
+        p_pTag->kind = m_iTagKind;
+        p_pTag->type = m_iTagType;
+        p_pTag->resize(m_iTagSize);
+        p_pTag->next = m_iTagNext;
+        memcpy(p_pTag->data(), m_matDecodeBuffer.data(), m_iTagSize);
+    }
+    else
+    {
+        p_pTag = m_pDecodedTag;
+    }
+
+    releaseTag();
+
+    return true;
+}
+
+//=============================================================================================================
+
+void RtDataClient::releaseTag()
+{
+    m_bTagReady = false;
+    m_pDecodedTag.clear();
 }
 
 //=============================================================================================================
@@ -42,6 +42,7 @@
 //=============================================================================================================
 
 #include "../communication_global.h"
+#include "../rtSharedMemory/rtsharedmemoryring.h"
 
 #include <fiff/fiff_stream.h>
 #include <fiff/fiff_info.h>
@@ -118,11 +119,15 @@ public:
 
     //=========================================================================================================
     /**
-     * Reads fiff measurement information of a data the connection
+     * Reads the next tag of the connection. Raw data buffers are decoded directly into a reused matrix, which is
+     * swapped into data, so the received samples are not copied again. The previous content of data is used as
+     * decoding buffer for the next raw buffer. Quantized raw buffers (int16, int32 or delta coded int32, see the
+     * datatype command of mne_rt_server) are decoded and scaled back with the calibrations of the last read info.
      *
      * @param[in] p_nChannels    Number of channels to reshape the received data
      * @param[out] data          The read data - ToDo change this to raw buffer data object
-     * @param[out] kind          Data kind
+     * @param[out] kind          Data kind, -1 if the connection was closed before a complete tag was received or
+     *                           a quantized raw buffer could not be decoded or scaled back
      */
     void readRawBuffer(qint32 p_nChannels, Eigen::MatrixXf& data, FIFFLIB::fiff_int_t& kind);
 
@@ -134,14 +139,125 @@ public:
      */
     void setClientAlias(const QString &p_sAlias);
 
+    //=========================================================================================================
+    /**
+     * Attaches to the shared memory ring which mne_rt_server created for this client after the shmem command.
+     * Afterwards readRawBuffer receives the raw buffers from the ring instead of the socket. Raw buffers which do
+     * not fit into a slot of the ring and control tags are still received from the socket.
+     *
+     * @param[in] sKey   The key of the ring, as replied by mne_rt_server to the shmem command.
+     *
+     * @return true if the ring was attached.
+     */
+    bool attachSharedMemory(const QString& sKey);
+
+    //=========================================================================================================
+    /**
+     * Detaches from the shared memory ring. Raw buffers are received from the socket again.
+     */
+    void detachSharedMemory();
+
+    //=========================================================================================================
+    /**
+     * Returns whether raw buffers are received from a shared memory ring.
+     *
+     * @return true if the shared memory transport is used.
+     */
+    inline bool isUsingSharedMemory() const;
+
 private:
+    //=========================================================================================================
+    /**
+     * Reads the next raw buffer from the shared memory ring or the next tag of the socket, whichever was sent
+     * first by mne_rt_server.
+     *
+     * @param[out] data          The read data.
+     * @param[out] kind          Data kind, -1 if the connection was closed.
+     *
+     * @return false if the ring was closed and the data has to be read from the socket.
+     */
+    bool readSharedMemoryBuffer(Eigen::MatrixXf& data, FIFFLIB::fiff_int_t& kind);
+
+    //=========================================================================================================
+    /**
+     * Converts the current tag into a raw buffer and releases it.
+     *
+     * @param[out] data          The read data.
+     * @param[out] kind          Data kind, -1 if a raw buffer could not be decoded.
+     */
+    void takeRawBuffer(Eigen::MatrixXf& data, FIFFLIB::fiff_int_t& kind);
+
+    //=========================================================================================================
+    /**
+     * Consumes the bytes which are currently available on the socket without blocking and assembles them into
+     * the current tag.
+     *
+     * @return true if a complete tag is ready, false if more data is needed.
+     */
+    bool decodeTag();
+
+    //=========================================================================================================
+    /**
+     * Waits until the next tag is complete. Returns as soon as the missing bytes arrived.
+     *
+     * @param[in] iMsecs     Timeout in msecs for each wait on new data, -1 waits without timeout.
+     *
+     * @return true if a complete tag is ready.
+     */
+    bool waitForTag(int iMsecs = -1);
+
+    //=========================================================================================================
+    /**
+     * Reads the next complete tag of the connection.
+     *
+     * @param[out] p_pTag    The read tag.
+     * @param[in] iMsecs     Timeout in msecs for each wait on new data, -1 waits without timeout.
+     *
+     * @return true if a tag was read.
+     */
+    bool readNextTag(FIFFLIB::FiffTag::SPtr& p_pTag, int iMsecs = -1);
+
+    //=========================================================================================================
+    /**
+     * Marks the decoded tag as consumed, so the decoder continues with the next one.
+     */
+    void releaseTag();
+
     qint32 m_clientID;  /**< Corresponding client id of the data client at mne_rt_server */
 
+    char                    m_pTagHeader[16];       /**< The received bytes of the current tag header. */
+    qint32                  m_iHeaderReceived;      /**< Number of received header bytes. */
+    FIFFLIB::fiff_int_t     m_iTagKind;             /**< Kind of the current tag. */
+    FIFFLIB::fiff_int_t     m_iTagType;             /**< Type of the current tag. */
+    FIFFLIB::fiff_int_t     m_iTagSize;             /**< Payload size of the current tag. */
+    FIFFLIB::fiff_int_t     m_iTagNext;             /**< Next field of the current tag. */
+    char*                   m_pPayload;             /**< Where the payload of the current tag is assembled. */
+    qint64                  m_iPayloadReceived;     /**< Number of received payload bytes. */
+    bool                    m_bPayloadToMatrix;     /**< Whether the payload is assembled in m_matDecodeBuffer. */
+    bool                    m_bTagReady;            /**< Whether the current tag is complete and not yet consumed. */
+    qint32                  m_iNumChannels;         /**< Number of channels used to shape raw data buffers, -1 if unknown. */
+    FIFFLIB::FiffTag::SPtr  m_pDecodedTag;          /**< The current tag, if it is not decoded into m_matDecodeBuffer. */
+    Eigen::MatrixXf         m_matDecodeBuffer;      /**< Aligned buffer raw data buffers are decoded into. */
+    Eigen::MatrixXi         m_matQuantBuffer;       /**< Reused buffer for quantized raw data buffers. */
+    Eigen::VectorXf         m_vecCals;              /**< Quantization steps (range * cal) of the channels of the last read info. */
+
+    RtSharedMemoryRing::SPtr m_pSharedMemoryRing;   /**< The local shared memory transport, if attached. */
+    qint32                  m_iPendingSocketBuffers;    /**< Number of raw buffers the ring redirected to the socket, which were not read yet. */
+
 signals:
     
 public slots:
     
 };
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool RtDataClient::isUsingSharedMemory() const
+{
+    return !m_pSharedMemoryRing.isNull();
+}
 } // NAMESPACE
 
 #endif // RTDATACLIENT_H
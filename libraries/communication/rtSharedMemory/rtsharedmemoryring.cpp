@@ -0,0 +1,518 @@
+//=============================================================================================================
+/**
+ * @file     rtsharedmemoryring.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    RtSharedMemoryRing class definition.
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "rtsharedmemoryring.h"
+
+#include <new>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QDebug>
+#include <QThread>
+#include <QUuid>
+#include <QElapsedTimer>
+
+//=============================================================================================================
+// SYSTEM INCLUDES
+//=============================================================================================================
+
+#if defined(Q_OS_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <climits>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define RT_SHM_RING_MAGIC           0x4d4e4552      /**< Identifies an initialized ring ("MNER"). */
+#define RT_SHM_RING_HEADER_BYTES    64              /**< Bytes reserved for the ring header. */
+#define RT_SHM_RING_SLOT_INFO_BYTES 16              /**< Bytes reserved for the slot info in front of the samples. */
+#define RT_SHM_RING_REDIRECT        -1              /**< Number of rows of a redirect entry. */
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace COMMUNICATIONLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+// DEFINE STRUCTS
+//=============================================================================================================
+
+namespace COMMUNICATIONLIB
+{
+
+//=============================================================================================================
+/**
+ * The ring header placed at the begin of the shared memory segment. The head counts the written slots and is
+ * only advanced by the producer, the tail counts the read slots and is only advanced by the consumer. The wakeup
+ * sequence is advanced whenever a waiting consumer needs to recheck the ring, it is the futex word on Linux.
+ */
+struct RtSharedMemoryRingHeader
+{
+    quint32                     iMagic;         /**< RT_SHM_RING_MAGIC if the ring is initialized. */
+    qint32                      iNumSlots;      /**< Number of slots. */
+    qint32                      iSlotBytes;     /**< Maximal size in bytes of one raw buffer. */
+    qint32                      iSlotStride;    /**< Distance in bytes between two slots. */
+    QAtomicInteger<quint32>     iHead;          /**< Number of written slots. */
+    QAtomicInteger<quint32>     iTail;          /**< Number of read slots. */
+    QAtomicInt                  iClosed;        /**< Whether the producer closed the ring. */
+    QAtomicInt                  iSequence;      /**< The wakeup sequence. */
+    QAtomicInt                  iWaiters;       /**< Number of consumers sleeping on the wakeup sequence. */
+};
+
+} // NAMESPACE
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+RtSharedMemoryRing::RtSharedMemoryRing(const QString& sKey)
+: m_sKey(sKey)
+, m_sharedMemory(sKey)
+, m_pHeader(Q_NULLPTR)
+, m_bIsProducer(false)
+, m_iInterrupted(0)
+, m_pWakeUpEvent(Q_NULLPTR)
+{
+    Q_STATIC_ASSERT(sizeof(RtSharedMemoryRingHeader) <= RT_SHM_RING_HEADER_BYTES);
+    Q_STATIC_ASSERT(sizeof(QAtomicInt) == sizeof(int));
+}
+
+//=============================================================================================================
+
+RtSharedMemoryRing::~RtSharedMemoryRing()
+{
+    detach();
+}
+
+//=============================================================================================================
+
+QString RtSharedMemoryRing::keyForClient(qint32 iClientId,
+                                         const QString& sToken)
+{
+    return QString("mne_rt_server_shm_%1_%2").arg(iClientId).arg(sToken);
+}
+
+//=============================================================================================================
+
+QString RtSharedMemoryRing::createToken()
+{
+    return QString(QUuid::createUuid().toRfc4122().toHex());
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::create(qint32 iNumSlots,
+                                qint32 iSlotBytes)
+{
+    detach();
+
+    if(iNumSlots <= 0 || iSlotBytes <= 0) {
+        return false;
+    }
+
+    //Keep the samples of every slot cache line aligned
+    qint32 iSlotStride = ((RT_SHM_RING_SLOT_INFO_BYTES + iSlotBytes + 63) / 64) * 64;
+    qint32 iSize = RT_SHM_RING_HEADER_BYTES + iNumSlots * iSlotStride;
+
+    if(!m_sharedMemory.create(iSize)) {
+        //A segment left over by a crashed server is released by attaching and detaching it
+        if(m_sharedMemory.error() == QSharedMemory::AlreadyExists && m_sharedMemory.attach()) {
+            m_sharedMemory.detach();
+        }
+
+        if(!m_sharedMemory.create(iSize)) {
+            qWarning() << "[RtSharedMemoryRing::create] Could not create shared memory" << m_sKey << m_sharedMemory.errorString();
+            return false;
+        }
+    }
+
+    m_pHeader = new (m_sharedMemory.data()) RtSharedMemoryRingHeader;
+    m_pHeader->iNumSlots = iNumSlots;
+    m_pHeader->iSlotBytes = iSlotBytes;
+    m_pHeader->iSlotStride = iSlotStride;
+    m_pHeader->iHead.storeRelease(0);
+    m_pHeader->iTail.storeRelease(0);
+    m_pHeader->iClosed.storeRelease(0);
+    m_pHeader->iSequence.storeRelease(0);
+    m_pHeader->iWaiters.storeRelease(0);
+    m_pHeader->iMagic = RT_SHM_RING_MAGIC;
+
+    m_bIsProducer = true;
+
+    if(!openWakeUpEvent()) {
+        detach();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::attach()
+{
+    detach();
+
+    if(!m_sharedMemory.attach()) {
+        qWarning() << "[RtSharedMemoryRing::attach] Could not attach to shared memory" << m_sKey << m_sharedMemory.errorString();
+        return false;
+    }
+
+    RtSharedMemoryRingHeader* pHeader = static_cast<RtSharedMemoryRingHeader*>(m_sharedMemory.data());
+
+    if(m_sharedMemory.size() < RT_SHM_RING_HEADER_BYTES
+       || pHeader->iMagic != RT_SHM_RING_MAGIC
+       || pHeader->iNumSlots <= 0
+       || pHeader->iSlotBytes <= 0
+       || pHeader->iSlotStride < RT_SHM_RING_SLOT_INFO_BYTES + pHeader->iSlotBytes
+       || RT_SHM_RING_HEADER_BYTES + qint64(pHeader->iNumSlots) * pHeader->iSlotStride > m_sharedMemory.size()) {
+        qWarning() << "[RtSharedMemoryRing::attach] Shared memory" << m_sKey << "does not hold a ring";
+        m_sharedMemory.detach();
+        return false;
+    }
+
+    m_pHeader = pHeader;
+    m_bIsProducer = false;
+    m_iInterrupted.storeRelease(0);
+
+    if(!openWakeUpEvent()) {
+        detach();
+        return false;
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+void RtSharedMemoryRing::detach()
+{
+    if(!m_pHeader) {
+        return;
+    }
+
+    if(m_bIsProducer) {
+        m_pHeader->iClosed.storeRelease(1);
+        notify();
+    }
+
+#if defined(Q_OS_WIN)
+    if(m_pWakeUpEvent) {
+        CloseHandle(static_cast<HANDLE>(m_pWakeUpEvent));
+        m_pWakeUpEvent = Q_NULLPTR;
+    }
+#endif
+
+    m_pHeader = Q_NULLPTR;
+    m_sharedMemory.detach();
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::fits(const MatrixXf& matData) const
+{
+    return m_pHeader && matData.size() * qint64(sizeof(float)) <= m_pHeader->iSlotBytes;
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::write(const MatrixXf& matData)
+{
+    if(!m_pHeader || !m_bIsProducer || !fits(matData)) {
+        return false;
+    }
+
+    return writeSlot(matData.rows(), matData.cols(), matData.data());
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::writeRedirect()
+{
+    if(!m_pHeader || !m_bIsProducer) {
+        return false;
+    }
+
+    return writeSlot(RT_SHM_RING_REDIRECT, 0, Q_NULLPTR);
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::read(MatrixXf& matData,
+                              bool* pRedirected,
+                              int iMsecs)
+{
+    if(!m_pHeader) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while(!tryRead(matData, pRedirected)) {
+        qint64 iRemaining = iMsecs < 0 ? -1 : iMsecs - timer.elapsed();
+
+        if((iMsecs >= 0 && iRemaining <= 0) || !waitForData(int(iRemaining))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::tryRead(MatrixXf& matData,
+                                 bool* pRedirected)
+{
+    if(!m_pHeader || m_bIsProducer) {
+        return false;
+    }
+
+    forever {
+        quint32 iTail = m_pHeader->iTail.loadAcquire();
+        quint32 iHead = m_pHeader->iHead.loadAcquire();
+
+        if(iHead == iTail) {
+            return false;
+        }
+
+        const char* pSlot = slot(iTail);
+        const qint32* pInfo = reinterpret_cast<const qint32*>(pSlot);
+        qint32 iRows = pInfo[0];
+        qint32 iCols = pInfo[1];
+
+        if(iRows == RT_SHM_RING_REDIRECT) {
+            m_pHeader->iTail.storeRelease(iTail + 1);
+
+            if(pRedirected) {
+                *pRedirected = true;
+                return true;
+            }
+
+            continue;
+        }
+
+        //Do not trust the slot info, the segment is writable by the producer process
+        if(iRows < 0 || iCols < 0 || qint64(iRows) * iCols * qint64(sizeof(float)) > m_pHeader->iSlotBytes) {
+            qWarning() << "[RtSharedMemoryRing::tryRead] Invalid slot info in" << m_sKey << "- closing the ring.";
+            m_iInterrupted.storeRelease(1);
+            return false;
+        }
+
+        matData.resize(iRows, iCols);
+        memcpy(matData.data(), pSlot + RT_SHM_RING_SLOT_INFO_BYTES, matData.size() * sizeof(float));
+
+        m_pHeader->iTail.storeRelease(iTail + 1);
+
+        if(pRedirected) {
+            *pRedirected = false;
+        }
+
+        return true;
+    }
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::waitForData(int iMsecs)
+{
+    if(!m_pHeader) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    forever {
+        //Read the sequence first, so a notification after the checks below makes the wait return immediately
+        qint32 iSequence = m_pHeader->iSequence.loadAcquire();
+
+        if(m_pHeader->iHead.loadAcquire() != m_pHeader->iTail.loadAcquire()) {
+            return true;
+        }
+
+        if(m_pHeader->iClosed.loadAcquire() || m_iInterrupted.loadAcquire()) {
+            return false;
+        }
+
+        qint64 iRemaining = iMsecs < 0 ? -1 : iMsecs - timer.elapsed();
+
+        if(iMsecs >= 0 && iRemaining <= 0) {
+            return false;
+        }
+
+        waitForNotify(iSequence, int(iRemaining));
+    }
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::isClosed() const
+{
+    return !m_pHeader || m_pHeader->iClosed.loadAcquire() || m_iInterrupted.loadAcquire();
+}
+
+//=============================================================================================================
+
+void RtSharedMemoryRing::wakeUp()
+{
+    m_iInterrupted.storeRelease(1);
+
+    if(m_pHeader) {
+        notify();
+    }
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::writeSlot(qint32 iRows,
+                                   qint32 iCols,
+                                   const float* pData)
+{
+    quint32 iHead = m_pHeader->iHead.loadAcquire();
+    quint32 iTail = m_pHeader->iTail.loadAcquire();
+
+    //The ring is full, the consumer does not keep up
+    if(iHead - iTail >= quint32(m_pHeader->iNumSlots)) {
+        return false;
+    }
+
+    char* pSlot = slot(iHead);
+    qint32* pInfo = reinterpret_cast<qint32*>(pSlot);
+    pInfo[0] = iRows;
+    pInfo[1] = iCols;
+
+    if(pData && iRows > 0 && iCols > 0) {
+        memcpy(pSlot + RT_SHM_RING_SLOT_INFO_BYTES, pData, qint64(iRows) * iCols * sizeof(float));
+    }
+
+    m_pHeader->iHead.storeRelease(iHead + 1);
+
+    notify();
+
+    return true;
+}
+
+//=============================================================================================================
+
+void RtSharedMemoryRing::notify()
+{
+    m_pHeader->iSequence.fetchAndAddOrdered(1);
+
+    //Full barrier read, pairs with the registration of the waiter in waitForNotify. Skips the system call while
+    //the consumer is busy.
+    if(m_pHeader->iWaiters.fetchAndAddOrdered(0) == 0) {
+        return;
+    }
+
+#if defined(Q_OS_LINUX)
+    syscall(SYS_futex, reinterpret_cast<int*>(&m_pHeader->iSequence), FUTEX_WAKE, INT_MAX, Q_NULLPTR, Q_NULLPTR, 0);
+#elif defined(Q_OS_WIN)
+    if(m_pWakeUpEvent) {
+        SetEvent(static_cast<HANDLE>(m_pWakeUpEvent));
+    }
+#endif
+}
+
+//=============================================================================================================
+
+void RtSharedMemoryRing::waitForNotify(qint32 iSequence,
+                                       int iMsecs)
+{
+    m_pHeader->iWaiters.fetchAndAddOrdered(1);
+
+    //Do not sleep if the producer advanced the sequence before it could see the registration
+    if(m_pHeader->iSequence.fetchAndAddOrdered(0) == iSequence) {
+#if defined(Q_OS_LINUX)
+        struct timespec timeout;
+        timeout.tv_sec = iMsecs / 1000;
+        timeout.tv_nsec = (iMsecs % 1000) * 1000000L;
+
+        //Returns immediately if the sequence changed in the meantime
+        syscall(SYS_futex, reinterpret_cast<int*>(&m_pHeader->iSequence), FUTEX_WAIT, iSequence,
+                iMsecs < 0 ? Q_NULLPTR : &timeout, Q_NULLPTR, 0);
+#elif defined(Q_OS_WIN)
+        //The auto-reset event stays signaled if the producer set it before
+        WaitForSingleObject(static_cast<HANDLE>(m_pWakeUpEvent), iMsecs < 0 ? INFINITE : DWORD(iMsecs));
+#else
+        Q_UNUSED(iMsecs)
+        QThread::usleep(RT_SHM_RING_POLL_USECS);
+#endif
+    }
+
+    m_pHeader->iWaiters.fetchAndAddOrdered(-1);
+}
+
+//=============================================================================================================
+
+bool RtSharedMemoryRing::openWakeUpEvent()
+{
+#if defined(Q_OS_WIN)
+    //Both sides open the same auto-reset event, whoever comes first creates it
+    QString sName = QString("Local\\%1_wakeup").arg(m_sKey);
+    m_pWakeUpEvent = CreateEventW(Q_NULLPTR, FALSE, FALSE, reinterpret_cast<LPCWSTR>(sName.utf16()));
+
+    if(!m_pWakeUpEvent) {
+        qWarning() << "[RtSharedMemoryRing::openWakeUpEvent] Could not open the wakeup event of" << m_sKey;
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+//=============================================================================================================
+
+char* RtSharedMemoryRing::slot(quint32 iIndex)
+{
+    return static_cast<char*>(m_sharedMemory.data())
+            + RT_SHM_RING_HEADER_BYTES
+            + qint64(iIndex % quint32(m_pHeader->iNumSlots)) * m_pHeader->iSlotStride;
+}
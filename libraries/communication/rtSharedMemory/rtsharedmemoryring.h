@@ -0,0 +1,331 @@
+//=============================================================================================================
+/**
+ * @file     rtsharedmemoryring.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    RtSharedMemoryRing class declaration.
+ *
+ */
+
+#ifndef RTSHAREDMEMORYRING_H
+#define RTSHAREDMEMORYRING_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../communication_global.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QSharedPointer>
+#include <QSharedMemory>
+#include <QString>
+#include <QAtomicInt>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define RT_SHM_RING_NUM_SLOTS   32          /**< Default number of raw buffer slots of the ring. */
+#define RT_SHM_RING_SLOT_BYTES  2097152     /**< Default maximal size in bytes of one raw buffer (2 MB). */
+#define RT_SHM_RING_POLL_USECS  200         /**< Interval in microseconds in which a waiting consumer polls the ring on platforms without a wakeup primitive. */
+
+//=============================================================================================================
+// DEFINE NAMESPACE COMMUNICATIONLIB
+//=============================================================================================================
+
+namespace COMMUNICATIONLIB
+{
+
+//=============================================================================================================
+// FORWARD DECLARATIONS
+//=============================================================================================================
+
+struct RtSharedMemoryRingHeader;
+
+//=============================================================================================================
+/**
+ * Single producer, single consumer ring of raw data buffers in shared memory. It is used as local transport
+ * between mne_rt_server and a client running on the same host. The producer writes the samples once into a free
+ * slot, the consumer copies the samples out of the slot, no data passes through the kernel. A waiting consumer
+ * sleeps on a futex (Linux) or a named event (Windows) and is woken up by the producer, other platforms poll.
+ * A buffer which does not fit into a slot is sent through another transport (the socket), the producer then
+ * writes a redirect entry into the ring, so that the consumer keeps the order of the buffers.
+ *
+ * @brief Shared memory ring of raw data buffers
+ */
+class COMMUNICATIONSHARED_EXPORT RtSharedMemoryRing
+{
+
+public:
+    typedef QSharedPointer<RtSharedMemoryRing> SPtr;               /**< Shared pointer type for RtSharedMemoryRing. */
+    typedef QSharedPointer<const RtSharedMemoryRing> ConstSPtr;    /**< Const shared pointer type for RtSharedMemoryRing. */
+
+    //=========================================================================================================
+    /**
+     * Constructs the ring. Call create or attach before using it.
+     *
+     * @param[in] sKey   The key of the shared memory segment.
+     */
+    explicit RtSharedMemoryRing(const QString& sKey);
+
+    //=========================================================================================================
+    /**
+     * Destroys the ring. A producer marks the ring as closed and wakes up the consumer.
+     */
+    ~RtSharedMemoryRing();
+
+    //=========================================================================================================
+    /**
+     * Returns the shared memory key used for the stream client with the given id. The key contains a random token,
+     * which is only handed to the client over the command connection, so that other local processes can not guess it.
+     *
+     * @param[in] iClientId  The id of the FiffStreamClient at mne_rt_server.
+     * @param[in] sToken     The session token, see createToken.
+     *
+     * @return the shared memory key.
+     */
+    static QString keyForClient(qint32 iClientId,
+                                const QString& sToken);
+
+    //=========================================================================================================
+    /**
+     * Creates a random session token for keyForClient.
+     *
+     * @return the token.
+     */
+    static QString createToken();
+
+    //=========================================================================================================
+    /**
+     * Creates the shared memory segment. Called by the producer.
+     *
+     * @param[in] iNumSlots      Number of raw buffer slots.
+     * @param[in] iSlotBytes     Maximal size in bytes of one raw buffer.
+     *
+     * @return true if the ring was created.
+     */
+    bool create(qint32 iNumSlots = RT_SHM_RING_NUM_SLOTS,
+                qint32 iSlotBytes = RT_SHM_RING_SLOT_BYTES);
+
+    //=========================================================================================================
+    /**
+     * Attaches to a ring created by the producer. Called by the consumer.
+     *
+     * @return true if the ring was attached.
+     */
+    bool attach();
+
+    //=========================================================================================================
+    /**
+     * Detaches from the shared memory segment. A producer marks the ring as closed before.
+     */
+    void detach();
+
+    //=========================================================================================================
+    /**
+     * Returns whether the ring is created or attached.
+     *
+     * @return true if the ring can be used.
+     */
+    inline bool isValid() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the shared memory key.
+     *
+     * @return the key.
+     */
+    inline QString key() const;
+
+    //=========================================================================================================
+    /**
+     * Returns whether a raw buffer fits into one slot.
+     *
+     * @param[in] matData    The raw buffer.
+     *
+     * @return true if the buffer can be written with write.
+     */
+    bool fits(const Eigen::MatrixXf& matData) const;
+
+    //=========================================================================================================
+    /**
+     * Writes a raw buffer into the next free slot. Does not block.
+     *
+     * @param[in] matData    The raw buffer.
+     *
+     * @return true if written, false if the ring is full or the buffer does not fit into a slot.
+     */
+    bool write(const Eigen::MatrixXf& matData);
+
+    //=========================================================================================================
+    /**
+     * Writes a redirect entry into the next free slot. It tells the consumer that the next raw buffer is sent
+     * through another transport. Does not block.
+     *
+     * @return true if written, false if the ring is full.
+     */
+    bool writeRedirect();
+
+    //=========================================================================================================
+    /**
+     * Reads the next raw buffer. Waits until a buffer is available, the ring is closed, the reader is woken up or
+     * the timeout expired.
+     *
+     * @param[out] matData       The raw buffer. Only reallocated if its size changed.
+     * @param[out] pRedirected   Set to true if a redirect entry was read instead of a buffer. If Q_NULLPTR, redirect
+     *                           entries are skipped.
+     * @param[in] iMsecs         The timeout in milliseconds. -1 waits until the ring is closed or the reader is woken up.
+     *
+     * @return true if a buffer or a redirect entry was read, false otherwise.
+     */
+    bool read(Eigen::MatrixXf& matData,
+              bool* pRedirected = Q_NULLPTR,
+              int iMsecs = -1);
+
+    //=========================================================================================================
+    /**
+     * Reads the next raw buffer if one is available. Does not block.
+     *
+     * @param[out] matData       The raw buffer. Only reallocated if its size changed.
+     * @param[out] pRedirected   Set to true if a redirect entry was read instead of a buffer. If Q_NULLPTR, redirect
+     *                           entries are skipped.
+     *
+     * @return true if a buffer or a redirect entry was read.
+     */
+    bool tryRead(Eigen::MatrixXf& matData,
+                 bool* pRedirected = Q_NULLPTR);
+
+    //=========================================================================================================
+    /**
+     * Waits until an entry is available, the ring is closed, the reader is woken up or the timeout expired.
+     *
+     * @param[in] iMsecs     The timeout in milliseconds. -1 waits until the ring is closed or the reader is woken up.
+     *
+     * @return true if an entry is available.
+     */
+    bool waitForData(int iMsecs);
+
+    //=========================================================================================================
+    /**
+     * Returns whether the producer closed the ring, i.e. no further buffers will arrive.
+     *
+     * @return true if the ring was closed or is not attached.
+     */
+    bool isClosed() const;
+
+    //=========================================================================================================
+    /**
+     * Wakes up a consumer waiting in read or waitForData. Subsequent calls return false.
+     */
+    void wakeUp();
+
+private:
+    //=========================================================================================================
+    /**
+     * Returns a pointer to the given slot.
+     *
+     * @param[in] iIndex     The running index of the slot.
+     *
+     * @return the slot data.
+     */
+    char* slot(quint32 iIndex);
+
+    //=========================================================================================================
+    /**
+     * Writes the slot info and the samples into the next free slot.
+     *
+     * @param[in] iRows      The number of rows, -1 for a redirect entry.
+     * @param[in] iCols      The number of columns.
+     * @param[in] pData      The samples.
+     *
+     * @return true if written, false if the ring is full.
+     */
+    bool writeSlot(qint32 iRows,
+                   qint32 iCols,
+                   const float* pData);
+
+    //=========================================================================================================
+    /**
+     * Advances the wakeup sequence and wakes up a waiting consumer.
+     */
+    void notify();
+
+    //=========================================================================================================
+    /**
+     * Sleeps until the wakeup sequence differs from the given value or the timeout expired. May return early.
+     *
+     * @param[in] iSequence  The wakeup sequence read before the ring was found empty.
+     * @param[in] iMsecs     The timeout in milliseconds. -1 waits until woken up.
+     */
+    void waitForNotify(qint32 iSequence,
+                       int iMsecs);
+
+    //=========================================================================================================
+    /**
+     * Opens the named wakeup event of the ring on platforms which use one.
+     *
+     * @return true if the event was opened or is not needed.
+     */
+    bool openWakeUpEvent();
+
+    QString                             m_sKey;             /**< The shared memory key. */
+    QSharedMemory                       m_sharedMemory;     /**< The shared memory segment. */
+    RtSharedMemoryRingHeader*           m_pHeader;          /**< The ring header at the begin of the segment. */
+    bool                                m_bIsProducer;      /**< Whether this instance created the ring. */
+    QAtomicInt                          m_iInterrupted;     /**< Whether the consumer was woken up. */
+    void*                               m_pWakeUpEvent;     /**< The named wakeup event (Windows only). */
+};
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool RtSharedMemoryRing::isValid() const
+{
+    return m_pHeader != Q_NULLPTR;
+}
+
+//=============================================================================================================
+
+inline QString RtSharedMemoryRing::key() const
+{
+    return m_sKey;
+}
+} // NAMESPACE
+
+#endif // RTSHAREDMEMORYRING_H
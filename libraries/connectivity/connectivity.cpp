@@ -51,6 +51,7 @@
 #include "metrics/weightedphaselagindex.h"
 #include "metrics/unbiasedsquaredphaselagindex.h"
 #include "metrics/debiasedsquaredweightedphaselagindex.h"
+#include "metrics/metricfusion.h"
 
 //=============================================================================================================
 // QT INCLUDES
@@ -91,6 +92,9 @@ QList<Network> Connectivity::calculate(ConnectivitySettings& connectivitySetting
     QElapsedTimer timer;
     timer.start();
 
+    // Compute the tapered spectra and CSD based intermediate data once for all requested spectral metrics
+    connectivitySettings.setFusedModeActive(MetricFusion::calculate(connectivitySettings));
+
     if(lMethods.contains("WPLI")) {
         results.append(WeightedPhaseLagIndex::calculate(connectivitySettings));
     }
@@ -127,6 +131,8 @@ QList<Network> Connectivity::calculate(ConnectivitySettings& connectivitySetting
         results.append(DebiasedSquaredWeightedPhaseLagIndex::calculate(connectivitySettings));
     }
 
+    connectivitySettings.setFusedModeActive(false);
+
     qWarning() << "Total" << timer.elapsed();
     qDebug() << "Connectivity::calculateMultiMethods - Calculated"<< lMethods <<"for" << connectivitySettings.size() << "trials in"<< timer.elapsed() << "msecs.";
 
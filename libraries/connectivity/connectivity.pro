@@ -82,6 +82,7 @@ SOURCES += \
     metrics/weightedphaselagindex.cpp \
     metrics/debiasedsquaredweightedphaselagindex.cpp \
     metrics/phaselagindex.cpp \
+    metrics/metricfusion.cpp \
     network/network.cpp \
     network/networknode.cpp \
     network/networkedge.cpp \
@@ -101,6 +102,7 @@ HEADERS += \
     metrics/weightedphaselagindex.h \
     metrics/debiasedsquaredweightedphaselagindex.h \
     metrics/phaselagindex.h \
+    metrics/metricfusion.h \
     network/network.h \
     network/networknode.h \
     network/networkedge.h \
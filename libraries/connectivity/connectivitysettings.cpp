@@ -68,6 +68,32 @@ using namespace FSLIB;
 // DEFINE GLOBAL METHODS
 //=============================================================================================================
 
+template<typename T>
+void sumTrialPairs(QVector<QPair<int,T> >& vecSum,
+                   const QList<ConnectivitySettings::IntermediateTrialData>& lTrialData,
+                   QVector<QPair<int,T> > ConnectivitySettings::IntermediateTrialData::* pTrialPairs)
+{
+    for (int i = 0; i < vecSum.size(); ++i) {
+        vecSum[i].second.setZero();
+    }
+
+    // Trials which were not calculated yet do not contribute to the sum
+    for (int j = 0; j < lTrialData.size(); ++j) {
+        const QVector<QPair<int,T> >& vecTrial = lTrialData.at(j).*pTrialPairs;
+
+        if(vecTrial.size() != vecSum.size()) {
+            continue;
+        }
+
+        for (int i = 0; i < vecSum.size(); ++i) {
+            if(vecTrial.at(i).second.rows() == vecSum.at(i).second.rows() &&
+               vecTrial.at(i).second.cols() == vecSum.at(i).second.cols()) {
+                vecSum[i].second += vecTrial.at(i).second;
+            }
+        }
+    }
+}
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -76,6 +102,7 @@ ConnectivitySettings::ConnectivitySettings()
 : m_fFreqResolution(1.0f)
 , m_fSFreq(1000.0f)
 , m_sWindowType("hanning")
+, m_bFusedModeIsActive(false)
 {
     m_iNfft = int(m_fSFreq/m_fFreqResolution);
     qRegisterMetaType<CONNECTIVITYLIB::ConnectivitySettings>("CONNECTIVITYLIB::ConnectivitySettings");
@@ -93,6 +120,22 @@ void ConnectivitySettings::clearAllData()
 //*******************************************************************************************************
 
 void ConnectivitySettings::clearIntermediateData() 
+{
+    clearIntermediateTrialData();
+
+    m_intermediateSumData.matPsdSum.resize(0,0);
+    m_intermediateSumData.vecPairCsdSum.clear();
+    m_intermediateSumData.vecPairCsdNormalizedSum.clear();
+    m_intermediateSumData.vecPairCsdImagSignSum.clear();
+    m_intermediateSumData.vecPairCsdImagAbsSum.clear();
+    m_intermediateSumData.vecPairCsdImagSqrdSum.clear();
+
+    m_bFusedModeIsActive = false;
+}
+
+//*******************************************************************************************************
+
+void ConnectivitySettings::clearIntermediateTrialData()
 {
     for (int i = 0; i < m_trialData.size(); ++i) {
         m_trialData[i].matPsd.resize(0,0);
@@ -103,13 +146,6 @@ void ConnectivitySettings::clearIntermediateData()
         m_trialData[i].vecPairCsdImagAbs.clear();
         m_trialData[i].vecPairCsdImagSqrd.clear();
     }
-
-    m_intermediateSumData.matPsdSum.resize(0,0);
-    m_intermediateSumData.vecPairCsdSum.clear();
-    m_intermediateSumData.vecPairCsdNormalizedSum.clear();
-    m_intermediateSumData.vecPairCsdImagSignSum.clear();
-    m_intermediateSumData.vecPairCsdImagAbsSum.clear();
-    m_intermediateSumData.vecPairCsdImagSqrdSum.clear();
 }
 
 //*******************************************************************************************************
@@ -263,6 +299,27 @@ void ConnectivitySettings::removeLast(int iAmount)
 
 //*******************************************************************************************************
 
+void ConnectivitySettings::recomputeIntermediateSumData()
+{
+    // Sum up the stored trials again, so rounding errors of the subtractions in removeFirst do not accumulate
+    sumTrialPairs(m_intermediateSumData.vecPairCsdSum, m_trialData, &IntermediateTrialData::vecPairCsd);
+    sumTrialPairs(m_intermediateSumData.vecPairCsdNormalizedSum, m_trialData, &IntermediateTrialData::vecPairCsdNormalized);
+    sumTrialPairs(m_intermediateSumData.vecPairCsdImagSignSum, m_trialData, &IntermediateTrialData::vecPairCsdImagSign);
+    sumTrialPairs(m_intermediateSumData.vecPairCsdImagAbsSum, m_trialData, &IntermediateTrialData::vecPairCsdImagAbs);
+    sumTrialPairs(m_intermediateSumData.vecPairCsdImagSqrdSum, m_trialData, &IntermediateTrialData::vecPairCsdImagSqrd);
+
+    m_intermediateSumData.matPsdSum.setZero();
+
+    for (int j = 0; j < m_trialData.size(); ++j) {
+        if(m_intermediateSumData.matPsdSum.rows() == m_trialData.at(j).matPsd.rows() &&
+           m_intermediateSumData.matPsdSum.cols() == m_trialData.at(j).matPsd.cols() ) {
+            m_intermediateSumData.matPsdSum += m_trialData.at(j).matPsd;
+        }
+    }
+}
+
+//*******************************************************************************************************
+
 void ConnectivitySettings::setConnectivityMethods(const QStringList& sConnectivityMethods)
 {
     m_sConnectivityMethods = sConnectivityMethods;
@@ -416,3 +473,17 @@ ConnectivitySettings::IntermediateSumData& ConnectivitySettings::getIntermediate
 {
     return m_intermediateSumData;
 }
+
+//*******************************************************************************************************
+
+void ConnectivitySettings::setFusedModeActive(bool bFusedModeIsActive)
+{
+    m_bFusedModeIsActive = bFusedModeIsActive;
+}
+
+//*******************************************************************************************************
+
+bool ConnectivitySettings::isFusedModeActive() const
+{
+    return m_bFusedModeIsActive;
+}
@@ -125,6 +125,8 @@ public:
 
     void clearIntermediateData();
 
+    void clearIntermediateTrialData();
+
     void append(const QList<Eigen::MatrixXd>& matInputData);
 
     void append(const Eigen::MatrixXd& matInputData);
@@ -141,6 +143,8 @@ public:
 
     void removeLast(int iAmount = 1);
 
+    void recomputeIntermediateSumData();
+
     void setConnectivityMethods(const QStringList& sConnectivityMethods);
 
     const QStringList& getConnectivityMethods() const;
@@ -171,6 +175,10 @@ public:
 
     IntermediateSumData& getIntermediateSumData();
 
+    void setFusedModeActive(bool bFusedModeIsActive);
+
+    bool isFusedModeActive() const;
+
 protected:
     QStringList                     m_sConnectivityMethods;         /**< The connectivity methods. */
     QString                         m_sWindowType;                  /**< The window type used to compute tapered spectra. */
@@ -183,6 +191,8 @@ protected:
 
     IntermediateSumData             m_intermediateSumData;          /**< The intermediate sum data holds data calculated over all trials as a whole. */
     QList<IntermediateTrialData>    m_trialData;                    /**< The trial data holds the actual and intermediate data calcualted for each trial. */
+
+    bool                            m_bFusedModeIsActive;           /**< Whether the intermediate sum data were already computed for all trials by MetricFusion. */
 };
 
 //=============================================================================================================
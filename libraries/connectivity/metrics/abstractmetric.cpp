@@ -38,6 +38,8 @@
 
 #include "abstractmetric.h"
 
+#include <utils/spectral.h>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
@@ -51,6 +53,8 @@
 //=============================================================================================================
 
 using namespace CONNECTIVITYLIB;
+using namespace Eigen;
+using namespace UTILSLIB;
 
 //=============================================================================================================
 // DEFINE GLOBAL METHODS
@@ -68,3 +72,36 @@ AbstractMetric::AbstractMetric()
 {
 }
 
+//*******************************************************************************************************
+
+void AbstractMetric::computeTaperedSpectra(const MatrixXd& matData,
+                                           const QPair<MatrixXd, VectorXd>& tapers,
+                                           int iNfft,
+                                           QVector<MatrixXcd>& vecTapSpectra)
+{
+    int iNRows = matData.rows();
+    int iNTapers = tapers.first.rows();
+    int iNSamples = qMin(int(matData.cols()), iNfft);
+
+    // Substract mean
+    MatrixXd matDemeaned = matData.leftCols(iNSamples).colwise() - matData.rowwise().mean();
+
+    Spectral::RowMajorMatrixXcd matTapSpectra;
+    vecTapSpectra.clear();
+
+    if(!Spectral::computeTaperedSpectraTensor(matDemeaned,
+                                              tapers.first.leftCols(iNSamples),
+                                              iNfft,
+                                              matTapSpectra,
+                                              false)) {
+        return;
+    }
+
+    // Multiply taper weights
+    vecTapSpectra.resize(iNRows);
+
+    for (int i = 0; i < iNRows; ++i) {
+        vecTapSpectra[i] = matTapSpectra.middleRows(i * iNTapers, iNTapers);
+        vecTapSpectra[i].array().colwise() *= tapers.second.array().cast<std::complex<double> >();
+    }
+}
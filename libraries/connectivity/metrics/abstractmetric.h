@@ -47,6 +47,7 @@
 
 #include <QSharedPointer>
 #include <QVector>
+#include <QPair>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -92,6 +93,22 @@ public:
     static int      m_iNumberBinAmount;
 
 protected:
+    //=========================================================================================================
+    /**
+     * Computes the tapered spectra of all rows of one trial with Spectral::computeTaperedSpectraTensor, so one
+     * FFT plan is set up per trial instead of one per row and taper. The mean of each row is removed and the
+     * spectrum of each taper is multiplied with the taper weight. This function gets called in parallel over
+     * the trials and therefore does not spawn threads on its own.
+     *
+     * @param[in] matData            The trial data (rows x samples).
+     * @param[in] tapers             The tapers and taper weights.
+     * @param[in] iNfft              The FFT length. Longer data is truncated to iNfft samples.
+     * @param[out] vecTapSpectra     The tapered spectra (tapers x frequency bins) of each row.
+     */
+    static void computeTaperedSpectra(const Eigen::MatrixXd& matData,
+                                      const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers,
+                                      int iNfft,
+                                      QVector<Eigen::MatrixXcd>& vecTapSpectra);
 };
 
 //=============================================================================================================
@@ -89,7 +89,7 @@ Network Coherence::calculate(ConnectivitySettings& connectivitySettings)
         return finalNetwork;
     }
 
-    if(AbstractMetric::m_bStorageModeIsActive == false) {
+    if(AbstractMetric::m_bStorageModeIsActive == false && connectivitySettings.isFusedModeActive() == false) {
         connectivitySettings.clearIntermediateData();
     }
 
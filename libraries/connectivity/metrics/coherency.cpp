@@ -126,26 +126,32 @@ void Coherency::calculateAbs(Network& finalNetwork,
 //    qWarning() << "Preparation" << iTime;
 //    timer.restart();
 
-    QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
-                                             computeLambda);
-    result.waitForFinished();
+    // The intermediate sum data were already computed by MetricFusion in fused mode
+    if(!connectivitySettings.isFusedModeActive()) {
+        QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
+                                                 computeLambda);
+        result.waitForFinished();
+    }
 
 //    iTime = timer.elapsed();
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
 //    timer.restart();
 
-    // Compute CSD/sqrt(PSD_X * PSD_Y)
+    // Compute CSD/sqrt(PSD_X * PSD_Y). Each start node writes to its own slot to keep the edge order deterministic.
+    QVector<MatrixXd> vecWeights(iNRows);
+
     std::function<void(QPair<int,MatrixXcd>&)> computePSDCSDLambda = [&](QPair<int,MatrixXcd>& pairInput) {
-        computePSDCSDAbs(mutex,
-                         finalNetwork,
-                         pairInput,
-                         connectivitySettings.getIntermediateSumData().matPsdSum);
+        computePSDCSDAbs(pairInput,
+                         connectivitySettings.getIntermediateSumData().matPsdSum,
+                         vecWeights);
     };
 
     QFuture<void> resultCSDPSD = QtConcurrent::map(connectivitySettings.getIntermediateSumData().vecPairCsdSum,
                                                    computePSDCSDLambda);
     resultCSDPSD.waitForFinished();
 
+    appendEdges(finalNetwork, vecWeights);
+
 //    iTime = timer.elapsed();
 //    qWarning() << "Compute" << iTime;
 //    timer.restart();
@@ -197,26 +203,32 @@ void Coherency::calculateImag(Network& finalNetwork,
 //    qWarning() << "Preparation" << iTime;
 //    timer.restart();
 
-    QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
-                                             computeLambda);
-    result.waitForFinished();
+    // The intermediate sum data were already computed by MetricFusion in fused mode
+    if(!connectivitySettings.isFusedModeActive()) {
+        QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
+                                                 computeLambda);
+        result.waitForFinished();
+    }
 
 //    iTime = timer.elapsed();
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
 //    timer.restart();
 
-    // Compute CSD/sqrt(PSD_X * PSD_Y)
+    // Compute CSD/sqrt(PSD_X * PSD_Y). Each start node writes to its own slot to keep the edge order deterministic.
+    QVector<MatrixXd> vecWeights(iNRows);
+
     std::function<void(QPair<int,MatrixXcd>&)> computePSDCSDLambda = [&](QPair<int,MatrixXcd>& pairInput) {
-        computePSDCSDImag(mutex,
-                          finalNetwork,
-                          pairInput,
-                          connectivitySettings.getIntermediateSumData().matPsdSum);
+        computePSDCSDImag(pairInput,
+                          connectivitySettings.getIntermediateSumData().matPsdSum,
+                          vecWeights);
     };
 
     QFuture<void> resultCSDPSD = QtConcurrent::map(connectivitySettings.getIntermediateSumData().vecPairCsdSum,
                                                    computePSDCSDLambda);
     resultCSDPSD.waitForFinished();
 
+    appendEdges(finalNetwork, vecWeights);
+
 //    iTime = timer.elapsed();
 //    qWarning() << "Compute" << iTime;
 //    timer.restart();
@@ -244,50 +256,24 @@ void Coherency::compute(ConnectivitySettings::IntermediateTrialData& inputData,
 
     //qDebug() << "Coherency::compute - vecPairCsdSum and matPsdSum are computed for this trial.";
 
-    // Substract mean, compute tapered spectra and PSD
-    // This code was copied and changed modified Utils/Spectra since we do not want to call the function due to time loss.
+    // Compute tapered spectra and PSD
     bool bNfftEven = false;
     if (iNfft % 2 == 0){
         bNfftEven = true;
     }
 
-    FFT<double> fft;
-    fft.SetFlag(fft.HalfSpectrum);
-
     double denomPSD = tapers.second.cwiseAbs2().sum() / 2.0;
 
-    RowVectorXd vecInputFFT, rowData;
-    RowVectorXcd vecTmpFreq;
-
-    MatrixXcd matTapSpectrum(tapers.first.rows(), iNFreqs);
-
     int i,j;
 
+    // Calculate tapered spectra if not available already
+    if(inputData.vecTapSpectra.size() != iNRows) {
+        computeTaperedSpectra(inputData.matData, tapers, iNfft, inputData.vecTapSpectra);
+    }
+
     inputData.matPsd = MatrixXd(iNRows, m_iNumberBinAmount);
 
     for (i = 0; i < iNRows; ++i) {
-        // Substract mean
-        rowData.array() = inputData.matData.row(i).array() - inputData.matData.row(i).mean();
-
-        // Calculate tapered spectra if not available already
-        if(inputData.vecTapSpectra.size() != iNRows) {
-            for(j = 0; j < tapers.first.rows(); j++) {
-                // Zero padd if necessary. The zero padding in Eigen's FFT is only working for column vectors.
-                if (rowData.cols() < iNfft) {
-                    vecInputFFT.setZero(iNfft);
-                    vecInputFFT.block(0,0,1,rowData.cols()) = rowData.cwiseProduct(tapers.first.row(j));;
-                } else {
-                    vecInputFFT = rowData.cwiseProduct(tapers.first.row(j));
-                }
-
-                // FFT for freq domain returning the half spectrum and multiply taper weights
-                fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecTmpFreq * tapers.second(j);
-            }
-
-            inputData.vecTapSpectra.append(matTapSpectrum);
-        }
-
         // Compute PSD (average over tapers if necessary).
         inputData.matPsd.row(i) = inputData.vecTapSpectra.at(i).block(0,m_iNumberBinStart,inputData.vecTapSpectra.at(i).rows(),m_iNumberBinAmount).cwiseAbs2().colwise().sum() / denomPSD;
 
@@ -372,10 +358,9 @@ void Coherency::compute(ConnectivitySettings::IntermediateTrialData& inputData,
 
 //=============================================================================================================
 
-void Coherency::computePSDCSDAbs(QMutex& mutex,
-                                 Network& finalNetwork,
-                                 const QPair<int,MatrixXcd>& pairInput,
-                                 const MatrixXd& matPsdSum)
+void Coherency::computePSDCSDAbs(const QPair<int,MatrixXcd>& pairInput,
+                                 const MatrixXd& matPsdSum,
+                                 QVector<MatrixXd>& vecWeights)
 {
     MatrixXd matPSDtmp(matPsdSum.rows(), matPsdSum.cols());
     RowVectorXd rowPsdSum = matPsdSum.row(pairInput.first);
@@ -387,29 +372,21 @@ void Coherency::computePSDCSDAbs(QMutex& mutex,
     // Average. Note that the number of trials cancel each other out.
     MatrixXcd matCohy = pairInput.second.cwiseQuotient(matPSDtmp.cwiseSqrt());
 
-    QSharedPointer<NetworkEdge> pEdge;
-    MatrixXd matWeight;
-    int j;
     int i = pairInput.first;
 
-    for(j = i; j < matCohy.rows(); ++j) {
-        matWeight = matCohy.row(j).cwiseAbs().transpose();
-        pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-        mutex.lock();
-        finalNetwork.getNodeAt(i)->append(pEdge);
-        finalNetwork.getNodeAt(j)->append(pEdge);
-        finalNetwork.append(pEdge);
-        mutex.unlock();
+    if(i < 0 || i >= vecWeights.size()) {
+        qDebug() << "Coherency::computePSDCSDAbs - Start node index is out of range. Returning.";
+        return;
     }
+
+    vecWeights[i] = matCohy.bottomRows(matCohy.rows() - i).cwiseAbs().transpose();
 }
 
 //=============================================================================================================
 
-void Coherency::computePSDCSDImag(QMutex& mutex,
-                                  Network& finalNetwork,
-                                  const QPair<int,MatrixXcd>& pairInput,
-                                  const MatrixXd& matPsdSum)
+void Coherency::computePSDCSDImag(const QPair<int,MatrixXcd>& pairInput,
+                                  const MatrixXd& matPsdSum,
+                                  QVector<MatrixXd>& vecWeights)
 {
     MatrixXd matPSDtmp(matPsdSum.rows(), matPsdSum.cols());
     RowVectorXd rowPsdSum = matPsdSum.row(pairInput.first);
@@ -420,19 +397,28 @@ void Coherency::computePSDCSDImag(QMutex& mutex,
 
     MatrixXcd matCohy = pairInput.second.cwiseQuotient(matPSDtmp.cwiseSqrt());
 
-    QSharedPointer<NetworkEdge> pEdge;
-    MatrixXd matWeight;
-    int j;
     int i = pairInput.first;
 
-    for(j = i; j < matCohy.rows(); ++j) {
-        matWeight = matCohy.row(j).imag().transpose();
-        pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
+    if(i < 0 || i >= vecWeights.size()) {
+        qDebug() << "Coherency::computePSDCSDImag - Start node index is out of range. Returning.";
+        return;
+    }
 
-        mutex.lock();
-        finalNetwork.getNodeAt(i)->append(pEdge);
-        finalNetwork.getNodeAt(j)->append(pEdge);
-        finalNetwork.append(pEdge);
-        mutex.unlock();
+    vecWeights[i] = matCohy.bottomRows(matCohy.rows() - i).imag().transpose();
+}
+
+//=============================================================================================================
+
+void Coherency::appendEdges(Network& finalNetwork,
+                            const QVector<MatrixXd>& vecWeights)
+{
+    for(int i = 0; i < vecWeights.size(); ++i) {
+        if(vecWeights.at(i).cols() == 0) {
+            continue;
+        }
+
+        finalNetwork.append(i,
+                            VectorXi::LinSpaced(vecWeights.at(i).cols(), i, i + vecWeights.at(i).cols() - 1),
+                            vecWeights.at(i));
     }
 }
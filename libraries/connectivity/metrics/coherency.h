@@ -141,16 +141,29 @@ private:
 
     //=========================================================================================================
     /**
-     * Computes the PSD and CSD. This function gets called in parallel.
+     * Computes the coherency edge weights of one start node. This function gets called in parallel. Each call writes
+     * to its own slot of vecWeights, so that the edges can be appended in start node order afterwards.
+     *
+     * @param[in]    pairInput           The start node index and its CSD sum.
+     * @param[in]    matPsdSum           The sum of all PSD matrices.
+     * @param[out]   vecWeights          The edge weights per start node. Slot pairInput.first gets the weights of this start node.
+     */
+    static void computePSDCSDAbs(const QPair<int,Eigen::MatrixXcd>& pairInput,
+                                 const Eigen::MatrixXd& matPsdSum,
+                                 QVector<Eigen::MatrixXd>& vecWeights);
+    static void computePSDCSDImag(const QPair<int,Eigen::MatrixXcd>& pairInput,
+                                  const Eigen::MatrixXd& matPsdSum,
+                                  QVector<Eigen::MatrixXd>& vecWeights);
+
+    //=========================================================================================================
+    /**
+     * Appends the edge weights computed by computePSDCSDAbs() or computePSDCSDImag() to the network in start node order.
+     *
+     * @param[out]   finalNetwork        The network to append the edges to.
+     * @param[in]    vecWeights          The edge weights per start node.
      */
-    static void computePSDCSDAbs(QMutex& mutex,
-                                 Network& finalNetwork,
-                                 const QPair<int,Eigen::MatrixXcd>& pairInput,
-                                 const Eigen::MatrixXd& matPsdSum);
-    static void computePSDCSDImag(QMutex& mutex,
-                                  Network& finalNetwork,
-                                  const QPair<int,Eigen::MatrixXcd>& pairInput,
-                                  const Eigen::MatrixXd& matPsdSum);
+    static void appendEdges(Network& finalNetwork,
+                            const QVector<Eigen::MatrixXd>& vecWeights);
 };
 
 //=============================================================================================================
@@ -95,7 +95,7 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
         return finalNetwork;
     }
 
-    if(AbstractMetric::m_bStorageModeIsActive == false) {
+    if(AbstractMetric::m_bStorageModeIsActive == false && connectivitySettings.isFusedModeActive() == false) {
         connectivitySettings.clearIntermediateData();
     }
 
@@ -151,20 +151,10 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
 //    timer.restart();
 
     //Add edges to network
-    MatrixXd matWeight(1,1);
-    QSharedPointer<NetworkEdge> pEdge;
-    int j;
-
     for(int i = 0; i < matDist.rows(); ++i) {
-        for(j = i; j < matDist.cols(); ++j) {
-            matWeight << matDist(i,j);
-
-            pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-            finalNetwork.getNodeAt(i)->append(pEdge);
-            finalNetwork.getNodeAt(j)->append(pEdge);
-            finalNetwork.append(pEdge);
-        }
+        finalNetwork.append(i,
+                            VectorXi::LinSpaced(matDist.cols() - i, i, matDist.cols() - 1),
+                            matDist.row(i).tail(matDist.cols() - i));
     }
 
 //    iTime = timer.elapsed();
@@ -95,7 +95,7 @@ Network DebiasedSquaredWeightedPhaseLagIndex::calculate(ConnectivitySettings& co
         return finalNetwork;
     }
 
-    if(AbstractMetric::m_bStorageModeIsActive == false) {
+    if(AbstractMetric::m_bStorageModeIsActive == false && connectivitySettings.isFusedModeActive() == false) {
         connectivitySettings.clearIntermediateData();
     }
 
@@ -165,10 +165,13 @@ Network DebiasedSquaredWeightedPhaseLagIndex::calculate(ConnectivitySettings& co
 //    qWarning() << "Preparation" << iTime;
 //    timer.restart();
 
-    // Compute DSWPLI in parallel for all trials
-    QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
-                                             computeLambda);
-    result.waitForFinished();
+    // The intermediate sum data were already computed by MetricFusion in fused mode
+    if(!connectivitySettings.isFusedModeActive()) {
+        // Compute DSWPLI in parallel for all trials
+        QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
+                                                 computeLambda);
+        result.waitForFinished();
+    }
 
 //    iTime = timer.elapsed();
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
@@ -207,37 +210,8 @@ void DebiasedSquaredWeightedPhaseLagIndex::compute(ConnectivitySettings::Interme
     int i,j;
 
     // Calculate tapered spectra if not available already
-    // This code was copied and changed modified Utils/Spectra since we do not want to call the function due to time loss.
     if(inputData.vecTapSpectra.isEmpty()) {
-        RowVectorXd vecInputFFT, rowData;
-        RowVectorXcd vecTmpFreq;
-
-        MatrixXcd matTapSpectrum(tapers.first.rows(), iNFreqs);
-
-        FFT<double> fft;
-        fft.SetFlag(fft.HalfSpectrum);
-
-        for (i = 0; i < iNRows; ++i) {
-            // Substract mean
-            rowData.array() = inputData.matData.row(i).array() - inputData.matData.row(i).mean();
-
-            // Calculate tapered spectra if not available already
-            for(j = 0; j < tapers.first.rows(); j++) {
-                // Zero padd if necessary. The zero padding in Eigen's FFT is only working for column vectors.
-                if (rowData.cols() < iNfft) {
-                    vecInputFFT.setZero(iNfft);
-                    vecInputFFT.block(0,0,1,rowData.cols()) = rowData.cwiseProduct(tapers.first.row(j));;
-                } else {
-                    vecInputFFT = rowData.cwiseProduct(tapers.first.row(j));
-                }
-
-                // FFT for freq domain returning the half spectrum and multiply taper weights
-                fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecTmpFreq * tapers.second(j);
-            }
-
-            inputData.vecTapSpectra.append(matTapSpectrum);
-        }
+        computeTaperedSpectra(inputData.matData, tapers, iNfft, inputData.vecTapSpectra);
     }
 
     // Compute CSD
@@ -339,9 +313,6 @@ void DebiasedSquaredWeightedPhaseLagIndex::computeDSWPLI(ConnectivitySettings &c
 {
     // Compute final DSWPLI and create Network
     MatrixXd matNom, matDenom;
-    MatrixXd matWeight;
-    QSharedPointer<NetworkEdge> pEdge;
-    int j;
 
     for (int i = 0; i < connectivitySettings.at(0).matData.rows(); ++i) {
 
@@ -354,15 +325,9 @@ void DebiasedSquaredWeightedPhaseLagIndex::computeDSWPLI(ConnectivitySettings &c
         matDenom = (matDenom.array() == 0.).select(INFINITY, matDenom);
         matDenom = matNom.cwiseQuotient(matDenom);
 
-        for(j = i; j < connectivitySettings.at(0).matData.rows(); ++j) {
-            matWeight = matDenom.row(j).transpose();
-
-            pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-            finalNetwork.getNodeAt(i)->append(pEdge);
-            finalNetwork.getNodeAt(j)->append(pEdge);
-            finalNetwork.append(pEdge);
-        }
+        finalNetwork.append(i,
+                            VectorXi::LinSpaced(matDenom.rows() - i, i, matDenom.rows() - 1),
+                            matDenom.bottomRows(matDenom.rows() - i).transpose());
 
     }
 }
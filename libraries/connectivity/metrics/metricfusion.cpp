@@ -0,0 +1,568 @@
+//=============================================================================================================
+/**
+ * @file     metricfusion.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    MetricFusion class definition.
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "metricfusion.h"
+
+#include <utils/spectral.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QDebug>
+#include <QtConcurrent>
+#include <QThread>
+
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <numeric>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <unsupported/Eigen/FFT>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace CONNECTIVITYLIB;
+using namespace Eigen;
+using namespace UTILSLIB;
+
+//=============================================================================================================
+// DEFINE GLOBAL METHODS
+//=============================================================================================================
+
+template<typename T>
+void initPairs(QVector<QPair<int,T> >& vecPairs,
+               int iNRows,
+               int iNBins,
+               bool bZero)
+{
+    // Reuse the matrices of the last call if the dimensions did not change
+    if(vecPairs.size() == iNRows &&
+       !vecPairs.isEmpty() &&
+       vecPairs.first().second.rows() == iNRows &&
+       vecPairs.first().second.cols() == iNBins) {
+        if(bZero) {
+            for (int i = 0; i < vecPairs.size(); ++i) {
+                vecPairs[i].second.setZero();
+            }
+        }
+
+        return;
+    }
+
+    vecPairs.clear();
+    vecPairs.reserve(iNRows);
+
+    for (int i = 0; i < iNRows; ++i) {
+        vecPairs.append(QPair<int,T>(i, T::Zero(iNRows, iNBins)));
+    }
+}
+
+//=============================================================================================================
+
+template<typename T, typename Derived>
+void addPackedPairs(QVector<QPair<int,T> >& vecPairs,
+                    const MatrixBase<Derived>& vecPacked,
+                    int iBin)
+{
+    // The pairs (i,j) with j >= i are stored contiguously for each row i
+    int iNRows = vecPairs.size();
+    int iOffset = 0;
+
+    for (int i = 0; i < iNRows; ++i) {
+        vecPairs[i].second.col(iBin).tail(iNRows - i) += vecPacked.segment(iOffset, iNRows - i);
+        iOffset += iNRows - i;
+    }
+}
+
+//=============================================================================================================
+
+template<typename T, typename Derived>
+void setPackedPairs(QVector<QPair<int,T> >& vecPairs,
+                    const MatrixBase<Derived>& vecPacked,
+                    int iBin)
+{
+    int iNRows = vecPairs.size();
+    int iOffset = 0;
+
+    for (int i = 0; i < iNRows; ++i) {
+        vecPairs[i].second.col(iBin).tail(iNRows - i) = vecPacked.segment(iOffset, iNRows - i);
+        iOffset += iNRows - i;
+    }
+}
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+MetricFusion::MetricFusion()
+: AbstractMetric()
+{
+}
+
+//*******************************************************************************************************
+
+bool MetricFusion::calculate(ConnectivitySettings& connectivitySettings)
+{
+    int iIntermediateData = getIntermediateData(connectivitySettings.getConnectivityMethods());
+
+    if(iIntermediateData == 0 || connectivitySettings.isEmpty()) {
+        return false;
+    }
+
+    // The sum data of the last call is kept as workspace and zeroed below
+    if(AbstractMetric::m_bStorageModeIsActive == false) {
+        connectivitySettings.clearIntermediateTrialData();
+    }
+
+    #ifdef EIGEN_FFTW_DEFAULT
+        fftw_make_planner_thread_safe();
+    #endif
+
+    int iSignalLength = connectivitySettings.at(0).matData.cols();
+    int iNfft = connectivitySettings.getFFTSize();
+
+    // Generate tapers
+    QPair<MatrixXd, VectorXd> tapers = Spectral::generateTapers(iSignalLength, connectivitySettings.getWindowType());
+
+    // Initialize
+    int iNRows = connectivitySettings.at(0).matData.rows();
+    int iNFreqs = int(floor(iNfft / 2.0)) + 1;
+
+    // Check if start and bin amount need to be reset to full spectrum
+    if(m_iNumberBinStart == -1 ||
+       m_iNumberBinAmount == -1 ||
+       m_iNumberBinStart > iNFreqs ||
+       m_iNumberBinAmount > iNFreqs ||
+       m_iNumberBinAmount + m_iNumberBinStart > iNFreqs) {
+        qDebug() << "MetricFusion::calculate - Resetting to full spectrum";
+        AbstractMetric::m_iNumberBinStart = 0;
+        AbstractMetric::m_iNumberBinAmount = iNFreqs;
+    }
+
+    int iNTrials = connectivitySettings.size();
+    int iNBins = m_iNumberBinAmount;
+    int iNTapers = tapers.first.rows();
+    int iCsdData = Csd | CsdNormalized | CsdImagSign | CsdImagAbs | CsdImagSqrd;
+
+    // Only compute what is not already part of the sum data. This is only the case in storage mode.
+    QVector<int> vecIntermediateData(iNTrials, 0);
+    QVector<int> vecTrials;
+    int iSumData = 0;
+
+    for (int i = 0; i < iNTrials; ++i) {
+        const ConnectivitySettings::IntermediateTrialData& trialData = connectivitySettings.at(i);
+
+        if((iIntermediateData & Psd) && trialData.matPsd.rows() != iNRows) {
+            vecIntermediateData[i] |= Psd;
+        }
+        if((iIntermediateData & Csd) && trialData.vecPairCsd.size() != iNRows) {
+            vecIntermediateData[i] |= Csd;
+        }
+        if((iIntermediateData & CsdNormalized) && trialData.vecPairCsdNormalized.size() != iNRows) {
+            vecIntermediateData[i] |= CsdNormalized;
+        }
+        if((iIntermediateData & CsdImagSign) && trialData.vecPairCsdImagSign.size() != iNRows) {
+            vecIntermediateData[i] |= CsdImagSign;
+        }
+        if((iIntermediateData & CsdImagAbs) && trialData.vecPairCsdImagAbs.size() != iNRows) {
+            vecIntermediateData[i] |= CsdImagAbs;
+        }
+        if((iIntermediateData & CsdImagSqrd) && trialData.vecPairCsdImagSqrd.size() != iNRows) {
+            vecIntermediateData[i] |= CsdImagSqrd;
+        }
+
+        if(vecIntermediateData.at(i) != 0) {
+            vecTrials.append(i);
+            iSumData |= vecIntermediateData.at(i);
+        }
+    }
+
+    // Prepare the sum data. Outside of storage mode the sums are reset, reusing the matrices of the last call.
+    ConnectivitySettings::IntermediateSumData& sumData = connectivitySettings.getIntermediateSumData();
+    bool bResetSum = !m_bStorageModeIsActive;
+
+    if(iIntermediateData & Psd) {
+        if(sumData.matPsdSum.rows() != iNRows || sumData.matPsdSum.cols() != iNBins) {
+            sumData.matPsdSum = MatrixXd::Zero(iNRows, iNBins);
+        } else if(bResetSum) {
+            sumData.matPsdSum.setZero();
+        }
+    } else if(bResetSum) {
+        sumData.matPsdSum.resize(0,0);
+    }
+
+    if(iIntermediateData & Csd) {
+        initPairs(sumData.vecPairCsdSum, iNRows, iNBins, bResetSum);
+    } else if(bResetSum) {
+        sumData.vecPairCsdSum.clear();
+    }
+    if(iIntermediateData & CsdNormalized) {
+        initPairs(sumData.vecPairCsdNormalizedSum, iNRows, iNBins, bResetSum);
+    } else if(bResetSum) {
+        sumData.vecPairCsdNormalizedSum.clear();
+    }
+    if(iIntermediateData & CsdImagSign) {
+        initPairs(sumData.vecPairCsdImagSignSum, iNRows, iNBins, bResetSum);
+    } else if(bResetSum) {
+        sumData.vecPairCsdImagSignSum.clear();
+    }
+    if(iIntermediateData & CsdImagAbs) {
+        initPairs(sumData.vecPairCsdImagAbsSum, iNRows, iNBins, bResetSum);
+    } else if(bResetSum) {
+        sumData.vecPairCsdImagAbsSum.clear();
+    }
+    if(iIntermediateData & CsdImagSqrd) {
+        initPairs(sumData.vecPairCsdImagSqrdSum, iNRows, iNBins, bResetSum);
+    } else if(bResetSum) {
+        sumData.vecPairCsdImagSqrdSum.clear();
+    }
+
+    // Keep the CSD based data of each trial in storage mode, so it can be removed from the sum data later on
+    if(m_bStorageModeIsActive) {
+        for (int i = 0; i < vecTrials.size(); ++i) {
+            int iTrial = vecTrials.at(i);
+            ConnectivitySettings::IntermediateTrialData& trialData = connectivitySettings.getTrialData()[iTrial];
+
+            if(vecIntermediateData.at(iTrial) & Csd) {
+                initPairs(trialData.vecPairCsd, iNRows, iNBins, true);
+            }
+            if(vecIntermediateData.at(iTrial) & CsdNormalized) {
+                initPairs(trialData.vecPairCsdNormalized, iNRows, iNBins, true);
+            }
+            if(vecIntermediateData.at(iTrial) & CsdImagSign) {
+                initPairs(trialData.vecPairCsdImagSign, iNRows, iNBins, true);
+            }
+            if(vecIntermediateData.at(iTrial) & CsdImagAbs) {
+                initPairs(trialData.vecPairCsdImagAbs, iNRows, iNBins, true);
+            }
+            if(vecIntermediateData.at(iTrial) & CsdImagSqrd) {
+                initPairs(trialData.vecPairCsdImagSqrd, iNRows, iNBins, true);
+            }
+        }
+    }
+
+    // Only keep the packed spectra of as many trials in memory as fit into MAX_SPECTRA_BATCH_BYTES
+    int iBatchSize = vecTrials.size();
+    qint64 iSpectraBytes = qint64(iNRows) * iNTapers * iNBins * qint64(sizeof(std::complex<double>));
+
+    if((iSumData & iCsdData) && iSpectraBytes > 0) {
+        iBatchSize = int(qBound(qint64(1), qint64(MAX_SPECTRA_BATCH_BYTES) / iSpectraBytes, qint64(qMax(1, vecTrials.size()))));
+    }
+
+    // Blocks of frequency bins write to disjoint columns of the sum data, so they can be computed in parallel
+    // without locking.
+    int iBlockSize = qMax(1, iNBins / (4 * qMax(1, QThread::idealThreadCount())));
+    QVector<QPair<int,int> > vecBlocks;
+
+    for (int i = 0; i < iNBins; i += iBlockSize) {
+        vecBlocks.append(QPair<int,int>(i, qMin(iBlockSize, iNBins - i)));
+    }
+
+    for (int iBatchStart = 0; iBatchStart < vecTrials.size(); iBatchStart += iBatchSize) {
+        QVector<int> vecBatch = vecTrials.mid(iBatchStart, iBatchSize);
+        QVector<int> vecBatchIdx(vecBatch.size());
+        std::iota(vecBatchIdx.begin(), vecBatchIdx.end(), 0);
+
+        // Compute the tapered spectra and PSD of the batch in parallel
+        QVector<MatrixXcd> vecSpectra(vecBatch.size());
+
+        std::function<void(const int&)> computeSpectraLambda = [&](const int& iIdx) {
+            int iTrial = vecBatch.at(iIdx);
+
+            computeSpectra(connectivitySettings.getTrialData()[iTrial],
+                           vecSpectra[iIdx],
+                           vecIntermediateData.at(iTrial) & Psd,
+                           vecIntermediateData.at(iTrial) & iCsdData,
+                           iNRows,
+                           iNFreqs,
+                           iNfft,
+                           tapers);
+        };
+
+        QFuture<void> resultSpectra = QtConcurrent::map(vecBatchIdx,
+                                                        computeSpectraLambda);
+        resultSpectra.waitForFinished();
+
+        for (int i = 0; i < vecBatch.size(); ++i) {
+            if(vecIntermediateData.at(vecBatch.at(i)) & Psd) {
+                sumData.matPsdSum += connectivitySettings.at(vecBatch.at(i)).matPsd;
+            }
+        }
+
+        if(!(iSumData & iCsdData)) {
+            continue;
+        }
+
+        // Compute the CSD based sum data of the batch in parallel for blocks of frequency bins
+        std::function<void(const QPair<int,int>&)> computeBlockLambda = [&](const QPair<int,int>& block) {
+            computeFrequencyBlock(block.first,
+                                  block.second,
+                                  vecBatch,
+                                  vecSpectra,
+                                  connectivitySettings,
+                                  vecIntermediateData,
+                                  iNTapers);
+        };
+
+        QFuture<void> resultBlocks = QtConcurrent::map(vecBlocks,
+                                                       computeBlockLambda);
+        resultBlocks.waitForFinished();
+    }
+
+    return true;
+}
+
+//*******************************************************************************************************
+
+int MetricFusion::getIntermediateData(const QStringList& lMethods)
+{
+    int iIntermediateData = 0;
+
+    if(lMethods.contains("COH") || lMethods.contains("IMAGCOH")) {
+        iIntermediateData |= Psd | Csd;
+    }
+
+    if(lMethods.contains("PLI") || lMethods.contains("USPLI")) {
+        iIntermediateData |= Csd | CsdImagSign;
+    }
+
+    if(lMethods.contains("WPLI")) {
+        iIntermediateData |= Csd | CsdImagAbs;
+    }
+
+    if(lMethods.contains("DSWPLI")) {
+        iIntermediateData |= Csd | CsdImagAbs | CsdImagSqrd;
+    }
+
+    if(lMethods.contains("PLV")) {
+        iIntermediateData |= Csd | CsdNormalized;
+    }
+
+    return iIntermediateData;
+}
+
+//*******************************************************************************************************
+
+void MetricFusion::computeSpectra(ConnectivitySettings::IntermediateTrialData& inputData,
+                                  MatrixXcd& matSpectra,
+                                  bool bPsd,
+                                  bool bPack,
+                                  int iNRows,
+                                  int iNFreqs,
+                                  int iNfft,
+                                  const QPair<MatrixXd, VectorXd>& tapers)
+{
+    int i,j;
+    int iNTapers = tapers.first.rows();
+
+    bool bNfftEven = false;
+    if (iNfft % 2 == 0){
+        bNfftEven = true;
+    }
+
+    // Calculate tapered spectra if not available already. These are shared by all metrics.
+    if(inputData.vecTapSpectra.size() != iNRows) {
+        computeTaperedSpectra(inputData.matData, tapers, iNfft, inputData.vecTapSpectra);
+    }
+
+    // Compute PSD (average over tapers if necessary)
+    if(bPsd) {
+        double denomPSD = tapers.second.cwiseAbs2().sum() / 2.0;
+
+        inputData.matPsd = MatrixXd(iNRows, m_iNumberBinAmount);
+
+        for (i = 0; i < iNRows; ++i) {
+            inputData.matPsd.row(i) = inputData.vecTapSpectra.at(i).block(0,m_iNumberBinStart,iNTapers,m_iNumberBinAmount).cwiseAbs2().colwise().sum() / denomPSD;
+
+            // Divide first and last element by 2 due to half spectrum
+            if(m_iNumberBinStart == 0) {
+                inputData.matPsd.row(i)(0) /= 2.0;
+            }
+
+            if(bNfftEven && m_iNumberBinStart + m_iNumberBinAmount >= iNFreqs) {
+                inputData.matPsd.row(i).tail(1) /= 2.0;
+            }
+        }
+    }
+
+    // Pack the spectra frequency major. The CSD normalization and the division of the first and last element by 2
+    // due to the half spectrum are applied to the spectra, so the CSD is the plain product of two spectra.
+    if(bPack) {
+        double denomCSD = sqrt(tapers.second.cwiseAbs2().sum()) * sqrt(tapers.second.cwiseAbs2().sum()) / 2.0;
+
+        VectorXd vecScale = VectorXd::Constant(m_iNumberBinAmount, 1.0 / sqrt(denomCSD));
+
+        if(m_iNumberBinStart == 0) {
+            vecScale(0) *= sqrt(0.5);
+        }
+
+        if(bNfftEven && m_iNumberBinStart + m_iNumberBinAmount >= iNFreqs) {
+            vecScale.tail(1) *= sqrt(0.5);
+        }
+
+        matSpectra.resize(iNRows, iNTapers * m_iNumberBinAmount);
+
+        for (i = 0; i < iNRows; ++i) {
+            const MatrixXcd& matTapSpectrum = inputData.vecTapSpectra.at(i);
+
+            for (j = 0; j < m_iNumberBinAmount; ++j) {
+                matSpectra.block(i, j * iNTapers, 1, iNTapers) = matTapSpectrum.col(m_iNumberBinStart + j).transpose() * vecScale(j);
+            }
+        }
+    }
+
+    //Do not store data to save memory
+    if(!m_bStorageModeIsActive) {
+        inputData.vecTapSpectra.clear();
+    }
+}
+
+//*******************************************************************************************************
+
+void MetricFusion::computeCsd(const MatrixXcd& matSpectra,
+                              int iBin,
+                              int iNTapers,
+                              VectorXcd& vecCsd,
+                              MatrixXcd& matTile)
+{
+    int iNRows = matSpectra.rows();
+    int i, iRow, iCol, iNTileRows, iNTileCols, iColStart;
+
+    vecCsd.resize(iNRows * (iNRows + 1) / 2);
+
+    for (iRow = 0; iRow < iNRows; iRow += CSD_TILE_SIZE) {
+        iNTileRows = qMin(CSD_TILE_SIZE, iNRows - iRow);
+
+        for (iCol = iRow; iCol < iNRows; iCol += CSD_TILE_SIZE) {
+            iNTileCols = qMin(CSD_TILE_SIZE, iNRows - iCol);
+
+            // Cross products of all row pairs of the two tiles, summed over the tapers
+            matTile.noalias() = matSpectra.block(iRow, iBin * iNTapers, iNTileRows, iNTapers)
+                                * matSpectra.block(iCol, iBin * iNTapers, iNTileCols, iNTapers).adjoint();
+
+            // Only keep the upper triangular part
+            for (i = 0; i < iNTileRows; ++i) {
+                iColStart = (iCol == iRow) ? i : 0;
+
+                if(iColStart < iNTileCols) {
+                    vecCsd.segment(getPairIdx(iNRows, iRow + i, iCol + iColStart), iNTileCols - iColStart) = matTile.row(i).segment(iColStart, iNTileCols - iColStart).transpose();
+                }
+            }
+        }
+    }
+}
+
+//*******************************************************************************************************
+
+void MetricFusion::computeFrequencyBlock(int iBinStart,
+                                         int iBinAmount,
+                                         const QVector<int>& vecBatch,
+                                         const QVector<MatrixXcd>& vecSpectra,
+                                         ConnectivitySettings& connectivitySettings,
+                                         const QVector<int>& vecIntermediateData,
+                                         int iNTapers)
+{
+    ConnectivitySettings::IntermediateSumData& sumData = connectivitySettings.getIntermediateSumData();
+    VectorXcd vecCsd, vecCsdNormalized;
+    VectorXd vecCsdImag;
+    MatrixXcd matTile;
+    int iTrial, iIntermediateData;
+
+    for (int iBin = iBinStart; iBin < iBinStart + iBinAmount; ++iBin) {
+        for (int iIdx = 0; iIdx < vecBatch.size(); ++iIdx) {
+            iTrial = vecBatch.at(iIdx);
+            iIntermediateData = vecIntermediateData.at(iTrial);
+
+            if(!(iIntermediateData & (Csd | CsdNormalized | CsdImagSign | CsdImagAbs | CsdImagSqrd))) {
+                continue;
+            }
+
+            ConnectivitySettings::IntermediateTrialData& trialData = connectivitySettings.getTrialData()[iTrial];
+
+            computeCsd(vecSpectra.at(iIdx), iBin, iNTapers, vecCsd, matTile);
+
+            if(iIntermediateData & Csd) {
+                addPackedPairs(sumData.vecPairCsdSum, vecCsd, iBin);
+
+                if(m_bStorageModeIsActive) {
+                    setPackedPairs(trialData.vecPairCsd, vecCsd, iBin);
+                }
+            }
+            if(iIntermediateData & CsdNormalized) {
+                vecCsdNormalized = vecCsd.cwiseQuotient(vecCsd.cwiseAbs());
+                addPackedPairs(sumData.vecPairCsdNormalizedSum, vecCsdNormalized, iBin);
+
+                if(m_bStorageModeIsActive) {
+                    setPackedPairs(trialData.vecPairCsdNormalized, vecCsdNormalized, iBin);
+                }
+            }
+            if(iIntermediateData & CsdImagSign) {
+                vecCsdImag = vecCsd.imag().cwiseSign();
+                addPackedPairs(sumData.vecPairCsdImagSignSum, vecCsdImag, iBin);
+
+                if(m_bStorageModeIsActive) {
+                    setPackedPairs(trialData.vecPairCsdImagSign, vecCsdImag, iBin);
+                }
+            }
+            if(iIntermediateData & CsdImagAbs) {
+                vecCsdImag = vecCsd.imag().cwiseAbs();
+                addPackedPairs(sumData.vecPairCsdImagAbsSum, vecCsdImag, iBin);
+
+                if(m_bStorageModeIsActive) {
+                    setPackedPairs(trialData.vecPairCsdImagAbs, vecCsdImag, iBin);
+                }
+            }
+            if(iIntermediateData & CsdImagSqrd) {
+                vecCsdImag = vecCsd.imag().array().square().matrix();
+                addPackedPairs(sumData.vecPairCsdImagSqrdSum, vecCsdImag, iBin);
+
+                if(m_bStorageModeIsActive) {
+                    setPackedPairs(trialData.vecPairCsdImagSqrd, vecCsdImag, iBin);
+                }
+            }
+        }
+    }
+}
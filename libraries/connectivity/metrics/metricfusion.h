@@ -0,0 +1,224 @@
+//=============================================================================================================
+/**
+ * @file     metricfusion.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    MetricFusion class declaration.
+ *
+ */
+
+#ifndef METRICFUSION_H
+#define METRICFUSION_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../connectivity_global.h"
+
+#include "abstractmetric.h"
+#include "../connectivitysettings.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QSharedPointer>
+#include <QVector>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define CSD_TILE_SIZE               64          /**< Rows per CSD tile, the spectra of two tiles stay in cache */
+#define MAX_SPECTRA_BATCH_BYTES     268435456   /**< Upper bound for the packed spectra kept in memory at once */
+
+//=============================================================================================================
+// FORWARD DECLARATIONS
+//=============================================================================================================
+
+//=============================================================================================================
+// DEFINE NAMESPACE CONNECTIVITYLIB
+//=============================================================================================================
+
+namespace CONNECTIVITYLIB {
+
+//=============================================================================================================
+// CONNECTIVITYLIB FORWARD DECLARATIONS
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+ * The spectral metrics (COH, IMAGCOH, PLI, WPLI, USPLI, DSWPLI, PLV) are all based on the same tapered spectra
+ * and cross spectral densities. This class computes these once per trial and derives the intermediate sum data
+ * of all requested metrics in a single reduction step per trial. The trials are processed in batches, so that only
+ * the spectra of a bounded number of trials are kept in memory.
+ *
+ * @brief This class computes the shared intermediate data of all requested spectral connectivity metrics.
+ */
+class CONNECTIVITYSHARED_EXPORT MetricFusion : public AbstractMetric
+{
+
+public:
+    typedef QSharedPointer<MetricFusion> SPtr;            /**< Shared pointer type for MetricFusion. */
+    typedef QSharedPointer<const MetricFusion> ConstSPtr; /**< Const shared pointer type for MetricFusion. */
+
+    enum IntermediateData {
+        Psd = 0x01,
+        Csd = 0x02,
+        CsdNormalized = 0x04,
+        CsdImagSign = 0x08,
+        CsdImagAbs = 0x10,
+        CsdImagSqrd = 0x20
+    };
+
+    //=========================================================================================================
+    /**
+     * Constructs a MetricFusion object.
+     */
+    explicit MetricFusion();
+
+    //=========================================================================================================
+    /**
+     * Computes the intermediate sum data for all spectral metrics requested in the connectivity settings.
+     *
+     * @param[in] connectivitySettings   The input data and parameters.
+     *
+     * @return                   True if intermediate sum data were computed, false if no spectral metric was
+     *                           requested or the input data is empty.
+     */
+    static bool calculate(ConnectivitySettings& connectivitySettings);
+
+    //=========================================================================================================
+    /**
+     * Returns the intermediate data needed by the given connectivity methods.
+     *
+     * @param[in] lMethods       The connectivity methods, e.g. "COH" or "WPLI".
+     *
+     * @return                   The needed intermediate data as combination of IntermediateData flags.
+     */
+    static int getIntermediateData(const QStringList& lMethods);
+
+protected:
+    //=========================================================================================================
+    /**
+     * Computes the tapered spectra and the PSD of one trial if not available already. The spectra of the used
+     * frequency bins are additionally packed frequency major for the CSD kernel. This function gets called in
+     * parallel.
+     *
+     * @param[in] inputData              The input data.
+     * @param[out] matSpectra            The packed spectra. Column iBin * iNTapers + iTaper holds all rows for
+     *                                   the given bin and taper. Already scaled, so that the CSD is the plain
+     *                                   product of the spectra.
+     * @param[in] bPsd                   Whether to compute the PSD.
+     * @param[in] bPack                  Whether to pack the spectra.
+     * @param[in] iNRows                 The number of rows.
+     * @param[in] iNFreqs                The number of frequenciy bins.
+     * @param[in] iNfft                  The FFT length.
+     * @param[in] tapers                 The taper information.
+     */
+    static void computeSpectra(ConnectivitySettings::IntermediateTrialData& inputData,
+                               Eigen::MatrixXcd& matSpectra,
+                               bool bPsd,
+                               bool bPack,
+                               int iNRows,
+                               int iNFreqs,
+                               int iNfft,
+                               const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers);
+
+    //=========================================================================================================
+    /**
+     * Computes the upper triangular CSD of one frequency bin out of the packed spectra. The rows are processed in
+     * tiles, so that the spectra of two tiles stay in cache while computing their cross products.
+     *
+     * @param[in] matSpectra             The packed spectra as computed by computeSpectra.
+     * @param[in] iBin                   The frequency bin (relative to m_iNumberBinStart).
+     * @param[in] iNTapers               The number of tapers.
+     * @param[out] vecCsd                The packed upper triangular CSD of the frequency bin.
+     * @param[in, out] matTile           Buffer for the tile products. Will be resized if necessary.
+     */
+    static void computeCsd(const Eigen::MatrixXcd& matSpectra,
+                           int iBin,
+                           int iNTapers,
+                           Eigen::VectorXcd& vecCsd,
+                           Eigen::MatrixXcd& matTile);
+
+    //=========================================================================================================
+    /**
+     * Computes the CSD and the CSD based products of a block of frequency bins for a batch of trials and adds them
+     * to the intermediate sum data. In storage mode the products are additionally stored per trial. Each block
+     * only touches its own columns of the (pre-allocated) pair matrices, so blocks can be computed in parallel
+     * without locking.
+     *
+     * @param[in] iBinStart              The first frequency bin of the block (relative to m_iNumberBinStart).
+     * @param[in] iBinAmount             The number of frequency bins of the block.
+     * @param[in] vecBatch               The trial indices of the batch.
+     * @param[in] vecSpectra             The packed spectra of the batch, in the order of vecBatch.
+     * @param[in, out] connectivitySettings  The connectivity settings holding the trial and sum data.
+     * @param[in] vecIntermediateData    The intermediate data to compute per trial as combination of
+     *                                   IntermediateData flags.
+     * @param[in] iNTapers               The number of tapers.
+     */
+    static void computeFrequencyBlock(int iBinStart,
+                                      int iBinAmount,
+                                      const QVector<int>& vecBatch,
+                                      const QVector<Eigen::MatrixXcd>& vecSpectra,
+                                      ConnectivitySettings& connectivitySettings,
+                                      const QVector<int>& vecIntermediateData,
+                                      int iNTapers);
+
+    //=========================================================================================================
+    /**
+     * Returns the index of the row pair (i,j) with i <= j in the packed upper triangular layout.
+     *
+     * @param[in] iNRows     The number of rows.
+     * @param[in] i          The first row.
+     * @param[in] j          The second row.
+     *
+     * @return               The pair index.
+     */
+    static inline int getPairIdx(int iNRows, int i, int j);
+};
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline int MetricFusion::getPairIdx(int iNRows, int i, int j)
+{
+    return i*iNRows - (i*(i-1))/2 + (j-i);
+}
+} // namespace CONNECTIVITYLIB
+
+#endif // METRICFUSION_H
@@ -95,7 +95,7 @@ Network PhaseLockingValue::calculate(ConnectivitySettings& connectivitySettings)
         return finalNetwork;
     }
 
-    if(AbstractMetric::m_bStorageModeIsActive == false) {
+    if(AbstractMetric::m_bStorageModeIsActive == false && connectivitySettings.isFusedModeActive() == false) {
         connectivitySettings.clearIntermediateData();
     }
 
@@ -163,10 +163,13 @@ Network PhaseLockingValue::calculate(ConnectivitySettings& connectivitySettings)
 //    qWarning() << "Preparation" << iTime;
 //    timer.restart();
 
-    // Compute PLV in parallel for all trials
-    QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
-                                             computeLambda);
-    result.waitForFinished();
+    // The intermediate sum data were already computed by MetricFusion in fused mode
+    if(!connectivitySettings.isFusedModeActive()) {
+        // Compute PLV in parallel for all trials
+        QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
+                                                 computeLambda);
+        result.waitForFinished();
+    }
 
 //    iTime = timer.elapsed();
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
@@ -202,37 +205,8 @@ void PhaseLockingValue::compute(ConnectivitySettings::IntermediateTrialData& inp
     int i,j;
 
     // Calculate tapered spectra if not available already
-    // This code was copied and changed modified Utils/Spectra since we do not want to call the function due to time loss.
     if(inputData.vecTapSpectra.isEmpty()) {
-        RowVectorXd vecInputFFT, rowData;
-        RowVectorXcd vecTmpFreq;
-
-        MatrixXcd matTapSpectrum(tapers.first.rows(), iNFreqs);
-
-        FFT<double> fft;
-        fft.SetFlag(fft.HalfSpectrum);
-
-        for (i = 0; i < iNRows; ++i) {
-            // Substract mean
-            rowData.array() = inputData.matData.row(i).array() - inputData.matData.row(i).mean();
-
-            // Calculate tapered spectra if not available already
-            for(j = 0; j < tapers.first.rows(); j++) {
-                // Zero padd if necessary. The zero padding in Eigen's FFT is only working for column vectors.
-                if (rowData.cols() < iNfft) {
-                    vecInputFFT.setZero(iNfft);
-                    vecInputFFT.block(0,0,1,rowData.cols()) = rowData.cwiseProduct(tapers.first.row(j));;
-                } else {
-                    vecInputFFT = rowData.cwiseProduct(tapers.first.row(j));
-                }
-
-                // FFT for freq domain returning the half spectrum and multiply taper weights
-                fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecTmpFreq * tapers.second(j);
-            }
-
-            inputData.vecTapSpectra.append(matTapSpectrum);
-        }
+        computeTaperedSpectra(inputData.matData, tapers, iNfft, inputData.vecTapSpectra);
     }
 
     // Compute CSD
@@ -312,21 +286,12 @@ void PhaseLockingValue::computePLV(ConnectivitySettings &connectivitySettings,
 {
     // Compute final PLV and create Network
     MatrixXd matNom;
-    MatrixXd matWeight;
-    QSharedPointer<NetworkEdge> pEdge;
-    int j;
 
     for (int i = 0; i < connectivitySettings.at(0).matData.rows(); ++i) {
         matNom = connectivitySettings.getIntermediateSumData().vecPairCsdNormalizedSum.at(i).second.cwiseAbs() / connectivitySettings.size();
 
-        for(j = i; j < connectivitySettings.at(0).matData.rows(); ++j) {
-            matWeight = matNom.row(j).transpose();
-
-            pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-            finalNetwork.getNodeAt(i)->append(pEdge);
-            finalNetwork.getNodeAt(j)->append(pEdge);
-            finalNetwork.append(pEdge);
-        }
+        finalNetwork.append(i,
+                            VectorXi::LinSpaced(matNom.rows() - i, i, matNom.rows() - 1),
+                            matNom.bottomRows(matNom.rows() - i).transpose());
     }
 }
@@ -74,7 +74,13 @@ using namespace UTILSLIB;
 
 Network::Network(const QString& sConnectivityMethod,
                  double dThreshold)
-: m_sConnectivityMethod(sConnectivityMethod)
+: m_iNumberEdgeBins(0)
+, m_minMaxFreqBins(QPair<int,int>(-1,-1))
+, m_bFullEdgesChanged(false)
+, m_bThresholdedEdgesChanged(false)
+, m_bNodesChanged(false)
+, m_pCacheMutex(QSharedPointer<QMutex>::create())
+, m_sConnectivityMethod(sConnectivityMethod)
 , m_minMaxFullWeights(QPair<double,double>(std::numeric_limits<double>::max(),0.0))
 , m_minMaxThresholdedWeights(QPair<double,double>(std::numeric_limits<double>::max(),0.0))
 , m_dThreshold(dThreshold)
@@ -95,15 +101,15 @@ MatrixXd Network::getFullConnectivityMatrix(bool bGetMirroredVersion) const
     MatrixXd matDist(m_lNodes.size(), m_lNodes.size());
     matDist.setZero();
 
-    for(int i = 0; i < m_lFullEdges.size(); ++i) {
-        int row = m_lFullEdges.at(i)->getStartNodeID();
-        int col = m_lFullEdges.at(i)->getEndNodeID();
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        int row = m_vecEdgeStartNodeIDs.at(i);
+        int col = m_vecEdgeEndNodeIDs.at(i);
 
         if(row < matDist.rows() && col < matDist.cols()) {
-            matDist(row,col) = m_lFullEdges.at(i)->getWeight();
+            matDist(row,col) = m_vecEdgeWeights.at(i);
 
             if(bGetMirroredVersion) {
-                matDist(col,row) = m_lFullEdges.at(i)->getWeight();
+                matDist(col,row) = m_vecEdgeWeights.at(i);
             }
         }
     }
@@ -119,15 +125,19 @@ MatrixXd Network::getThresholdedConnectivityMatrix(bool bGetMirroredVersion) con
     MatrixXd matDist(m_lNodes.size(), m_lNodes.size());
     matDist.setZero();
 
-    for(int i = 0; i < m_lThresholdedEdges.size(); ++i) {
-        int row = m_lThresholdedEdges.at(i)->getStartNodeID();
-        int col = m_lThresholdedEdges.at(i)->getEndNodeID();
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        if(!m_vecEdgeActive.at(i)) {
+            continue;
+        }
+
+        int row = m_vecEdgeStartNodeIDs.at(i);
+        int col = m_vecEdgeEndNodeIDs.at(i);
 
         if(row < matDist.rows() && col < matDist.cols()) {
-            matDist(row,col) = m_lThresholdedEdges.at(i)->getWeight();
+            matDist(row,col) = m_vecEdgeWeights.at(i);
 
             if(bGetMirroredVersion) {
-                matDist(col,row) = m_lThresholdedEdges.at(i)->getWeight();
+                matDist(col,row) = m_vecEdgeWeights.at(i);
             }
         }
     }
@@ -138,56 +148,126 @@ MatrixXd Network::getThresholdedConnectivityMatrix(bool bGetMirroredVersion) con
 
 //=============================================================================================================
 
-const QList<NetworkEdge::SPtr>& Network::getFullEdges() const
+QList<NetworkEdge::SPtr> Network::getFullEdges() const
 {
+    QMutexLocker locker(m_pCacheMutex.data());
+
+    updateFullEdges();
+
     return m_lFullEdges;
 }
 
 //=============================================================================================================
 
-const QList<NetworkEdge::SPtr>& Network::getThresholdedEdges() const
+QList<NetworkEdge::SPtr> Network::getThresholdedEdges() const
 {
+    QMutexLocker locker(m_pCacheMutex.data());
+
+    updateThresholdedEdges();
+
     return m_lThresholdedEdges;
 }
 
 //=============================================================================================================
 
-const QList<NetworkNode::SPtr>& Network::getNodes() const
+QList<NetworkNode::SPtr> Network::getNodes() const
 {
+    QMutexLocker locker(m_pCacheMutex.data());
+
+    updateNodes();
+
     return m_lNodes;
 }
 
 //=============================================================================================================
 
+NetworkEdge::SPtr Network::getEdgeAt(int i)
+{
+    QMutexLocker locker(m_pCacheMutex.data());
+
+    updateFullEdges();
+
+    return m_lFullEdges.at(i);
+}
+
+//=============================================================================================================
+
 NetworkNode::SPtr Network::getNodeAt(int i)
 {
+    QMutexLocker locker(m_pCacheMutex.data());
+
+    updateNodes();
+
     return m_lNodes.at(i);
 }
 
 //=============================================================================================================
 
-qint16 Network::getFullDistribution() const
+int Network::getNumberEdges() const
+{
+    return m_vecEdgeWeights.size();
+}
+
+//=============================================================================================================
+
+VectorXi Network::getFullDegrees() const
 {
-    qint16 distribution = 0;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        distribution += m_lNodes.at(i)->getFullDegree();
-    }
+    computeNodeMetrics(false, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
 
-    return distribution;
+    return vecIndegrees + vecOutdegrees;
 }
 
 //=============================================================================================================
 
-qint16 Network::getThresholdedDistribution() const
+VectorXi Network::getThresholdedDegrees() const
 {
-    qint16 distribution = 0;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        distribution += m_lNodes.at(i)->getThresholdedDegree();
-    }
+    computeNodeMetrics(true, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
 
-    return distribution;
+    return vecIndegrees + vecOutdegrees;
+}
+
+//=============================================================================================================
+
+VectorXd Network::getFullStrengths() const
+{
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
+
+    computeNodeMetrics(false, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    return vecInstrengths + vecOutstrengths;
+}
+
+//=============================================================================================================
+
+VectorXd Network::getThresholdedStrengths() const
+{
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
+
+    computeNodeMetrics(true, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    return vecInstrengths + vecOutstrengths;
+}
+
+//=============================================================================================================
+
+int Network::getFullDistribution() const
+{
+    return getFullDegrees().sum();
+}
+
+//=============================================================================================================
+
+int Network::getThresholdedDistribution() const
+{
+    return getThresholdedDegrees().sum();
 }
 
 //=============================================================================================================
@@ -222,108 +302,90 @@ QPair<double, double> Network::getMinMaxThresholdedWeights() const
 
 QPair<int,int> Network::getMinMaxFullDegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecDegrees = getFullDegrees();
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getFullDegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getFullDegree();
-        } else if (m_lNodes.at(i)->getFullDegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getFullDegree();
-        }
+    if(vecDegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecDegrees.minCoeff(),vecDegrees.maxCoeff());
 }
 
 //=============================================================================================================
 
 QPair<int,int> Network::getMinMaxThresholdedDegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecDegrees = getThresholdedDegrees();
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getThresholdedDegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getThresholdedDegree();
-        } else if (m_lNodes.at(i)->getThresholdedDegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getThresholdedDegree();
-        }
+    if(vecDegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecDegrees.minCoeff(),vecDegrees.maxCoeff());
 }
 
 //=============================================================================================================
 
 QPair<int,int> Network::getMinMaxFullIndegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getFullIndegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getFullIndegree();
-        } else if (m_lNodes.at(i)->getFullIndegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getFullIndegree();
-        }
+    computeNodeMetrics(false, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    if(vecIndegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecIndegrees.minCoeff(),vecIndegrees.maxCoeff());
 }
 
 //=============================================================================================================
 
 QPair<int,int> Network::getMinMaxThresholdedIndegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getThresholdedIndegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getThresholdedIndegree();
-        } else if (m_lNodes.at(i)->getThresholdedIndegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getThresholdedIndegree();
-        }
+    computeNodeMetrics(true, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    if(vecIndegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecIndegrees.minCoeff(),vecIndegrees.maxCoeff());
 }
 
 //=============================================================================================================
 
 QPair<int,int> Network::getMinMaxFullOutdegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getFullOutdegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getFullOutdegree();
-        } else if (m_lNodes.at(i)->getFullOutdegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getFullOutdegree();
-        }
+    computeNodeMetrics(false, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    if(vecOutdegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecOutdegrees.minCoeff(),vecOutdegrees.maxCoeff());
 }
 
 //=============================================================================================================
 
 QPair<int,int> Network::getMinMaxThresholdedOutdegrees() const
 {
-    int maxDegree = 0;
-    int minDegree = 1000000;
+    VectorXi vecIndegrees, vecOutdegrees;
+    VectorXd vecInstrengths, vecOutstrengths;
 
-    for(int i = 0; i < m_lNodes.size(); ++i) {
-        if(m_lNodes.at(i)->getThresholdedOutdegree() > maxDegree){
-            maxDegree = m_lNodes.at(i)->getThresholdedOutdegree();
-        } else if (m_lNodes.at(i)->getThresholdedOutdegree() < minDegree){
-            minDegree = m_lNodes.at(i)->getThresholdedOutdegree();
-        }
+    computeNodeMetrics(true, vecIndegrees, vecOutdegrees, vecInstrengths, vecOutstrengths);
+
+    if(vecOutdegrees.size() == 0) {
+        return QPair<int,int>(0,0);
     }
 
-    return QPair<int,int>(minDegree,maxDegree);
+    return QPair<int,int>(vecOutdegrees.minCoeff(),vecOutdegrees.maxCoeff());
 }
 
 //=============================================================================================================
@@ -331,16 +393,17 @@ QPair<int,int> Network::getMinMaxThresholdedOutdegrees() const
 void Network::setThreshold(double dThreshold)
 {
     m_dThreshold = dThreshold;
-    m_lThresholdedEdges.clear();
 
-    for(int i = 0; i < m_lFullEdges.size(); ++i) {
-        if(fabs(m_lFullEdges.at(i)->getWeight()) >= m_dThreshold) {
-            m_lFullEdges.at(i)->setActive(true);
-            m_lThresholdedEdges.append(m_lFullEdges.at(i));
-        } else {
-            m_lFullEdges.at(i)->setActive(false);
-        }
-    }
+    // Threshold all edges at once
+    int iNumberEdges = m_vecEdgeWeights.size();
+    Map<const ArrayXd> vecWeights(m_vecEdgeWeights.constData(), iNumberEdges);
+    Map<Array<bool,Dynamic,1> > vecActive(m_vecEdgeActive.data(), iNumberEdges);
+
+    vecActive = vecWeights.abs() >= m_dThreshold;
+
+    m_bFullEdgesChanged = true;
+    m_bThresholdedEdgesChanged = true;
+    m_bNodesChanged = true;
 
     m_minMaxThresholdedWeights.first = m_dThreshold;
     m_minMaxThresholdedWeights.second = m_minMaxFullWeights.second;
@@ -385,18 +448,30 @@ void Network::setFrequencyRange(float fLowerFreq, float fUpperFreq)
     int iLowerBin = fLowerFreq * dScaleFactor;
     int iUpperBin = fUpperFreq * dScaleFactor;
 
-    // Update the min max values
-    m_minMaxFullWeights = QPair<double,double>(std::numeric_limits<double>::max(),0.0);
+    m_minMaxFreqBins = QPair<int,int>(iLowerBin,iUpperBin);
 
-    for(int i = 0; i < m_lFullEdges.size(); ++i) {
-        m_lFullEdges.at(i)->setFrequencyBins(QPair<int,int>(iLowerBin,iUpperBin));
+    int iNumberEdges = m_vecEdgeWeights.size();
 
-        if(fabs(m_lFullEdges.at(i)->getWeight()) < m_minMaxFullWeights.first) {
-            m_minMaxFullWeights.first = fabs(m_lFullEdges.at(i)->getWeight());
-        } else if(fabs(m_lFullEdges.at(i)->getWeight()) > m_minMaxFullWeights.second) {
-            m_minMaxFullWeights.second = fabs(m_lFullEdges.at(i)->getWeight());
-        }
+    if(iNumberEdges == 0) {
+        return;
+    }
+
+    // Average all edges at once. The weights of one edge are stored contiguously, i.e. each column holds one edge.
+    Map<const MatrixXd> matBinWeights(m_vecEdgeBinWeights.constData(), m_iNumberEdgeBins, iNumberEdges);
+    Map<VectorXd> vecWeights(m_vecEdgeWeights.data(), iNumberEdges);
+
+    if(iLowerBin < m_iNumberEdgeBins) {
+        int iNumberBins = qMin(iUpperBin, m_iNumberEdgeBins - 1) - iLowerBin + 1;
+        vecWeights = matBinWeights.middleRows(iLowerBin, iNumberBins).colwise().mean().transpose();
     }
+
+    // Update the min max values
+    m_minMaxFullWeights.first = vecWeights.cwiseAbs().minCoeff();
+    m_minMaxFullWeights.second = vecWeights.cwiseAbs().maxCoeff();
+
+    m_bFullEdgesChanged = true;
+    m_bThresholdedEdgesChanged = true;
+    m_bNodesChanged = true;
 }
 
 //=============================================================================================================
@@ -411,19 +486,50 @@ const QPair<float,float>& Network::getFrequencyRange() const
 void Network::append(NetworkEdge::SPtr newEdge)
 {
     if(newEdge->getEndNodeID() != newEdge->getStartNodeID()) {
-        double dEdgeWeight = newEdge->getWeight();
-        if(dEdgeWeight < m_minMaxFullWeights.first) {
-            m_minMaxFullWeights.first = dEdgeWeight;
-        } else if(dEdgeWeight >= m_minMaxFullWeights.second) {
-            m_minMaxFullWeights.second = dEdgeWeight;
-        }
+        MatrixXd matWeight = newEdge->getMatrixWeight();
+
+        appendEdge(newEdge->getStartNodeID(),
+                   newEdge->getEndNodeID(),
+                   matWeight.col(0),
+                   newEdge->getWeight());
+
+        newEdge->setActive(m_vecEdgeActive.last());
+
+        // The appended edge object stays with the caller. The network creates its own read only view of it.
+        m_bFullEdgesChanged = true;
+        m_bThresholdedEdgesChanged = true;
+    }
+}
+
+//=============================================================================================================
 
-        m_lFullEdges << newEdge;
+void Network::append(int iStartNodeID,
+                     const VectorXi& vecEndNodeIDs,
+                     const MatrixXd& matWeights)
+{
+    if(matWeights.cols() != vecEndNodeIDs.rows()) {
+        qDebug() << "Network::append - Number of weight columns does not match the number of end nodes. Returning.";
+        return;
+    }
 
-        if(fabs(newEdge->getWeight()) >= m_dThreshold) {
-            m_lThresholdedEdges << newEdge;
+    m_vecEdgeStartNodeIDs.reserve(m_vecEdgeStartNodeIDs.size() + vecEndNodeIDs.rows());
+    m_vecEdgeEndNodeIDs.reserve(m_vecEdgeEndNodeIDs.size() + vecEndNodeIDs.rows());
+    m_vecEdgeWeights.reserve(m_vecEdgeWeights.size() + vecEndNodeIDs.rows());
+    m_vecEdgeActive.reserve(m_vecEdgeActive.size() + vecEndNodeIDs.rows());
+    m_vecEdgeBinWeights.reserve(m_vecEdgeBinWeights.size() + vecEndNodeIDs.rows() * qMax(int(matWeights.rows()), 1));
+
+    for(int i = 0; i < vecEndNodeIDs.rows(); ++i) {
+        if(vecEndNodeIDs(i) != iStartNodeID) {
+            if(matWeights.rows() == 0) {
+                appendEdge(iStartNodeID, vecEndNodeIDs(i), VectorXd::Zero(1), 0.0);
+            } else {
+                appendEdge(iStartNodeID, vecEndNodeIDs(i), matWeights.col(i), matWeights.col(i).mean());
+            }
         }
     }
+
+    m_bFullEdgesChanged = true;
+    m_bThresholdedEdgesChanged = true;
 }
 
 //=============================================================================================================
@@ -431,13 +537,15 @@ void Network::append(NetworkEdge::SPtr newEdge)
 void Network::append(NetworkNode::SPtr newNode)
 {
     m_lNodes << newNode;
+
+    m_bNodesChanged = true;
 }
 
 //=============================================================================================================
 
 bool Network::isEmpty() const
 {
-    if(m_lFullEdges.isEmpty() || m_lNodes.isEmpty()) {
+    if(m_vecEdgeWeights.isEmpty() || m_lNodes.isEmpty()) {
         return true;
     }
 
@@ -454,15 +562,18 @@ void Network::normalize()
         return;
     }
 
-    for(int i = 0; i < m_lFullEdges.size(); ++i) {
-        m_lFullEdges.at(i)->setWeight(m_lFullEdges.at(i)->getWeight()/m_minMaxFullWeights.second);
-    }
+    Map<VectorXd> vecWeights(m_vecEdgeWeights.data(), m_vecEdgeWeights.size());
+    vecWeights /= m_minMaxFullWeights.second;
 
     m_minMaxFullWeights.first = m_minMaxFullWeights.first/m_minMaxFullWeights.second;
     m_minMaxFullWeights.second = 1.0;
 
     m_minMaxThresholdedWeights.first = m_minMaxThresholdedWeights.first/m_minMaxThresholdedWeights.second;
     m_minMaxThresholdedWeights.second = 1.0;
+
+    m_bFullEdgesChanged = true;
+    m_bThresholdedEdgesChanged = true;
+    m_bNodesChanged = true;
 }
 
 //=============================================================================================================
@@ -521,3 +632,206 @@ int Network::getFFTSize()
     return m_iFFTSize;
 }
 
+//=============================================================================================================
+
+void Network::computeNodeMetrics(bool bThresholded,
+                                 VectorXi& vecIndegrees,
+                                 VectorXi& vecOutdegrees,
+                                 VectorXd& vecInstrengths,
+                                 VectorXd& vecOutstrengths) const
+{
+    int iNumberNodes = m_lNodes.size();
+
+    vecIndegrees = VectorXi::Zero(iNumberNodes);
+    vecOutdegrees = VectorXi::Zero(iNumberNodes);
+    vecInstrengths = VectorXd::Zero(iNumberNodes);
+    vecOutstrengths = VectorXd::Zero(iNumberNodes);
+
+    int iStartNodeID, iEndNodeID;
+
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        if(bThresholded && !m_vecEdgeActive.at(i)) {
+            continue;
+        }
+
+        iStartNodeID = m_vecEdgeStartNodeIDs.at(i);
+        iEndNodeID = m_vecEdgeEndNodeIDs.at(i);
+
+        if(iEndNodeID < iNumberNodes) {
+            vecIndegrees(iEndNodeID)++;
+            vecInstrengths(iEndNodeID) += m_vecEdgeWeights.at(i);
+        }
+
+        if(iStartNodeID < iNumberNodes) {
+            vecOutdegrees(iStartNodeID)++;
+            vecOutstrengths(iStartNodeID) += m_vecEdgeWeights.at(i);
+        }
+    }
+}
+
+//=============================================================================================================
+
+void Network::updateNodes() const
+{
+    if(!m_bNodesChanged) {
+        return;
+    }
+
+    VectorXi vecFullIndegrees, vecFullOutdegrees, vecThresholdedIndegrees, vecThresholdedOutdegrees;
+    VectorXd vecFullInstrengths, vecFullOutstrengths, vecThresholdedInstrengths, vecThresholdedOutstrengths;
+
+    computeNodeMetrics(false, vecFullIndegrees, vecFullOutdegrees, vecFullInstrengths, vecFullOutstrengths);
+    computeNodeMetrics(true, vecThresholdedIndegrees, vecThresholdedOutdegrees, vecThresholdedInstrengths, vecThresholdedOutstrengths);
+
+    int iId;
+
+    for(int i = 0; i < m_lNodes.size(); ++i) {
+        iId = m_lNodes.at(i)->getId();
+
+        if(iId < 0 || iId >= m_lNodes.size()) {
+            continue;
+        }
+
+        m_lNodes.at(i)->setDegrees(vecFullIndegrees(iId),
+                                   vecFullOutdegrees(iId),
+                                   vecThresholdedIndegrees(iId),
+                                   vecThresholdedOutdegrees(iId));
+        m_lNodes.at(i)->setStrengths(vecFullInstrengths(iId),
+                                     vecFullOutstrengths(iId),
+                                     vecThresholdedInstrengths(iId),
+                                     vecThresholdedOutstrengths(iId));
+    }
+
+    // Attach the edges to their start and end nodes in the order of the edge arrays
+    updateFullEdges();
+
+    QVector<QList<NetworkEdge::SPtr> > vecNodeEdges(m_lNodes.size());
+    int iStartNodeID, iEndNodeID;
+
+    for(int i = 0; i < m_lFullEdges.size(); ++i) {
+        iStartNodeID = m_vecEdgeStartNodeIDs.at(i);
+        iEndNodeID = m_vecEdgeEndNodeIDs.at(i);
+
+        if(iStartNodeID >= 0 && iStartNodeID < vecNodeEdges.size()) {
+            vecNodeEdges[iStartNodeID] << m_lFullEdges.at(i);
+        }
+
+        if(iEndNodeID >= 0 && iEndNodeID < vecNodeEdges.size()) {
+            vecNodeEdges[iEndNodeID] << m_lFullEdges.at(i);
+        }
+    }
+
+    for(int i = 0; i < m_lNodes.size(); ++i) {
+        iId = m_lNodes.at(i)->getId();
+
+        if(iId < 0 || iId >= m_lNodes.size()) {
+            continue;
+        }
+
+        m_lNodes.at(i)->setEdges(vecNodeEdges.at(iId));
+    }
+
+    m_bNodesChanged = false;
+}
+
+//=============================================================================================================
+
+void Network::updateFullEdges() const
+{
+    if(!m_bFullEdgesChanged) {
+        return;
+    }
+
+    m_lFullEdges.clear();
+    m_lFullEdges.reserve(m_vecEdgeWeights.size());
+
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        m_lFullEdges << createEdge(i);
+    }
+
+    // Share the edge objects with the thresholded edges
+    m_lThresholdedEdges.clear();
+
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        if(m_vecEdgeActive.at(i)) {
+            m_lThresholdedEdges << m_lFullEdges.at(i);
+        }
+    }
+
+    m_bFullEdgesChanged = false;
+    m_bThresholdedEdgesChanged = false;
+}
+
+//=============================================================================================================
+
+void Network::updateThresholdedEdges() const
+{
+    if(!m_bThresholdedEdgesChanged) {
+        return;
+    }
+
+    m_lThresholdedEdges.clear();
+
+    // Only create the active edges, unless the full edge objects are available already
+    for(int i = 0; i < m_vecEdgeWeights.size(); ++i) {
+        if(m_vecEdgeActive.at(i)) {
+            m_lThresholdedEdges << (m_bFullEdgesChanged ? createEdge(i) : m_lFullEdges.at(i));
+        }
+    }
+
+    m_bThresholdedEdgesChanged = false;
+}
+
+//=============================================================================================================
+
+NetworkEdge::SPtr Network::createEdge(int i) const
+{
+    MatrixXd matWeight = Map<const VectorXd>(m_vecEdgeBinWeights.constData() + i * m_iNumberEdgeBins, m_iNumberEdgeBins);
+
+    NetworkEdge::SPtr pEdge = NetworkEdge::SPtr(new NetworkEdge(m_vecEdgeStartNodeIDs.at(i),
+                                                                m_vecEdgeEndNodeIDs.at(i),
+                                                                matWeight,
+                                                                m_vecEdgeActive.at(i),
+                                                                m_minMaxFreqBins.first,
+                                                                m_minMaxFreqBins.second));
+
+    // The averaged weight might have been normalized
+    pEdge->setWeight(m_vecEdgeWeights.at(i));
+
+    // Changes to the edge object would not reach the edge arrays
+    pEdge->setReadOnly(true);
+
+    return pEdge;
+}
+
+//=============================================================================================================
+
+void Network::appendEdge(int iStartNodeID,
+                         int iEndNodeID,
+                         const VectorXd& vecWeights,
+                         double dWeight)
+{
+    if(m_vecEdgeWeights.isEmpty()) {
+        m_iNumberEdgeBins = vecWeights.rows();
+    } else if(vecWeights.rows() != m_iNumberEdgeBins) {
+        qDebug() << "Network::appendEdge - Number of edge weights does not match the already stored edges. Zero padding or cutting weights.";
+    }
+
+    for(int i = 0; i < m_iNumberEdgeBins; ++i) {
+        m_vecEdgeBinWeights.append(i < vecWeights.rows() ? vecWeights(i) : 0.0);
+    }
+
+    if(dWeight < m_minMaxFullWeights.first) {
+        m_minMaxFullWeights.first = dWeight;
+    } else if(dWeight >= m_minMaxFullWeights.second) {
+        m_minMaxFullWeights.second = dWeight;
+    }
+
+    m_vecEdgeStartNodeIDs.append(iStartNodeID);
+    m_vecEdgeEndNodeIDs.append(iEndNodeID);
+    m_vecEdgeWeights.append(dWeight);
+    m_vecEdgeActive.append(fabs(dWeight) >= m_dThreshold);
+
+    m_bNodesChanged = true;
+}
+
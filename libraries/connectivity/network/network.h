@@ -46,6 +46,8 @@
 //=============================================================================================================
 
 #include <QSharedPointer>
+#include <QVector>
+#include <QMutex>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -80,6 +82,10 @@ struct VisualizationInfo {
 //=============================================================================================================
 /**
  * This class holds information (nodes and connecting edges) about a network, can compute a distance table and provide network metrics.
+ * The edges are stored in compact arrays (node ids, per bin weights, averaged weights and activity flags). NetworkEdge objects
+ * are only created on request, e.g. via getFullEdges(), getThresholdedEdges() or getNodes(). These edges are read only views
+ * of the arrays. They are shared between the network and its nodes and are kept in the upper-triangular, per start node
+ * order the edges were appended in.
  *
  * @brief This class holds information about a network, can compute a distance table and provide network metrics.
  */
@@ -127,27 +133,28 @@ public:
 
     //=========================================================================================================
     /**
-     * Returns the full and non thresholded edges.
+     * Returns the full and non thresholded edges. The list is copied while the edge cache is locked, so it stays
+     * valid if another thread makes the network recreate its edges.
      *
      * @return Returns the network edges.
      */
-    const QList<QSharedPointer<NetworkEdge> >& getFullEdges() const;
+    QList<QSharedPointer<NetworkEdge> > getFullEdges() const;
 
     //=========================================================================================================
     /**
-     * Returns the thresholded edges.
+     * Returns the thresholded edges. The list is copied while the edge cache is locked, see getFullEdges.
      *
      * @return Returns the network edges.
      */
-    const QList<QSharedPointer<NetworkEdge> >& getThresholdedEdges() const;
+    QList<QSharedPointer<NetworkEdge> > getThresholdedEdges() const;
 
     //=========================================================================================================
     /**
-     * Returns the nodes.
+     * Returns the nodes. The list is copied while the edge cache is locked, see getFullEdges.
      *
      * @return Returns the network nodes.
      */
-    const QList<QSharedPointer<NetworkNode> >& getNodes() const;
+    QList<QSharedPointer<NetworkNode> > getNodes() const;
 
     //=========================================================================================================
     /**
@@ -169,13 +176,53 @@ public:
      */
     QSharedPointer<NetworkNode> getNodeAt(int i);
 
+    //=========================================================================================================
+    /**
+     * Returns the number of edges of the full network.
+     *
+     * @return Returns the number of edges.
+     */
+    int getNumberEdges() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the degrees of all nodes corresponding to the full network.
+     *
+     * @return   The node degrees calculated as the number of edges connected to each node.
+     */
+    Eigen::VectorXi getFullDegrees() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the degrees of all nodes corresponding to the thresholded network.
+     *
+     * @return   The node degrees calculated as the number of active edges connected to each node.
+     */
+    Eigen::VectorXi getThresholdedDegrees() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the strengths of all nodes corresponding to the full network.
+     *
+     * @return   The node strengths calculated as the sum of all weights of all edges of each node.
+     */
+    Eigen::VectorXd getFullStrengths() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the strengths of all nodes corresponding to the thresholded network.
+     *
+     * @return   The node strengths calculated as the sum of all weights of all active edges of each node.
+     */
+    Eigen::VectorXd getThresholdedStrengths() const;
+
     //=========================================================================================================
     /**
      * Returns network distribution, also known as network degree, corresponding to the full network.
      *
      * @return   The network distribution calculated as degrees of all nodes together.
      */
-    qint16 getFullDistribution() const;
+    int getFullDistribution() const;
 
     //=========================================================================================================
     /**
@@ -183,7 +230,7 @@ public:
      *
      * @return   The network distribution calculated as degrees of all nodes together.
      */
-    qint16 getThresholdedDistribution() const;
+    int getThresholdedDistribution() const;
 
     //=========================================================================================================
     /**
@@ -306,6 +353,18 @@ public:
      */
     void append(QSharedPointer<NetworkEdge> newEdge);
 
+    //=========================================================================================================
+    /**
+     * Appends the network edges from one start node to multiple end nodes. Edges connecting a node with itself are skipped.
+     *
+     * @param[in] iStartNodeID       The start node id of all edges.
+     * @param[in] vecEndNodeIDs      The end node ids of the edges.
+     * @param[in] matWeights         The edge weights. Column i holds the weights (e.g. per frequency bin) of the edge to vecEndNodeIDs(i).
+     */
+    void append(int iStartNodeID,
+                const Eigen::VectorXi& vecEndNodeIDs,
+                const Eigen::MatrixXd& matWeights);
+
     //=========================================================================================================
     /**
      * Appends a network edge to this network node.
@@ -393,8 +452,81 @@ public:
     int getFFTSize();
 
 protected:
-    QList<QSharedPointer<NetworkEdge> >     m_lFullEdges;               /**< List with all edges of the network.*/
-    QList<QSharedPointer<NetworkEdge> >     m_lThresholdedEdges;        /**< List with all the active (thresholded) edges of the network.*/
+    //=========================================================================================================
+    /**
+     * Computes the in/out degrees and strengths of all nodes from the edge arrays.
+     *
+     * @param[in] bThresholded           Whether to only take the active edges into account.
+     * @param[out] vecIndegrees          The indegrees.
+     * @param[out] vecOutdegrees         The outdegrees.
+     * @param[out] vecInstrengths        The instrengths.
+     * @param[out] vecOutstrengths       The outstrengths.
+     */
+    void computeNodeMetrics(bool bThresholded,
+                            Eigen::VectorXi& vecIndegrees,
+                            Eigen::VectorXi& vecOutdegrees,
+                            Eigen::VectorXd& vecInstrengths,
+                            Eigen::VectorXd& vecOutstrengths) const;
+
+    //=========================================================================================================
+    /**
+     * Updates the degrees, strengths and edges of the nodes, if the edges changed since the last update.
+     * The caller must hold m_pCacheMutex.
+     */
+    void updateNodes() const;
+
+    //=========================================================================================================
+    /**
+     * Creates the full edge objects, if the edges changed since they were last created.
+     * The caller must hold m_pCacheMutex.
+     */
+    void updateFullEdges() const;
+
+    //=========================================================================================================
+    /**
+     * Creates the thresholded edge objects, if the edges changed since they were last created.
+     * The caller must hold m_pCacheMutex.
+     */
+    void updateThresholdedEdges() const;
+
+    //=========================================================================================================
+    /**
+     * Creates a read only edge object out of the edge arrays.
+     *
+     * @param[in] i      The index of the edge in the edge arrays.
+     *
+     * @return Returns the network edge.
+     */
+    QSharedPointer<NetworkEdge> createEdge(int i) const;
+
+    //=========================================================================================================
+    /**
+     * Appends a single edge to the edge arrays.
+     *
+     * @param[in] iStartNodeID       The start node id.
+     * @param[in] iEndNodeID         The end node id.
+     * @param[in] vecWeights         The non averaged edge weights.
+     * @param[in] dWeight            The averaged edge weight.
+     */
+    void appendEdge(int iStartNodeID,
+                    int iEndNodeID,
+                    const Eigen::VectorXd& vecWeights,
+                    double dWeight);
+
+    QVector<int>                                    m_vecEdgeStartNodeIDs;      /**< The start node ids of all edges.*/
+    QVector<int>                                    m_vecEdgeEndNodeIDs;        /**< The end node ids of all edges.*/
+    QVector<double>                                 m_vecEdgeBinWeights;        /**< The non averaged weights of all edges. m_iNumberEdgeBins consecutive values belong to one edge.*/
+    QVector<double>                                 m_vecEdgeWeights;           /**< The averaged weights of all edges.*/
+    QVector<bool>                                   m_vecEdgeActive;            /**< The activity flags of all edges indicating whether an edge is part of the thresholded network.*/
+    int                                             m_iNumberEdgeBins;          /**< The number of non averaged weights (e.g. frequency bins) per edge.*/
+    QPair<int,int>                                  m_minMaxFreqBins;           /**< The lower/upper bin indeces to average from/to. Default is -1 which means an average over all weights.*/
+
+    mutable QList<QSharedPointer<NetworkEdge> >     m_lFullEdges;               /**< List with all edges of the network. Created on request.*/
+    mutable QList<QSharedPointer<NetworkEdge> >     m_lThresholdedEdges;        /**< List with all the active (thresholded) edges of the network. Created on request.*/
+    mutable bool                                    m_bFullEdgesChanged;        /**< Whether the edge arrays changed since the full edge objects were created.*/
+    mutable bool                                    m_bThresholdedEdgesChanged; /**< Whether the edge arrays changed since the thresholded edge objects were created.*/
+    mutable bool                                    m_bNodesChanged;            /**< Whether the edge arrays changed since the nodes were updated.*/
+    QSharedPointer<QMutex>                          m_pCacheMutex;              /**< Guards the edge objects and node updates created on request by the const getters. Shared by copies of this network, since they share the nodes.*/
 
     QList<QSharedPointer<NetworkNode> >     m_lNodes;                   /**< List with all nodes of the network.*/
 
@@ -74,6 +74,7 @@ NetworkEdge::NetworkEdge(int iStartNodeID,
 : m_iStartNodeID(iStartNodeID)
 , m_iEndNodeID(iEndNodeID)
 , m_bIsActive(bIsActive)
+, m_bIsReadOnly(false)
 , m_iMinMaxFreqBins(QPair<int,int>(iStartWeightBin,iEndWeightBin))
 , m_dAveragedWeight(0.0)
 {
@@ -105,6 +106,11 @@ int NetworkEdge::getEndNodeID()
 
 void NetworkEdge::setActive(bool bActiveFlag)
 {
+    if(m_bIsReadOnly) {
+        qDebug() << "NetworkEdge::setActive - Edge is read only. Use Network::setThreshold instead. Returning.";
+        return;
+    }
+
     m_bIsActive = bActiveFlag;
 }
 
@@ -133,6 +139,11 @@ MatrixXd NetworkEdge::getMatrixWeight() const
 
 void NetworkEdge::setWeight(double dAveragedWeight)
 {
+    if(m_bIsReadOnly) {
+        qDebug() << "NetworkEdge::setWeight - Edge is read only. Returning.";
+        return;
+    }
+
     m_dAveragedWeight = dAveragedWeight;
 }
 
@@ -140,6 +151,11 @@ void NetworkEdge::setWeight(double dAveragedWeight)
 
 void NetworkEdge::calculateAveragedWeight()
 {
+    if(m_bIsReadOnly) {
+        qDebug() << "NetworkEdge::calculateAveragedWeight - Edge is read only. Use Network::setFrequencyRange instead. Returning.";
+        return;
+    }
+
     int iStartWeightBin = m_iMinMaxFreqBins.first;
     int iEndWeightBin = m_iMinMaxFreqBins.second;
 
@@ -164,6 +180,11 @@ void NetworkEdge::calculateAveragedWeight()
 
 void NetworkEdge::setFrequencyBins(const QPair<int,int>& minMaxFreqBins)
 {
+    if(m_bIsReadOnly) {
+        qDebug() << "NetworkEdge::setFrequencyBins - Edge is read only. Use Network::setFrequencyRange instead. Returning.";
+        return;
+    }
+
     m_iMinMaxFreqBins = minMaxFreqBins;
 
     if(m_iMinMaxFreqBins.second < m_iMinMaxFreqBins.first || m_iMinMaxFreqBins.first < -1 || m_iMinMaxFreqBins.second < -1 ) {
@@ -180,3 +201,16 @@ const QPair<int,int>& NetworkEdge::getFrequencyBins()
     return m_iMinMaxFreqBins;
 }
 
+//=============================================================================================================
+
+void NetworkEdge::setReadOnly(bool bReadOnly)
+{
+    m_bIsReadOnly = bReadOnly;
+}
+
+//=============================================================================================================
+
+bool NetworkEdge::isReadOnly() const
+{
+    return m_bIsReadOnly;
+}
@@ -179,11 +179,30 @@ public:
      */
     const QPair<int,int>& getFrequencyBins();
 
+    //=========================================================================================================
+    /**
+     * Sets whether this edge is read only. The edges created by a Network from its edge arrays are read only,
+     * since changes to them would not reach the network. Use Network::setThreshold(), Network::setFrequencyRange()
+     * or Network::normalize() instead.
+     *
+     * @param[in] bReadOnly        The new read only flag.
+     */
+    void setReadOnly(bool bReadOnly);
+
+    //=========================================================================================================
+    /**
+     * Returns whether this edge is read only.
+     *
+     * @return Whether this edge is read only.
+     */
+    bool isReadOnly() const;
+
 protected:
     int             m_iStartNodeID;         /**< The start node of the edge.*/
     int             m_iEndNodeID;           /**< The end node of the edge.*/
 
     bool            m_bIsActive;            /**< The activity flag indicating whether this edge is part of a thresholded network.*/
+    bool            m_bIsReadOnly;          /**< Whether the activity flag and the weights of this edge can be changed.*/
 
     QPair<int,int>  m_iMinMaxFreqBins;      /**< The lower/upper bin indeces to start avergaing from/to. Default is -1 which means an average over all weights.*/
 
@@ -66,6 +66,14 @@ using namespace Eigen;
 NetworkNode::NetworkNode(qint16 iId, const RowVectorXf& vecVert)
 : m_bIsHub(false)
 , m_iId(iId)
+, m_iFullIndegree(0)
+, m_iFullOutdegree(0)
+, m_iThresholdedIndegree(0)
+, m_iThresholdedOutdegree(0)
+, m_dFullInstrength(0.0)
+, m_dFullOutstrength(0.0)
+, m_dThresholdedInstrength(0.0)
+, m_dThresholdedOutstrength(0.0)
 , m_vecVert(vecVert)
 {
 }
@@ -168,172 +176,86 @@ qint16 NetworkNode::getId() const
 
 //=============================================================================================================
 
-qint16 NetworkNode::getFullDegree() const
+int NetworkNode::getFullDegree() const
 {
-    return m_lEdges.size();
+    return m_iFullIndegree + m_iFullOutdegree;
 }
 
 //=============================================================================================================
 
-qint16 NetworkNode::getThresholdedDegree() const
+int NetworkNode::getThresholdedDegree() const
 {
-    qint16 degree = 0;
-
-    for(int i = 0; i < m_lEdges.size(); i++) {
-        if(m_lEdges.at(i)->isActive()) {
-            degree++;
-        }
-    }
-
-    return degree;
+    return m_iThresholdedIndegree + m_iThresholdedOutdegree;
 }
 
 //=============================================================================================================
 
-qint16 NetworkNode::getFullIndegree() const
+int NetworkNode::getFullIndegree() const
 {
-    qint16 degree = 0;
-
-    for(int i = 0; i< m_lEdges.size(); i++) {
-        if(m_lEdges.at(i)->getEndNodeID() == this->getId()) {
-            degree++;
-        }
-    }
-
-    return degree;
+    return m_iFullIndegree;
 }
 
 //=============================================================================================================
 
-qint16 NetworkNode::getThresholdedIndegree() const
+int NetworkNode::getThresholdedIndegree() const
 {
-    qint16 degree = 0;
-
-    for(int i = 0; i< m_lEdges.size(); i++) {
-        if(m_lEdges.at(i)->isActive() && m_lEdges.at(i)->getEndNodeID() == this->getId()) {
-            degree++;
-        }
-    }
-
-    return degree;
+    return m_iThresholdedIndegree;
 }
 
 //=============================================================================================================
 
-qint16 NetworkNode::getFullOutdegree() const
+int NetworkNode::getFullOutdegree() const
 {
-    qint16 degree = 0;
-
-    for(int i = 0; i< m_lEdges.size(); i++) {
-        if(m_lEdges.at(i)->getStartNodeID() == this->getId()) {
-            degree++;
-        }
-    }
-
-    return degree;
+    return m_iFullOutdegree;
 }
 
 //=============================================================================================================
 
-qint16 NetworkNode::getThresholdedOutdegree() const
+int NetworkNode::getThresholdedOutdegree() const
 {
-    qint16 degree = 0;
-
-    for(int i = 0; i< m_lEdges.size(); i++) {
-        if(m_lEdges.at(i)->isActive() && m_lEdges.at(i)->getStartNodeID() == this->getId()) {
-            degree++;
-        }
-    }
-
-    return degree;
+    return m_iThresholdedOutdegree;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getFullStrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        dStrength += m_lEdges.at(i)->getWeight();
-    }
-
-    return dStrength;
+    return m_dFullInstrength + m_dFullOutstrength;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getThresholdedStrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        if(m_lEdges.at(i)->isActive()) {
-            dStrength += m_lEdges.at(i)->getWeight();
-        }
-    }
-
-    return dStrength;
+    return m_dThresholdedInstrength + m_dThresholdedOutstrength;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getFullInstrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        if(m_lEdges.at(i)->getEndNodeID() == this->getId()) {
-            dStrength += m_lEdges.at(i)->getWeight();
-        }
-    }
-
-    return dStrength;
+    return m_dFullInstrength;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getThresholdedInstrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        if(m_lEdges.at(i)->isActive() && m_lEdges.at(i)->getEndNodeID() == this->getId()) {
-            dStrength += m_lEdges.at(i)->getWeight();
-        }
-    }
-
-    return dStrength;
+    return m_dThresholdedInstrength;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getFullOutstrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        if(m_lEdges.at(i)->getStartNodeID() == this->getId()) {
-            dStrength += m_lEdges.at(i)->getWeight();
-        }
-    }
-
-    return dStrength;
+    return m_dFullOutstrength;
 }
 
 //=============================================================================================================
 
 double NetworkNode::getThresholdedOutstrength() const
 {
-    double dStrength = 0.0;
-
-    for(int i = 0; i < m_lEdges.size(); ++i) {
-        if(m_lEdges.at(i)->isActive() && m_lEdges.at(i)->getStartNodeID() == this->getId()) {
-            dStrength += m_lEdges.at(i)->getWeight();
-        }
-    }
-
-    return dStrength;
+    return m_dThresholdedOutstrength;
 }
 
 //=============================================================================================================
@@ -352,10 +274,63 @@ bool NetworkNode::getHubStatus() const
 
 //=============================================================================================================
 
+void NetworkNode::setDegrees(int iFullIndegree,
+                             int iFullOutdegree,
+                             int iThresholdedIndegree,
+                             int iThresholdedOutdegree)
+{
+    m_iFullIndegree = iFullIndegree;
+    m_iFullOutdegree = iFullOutdegree;
+    m_iThresholdedIndegree = iThresholdedIndegree;
+    m_iThresholdedOutdegree = iThresholdedOutdegree;
+}
+
+//=============================================================================================================
+
+void NetworkNode::setStrengths(double dFullInstrength,
+                               double dFullOutstrength,
+                               double dThresholdedInstrength,
+                               double dThresholdedOutstrength)
+{
+    m_dFullInstrength = dFullInstrength;
+    m_dFullOutstrength = dFullOutstrength;
+    m_dThresholdedInstrength = dThresholdedInstrength;
+    m_dThresholdedOutstrength = dThresholdedOutstrength;
+}
+
+//=============================================================================================================
+
+void NetworkNode::setEdges(const QList<QSharedPointer<NetworkEdge> >& lEdges)
+{
+    m_lEdges = lEdges;
+}
+
+//=============================================================================================================
+
 void NetworkNode::append(QSharedPointer<NetworkEdge> newEdge)
 {
     if(newEdge->getEndNodeID() != newEdge->getStartNodeID()) {
         m_lEdges << newEdge;
+
+        if(newEdge->getEndNodeID() == m_iId) {
+            m_iFullIndegree++;
+            m_dFullInstrength += newEdge->getWeight();
+
+            if(newEdge->isActive()) {
+                m_iThresholdedIndegree++;
+                m_dThresholdedInstrength += newEdge->getWeight();
+            }
+        }
+
+        if(newEdge->getStartNodeID() == m_iId) {
+            m_iFullOutdegree++;
+            m_dFullOutstrength += newEdge->getWeight();
+
+            if(newEdge->isActive()) {
+                m_iThresholdedOutdegree++;
+                m_dThresholdedOutstrength += newEdge->getWeight();
+            }
+        }
     }
 }
 
@@ -164,7 +164,7 @@ public:
      *
      * @return   The node degree calculated as the number of edges connected to a node (undirected gaph).
      */
-    qint16 getFullDegree() const;
+    int getFullDegree() const;
 
     //=========================================================================================================
     /**
@@ -172,7 +172,7 @@ public:
      *
      * @return   The node degree calculated as the number of edges connected to a node (undirected gaph).
      */
-    qint16 getThresholdedDegree() const;
+    int getThresholdedDegree() const;
 
     //=========================================================================================================
     /**
@@ -180,7 +180,7 @@ public:
      *
      * @return   The node degree calculated as the number of incoming edges (only in directed graphs).
      */
-    qint16 getFullIndegree() const;
+    int getFullIndegree() const;
 
     //=========================================================================================================
     /**
@@ -188,7 +188,7 @@ public:
      *
      * @return   The node degree calculated as the number of incoming edges (only in directed graphs).
      */
-    qint16 getThresholdedIndegree() const;
+    int getThresholdedIndegree() const;
 
     //=========================================================================================================
     /**
@@ -196,7 +196,7 @@ public:
      *
      * @return   The node degree calculated as the number of outgoing edges (only in directed graphs).
      */
-    qint16 getFullOutdegree() const;
+    int getFullOutdegree() const;
 
     //=========================================================================================================
     /**
@@ -204,7 +204,7 @@ public:
      *
      * @return   The node degree calculated as the number of outgoing edges (only in directed graphs).
      */
-    qint16 getThresholdedOutdegree() const;
+    int getThresholdedOutdegree() const;
 
     //=========================================================================================================
     /**
@@ -270,6 +270,43 @@ public:
      */
     bool getHubStatus() const;
 
+    //=========================================================================================================
+    /**
+     * Sets the node degrees. This is used by the Network to update its nodes from the network wide edge arrays.
+     *
+     * @param[in] iFullIndegree              The indegree corresponding to the full network.
+     * @param[in] iFullOutdegree             The outdegree corresponding to the full network.
+     * @param[in] iThresholdedIndegree       The indegree corresponding to the thresholded network.
+     * @param[in] iThresholdedOutdegree      The outdegree corresponding to the thresholded network.
+     */
+    void setDegrees(int iFullIndegree,
+                    int iFullOutdegree,
+                    int iThresholdedIndegree,
+                    int iThresholdedOutdegree);
+
+    //=========================================================================================================
+    /**
+     * Sets the node strengths. This is used by the Network to update its nodes from the network wide edge arrays.
+     *
+     * @param[in] dFullInstrength            The instrength corresponding to the full network.
+     * @param[in] dFullOutstrength           The outstrength corresponding to the full network.
+     * @param[in] dThresholdedInstrength     The instrength corresponding to the thresholded network.
+     * @param[in] dThresholdedOutstrength    The outstrength corresponding to the thresholded network.
+     */
+    void setStrengths(double dFullInstrength,
+                      double dFullOutstrength,
+                      double dThresholdedInstrength,
+                      double dThresholdedOutstrength);
+
+    //=========================================================================================================
+    /**
+     * Sets the edges of this node. This is used by the Network to attach the edges created from its edge arrays.
+     * Other than append(), this does not change the node degrees and strengths.
+     *
+     * @param[in] lEdges     The edges connected to this node.
+     */
+    void setEdges(const QList<QSharedPointer<NetworkEdge> >& lEdges);
+
     //=========================================================================================================
     /**
      * Appends a network edge to this network node. Automatically decides whether to add to the in or out edges.
@@ -279,13 +316,23 @@ public:
     void append(QSharedPointer<NetworkEdge> newEdge);
 
 protected:
-    bool                                    m_bIsHub;       /**< Whether this node is a hub.*/
+    bool                                    m_bIsHub;                   /**< Whether this node is a hub.*/
+
+    qint16                                  m_iId;                      /**< The node's ID.*/
+
+    int                                     m_iFullIndegree;            /**< The indegree corresponding to the full network.*/
+    int                                     m_iFullOutdegree;           /**< The outdegree corresponding to the full network.*/
+    int                                     m_iThresholdedIndegree;     /**< The indegree corresponding to the thresholded network.*/
+    int                                     m_iThresholdedOutdegree;    /**< The outdegree corresponding to the thresholded network.*/
 
-    qint16                                  m_iId;          /**< The node's ID.*/
+    double                                  m_dFullInstrength;          /**< The instrength corresponding to the full network.*/
+    double                                  m_dFullOutstrength;         /**< The outstrength corresponding to the full network.*/
+    double                                  m_dThresholdedInstrength;   /**< The instrength corresponding to the thresholded network.*/
+    double                                  m_dThresholdedOutstrength;  /**< The outstrength corresponding to the thresholded network.*/
 
-    Eigen::RowVectorXf                      m_vecVert;      /**< The 3D position of the node.*/
+    Eigen::RowVectorXf                      m_vecVert;                  /**< The 3D position of the node.*/
 
-    QList<QSharedPointer<NetworkEdge> >     m_lEdges;     /**< List with all incoming edges of the node.*/
+    QList<QSharedPointer<NetworkEdge> >     m_lEdges;                   /**< List with all incoming edges of the node.*/
 };
 
 //=============================================================================================================
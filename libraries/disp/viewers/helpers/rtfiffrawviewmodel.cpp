@@ -314,15 +314,13 @@ void RtFiffRawViewModel::setFiffInfo(QSharedPointer<FIFFLIB::FiffInfo> &p_pFiffI
 
         m_matOverlap.conservativeResize(m_pFiffInfo->chs.size(), m_iMaxFilterLength);
 
-        m_matSparseProjMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
-        m_matSparseCompMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
         m_matSparseSpharaMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
-        m_matSparseProjCompMult = SparseMatrix<double>(m_pFiffInfo->chs.size(),m_pFiffInfo->chs.size());
-
-        m_matSparseProjMult.setIdentity();
-        m_matSparseCompMult.setIdentity();
         m_matSparseSpharaMult.setIdentity();
-        m_matSparseProjCompMult.setIdentity();
+
+        m_projOperator.clear();
+
+        //The carried trigger channel state belongs to the old channel layout
+        m_triggerDetector.reset();
 
         //Create the initial Compensator projector
         updateCompensator(0);
@@ -353,8 +351,8 @@ void RtFiffRawViewModel::setFiffInfo(QSharedPointer<FIFFLIB::FiffInfo> &p_pFiffI
         initSphara();
     } else {
         m_vecBadIdcs = RowVectorXi(0,0);
-        m_matProj = MatrixXd(0,0);
-        m_matComp = MatrixXd(0,0);
+        m_projOperator.clear();
+        m_triggerDetector.reset();
     }
 }
 
@@ -404,10 +402,10 @@ MatrixXd RtFiffRawViewModel::getLastBlock()
 void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
 {
     //SSP
-    bool doProj = m_bProjActivated && m_matDataRaw.cols() > 0 && m_matDataRaw.rows() == m_matProj.cols() ? true : false;
+    bool doProj = m_bProjActivated && m_matDataRaw.cols() > 0 && m_matDataRaw.rows() == m_projOperator.getNumChannels() ? true : false;
 
     //Compensator
-    bool doComp = m_bCompActivated && m_matDataRaw.cols() > 0 && m_matDataRaw.rows() == m_matComp.cols() ? true : false;
+    bool doComp = m_bCompActivated && m_matDataRaw.cols() > 0 && m_matDataRaw.rows() == m_projOperator.getNumChannels() ? true : false;
 
     //SPHARA
     bool doSphara = m_bSpharaActivated && m_matSparseSpharaMult.cols() > 0 && m_matDataRaw.rows() == m_matSparseSpharaMult.cols() ? true : false;
@@ -435,23 +433,12 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
 //            std::cout<<"m_matDataRaw.cols(): "<<m_matDataRaw.cols()<<std::endl;
 //            std::cout<<"nCol-m_iResidual: "<<nCol-m_iResidual<<std::endl<<std::endl;
 
-            if(doComp) {
-                if(doProj) {
-                    //Comp + Proj
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjCompMult * data.at(b).block(0,0,nRow,m_iResidual);
-                } else {
-                    //Comp
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseCompMult * data.at(b).block(0,0,nRow,m_iResidual);
-                }
+            if(doComp || doProj) {
+                //Comp and/or Proj
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_projOperator.apply(data.at(b).block(0,0,nRow,m_iResidual), doProj, doComp);
             } else {
-                if(doProj)
-                {
-                    //Proj
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjMult * data.at(b).block(0,0,nRow,m_iResidual);
-                } else {
-                    //None - Raw
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = data.at(b).block(0,0,nRow,m_iResidual);
-                }
+                //None - Raw
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = data.at(b).block(0,0,nRow,m_iResidual);
             }
 
             m_iCurrentSample = 0;
@@ -478,22 +465,12 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
 
         //std::cout<<"incoming data is ok"<<std::endl;
 
-        if(doComp) {
-            if(doProj) {
-                //Comp + Proj
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjCompMult * data.at(b);
-            } else {
-                //Comp
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseCompMult * data.at(b);
-            }
+        if(doComp || doProj) {
+            //Comp and/or Proj
+            m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_projOperator.apply(data.at(b), doProj, doComp);
         } else {
-            if(doProj) {
-                //Proj
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjMult * data.at(b);
-            } else {
-                //None - Raw
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = data.at(b);
-            }
+            //None - Raw
+            m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = data.at(b);
         }
 
         //Filter if neccessary else set filtered data matrix to zero
@@ -529,11 +506,18 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
         if(m_bTriggerDetectionActive) {
             int iOldDetectedTriggers = m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].size();
 
-            QList<QPair<int,double> > qMapDetectedTrigger = DetectTrigger::detectTriggerFlanksMax(data.at(b), m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, true, 500);
-            //QList<QPair<int,double> > qMapDetectedTrigger = DetectTrigger::detectTriggerFlanksGrad(data.at(b), m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, false, "Rising");
+            if(m_triggerDetector.getTriggerChannels().size() != 1 || m_triggerDetector.getTriggerChannels().first() != m_iCurrentTriggerChIndex) {
+                m_triggerDetector.setTriggerChannels(QList<int>() << m_iCurrentTriggerChIndex, m_dTriggerThreshold, "Rising", 500);
+            }
+
+            m_triggerDetector.detectTriggerFlanks(data.at(b), m_iCurrentSample-nCol);
 
             //Append results to already found triggers
-            m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].append(qMapDetectedTrigger);
+            const QVector<TriggerEvent>& vecTriggerEvents = m_triggerDetector.getTriggerEvents();
+
+            for(int i = 0; i < vecTriggerEvents.size(); ++i) {
+                m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].append(qMakePair(vecTriggerEvents.at(i).iSample, vecTriggerEvents.at(i).dValue));
+            }
 
             //Compute newly counted triggers
             int newTriggers = m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].size() - iOldDetectedTriggers;
@@ -691,46 +675,10 @@ void RtFiffRawViewModel::updateProjection(const QList<FIFFLIB::FiffProj>& projs)
             }
         }
 
-        this->m_pFiffInfo->make_projector(m_matProj);
-
-        qDebug() << "RtFiffRawViewModel::updateProjection - New projection calculated.";
-
-        //set columns of matrix to zero depending on bad channels indexes
-        for(qint32 j = 0; j < m_vecBadIdcs.cols(); ++j) {
-            m_matProj.col(m_vecBadIdcs[j]).setZero();
-        }
-
-//        std::cout << "Bads\n" << m_vecBadIdcs << std::endl;
-//        std::cout << "Proj\n";
-//        std::cout << m_matProj.block(0,0,10,10) << std::endl;
-
-        //
-        // Make proj sparse
-        //
-        qint32 nchan = this->m_pFiffInfo->nchan;
-        qint32 i, k;
-
-        typedef Eigen::Triplet<double> T;
-        std::vector<T> tripletList;
-        tripletList.reserve(nchan);
-
-        tripletList.clear();
-        tripletList.reserve(m_matProj.rows()*m_matProj.cols());
-        for(i = 0; i < m_matProj.rows(); ++i) {
-            for(k = 0; k < m_matProj.cols(); ++k) {
-                if(m_matProj(i,k) != 0) {
-                    tripletList.push_back(T(i, k, m_matProj(i,k)));
-                }
-            }
-        }
-
-        m_matSparseProjMult = SparseMatrix<double>(m_matProj.rows(),m_matProj.cols());
-        if(tripletList.size() > 0) {
-            m_matSparseProjMult.setFromTriplets(tripletList.begin(), tripletList.end());
+        //The operator is only rebuilt if the active projectors or the bad channels changed
+        if(m_projOperator.updateProjection(m_pFiffInfo->projs, m_pFiffInfo->ch_names, m_pFiffInfo->bads)) {
+            qDebug() << "RtFiffRawViewModel::updateProjection - New projection calculated.";
         }
-
-        //Create full multiplication matrix
-        m_matSparseProjCompMult = m_matSparseProjMult * m_matSparseCompMult;
     }
 }
 
@@ -750,41 +698,11 @@ void RtFiffRawViewModel::updateCompensator(int to)
 //        qDebug()<<"from"<<from;
 //        qDebug()<<"m_bCompActivated"<<m_bCompActivated;
 
-        FiffCtfComp newComp;
-        this->m_pFiffInfo->make_compensator(0, to, newComp);//Do this always from 0 since we always read new raw data, we never actually perform a multiplication on already existing data
-
+        //Do this always from 0 since we always read new raw data, we never actually perform a multiplication on already existing data
         //We do not need to call this->m_pFiffInfo->set_current_comp(to);
         //Because we will set the compensators to the coil in the same FiffInfo which is already used to write to file.
         //Note that the data is written in raw form not in compensated form.
-        m_matComp = newComp.data->data;
-
-        //
-        // Make proj sparse
-        //
-        qint32 nchan = this->m_pFiffInfo->nchan;
-        qint32 i, k;
-
-        typedef Eigen::Triplet<double> T;
-        std::vector<T> tripletList;
-        tripletList.reserve(nchan);
-
-        tripletList.clear();
-        tripletList.reserve(m_matComp.rows()*m_matComp.cols());
-        for(i = 0; i < m_matComp.rows(); ++i) {
-            for(k = 0; k < m_matComp.cols(); ++k) {
-                if(m_matComp(i,k) != 0) {
-                    tripletList.push_back(T(i, k, m_matComp(i,k)));
-                }
-            }
-        }
-
-        m_matSparseCompMult = SparseMatrix<double>(m_matComp.rows(),m_matComp.cols());
-        if(tripletList.size() > 0) {
-            m_matSparseCompMult.setFromTriplets(tripletList.begin(), tripletList.end());
-        }
-
-        //Create full multiplication matrix
-        m_matSparseProjCompMult = m_matSparseProjMult * m_matSparseCompMult;
+        m_projOperator.updateCompensator(*m_pFiffInfo, to);
     }
 }
 
@@ -1042,6 +960,8 @@ void RtFiffRawViewModel::triggerInfoChanged(const QMap<double, QColor>& colorMap
     }
 
     m_sCurrentTriggerCh = triggerCh;
+
+    m_triggerDetector.setTriggerChannels(QList<int>() << m_iCurrentTriggerChIndex, m_dTriggerThreshold, "Rising", 500);
 }
 
 //=============================================================================================================
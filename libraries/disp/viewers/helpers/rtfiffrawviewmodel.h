@@ -44,7 +44,9 @@
 
 #include <fiff/fiff_types.h>
 #include <fiff/fiff_proj.h>
+#include <fiff/fiff_proj_operator.h>
 #include <utils/filterTools/filterdata.h>
+#include <utils/detecttrigger.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -578,12 +580,8 @@ private:
     Eigen::VectorXi                     m_vecIndicesFirstEEG;                       /**< The indices of the channels to pick for the second SPHARA operator in case of an EEG system.*/
 
     Eigen::SparseMatrix<double>         m_matSparseSpharaMult;                      /**< The final sparse SPHARA operator .*/
-    Eigen::SparseMatrix<double>         m_matSparseProjCompMult;                    /**< The final sparse projection + compensator operator.*/
-    Eigen::SparseMatrix<double>         m_matSparseProjMult;                        /**< The final sparse SSP projector */
-    Eigen::SparseMatrix<double>         m_matSparseCompMult;                        /**< The final sparse compensator matrix */
 
-    Eigen::MatrixXd                     m_matProj;                                  /**< SSP projector */
-    Eigen::MatrixXd                     m_matComp;                                  /**< Compensator */
+    FIFFLIB::FiffProjOperator           m_projOperator;                             /**< The cached SSP projector and compensator */
 
     Eigen::MatrixXd                     m_matSpharaVVGradLoaded;                    /**< The loaded VectorView gradiometer basis functions.*/
     Eigen::MatrixXd                     m_matSpharaVVMagLoaded;                     /**< The loaded VectorView magnetometer basis functions.*/
@@ -593,6 +591,7 @@ private:
 
     QMap<double, QColor>                m_qMapTriggerColor;                         /**< Current colors for all trigger channels. */
     QMap<int,QList<QPair<int,double> > >m_qMapDetectedTrigger;                      /**< Detected trigger for each trigger channel. */
+    UTILSLIB::DetectTrigger             m_triggerDetector;                          /**< Detects the trigger flanks and carries the trigger channel state over block boundaries. */
     QList<int>                          m_lTriggerChannelIndices;                   /**< List of all trigger channel indices. */
     QMap<int,QList<QPair<int,double> > >m_qMapDetectedTriggerFreeze;                /**< Detected trigger for each trigger channel while display is freezed. */
     QMap<int,QList<QPair<int,double> > >m_qMapDetectedTriggerOld;                   /**< Old detected trigger for each trigger channel. */
@@ -283,7 +283,7 @@ void NetworkTreeItem::plotNodes(const Network& tNetworkData)
     QVector<QMatrix4x4> vTransforms;
     QVector<QColor> vColorsNodes;
     QVector3D tempPos;
-    qint16 iDegree = 0;
+    int iDegree = 0;
 
     for(int i = 0; i < lNetworkNodes.size(); ++i) {
         iDegree = lNetworkNodes.at(i)->getThresholdedDegree();
@@ -52,6 +52,7 @@
 #include "fiff_tag.h"
 #include "fiff_types.h"
 #include "fiff_proj.h"
+#include "fiff_proj_operator.h"
 #include "fiff_ctf_comp.h"
 #include "fiff_info.h"
 #include "fiff_raw_data.h"
@@ -74,6 +74,7 @@ SOURCES += fiff.cpp \
     fiff_coord_trans.cpp \
     fiff_ch_info.cpp \
     fiff_proj.cpp \
+    fiff_proj_operator.cpp \
     fiff_named_matrix.cpp \
     fiff_raw_data.cpp \
     fiff_ctf_comp.cpp \
@@ -107,6 +108,7 @@ HEADERS += fiff.h \
     fiff_coord_trans.h \
     fiff_ch_info.h \
     fiff_proj.h \
+    fiff_proj_operator.h \
     fiff_named_matrix.h \
     fiff_ctf_comp.h \
     fiff_info.h \
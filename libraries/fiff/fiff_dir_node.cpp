@@ -45,6 +45,12 @@
 //#include "fiff_proj.h"
 //#include "fiff_info.h"
 
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <algorithm>
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -59,6 +65,9 @@ FiffDirNode::FiffDirNode()
 : type(-1)
 , nent_tree(-1)
 , parent(NULL)
+, m_iNumIndexedEntries(-1)
+, m_iPreOrder(-1)
+, m_iLastPreOrder(-1)
 {
 }
 
@@ -72,6 +81,11 @@ FiffDirNode::FiffDirNode(const FiffDirNode* p_FiffDirTree)
 , nent_tree(p_FiffDirTree->nent_tree)
 , parent(p_FiffDirTree->parent)
 , children(p_FiffDirTree->children)
+, m_qHashTagIndex(p_FiffDirTree->m_qHashTagIndex)
+, m_iNumIndexedEntries(p_FiffDirTree->m_iNumIndexedEntries)
+, m_iPreOrder(p_FiffDirTree->m_iPreOrder)
+, m_iLastPreOrder(p_FiffDirTree->m_iLastPreOrder)
+, m_pBlockIndex(p_FiffDirTree->m_pBlockIndex)
 {
 }
 
@@ -173,9 +187,58 @@ bool FiffDirNode::copy_tree(FiffStream::SPtr& p_pStreamIn, const FiffId& in_id,
 
 //=============================================================================================================
 
+void FiffDirNode::make_index(const FiffDirNode::SPtr& p_pRoot)
+{
+    if(!p_pRoot)
+        return;
+
+    QSharedPointer<BlockIndex> pBlockIndex(new BlockIndex);
+    qint32 iPreOrder = 0;
+    make_index(p_pRoot, pBlockIndex, iPreOrder);
+}
+
+//=============================================================================================================
+
+void FiffDirNode::make_index(const FiffDirNode::SPtr& p_pNode,
+                             const QSharedPointer<BlockIndex>& p_pBlockIndex,
+                             qint32& p_iPreOrder)
+{
+    p_pNode->m_qHashTagIndex.clear();
+    p_pNode->m_qHashTagIndex.reserve(p_pNode->dir.size());
+    for(qint32 p = p_pNode->dir.size() - 1; p >= 0; --p)
+        p_pNode->m_qHashTagIndex.insert(p_pNode->dir[p]->kind, p);
+    p_pNode->m_iNumIndexedEntries = p_pNode->dir.size();
+
+    BlockIndexEntry entry;
+    entry.iPreOrder = p_iPreOrder;
+    entry.pNode = p_pNode;
+    (*p_pBlockIndex)[p_pNode->type].append(entry);
+
+    p_pNode->m_iPreOrder = p_iPreOrder++;
+    for(qint32 k = 0; k < p_pNode->children.size(); ++k)
+        make_index(p_pNode->children[k], p_pBlockIndex, p_iPreOrder);
+    p_pNode->m_iLastPreOrder = p_iPreOrder - 1;
+    p_pNode->m_pBlockIndex = p_pBlockIndex;
+}
+
+//=============================================================================================================
+
 QList<FiffDirNode::SPtr> FiffDirNode::dir_tree_find(fiff_int_t p_kind) const
 {
     QList<FiffDirNode::SPtr> nodes;
+
+    const BlockIndexEntry* pBegin;
+    const BlockIndexEntry* pEnd;
+    if(find_blocks(p_kind, pBegin, pEnd)) {
+        //Copies like the linear scan, so callers cannot modify the tree through the result
+        for(const BlockIndexEntry* pEntry = pBegin; pEntry != pEnd; ++pEntry) {
+            FiffDirNode::SPtr pNode = pEntry->pNode.toStrongRef();
+            if(pNode)
+                nodes.append(FiffDirNode::SPtr(new FiffDirNode(pNode.data())));
+        }
+        return nodes;
+    }
+
     if(this->type == p_kind)
         nodes.append(FiffDirNode::SPtr(new FiffDirNode(this)));
 
@@ -190,13 +253,11 @@ QList<FiffDirNode::SPtr> FiffDirNode::dir_tree_find(fiff_int_t p_kind) const
 
 bool FiffDirNode::find_tag(FiffStream* p_pStream, fiff_int_t findkind, FiffTag::SPtr& p_pTag) const
 {
-    for (qint32 p = 0; p < this->nent(); ++p)
+    qint32 p = find_entry(findkind);
+    if (p >= 0)
     {
-        if (this->dir[p]->kind == findkind)
-        {
-            p_pStream->read_tag(p_pTag,this->dir[p]->pos);
-            return true;
-        }
+        p_pStream->read_tag(p_pTag,this->dir[p]->pos);
+        return true;
     }
     if (p_pTag)
         p_pTag.clear();
@@ -208,10 +269,7 @@ bool FiffDirNode::find_tag(FiffStream* p_pStream, fiff_int_t findkind, FiffTag::
 
 bool FiffDirNode::has_tag(fiff_int_t findkind)
 {
-    for(qint32 p = 0; p < this->nent(); ++p)
-        if(this->dir.at(p)->kind == findkind)
-            return true;
-    return false;
+    return find_entry(findkind) >= 0;
 }
 
 //=============================================================================================================
@@ -221,6 +279,11 @@ bool FiffDirNode::has_kind(fiff_int_t p_kind) const
     if(this->type == p_kind)
         return true;
 
+    const BlockIndexEntry* pBegin;
+    const BlockIndexEntry* pEnd;
+    if(find_blocks(p_kind, pBegin, pEnd))
+        return pBegin != pEnd;
+
     QList<FiffDirNode::SPtr>::const_iterator i;
     for(i = this->children.begin(); i != this->children.end(); ++i)
         if((*i)->has_kind(p_kind))
@@ -231,6 +294,54 @@ bool FiffDirNode::has_kind(fiff_int_t p_kind) const
 
 //=============================================================================================================
 
+qint32 FiffDirNode::find_entry(fiff_int_t findkind) const
+{
+    //
+    //   The index is only valid as long as dir was not modified after make_index
+    //
+    if(m_iNumIndexedEntries == this->dir.size()) {
+        QHash<fiff_int_t, qint32>::const_iterator it = m_qHashTagIndex.constFind(findkind);
+        if(it == m_qHashTagIndex.constEnd())
+            return -1;
+        if(it.value() < this->dir.size() && this->dir[it.value()]->kind == findkind)
+            return it.value();
+    }
+
+    for (qint32 p = 0; p < this->nent(); ++p)
+        if (this->dir[p]->kind == findkind)
+            return p;
+
+    return -1;
+}
+
+//=============================================================================================================
+
+bool FiffDirNode::find_blocks(fiff_int_t p_kind,
+                              const BlockIndexEntry*& p_pBegin,
+                              const BlockIndexEntry*& p_pEnd) const
+{
+    if(!m_pBlockIndex || m_iPreOrder < 0)
+        return false;
+
+    BlockIndex::const_iterator it = m_pBlockIndex->constFind(p_kind);
+    if(it == m_pBlockIndex->constEnd()) {
+        p_pBegin = p_pEnd = Q_NULLPTR;
+        return true;
+    }
+
+    //
+    //   The nodes of this subtree occupy the pre-order positions m_iPreOrder ... m_iLastPreOrder
+    //
+    const QVector<BlockIndexEntry>& entries = it.value();
+    p_pBegin = std::lower_bound(entries.constBegin(), entries.constEnd(), m_iPreOrder,
+                                [](const BlockIndexEntry& entry, qint32 iPreOrder) { return entry.iPreOrder < iPreOrder; });
+    p_pEnd = std::upper_bound(p_pBegin, entries.constEnd(), m_iLastPreOrder,
+                              [](qint32 iPreOrder, const BlockIndexEntry& entry) { return iPreOrder < entry.iPreOrder; });
+    return true;
+}
+
+//=============================================================================================================
+
 void FiffDirNode::print(int indent) const
 {
     int j, prev_kind,count;
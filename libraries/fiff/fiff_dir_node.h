@@ -52,9 +52,12 @@
 // QT INCLUDES
 //=============================================================================================================
 
+#include <QHash>
 #include <QList>
 #include <QSharedPointer>
 #include <QStringList>
+#include <QVector>
+#include <QWeakPointer>
 
 //=============================================================================================================
 // DEFINE NAMESPACE FIFFLIB
@@ -112,6 +115,18 @@ public:
      */
     static bool copy_tree(QSharedPointer<FiffStream>& p_pStreamIn, const FiffId& in_id, const QList< QSharedPointer<FiffDirNode> >& p_Nodes, QSharedPointer<FiffStream>& p_pStreamOut);
 
+    //=========================================================================================================
+    /**
+     * Builds the lookup indices of a directory tree: the position of the first entry of each tag kind in the dir
+     * of every node, and an index of the block kinds of all nodes which is shared by the whole tree.
+     * FiffStream::make_subtree calls this after the tree was created. dir_tree_find and has_kind use the block
+     * kind index, find_tag and has_tag use the tag kind index. Nodes whose dir was modified afterwards fall back
+     * to a linear scan. Call this again after adding or removing child nodes.
+     *
+     * @param[in] p_pRoot    Root node of the tree.
+     */
+    static void make_index(const FiffDirNode::SPtr& p_pRoot);
+
     //=========================================================================================================
     /**
      * Returns true if directory tree structure contains no data.
@@ -132,7 +147,7 @@ public:
      *
      * @param[in] p_kind the given kind
      *
-     * @return list of the found nodes
+     * @return list of copies of the found nodes
      */
     QList<FiffDirNode::SPtr> dir_tree_find(fiff_int_t p_kind) const;
 
@@ -242,19 +257,75 @@ public:
      */
     fiff_int_t nchild() const;
 
+private:
+    //=========================================================================================================
+    /**
+     * A node of the block kind index together with its position in a pre-order walk of the tree.
+     */
+    struct BlockIndexEntry {
+        qint32                      iPreOrder;  /**< Pre-order position of the node. */
+        QWeakPointer<FiffDirNode>   pNode;      /**< The node. Weak, since the nodes hold the index. */
+    };
+
+    typedef QHash<fiff_int_t, QVector<BlockIndexEntry> > BlockIndex;  /**< Block kind to nodes in pre-order. */
+
+    //=========================================================================================================
+    /**
+     * Indexes the tags of p_pNode and adds p_pNode and its subtree to the block kind index.
+     *
+     * @param[in] p_pNode        The node to index.
+     * @param[in] p_pBlockIndex  The block kind index of the tree.
+     * @param[in, out] p_iPreOrder   Pre-order position of p_pNode, the next free position on return.
+     */
+    static void make_index(const FiffDirNode::SPtr& p_pNode,
+                           const QSharedPointer<BlockIndex>& p_pBlockIndex,
+                           qint32& p_iPreOrder);
+
+    //=========================================================================================================
+    /**
+     * Returns the position of the first entry of the given kind in dir.
+     *
+     * @param[in] findkind   kind to find
+     *
+     * @return the position in dir, -1 if this node has no entry of the given kind
+     */
+    qint32 find_entry(fiff_int_t findkind) const;
+
+    //=========================================================================================================
+    /**
+     * Returns the range of the block kind index entries which lie within the subtree of this node.
+     *
+     * @param[in] p_kind     the block kind
+     * @param[out] p_pBegin  the first entry of the range
+     * @param[out] p_pEnd    one past the last entry of the range
+     *
+     * @return false if the block kind index is not available
+     */
+    bool find_blocks(fiff_int_t p_kind,
+                     const BlockIndexEntry*& p_pBegin,
+                     const BlockIndexEntry*& p_pEnd) const;
+
 public:
     fiff_int_t                  type;       /**< Block type for this directory */
     FiffId                      id;         /**< Id of this block if any */
     QList<FiffDirEntry::SPtr>   dir;        /**< Directory of tags in this node */
 //    fiff_int_t                  nent;       /**< Number of entries in this node */
-    QList<FiffDirEntry::SPtr>   dir_tree;   /**< Directory of tags within this node subtrees
-                                                 as well as FIFF_BLOCK_START and FIFF_BLOCK_END */
+    QList<FiffDirEntry::SPtr>   dir_tree;   /**< Directory of tags from the FIFF_BLOCK_START of this node up to the end
+                                                 of the file. The first nent_tree entries are the tags within this
+                                                 node subtrees as well as FIFF_BLOCK_START and FIFF_BLOCK_END */
     fiff_int_t                  nent_tree;  /**< Number of entries in the directory tree node */
     FiffDirNode::SPtr           parent;     /**< Parent node */
     FiffId                      parent_id;  /**< Newly added to stay consistent with MATLAB implementation */
     QList<FiffDirNode::SPtr>    children;   /**< Child nodes */
 //    fiff_int_t                  nchild;     /**< Number of child nodes */ -> use nchild() instead
 
+private:
+    QHash<fiff_int_t, qint32>           m_qHashTagIndex;        /**< Position of the first entry of each tag kind in dir. */
+    qint32                              m_iNumIndexedEntries;   /**< Size of dir when the tag index was built, -1 if not indexed. */
+    qint32                              m_iPreOrder;            /**< Pre-order position of this node in the indexed tree. */
+    qint32                              m_iLastPreOrder;        /**< Pre-order position of the last node of this subtree. */
+    QSharedPointer<const BlockIndex>    m_pBlockIndex;          /**< Block kind index shared by all nodes of the tree. */
+
     // typedef struct _fiffDirNode {
     //  int                 type;    /**< Block type for this directory *
     //  fiffId              id;      /**< Id of this block if any *
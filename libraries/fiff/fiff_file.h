@@ -253,6 +253,7 @@ namespace FIFFLIB
 #define FIFFT_DIG_STRING_STRUCT    36
 #define FIFFT_STREAM_SEGMENT_STRUCT 37
 #define FIFFT_DATA_REF_STRUCT       38
+#define FIFFT_MNE_DELTA_VARINT     100  /**< MNE-CPP extension, only used between mne_rt_server and its clients and never written to files: delta coded 32 bit integer samples stored as zigzag varints. */
 /*
  * These are for matrices of any of the above 
  */
@@ -0,0 +1,311 @@
+//=============================================================================================================
+/**
+ * @file     fiff_proj_operator.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    FiffProjOperator class definition.
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_proj_operator.h"
+#include "fiff_info.h"
+#include "fiff_ctf_comp.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCryptographicHash>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+FiffProjOperator::FiffProjOperator()
+: m_iNumChannels(0)
+, m_iCompTo(0)
+, m_bProjActive(false)
+, m_bCompActive(false)
+, m_bSparseProjValid(false)
+, m_bSparseOperatorValid(false)
+{
+}
+
+//=============================================================================================================
+
+void FiffProjOperator::clear()
+{
+    m_iNumChannels = 0;
+    m_iCompTo = 0;
+    m_bProjActive = false;
+    m_bCompActive = false;
+    m_baProjKey.clear();
+    m_baCompKey.clear();
+
+    m_matU.resize(0,0);
+    m_vecGoodMask.resize(0);
+    m_matSparseComp.resize(0,0);
+
+    m_bSparseProjValid = false;
+    m_bSparseOperatorValid = false;
+}
+
+//=============================================================================================================
+
+bool FiffProjOperator::updateProjection(const QList<FiffProj>& projs,
+                                        const QStringList& ch_names,
+                                        const QStringList& bads)
+{
+    QByteArray baKey = projKey(projs, ch_names, bads);
+
+    if(baKey == m_baProjKey) {
+        return false;
+    }
+
+    m_baProjKey = baKey;
+
+    int nchan = ch_names.size();
+
+    if(nchan != m_iNumChannels) {
+        m_iNumChannels = nchan;
+
+        //The compensator needs to be recomputed for the new channel set
+        if(!m_bCompActive || m_matSparseComp.rows() != nchan) {
+            m_iCompTo = 0;
+            m_bCompActive = false;
+            m_matSparseComp.resize(nchan, nchan);
+            m_matSparseComp.setIdentity();
+        }
+    }
+
+    m_bProjActive = false;
+    for(int i = 0; i < projs.size(); ++i) {
+        if(projs[i].active) {
+            m_bProjActive = true;
+            break;
+        }
+    }
+
+    MatrixXd matProj;
+    FiffProj::make_projector(projs, ch_names, matProj, bads, m_matU);
+
+    //No projection vectors survived, keep an empty basis with the correct number of rows
+    if(m_matU.rows() != nchan) {
+        m_matU.resize(nchan, 0);
+    }
+
+    m_vecGoodMask = VectorXd::Ones(nchan);
+    for(int i = 0; i < bads.size(); ++i) {
+        int iIdx = ch_names.indexOf(bads.at(i));
+        if(iIdx >= 0) {
+            m_vecGoodMask(iIdx) = 0.0;
+        }
+    }
+
+    m_bSparseProjValid = false;
+    m_bSparseOperatorValid = false;
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool FiffProjOperator::updateCompensator(const FiffInfo& info,
+                                         fiff_int_t to)
+{
+    QByteArray baKey = compKey(info, to);
+
+    if(baKey == m_baCompKey && m_matSparseComp.rows() == info.nchan) {
+        return false;
+    }
+
+    m_baCompKey = baKey;
+    m_iCompTo = to;
+    m_iNumChannels = info.nchan;
+    m_bCompActive = false;
+
+    //Do this always from 0 since we always compensate new raw data
+    FiffCtfComp newComp;
+    if(to != 0 && info.make_compensator(0, to, newComp) && newComp.data->data.rows() == info.nchan) {
+        m_matSparseComp = newComp.data->data.sparseView();
+        m_bCompActive = true;
+    } else {
+        m_matSparseComp.resize(info.nchan, info.nchan);
+        m_matSparseComp.setIdentity();
+    }
+
+    m_bSparseOperatorValid = false;
+
+    return true;
+}
+
+//=============================================================================================================
+
+MatrixXd FiffProjOperator::apply(const MatrixXd& matData,
+                                 bool bProj,
+                                 bool bComp) const
+{
+    MatrixXd matOut;
+
+    if(bComp && m_bCompActive) {
+        matOut = m_matSparseComp * matData;
+    } else {
+        matOut = matData;
+    }
+
+    //Without active projectors the projector still zeroes the bad channels
+    if(bProj && m_vecGoodMask.size() == matOut.rows()) {
+        //(D - U*U^T)*x = D*x - U*(U^T*x), U holds zeros for the bad channels
+        if(m_matU.cols() > 0) {
+            MatrixXd matCoeff = m_matU.transpose() * matOut;
+            matOut.array().colwise() *= m_vecGoodMask.array();
+            matOut.noalias() -= m_matU * matCoeff;
+        } else {
+            matOut.array().colwise() *= m_vecGoodMask.array();
+        }
+    }
+
+    return matOut;
+}
+
+//=============================================================================================================
+
+const SparseMatrix<double>& FiffProjOperator::getSparseProjector() const
+{
+    if(!m_bSparseProjValid) {
+        if(m_vecGoodMask.size() == m_iNumChannels && m_iNumChannels > 0) {
+            MatrixXd matProj = -m_matU * m_matU.transpose();
+            matProj.diagonal() += m_vecGoodMask;
+            m_matSparseProj = matProj.sparseView();
+        } else {
+            m_matSparseProj.resize(m_iNumChannels, m_iNumChannels);
+            m_matSparseProj.setIdentity();
+        }
+
+        m_bSparseProjValid = true;
+    }
+
+    return m_matSparseProj;
+}
+
+//=============================================================================================================
+
+const SparseMatrix<double>& FiffProjOperator::getSparseOperator() const
+{
+    if(!m_bSparseOperatorValid) {
+        m_matSparseOperator = getSparseProjector() * m_matSparseComp;
+        m_bSparseOperatorValid = true;
+    }
+
+    return m_matSparseOperator;
+}
+
+//=============================================================================================================
+
+QByteArray FiffProjOperator::projKey(const QList<FiffProj>& projs,
+                                     const QStringList& ch_names,
+                                     const QStringList& bads)
+{
+    //Hash the full projection data, so projectors only differing in single values get different keys
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(ch_names.join(',').toUtf8());
+    hash.addData(";");
+    hash.addData(bads.join(',').toUtf8());
+
+    for(int i = 0; i < projs.size(); ++i) {
+        if(!projs[i].active) {
+            continue;
+        }
+
+        const FiffNamedMatrix& data = *projs[i].data;
+
+        hash.addData(QString(";%1:%2:%3x%4:").arg(projs[i].kind)
+                                              .arg(projs[i].desc)
+                                              .arg(data.nrow)
+                                              .arg(data.ncol).toUtf8());
+        hash.addData(data.row_names.join(',').toUtf8());
+        hash.addData(":");
+        hash.addData(data.col_names.join(',').toUtf8());
+        hash.addData(":");
+        hash.addData(reinterpret_cast<const char*>(data.data.data()), int(data.data.size() * sizeof(double)));
+    }
+
+    return hash.result();
+}
+
+//=============================================================================================================
+
+QByteArray FiffProjOperator::compKey(const FiffInfo& info,
+                                     fiff_int_t to)
+{
+    //Hash everything make_compensator reads, so changed compensation data or calibrations get different keys. The
+    //current grade in the upper bits of the coil types is left out, it is set after each update.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(QString("%1;%2;").arg(to).arg(info.nchan).toUtf8());
+
+    for(int i = 0; i < info.chs.size(); ++i) {
+        hash.addData(QString("%1:%2:%3:%4:%5;").arg(info.chs[i].ch_name)
+                                               .arg(info.chs[i].kind)
+                                               .arg(info.chs[i].chpos.coil_type & 0xFFFF)
+                                               .arg(info.chs[i].cal, 0, 'g', 9)
+                                               .arg(info.chs[i].range, 0, 'g', 9).toUtf8());
+    }
+
+    for(int i = 0; i < info.comps.size(); ++i) {
+        const FiffCtfComp& comp = info.comps[i];
+        const FiffNamedMatrix& data = *comp.data;
+
+        hash.addData(QString(";%1:%2:%3:%4x%5:").arg(comp.ctfkind)
+                                                 .arg(comp.kind)
+                                                 .arg(comp.save_calibrated)
+                                                 .arg(data.nrow)
+                                                 .arg(data.ncol).toUtf8());
+        hash.addData(data.row_names.join(',').toUtf8());
+        hash.addData(":");
+        hash.addData(data.col_names.join(',').toUtf8());
+        hash.addData(":");
+        hash.addData(reinterpret_cast<const char*>(data.data.data()), int(data.data.size() * sizeof(double)));
+        hash.addData(reinterpret_cast<const char*>(comp.rowcals.data()), int(comp.rowcals.size() * sizeof(double)));
+        hash.addData(reinterpret_cast<const char*>(comp.colcals.data()), int(comp.colcals.size() * sizeof(double)));
+    }
+
+    return hash.result();
+}
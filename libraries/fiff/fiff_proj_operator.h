@@ -0,0 +1,307 @@
+//=============================================================================================================
+/**
+ * @file     fiff_proj_operator.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    FiffProjOperator class declaration.
+ *
+ */
+
+#ifndef FIFF_PROJ_OPERATOR_H
+#define FIFF_PROJ_OPERATOR_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiff_global.h"
+#include "fiff_types.h"
+#include "fiff_proj.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QSharedPointer>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+//=============================================================================================================
+// DEFINE NAMESPACE FIFFLIB
+//=============================================================================================================
+
+namespace FIFFLIB
+{
+
+//=============================================================================================================
+// FORWARD DECLARATIONS
+//=============================================================================================================
+
+class FiffInfo;
+
+//=============================================================================================================
+/**
+ * Builds and caches the SSP projector and the CTF compensator of a channel set. The projector is kept in its
+ * low-rank form P = D - U*U^T, where U is the orthonormal basis of the active projection vectors and D zeroes
+ * the bad channels. It is therefore applied in O(nchan*rank) per sample instead of O(nchan^2). Sparse versions of
+ * the operators are only built on request and cached until the active projectors, the bad channels or the
+ * compensation grade change. The lazily built members are not guarded, use one instance per thread.
+ *
+ * @brief Cached SSP projector and CTF compensator.
+ */
+class FIFFSHARED_EXPORT FiffProjOperator {
+
+public:
+    typedef QSharedPointer<FiffProjOperator> SPtr;              /**< Shared pointer type for FiffProjOperator. */
+    typedef QSharedPointer<const FiffProjOperator> ConstSPtr;   /**< Const shared pointer type for FiffProjOperator. */
+
+    //=========================================================================================================
+    /**
+     * Default constructor.
+     */
+    FiffProjOperator();
+
+    //=========================================================================================================
+    /**
+     * Resets the operator to identity for zero channels.
+     */
+    void clear();
+
+    //=========================================================================================================
+    /**
+     * Updates the SSP part of the operator. The projector is only recomputed if the active projectors, the channel
+     * names or the bad channels differ from the ones used for the cached projector.
+     *
+     * @param[in] projs      The SSP projectors. Only active ones are used.
+     * @param[in] ch_names   The channel names defining the rows/columns of the operator.
+     * @param[in] bads       The bad channels. These are excluded from the projection and zeroed by the projector.
+     *
+     * @return true if the projector was recomputed, false if the cached one was kept.
+     */
+    bool updateProjection(const QList<FiffProj>& projs,
+                          const QStringList& ch_names,
+                          const QStringList& bads = defaultQStringList);
+
+    //=========================================================================================================
+    /**
+     * Updates the compensator part of the operator, compensating from grade 0 to grade to. The compensator is only
+     * recomputed if the grade, the channels or the compensation data differ from the ones used for the cached
+     * compensator.
+     *
+     * @param[in] info   The measurement info holding the compensation data.
+     * @param[in] to     The desired compensation grade. 0 deactivates the compensator.
+     *
+     * @return true if the compensator was recomputed, false if the cached one was kept.
+     */
+    bool updateCompensator(const FiffInfo& info,
+                           fiff_int_t to);
+
+    //=========================================================================================================
+    /**
+     * Applies the compensator and the projector to the data, i.e. computes P*C*data. The projector is applied in
+     * its low-rank form. Like the full projector matrix, it zeroes the bad channels even if no projector is active.
+     *
+     * @param[in] matData    The data to apply the operator to (nchan x nsamples).
+     * @param[in] bProj      Whether to apply the projector.
+     * @param[in] bComp      Whether to apply the compensator.
+     *
+     * @return The processed data.
+     */
+    Eigen::MatrixXd apply(const Eigen::MatrixXd& matData,
+                          bool bProj = true,
+                          bool bComp = true) const;
+
+    //=========================================================================================================
+    /**
+     * Returns the sparse projector D - U*U^T. It is built on first request after the projector changed.
+     *
+     * @return The sparse projector. Only zeroes the bad channels if no projector is active, identity if the
+     *         projector was not set up yet.
+     */
+    const Eigen::SparseMatrix<double>& getSparseProjector() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the sparse compensator.
+     *
+     * @return The sparse compensator. Identity if no compensator is active.
+     */
+    inline const Eigen::SparseMatrix<double>& getSparseCompensator() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the sparse product of projector and compensator. It is built on first request after one of them
+     * changed.
+     *
+     * @return The sparse projector times compensator.
+     */
+    const Eigen::SparseMatrix<double>& getSparseOperator() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the orthonormal basis U of the active projection vectors.
+     *
+     * @return The projection basis (nchan x rank).
+     */
+    inline const Eigen::MatrixXd& getProjectionBasis() const;
+
+    //=========================================================================================================
+    /**
+     * Returns whether a minimum of one projector is active.
+     *
+     * @return Whether the projector is active.
+     */
+    inline bool isProjActive() const;
+
+    //=========================================================================================================
+    /**
+     * Returns whether a compensator with a grade other than 0 is active.
+     *
+     * @return Whether the compensator is active.
+     */
+    inline bool isCompActive() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of channels the operator was built for.
+     *
+     * @return The number of channels.
+     */
+    inline int getNumChannels() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the rank of the projection, i.e. the number of removed components.
+     *
+     * @return The rank of the projection.
+     */
+    inline int getRank() const;
+
+private:
+    //=========================================================================================================
+    /**
+     * Creates the key identifying a set of projectors, channel names and bad channels. The key is a SHA-1 hash
+     * over the channel names, the bad channels and the complete data of all active projectors.
+     *
+     * @param[in] projs      The SSP projectors.
+     * @param[in] ch_names   The channel names.
+     * @param[in] bads       The bad channels.
+     *
+     * @return The key.
+     */
+    static QByteArray projKey(const QList<FiffProj>& projs,
+                              const QStringList& ch_names,
+                              const QStringList& bads);
+
+    //=========================================================================================================
+    /**
+     * Creates the key identifying a compensation grade together with the measurement info it is computed from.
+     * The key is a SHA-1 hash over the grade, the channel names, kinds, coil types and calibrations and the
+     * complete data of all compensation matrices.
+     *
+     * @param[in] info   The measurement info holding the compensation data.
+     * @param[in] to     The compensation grade.
+     *
+     * @return The key.
+     */
+    static QByteArray compKey(const FiffInfo& info,
+                              fiff_int_t to);
+
+    int                                     m_iNumChannels;         /**< The number of channels. */
+    fiff_int_t                              m_iCompTo;              /**< The current compensation grade. */
+    bool                                    m_bProjActive;          /**< Whether a minimum of one projector is active. */
+    bool                                    m_bCompActive;          /**< Whether the compensator is active. */
+
+    QByteArray                              m_baProjKey;            /**< The key of the cached projector. */
+    QByteArray                              m_baCompKey;            /**< The key of the cached compensator. */
+
+    Eigen::MatrixXd                         m_matU;                 /**< The orthonormal basis of the projection vectors. */
+    Eigen::VectorXd                         m_vecGoodMask;          /**< 1 for good, 0 for bad channels. */
+    Eigen::SparseMatrix<double>             m_matSparseComp;        /**< The sparse compensator. */
+
+    mutable bool                            m_bSparseProjValid;     /**< Whether m_matSparseProj is up to date. */
+    mutable bool                            m_bSparseOperatorValid; /**< Whether m_matSparseOperator is up to date. */
+    mutable Eigen::SparseMatrix<double>     m_matSparseProj;        /**< The lazily built sparse projector. */
+    mutable Eigen::SparseMatrix<double>     m_matSparseOperator;    /**< The lazily built sparse projector times compensator. */
+};
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline const Eigen::SparseMatrix<double>& FiffProjOperator::getSparseCompensator() const
+{
+    return m_matSparseComp;
+}
+
+//=============================================================================================================
+
+inline const Eigen::MatrixXd& FiffProjOperator::getProjectionBasis() const
+{
+    return m_matU;
+}
+
+//=============================================================================================================
+
+inline bool FiffProjOperator::isProjActive() const
+{
+    return m_bProjActive;
+}
+
+//=============================================================================================================
+
+inline bool FiffProjOperator::isCompActive() const
+{
+    return m_bCompActive;
+}
+
+//=============================================================================================================
+
+inline int FiffProjOperator::getNumChannels() const
+{
+    return m_iNumChannels;
+}
+
+//=============================================================================================================
+
+inline int FiffProjOperator::getRank() const
+{
+    return m_matU.cols();
+}
+} // NAMESPACE
+
+#endif // FIFF_PROJ_OPERATOR_H
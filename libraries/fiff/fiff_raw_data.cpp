@@ -187,7 +187,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
             else if (this->comp.kind == -1)
                 mult_full = this->proj*cal;
             else
-                mult_full = this->proj*this->comp.data->data*cal;
+                mult_full = this->proj*(SparseMatrix<double>(this->comp.data->data.sparseView())*cal);
         }
     }
     else
@@ -230,7 +230,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
                 for( i = 0; i  < sel.size(); ++i)
                     selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
 
-                mult_full = selVect*this->comp.data->data*cal;
+                mult_full = selVect*(SparseMatrix<double>(this->comp.data->data.sparseView())*cal);
             }
         }
     }
@@ -238,16 +238,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     //
     // Make mult sparse
     //
-    tripletList.clear();
-    tripletList.reserve(mult_full.rows()*mult_full.cols());
-    for(i = 0; i < mult_full.rows(); ++i)
-        for(k = 0; k < mult_full.cols(); ++k)
-            if(mult_full(i,k) != 0)
-                tripletList.push_back(T(i, k, mult_full(i,k)));
-
-    SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
-    if(tripletList.size() > 0)
-        mult.setFromTriplets(tripletList.begin(), tripletList.end());
+    SparseMatrix<double> mult = mult_full.sparseView();
 //    mult.makeCompressed();
 
     //
@@ -363,6 +354,8 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
                         one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
                     else if(t_pTag->type == FIFFT_FLOAT)
                         one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
+                    else if(t_pTag->type == FIFFT_SHORT)
+                        one = mult*(Map< MatrixShort >( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
                     else
                         printf("Data Storage Format not known jet [3]!! Type: %d\n", t_pTag->type);
                 }
@@ -520,7 +513,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
             else if (this->comp.kind == -1)
                 mult_full = this->proj*cal;
             else
-                mult_full = this->proj*this->comp.data->data*cal;
+                mult_full = this->proj*(SparseMatrix<double>(this->comp.data->data.sparseView())*cal);
         }
     }
     else
@@ -563,7 +556,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
                 for( i = 0; i  < sel.size(); ++i)
                     selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
 
-                mult_full = selVect*this->comp.data->data*cal;
+                mult_full = selVect*(SparseMatrix<double>(this->comp.data->data.sparseView())*cal);
             }
         }
     }
@@ -571,16 +564,7 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     //
     // Make mult sparse
     //
-    tripletList.clear();
-    tripletList.reserve(mult_full.rows()*mult_full.cols());
-    for(i = 0; i < mult_full.rows(); ++i)
-        for(k = 0; k < mult_full.cols(); ++k)
-            if(mult_full(i,k) != 0)
-                tripletList.push_back(T(i, k, mult_full(i,k)));
-
-    SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
-    if(tripletList.size() > 0)
-        mult.setFromTriplets(tripletList.begin(), tripletList.end());
+    SparseMatrix<double> mult = mult_full.sparseView();
 //    mult.makeCompressed();
 
     //
@@ -696,6 +680,8 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
                         one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
                     else if(t_pTag->type == FIFFT_FLOAT)
                         one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
+                    else if(t_pTag->type == FIFFT_SHORT)
+                        one = mult*(Map< MatrixShort >( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
                     else
                         printf("Data Storage Format not known jet [3]!! Type: %d\n", t_pTag->type);
                 }
@@ -68,7 +68,11 @@
 #define FALSE 0
 #endif
 
+#define FIFF_MATRIX_READ_CHUNK (4*1024*1024)    /**< Maximal number of bytes read at once by read_named_matrix_data. */
+
 #include <iostream>
+#include <cstring>
+#include <limits>
 #include <time.h>
 
 //=============================================================================================================
@@ -84,6 +88,7 @@
 
 #include <QFile>
 #include <QTcpSocket>
+#include <QtEndian>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -99,6 +104,7 @@ using namespace Eigen;
 
 FiffStream::FiffStream(QIODevice *p_pIODevice)
 : QDataStream(p_pIODevice)
+, m_iSmallTagCount(0)
 {
     this->setFloatingPointPrecision(QDataStream::SinglePrecision);
     this->setByteOrder(QDataStream::BigEndian);
@@ -109,6 +115,7 @@ FiffStream::FiffStream(QIODevice *p_pIODevice)
 
 FiffStream::FiffStream(QByteArray * a, QIODevice::OpenMode mode)
 : QDataStream(a, mode)
+, m_iSmallTagCount(0)
 {
     this->setFloatingPointPrecision(QDataStream::SinglePrecision);
     this->setByteOrder(QDataStream::BigEndian);
@@ -350,18 +357,31 @@ bool FiffStream::close()
 //=============================================================================================================
 
 FiffDirNode::SPtr FiffStream::make_subtree(QList<FiffDirEntry::SPtr> &dentry)
+{
+    if (dentry.isEmpty())
+        return FiffDirNode::SPtr();
+
+    qint32 last;
+    bool closed;
+    FiffDirNode::SPtr node = this->make_subtree(dentry, 0, last, closed);
+    if (node)
+        FiffDirNode::make_index(node);
+    return node;
+}
+
+//=============================================================================================================
+
+FiffDirNode::SPtr FiffStream::make_subtree(const QList<FiffDirEntry::SPtr> &dentry, qint32 start, qint32 &last, bool &closed)
 {
     FiffDirNode::SPtr defaultNode;
     FiffDirNode::SPtr node = FiffDirNode::SPtr(new FiffDirNode);
     FiffDirNode::SPtr child;
     FiffTag::SPtr t_pTag;
-    QList<FiffDirEntry::SPtr> dir;
-    qint32 current = 0;
+    qint32 current = start;
 
-    node->dir_tree    = dentry;
-    node->nent_tree   = 1;
     node->parent      = FiffDirNode::SPtr();
     node->type = FIFFB_ROOT;
+    closed = false;
 
     if (dentry[current]->kind == FIFF_BLOCK_START) {
         if (!this->read_tag(t_pTag,dentry[current]->pos))
@@ -373,28 +393,35 @@ FiffDirNode::SPtr FiffStream::make_subtree(QList<FiffDirEntry::SPtr> &dentry)
         node->id = this->id();
     }
 
-    ++current;
-    int level = 0;
-    for (; current < dentry.size(); ++current) {
-        ++node->nent_tree;
+    //
+    //   Child blocks are built recursively and skipped as a whole, the entries are shared with the stream
+    //   directory. Only the block kinds and the ids are read from the file.
+    //
+    last = dentry.size() - 1;
+    for (++current; current < dentry.size(); ++current) {
         if (dentry[current]->kind == FIFF_BLOCK_START) {
-            level++;
-            if (level == 1) {
-                QList<FiffDirEntry::SPtr> sub_dentry = dentry.mid(current);
-                if (!(child = this->make_subtree(sub_dentry)))
-                    return defaultNode;
-                child->parent = node;
-                node->children.append(child);
+            qint32 childLast;
+            bool childClosed;
+            if (!(child = this->make_subtree(dentry, current, childLast, childClosed)))
+                return defaultNode;
+            child->parent = node;
+            node->children.append(child);
+            current = childLast;
+            if (!childClosed) {
+                last = childLast;
+                break;
             }
         }
         else if (dentry[current]->kind == FIFF_BLOCK_END) {
-            level--;
-            if (level < 0)
-                break;
+            last = current;
+            closed = true;
+            break;
         }
-        else if (dentry[current]->kind == -1)
+        else if (dentry[current]->kind == -1) {
+            last = current;
             break;
-        else if (level == 0) {
+        }
+        else {
             /*
             * Take the node id from the parent block id,
             * block id, or file id. Let the block id
@@ -405,13 +432,13 @@ FiffDirNode::SPtr FiffStream::make_subtree(QList<FiffDirEntry::SPtr> &dentry)
                     return defaultNode;
                 node->id = t_pTag->toFiffID();
             }
-            dir.append(FiffDirEntry::SPtr(new FiffDirEntry(*dentry[current])));//Memcopy necessary here - or is a pointer fine?
+            node->dir.append(dentry[current]);
         }
     }
-    /*
-     * Strip unused entries
-     */
-    node->dir = dir;
+
+    //dir_tree reaches up to the end of the directory as before, the block consists of its first nent_tree entries
+    node->nent_tree = last - start + 1;
+    node->dir_tree  = dentry.mid(start);
     return node;
 }
 
@@ -1311,39 +1338,9 @@ bool FiffStream::read_named_matrix(const FiffDirNode::SPtr& p_Node, fiff_int_t m
 {
     mat.clear();
 
-    FiffDirNode::SPtr node = p_Node;
-    //
-    //   Descend one level if necessary
-    //
-    bool found_it = false;
-    if (node->type != FIFFB_MNE_NAMED_MATRIX)
-    {
-        for (int k = 0; k < node->nchild(); ++k)
-        {
-            if (node->children[k]->type == FIFFB_MNE_NAMED_MATRIX)
-            {
-                if(node->children[k]->has_tag(matkind))
-                {
-                    node = node->children[k];
-                    found_it = true;
-                    break;
-                }
-            }
-       }
-       if (!found_it)
-       {
-          qWarning("Fiff::read_named_matrix: Desired named matrix (kind = %d) not available\n",matkind);
-          return false;
-       }
-    }
-    else
-    {
-        if (!node->has_tag(matkind))
-        {
-            qWarning("Desired named matrix (kind = %d) not available",matkind);
-            return false;
-        }
-    }
+    FiffDirNode::SPtr node = this->find_named_matrix(p_Node, matkind);
+    if(!node)
+        return false;
 
     FiffTag::SPtr t_pTag;
     //
@@ -1409,6 +1406,144 @@ bool FiffStream::read_named_matrix(const FiffDirNode::SPtr& p_Node, fiff_int_t m
 
 //=============================================================================================================
 
+bool FiffStream::read_named_matrix_info(const FiffDirNode::SPtr& p_Node, fiff_int_t matkind, FiffNamedMatrix& mat)
+{
+    mat.clear();
+
+    FiffDirNode::SPtr node = this->find_named_matrix(p_Node, matkind);
+    if(!node)
+        return false;
+
+    fiff_long_t dataPos;
+    if(!this->read_dense_float_matrix_layout(node, matkind, mat.nrow, mat.ncol, dataPos))
+    {
+        //Other matrix types are read completely
+        if(!this->read_named_matrix(p_Node, matkind, mat))
+            return false;
+        mat.data.resize(0,0);
+        return true;
+    }
+
+    FiffTag::SPtr t_pTag;
+    if(node->find_tag(this, FIFF_MNE_ROW_NAMES, t_pTag))
+        mat.row_names = split_name_list(t_pTag->toString());
+
+    if(node->find_tag(this, FIFF_MNE_COL_NAMES, t_pTag))
+        mat.col_names = split_name_list(t_pTag->toString());
+
+    if (mat.row_names.size() != mat.nrow)
+    {
+        qWarning("FiffStream::read_named_matrix_info - Number of rows in matrix data and row names do not match\n");
+    }
+
+    if (mat.col_names.size() != mat.ncol)
+    {
+        qWarning("FiffStream::read_named_matrix_info - Number of columns in matrix data and column names do not match\n");
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool FiffStream::read_named_matrix_data(const FiffDirNode::SPtr& p_Node,
+                                        fiff_int_t matkind,
+                                        const VectorXi& rowSel,
+                                        const VectorXi& colSel,
+                                        MatrixXf& data)
+{
+    FiffDirNode::SPtr node = this->find_named_matrix(p_Node, matkind);
+    if(!node)
+        return false;
+
+    fiff_int_t nrow, ncol;
+    fiff_long_t dataPos;
+    FiffNamedMatrix matFull;
+    bool bDense = this->read_dense_float_matrix_layout(node, matkind, nrow, ncol, dataPos);
+
+    if(!bDense)
+    {
+        //Other matrix types are read completely and picked afterwards
+        if(!this->read_named_matrix(p_Node, matkind, matFull))
+            return false;
+        nrow = matFull.nrow;
+        ncol = matFull.ncol;
+    }
+
+    if((rowSel.size() > 0 && (rowSel.minCoeff() < 0 || rowSel.maxCoeff() >= nrow)) ||
+       (colSel.size() > 0 && (colSel.minCoeff() < 0 || colSel.maxCoeff() >= ncol)))
+    {
+        qWarning("FiffStream::read_named_matrix_data - Selection exceeds the matrix dimensions (%d x %d)\n", nrow, ncol);
+        return false;
+    }
+
+    const qint32 nSelRows = rowSel.size() > 0 ? rowSel.size() : nrow;
+    const qint32 nSelCols = colSel.size() > 0 ? colSel.size() : ncol;
+    data.resize(nSelRows, nSelCols);
+
+    if(nSelRows == 0 || ncol == 0)
+        return true;
+
+    if(!bDense)
+    {
+        for(qint32 i = 0; i < nSelRows; ++i)
+            for(qint32 j = 0; j < nSelCols; ++j)
+                data(i, j) = (float)matFull.data(rowSel.size() > 0 ? rowSel[i] : i, colSel.size() > 0 ? colSel[j] : j);
+        return true;
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    bool bSwap = this->byteOrder() == QDataStream::LittleEndian;
+#else
+    bool bSwap = this->byteOrder() == QDataStream::BigEndian;
+#endif
+
+    //
+    //   The matrix is stored row by row. Runs of consecutive selected rows are read at once, in chunks of
+    //   at most FIFF_MATRIX_READ_CHUNK bytes, and only the selected columns are kept.
+    //
+    const qint32 maxRows = qMax(1, FIFF_MATRIX_READ_CHUNK / (ncol * (qint32)sizeof(float)));
+    QVector<float> buffer;
+
+    qint32 i = 0;
+    while(i < nSelRows) {
+        const qint32 row = rowSel.size() > 0 ? rowSel[i] : i;
+        qint32 nRun = 1;
+        while(i + nRun < nSelRows && nRun < maxRows && (rowSel.size() > 0 ? rowSel[i + nRun] : i + nRun) == row + nRun)
+            ++nRun;
+
+        const qint64 nBytes = (qint64)nRun * ncol * sizeof(float);
+        buffer.resize(nRun * ncol);
+        if(!this->device()->seek(dataPos + (fiff_long_t)row * ncol * sizeof(float)) ||
+           this->readRawData(reinterpret_cast<char*>(buffer.data()), nBytes) != nBytes)
+        {
+            qWarning("FiffStream::read_named_matrix_data - Could not read the matrix data\n");
+            return false;
+        }
+
+        if(bSwap) {
+            quint32* words = reinterpret_cast<quint32*>(buffer.data());
+            for(qint64 k = 0; k < (qint64)nRun * ncol; ++k) {
+                words[k] = qbswap(words[k]);
+            }
+        }
+
+        Map<const Matrix<float, Dynamic, Dynamic, RowMajor> > block(buffer.constData(), nRun, ncol);
+        if(colSel.size() == 0) {
+            data.middleRows(i, nRun) = block;
+        } else {
+            for(qint32 j = 0; j < nSelCols; ++j)
+                data.block(i, j, nRun, 1) = block.col(colSel[j]);
+        }
+
+        i += nRun;
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
 QList<FiffProj> FiffStream::read_proj(const FiffDirNode::SPtr& p_Node)
 {
     QList<FiffProj> projdata;// = struct('kind',{},'active',{},'desc',{},'data',{});
@@ -2009,12 +2144,18 @@ FiffStream::SPtr FiffStream::open_update(QIODevice &p_IODevice)
 
 //=============================================================================================================
 
-FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const FiffInfo& info, RowVectorXd& cals, MatrixXi sel, bool bResetRange)
+FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const FiffInfo& info, RowVectorXd& cals, MatrixXi sel, bool bResetRange, fiff_int_t dataType)
 {
     //
-    //   We will always write floats
+    //   Floats unless quantized integers are requested
     //
-    fiff_int_t data_type = 4;
+    if(dataType != FIFFT_FLOAT && dataType != FIFFT_SHORT && dataType != FIFFT_INT) {
+        qWarning("FiffStream::start_writing_raw - Raw files can not be written with data type %d\n", dataType);
+        return FiffStream::SPtr();
+    }
+
+    fiff_int_t data_type = dataType;
+    bool bWriteFloats = data_type == FIFFT_FLOAT;
     qint32 k;
 
     if(sel.cols() == 0)
@@ -2035,6 +2176,9 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
     //  Create the file and save the essentials
     //
     FiffStream::SPtr t_pStream = start_file(p_IODevice);//1, 2, 3
+    if(!t_pStream) {
+        return t_pStream;
+    }
     t_pStream->start_block(FIFFB_MEAS);//4
     t_pStream->write_id(FIFF_BLOCK_ID);//5
     if(info.meas_id.version != -1)
@@ -2156,10 +2300,14 @@ FiffStream::SPtr FiffStream::start_writing_raw(QIODevice &p_IODevice, const Fiff
         //    Scan numbers may have been messed up
         //
         chs[k].scanNo = k+1;
-        if(bResetRange) {
-            chs[k].range = 1.0; // Reset to 1.0 because we always write floats.
+        if(bWriteFloats) {
+            if(bResetRange) {
+                chs[k].range = 1.0; // Reset to 1.0 because we write floats.
+            }
+            cals[k] = chs[k].cal;
+        } else {
+            cals[k] = chs[k].cal * chs[k].range; // The quantization step of the integer samples
         }
-        cals[k] = chs[k].cal;
         t_pStream->write_ch_info(chs[k]);
     }
     //
@@ -2591,15 +2739,9 @@ fiff_long_t FiffStream::write_double(fiff_int_t kind, const double* data, fiff_i
 
     qint32 datasize = nel * 8;
 
-     *this << (qint32)kind;
-     *this << (qint32)FIFFT_DOUBLE;
-     *this << (qint32)datasize;
-     *this << (qint32)FIFFV_NEXT_SEQ;
-
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    char* payload = stage_tag(kind, FIFFT_DOUBLE, datasize);
+    memcpy(payload, data, datasize);
+    flush_tag(8);
 
     return pos;
 }
@@ -2612,15 +2754,9 @@ fiff_long_t FiffStream::write_float(fiff_int_t kind, const float* data, fiff_int
 
     qint32 datasize = nel * 4;
 
-     *this << (qint32)kind;
-     *this << (qint32)FIFFT_FLOAT;
-     *this << (qint32)datasize;
-     *this << (qint32)FIFFV_NEXT_SEQ;
-
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    char* payload = stage_tag(kind, FIFFT_FLOAT, datasize);
+    memcpy(payload, data, datasize);
+    flush_tag(4);
 
     return pos;
 }
@@ -2963,13 +3099,9 @@ fiff_long_t FiffStream::write_int(fiff_int_t kind, const fiff_int_t* data, fiff_
 
     fiff_int_t datasize = nel * 4;
 
-     *this << (qint32)kind;
-     *this << (qint32)FIFFT_INT;
-     *this << (qint32)datasize;
-     *this << (qint32)next;
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    char* payload = stage_tag(kind, FIFFT_INT, datasize, next);
+    memcpy(payload, data, datasize);
+    flush_tag(4);
 
     return pos;
 }
@@ -3081,17 +3213,12 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const RowVectorXd& cals)
         return false;
     }
 
-    typedef Eigen::Triplet<double> T;
-    std::vector<T> tripletList;
-    tripletList.reserve(cals.cols());
-    for(qint32 i = 0; i < cals.cols(); ++i)
-        tripletList.push_back(T(i, i, 1.0/cals[i]));
+    // Scale and convert directly into the staging buffer
+    char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_FLOAT, 4*buf.rows()*buf.cols());
+    // Multiply with the inverse like the sparse calibration matrix did, so the written floats do not change
+    Map<MatrixXf>(reinterpret_cast<float*>(payload), buf.rows(), buf.cols()) = (buf.array().colwise() * cals.transpose().array().inverse()).cast<float>();
+    flush_tag(4);
 
-    SparseMatrix<double> inv_calsMat(cals.cols(), cals.cols());
-    inv_calsMat.setFromTriplets(tripletList.begin(), tripletList.end());
-
-    MatrixXf tmp = (inv_calsMat*buf).cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
     return true;
 }
 
@@ -3104,13 +3231,33 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const SparseMatrix<double
         return false;
     }
 
+    // A diagonal multiplication matrix (calibration only) is applied as a channel wise scaling
+    bool bIsDiagonal = mult.rows() == mult.cols() && mult.nonZeros() == mult.rows();
+    VectorXd vecDiag = VectorXd::Ones(mult.cols());
+
+    for (int k=0; k<mult.outerSize() && bIsDiagonal; ++k) {
+        for (SparseMatrix<double>::InnerIterator it(mult,k); it; ++it) {
+            if(it.row() != it.col()) {
+                bIsDiagonal = false;
+                break;
+            }
+            vecDiag[it.row()] = it.value();
+        }
+    }
+
+    if(bIsDiagonal) {
+        return write_raw_buffer(buf, vecDiag.transpose());
+    }
+
     SparseMatrix<double> inv_mult(mult.rows(), mult.cols());
     for (int k=0; k<inv_mult.outerSize(); ++k)
       for (SparseMatrix<double>::InnerIterator it(mult,k); it; ++it)
         inv_mult.coeffRef(it.row(),it.col()) = 1/it.value();
 
-    MatrixXf tmp = (inv_mult*buf).cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
+    char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_FLOAT, 4*inv_mult.rows()*buf.cols());
+    Map<MatrixXf>(reinterpret_cast<float*>(payload), inv_mult.rows(), buf.cols()) = (inv_mult*buf).cast<float>();
+    flush_tag(4);
+
     return true;
 }
 
@@ -3118,8 +3265,197 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const SparseMatrix<double
 
 bool FiffStream::write_raw_buffer(const MatrixXd& buf)
 {
-    MatrixXf tmp = buf.cast<float>();
-    this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
+    char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_FLOAT, 4*buf.rows()*buf.cols());
+    Map<MatrixXf>(reinterpret_cast<float*>(payload), buf.rows(), buf.cols()) = buf.cast<float>();
+    flush_tag(4);
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool FiffStream::write_raw_buffer(const MatrixXd& buf, const RowVectorXd& cals, fiff_int_t dataType)
+{
+    if (buf.rows() != cals.cols())
+    {
+        qWarning("buffer and calibration sizes do not match\n");
+        return false;
+    }
+
+    fiff_int_t iMin = std::numeric_limits<qint32>::min();
+    fiff_int_t iMax = std::numeric_limits<qint32>::max();
+
+    switch(dataType) {
+        case FIFFT_FLOAT:
+            return write_raw_buffer(buf, cals);
+        case FIFFT_SHORT:
+            iMin = std::numeric_limits<qint16>::min();
+            iMax = std::numeric_limits<qint16>::max();
+            break;
+        case FIFFT_INT:
+        case FIFFT_MNE_DELTA_VARINT:
+            break;
+        default:
+            qWarning("Cannot write data buffers of type %d\n", dataType);
+            return false;
+    }
+
+    MatrixXi matQuant;
+    qint64 iNumSaturated = 0;
+    if(!quantize_raw_buffer(buf, cals, iMin, iMax, matQuant, &iNumSaturated)) {
+        return false;
+    }
+
+    if(iNumSaturated > 0) {
+        qWarning("FiffStream::write_raw_buffer - %lld samples exceed the range of data type %d and were saturated\n", iNumSaturated, dataType);
+    }
+
+    switch(dataType) {
+        case FIFFT_SHORT: {
+            char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_SHORT, 2*buf.rows()*buf.cols());
+            Map<MatrixShort>(reinterpret_cast<short*>(payload), buf.rows(), buf.cols()) = matQuant.cast<short>();
+            flush_tag(2);
+            break;
+        }
+
+        case FIFFT_INT: {
+            char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_INT, 4*buf.rows()*buf.cols());
+            Map<MatrixXi>(reinterpret_cast<int*>(payload), buf.rows(), buf.cols()) = matQuant;
+            flush_tag(4);
+            break;
+        }
+
+        default: {
+            QByteArray baEncoded;
+            encode_delta_varint(matQuant, baEncoded);
+            char* payload = stage_tag(FIFF_DATA_BUFFER, FIFFT_MNE_DELTA_VARINT, baEncoded.size());
+            memcpy(payload, baEncoded.constData(), baEncoded.size());
+            flush_tag(1);
+            break;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool FiffStream::quantize_raw_buffer(const MatrixXd& buf,
+                                     const RowVectorXd& cals,
+                                     fiff_int_t iMin,
+                                     fiff_int_t iMax,
+                                     MatrixXi& matQuant,
+                                     qint64* pNumSaturated)
+{
+    // A zero step gives inf or NaN, which has no integer representation
+    if(!cals.allFinite() || (cals.array() == 0.0).any()) {
+        qWarning("FiffStream::quantize_raw_buffer - The quantization steps must be finite and non-zero.\n");
+        return false;
+    }
+
+    ArrayXXd arrScaled = (buf.array().colwise() / cals.transpose().array()).round();
+    if(!arrScaled.allFinite()) {
+        qWarning("FiffStream::quantize_raw_buffer - The buffer contains samples which are not finite.\n");
+        return false;
+    }
+
+    if(pNumSaturated) {
+        *pNumSaturated = (arrScaled < double(iMin)).count() + (arrScaled > double(iMax)).count();
+    }
+
+    matQuant = arrScaled.max(double(iMin)).min(double(iMax)).cast<int>();
+
+    return true;
+}
+
+//=============================================================================================================
+
+void FiffStream::encode_delta_varint(const MatrixXi& matQuant,
+                                     QByteArray& baEncoded)
+{
+    typedef Eigen::Matrix<quint32, Eigen::Dynamic, Eigen::Dynamic> MatrixXui;
+
+    qint32 nchan = matQuant.rows();
+    qint32 nsamp = matQuant.cols();
+
+    // Differences to the previous sample of the same channel, unsigned so an overflow wraps around
+    MatrixXui matDelta = matQuant.cast<quint32>();
+    if(nsamp > 1) {
+        matDelta.rightCols(nsamp-1) -= matQuant.leftCols(nsamp-1).cast<quint32>();
+    }
+
+    // Zigzag mapping so small negative differences get small codes as well
+    quint32* pDelta = matDelta.data();
+    for(qint64 i = 0; i < matDelta.size(); ++i) {
+        pDelta[i] = (pDelta[i] << 1) ^ (0u - (pDelta[i] >> 31));
+    }
+
+    // Every varint takes at most 5 bytes
+    baEncoded.resize(8 + 5*matDelta.size());
+    uchar* pOut = reinterpret_cast<uchar*>(baEncoded.data());
+    qToBigEndian<qint32>(nchan, pOut);
+    qToBigEndian<qint32>(nsamp, pOut + 4);
+    pOut += 8;
+
+    for(qint64 i = 0; i < matDelta.size(); ++i) {
+        quint32 value = pDelta[i];
+        while(value >= 0x80) {
+            *pOut++ = uchar(value | 0x80);
+            value >>= 7;
+        }
+        *pOut++ = uchar(value);
+    }
+
+    baEncoded.resize(pOut - reinterpret_cast<uchar*>(baEncoded.data()));
+}
+
+//=============================================================================================================
+
+bool FiffStream::decode_delta_varint(const char* pData,
+                                     qint64 iSize,
+                                     MatrixXi& matQuant)
+{
+    if(iSize < 8) {
+        return false;
+    }
+
+    const uchar* pIn = reinterpret_cast<const uchar*>(pData);
+    const uchar* pEnd = pIn + iSize;
+    qint32 nchan = qFromBigEndian<qint32>(pIn);
+    qint32 nsamp = qFromBigEndian<qint32>(pIn + 4);
+    pIn += 8;
+
+    if(nchan < 0 || nsamp < 0 || qint64(nchan)*nsamp > iSize - 8) {
+        return false;
+    }
+
+    matQuant.resize(nchan, nsamp);
+    quint32* pOut = reinterpret_cast<quint32*>(matQuant.data());
+
+    for(qint64 i = 0; i < matQuant.size(); ++i) {
+        quint32 value = 0;
+        int shift = 0;
+        while(pIn < pEnd && (*pIn & 0x80) && shift < 28) {
+            value |= quint32(*pIn++ & 0x7f) << shift;
+            shift += 7;
+        }
+        if(pIn == pEnd) {
+            return false;
+        }
+        value |= quint32(*pIn++) << shift;
+
+        pOut[i] = (value >> 1) ^ (0u - (value & 1));
+    }
+
+    // Running sum over the samples, the inner loop runs over the contiguous channels of one sample
+    for(qint32 j = 1; j < nsamp; ++j) {
+        quint32* pCol = pOut + qint64(j)*nchan;
+        const quint32* pPrev = pCol - nchan;
+        for(qint32 i = 0; i < nchan; ++i) {
+            pCol[i] += pPrev[i];
+        }
+    }
+
     return true;
 }
 
@@ -3228,3 +3564,151 @@ bool FiffStream::check_beginning(FiffTag::SPtr &p_pTag)
     //do not rewind since the data is contained in the returned tag; -> done for TCP IP reasosn, no rewind possible there
     return true;
 }
+
+//=============================================================================================================
+
+char* FiffStream::stage_tag(fiff_int_t kind,
+                            fiff_int_t type,
+                            fiff_int_t datasize,
+                            fiff_int_t next)
+{
+    // Shrinking keeps the allocated capacity, so consecutive tags reuse the same memory
+    m_stagingBuffer.resize(4*4 + datasize);
+
+    fiff_int_t* header = reinterpret_cast<fiff_int_t*>(m_stagingBuffer.data());
+    header[0] = kind;
+    header[1] = type;
+    header[2] = datasize;
+    header[3] = next;
+
+    return m_stagingBuffer.data() + 4*4;
+}
+
+//=============================================================================================================
+
+void FiffStream::flush_tag(int wordSize)
+{
+    char* data = m_stagingBuffer.data();
+    qint64 size = m_stagingBuffer.size();
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    bool bSwap = this->byteOrder() == QDataStream::LittleEndian;
+#else
+    bool bSwap = this->byteOrder() == QDataStream::BigEndian;
+#endif
+
+    if(bSwap) {
+        // Plain loops over whole words which the compiler turns into vectorized byte shuffles
+        quint32* header = reinterpret_cast<quint32*>(data);
+        for(int i = 0; i < 4; ++i) {
+            header[i] = qbswap(header[i]);
+        }
+
+        qint64 datasize = size - 4*4;
+
+        if(wordSize == 2) {
+            quint16* words = reinterpret_cast<quint16*>(data + 4*4);
+            for(qint64 i = 0; i < datasize/2; ++i) {
+                words[i] = qbswap(words[i]);
+            }
+        } else if(wordSize == 4) {
+            quint32* words = reinterpret_cast<quint32*>(data + 4*4);
+            for(qint64 i = 0; i < datasize/4; ++i) {
+                words[i] = qbswap(words[i]);
+            }
+        } else if(wordSize == 8) {
+            quint64* words = reinterpret_cast<quint64*>(data + 4*4);
+            for(qint64 i = 0; i < datasize/8; ++i) {
+                words[i] = qbswap(words[i]);
+            }
+        }
+    }
+
+    this->writeRawData(data, size);
+
+    // Do not hold on to the memory of a single oversized tag, e.g. a large matrix, for the lifetime of the stream,
+    // but keep it while large tags keep coming, e.g. high density data blocks
+    if(m_stagingBuffer.capacity() > STAGING_BUFFER_KEEP_SIZE) {
+        if(2 * size > m_stagingBuffer.capacity()) {
+            m_iSmallTagCount = 0;
+        } else if(++m_iSmallTagCount >= STAGING_BUFFER_SHRINK_TAGS) {
+            m_stagingBuffer.clear();
+            m_iSmallTagCount = 0;
+        }
+    }
+}
+
+//=============================================================================================================
+
+FiffDirNode::SPtr FiffStream::find_named_matrix(const FiffDirNode::SPtr& p_Node, fiff_int_t matkind) const
+{
+    FiffDirNode::SPtr node = p_Node;
+    //
+    //   Descend one level if necessary
+    //
+    if (node->type != FIFFB_MNE_NAMED_MATRIX)
+    {
+        for (int k = 0; k < node->nchild(); ++k)
+        {
+            if (node->children[k]->type == FIFFB_MNE_NAMED_MATRIX)
+            {
+                if(node->children[k]->has_tag(matkind))
+                    return node->children[k];
+            }
+        }
+        qWarning("Fiff::read_named_matrix: Desired named matrix (kind = %d) not available\n",matkind);
+        return FiffDirNode::SPtr();
+    }
+    else
+    {
+        if (!node->has_tag(matkind))
+        {
+            qWarning("Desired named matrix (kind = %d) not available",matkind);
+            return FiffDirNode::SPtr();
+        }
+    }
+
+    return node;
+}
+
+//=============================================================================================================
+
+bool FiffStream::read_dense_float_matrix_layout(const FiffDirNode::SPtr& p_Node,
+                                                fiff_int_t matkind,
+                                                fiff_int_t& nrow,
+                                                fiff_int_t& ncol,
+                                                fiff_long_t& dataPos)
+{
+    fiff_long_t pos = -1;
+    for(qint32 p = 0; p < p_Node->nent(); ++p) {
+        if(p_Node->dir[p]->kind == matkind) {
+            pos = p_Node->dir[p]->pos;
+            break;
+        }
+    }
+
+    //A missing matrix is reported by read_named_matrix
+    if(pos < 0 || !this->device()->seek(pos))
+        return false;
+
+    //
+    //   Read the tag header and the dimensions, which are stored after the data
+    //
+    fiff_int_t kind, type, size, next;
+    *this >> kind >> type >> size >> next;
+
+    //Other matrix types are left to read_named_matrix
+    if(!(type & IS_MATRIX) || (type & DATA_TYPE) != FIFFT_FLOAT || FiffTag::fiff_type_matrix_coding(type) != FIFFTS_MC_DENSE || size < 3*4)
+        return false;
+
+    dataPos = pos + 4*4;
+    this->device()->seek(dataPos + size - 3*4);
+
+    fiff_int_t ndim;
+    *this >> ncol >> nrow >> ndim;
+
+    if(ndim != 2 || nrow < 0 || ncol < 0 || (qint64)nrow * ncol * (qint64)sizeof(float) > size - 3*4)
+        return false;
+
+    return true;
+}
@@ -67,6 +67,13 @@
 #include <QString>
 #include <QStringList>
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define STAGING_BUFFER_KEEP_SIZE    16777216    /**< Capacity in bytes of the tag staging buffer which is always kept between tags. */
+#define STAGING_BUFFER_SHRINK_TAGS  64          /**< Number of consecutive tags using less than half of a larger staging buffer after which it is freed. */
+
 //=============================================================================================================
 // DEFINE NAMESPACE FIFFLIB
 //=============================================================================================================
@@ -255,7 +262,7 @@ public:
      *
      * @param[in] dentry     The dir entries of which the tree should be constructed
      *
-     * @return The created dir tree
+     * @return The created dir tree, with its tag and block kind indices built (see FiffDirNode::make_index)
      */
     FiffDirNode::SPtr make_subtree(QList<FiffDirEntry::SPtr>& dentry);
 
@@ -367,6 +374,39 @@ public:
      */
     bool read_named_matrix(const FiffDirNode::SPtr& p_Node, fiff_int_t matkind, FiffNamedMatrix& mat);
 
+    //=========================================================================================================
+    /**
+     * Reads the dimensions and the row and column names of a named matrix without reading its data. Matrices
+     * which are not dense float matrices are read completely with read_named_matrix and their data is dropped.
+     *
+     * @param[in] p_Node     The node of interest
+     * @param[in] matkind    The matrix kind to look for
+     * @param[out] mat       The named matrix with empty data
+     *
+     * @return true if succeeded, false otherwise
+     */
+    bool read_named_matrix_info(const FiffDirNode::SPtr& p_Node, fiff_int_t matkind, FiffNamedMatrix& mat);
+
+    //=========================================================================================================
+    /**
+     * Reads selected rows and columns of the data of a named matrix. The data of dense float matrices are
+     * decoded in chunks directly from the file, so only the selected part of the matrix is held in memory. Other
+     * matrix types are read completely with read_named_matrix and picked afterwards.
+     *
+     * @param[in] p_Node     The node of interest
+     * @param[in] matkind    The matrix kind to look for
+     * @param[in] rowSel     Indices of the rows to read, in the order of the result. All rows if empty.
+     * @param[in] colSel     Indices of the columns to read, in the order of the result. All columns if empty.
+     * @param[out] data      The selected data, rows x columns as returned by read_named_matrix
+     *
+     * @return true if succeeded, false otherwise
+     */
+    bool read_named_matrix_data(const FiffDirNode::SPtr& p_Node,
+                                fiff_int_t matkind,
+                                const Eigen::VectorXi& rowSel,
+                                const Eigen::VectorXi& colSel,
+                                Eigen::MatrixXf& data);
+
     //=========================================================================================================
     /**
      * Read the SSP data under a given directory node
@@ -503,15 +543,18 @@ public:
      * @param[in] info           The measurement info block of the source file
      * @param[out] cals          A copy of the calibration values
      * @param[in] sel            Which channels will be included in the output file (optional)
-     * @param[in] bResetRange    Flag whether to reset the channel range to 1.0. Default is true.
+     * @param[in] bResetRange    Flag whether to reset the channel range to 1.0. Default is true. Only applies to float files.
+     * @param[in] dataType       The data type of the raw buffers (FIFFT_FLOAT, FIFFT_SHORT or FIFFT_INT). For the
+     *                           integer types cals holds the quantization steps (range * cal). Default is FIFFT_FLOAT.
      *
-     * @return the started fiff file
+     * @return the started fiff file, a null pointer if the data type can not be written to files or the device can not be opened
      */
     static FiffStream::SPtr start_writing_raw(QIODevice &p_IODevice,
                                               const FiffInfo& info,
                                               Eigen::RowVectorXd& cals,
                                               Eigen::MatrixXi sel = defaultMatrixXi,
-                                              bool bResetRange = true);
+                                              bool bResetRange = true,
+                                              fiff_int_t dataType = FIFFT_FLOAT);
 
     //=========================================================================================================
     /**
@@ -832,6 +875,67 @@ public:
      */
     bool write_raw_buffer(const Eigen::MatrixXd& buf);
 
+    //=========================================================================================================
+    /**
+     * Writes a raw buffer with the given data type. For the integer types the samples are quantized to
+     * round(buf / cals) and saturated to the range of the type, saturated samples are reported with a warning.
+     * FIFFT_MNE_DELTA_VARINT is only meant for the mne_rt_server connection and must not be written to files.
+     *
+     * @param[in] buf        the buffer to write
+     * @param[in] cals       calibration factors, i.e. the quantization steps for the integer types
+     * @param[in] dataType   FIFFT_FLOAT, FIFFT_SHORT, FIFFT_INT or FIFFT_MNE_DELTA_VARINT
+     *
+     * @return true if succeeded, false if the type is unknown, a step is zero or a sample is not finite
+     */
+    bool write_raw_buffer(const Eigen::MatrixXd& buf, const Eigen::RowVectorXd& cals, fiff_int_t dataType);
+
+    //=========================================================================================================
+    /**
+     * Quantizes a raw buffer to round(buf / cals), saturated to [iMin, iMax].
+     *
+     * @param[in] buf                the buffer
+     * @param[in] cals               the quantization steps
+     * @param[in] iMin               the smallest quantized value
+     * @param[in] iMax               the largest quantized value
+     * @param[out] matQuant          the quantized samples
+     * @param[out] pNumSaturated     if not null, the number of samples which were saturated
+     *
+     * @return true if succeeded, false if a step is zero or not finite or a sample is not finite
+     */
+    static bool quantize_raw_buffer(const Eigen::MatrixXd& buf,
+                                    const Eigen::RowVectorXd& cals,
+                                    fiff_int_t iMin,
+                                    fiff_int_t iMax,
+                                    Eigen::MatrixXi& matQuant,
+                                    qint64* pNumSaturated = Q_NULLPTR);
+
+    //=========================================================================================================
+    /**
+     * Encodes quantized samples losslessly as FIFFT_MNE_DELTA_VARINT data. The data starts with the number of
+     * channels and samples as big endian 32 bit integers. Then follows the difference of every sample to the
+     * previous sample of the same channel (the first sample as it is), in sample major order and as zigzag
+     * varints, i.e. small differences take fewer bytes. There is no entropy coding stage.
+     *
+     * @param[in] matQuant       the quantized samples (channels x samples)
+     * @param[out] baEncoded     the encoded data
+     */
+    static void encode_delta_varint(const Eigen::MatrixXi& matQuant,
+                                    QByteArray& baEncoded);
+
+    //=========================================================================================================
+    /**
+     * Decodes FIFFT_MNE_DELTA_VARINT data.
+     *
+     * @param[in] pData      the encoded data
+     * @param[in] iSize      the size of the encoded data in bytes
+     * @param[out] matQuant  the quantized samples (channels x samples)
+     *
+     * @return true if succeeded, false if the data is corrupt
+     */
+    static bool decode_delta_varint(const char* pData,
+                                    qint64 iSize,
+                                    Eigen::MatrixXi& matQuant);
+
     //=========================================================================================================
     /**
      * Writes a string tag
@@ -876,6 +980,80 @@ private:
      */
     QList<FiffDirEntry::SPtr> make_dir(bool *ok=Q_NULLPTR);
 
+    //=========================================================================================================
+    /**
+     * Creates the directory tree node of the block starting at dentry[start] and, recursively, of its children.
+     * The dir entries are shared with dentry and each block is scanned once, child blocks are skipped as a whole.
+     *
+     * @param[in] dentry     The dir entries of which the tree should be constructed
+     * @param[in] start      Index of the first entry of the block
+     * @param[out] last      Index of the last entry which belongs to the block
+     * @param[out] closed    Whether the block was terminated by its FIFF_BLOCK_END
+     *
+     * @return The created node, a null pointer if a tag could not be read
+     */
+    FiffDirNode::SPtr make_subtree(const QList<FiffDirEntry::SPtr>& dentry,
+                                   qint32 start,
+                                   qint32& last,
+                                   bool& closed);
+
+    //=========================================================================================================
+    /**
+     * Prepares the staging buffer for a tag with datasize bytes of data and writes the tag header to it.
+     * The data has to be written to the returned pointer in native byte order before calling flush_tag.
+     *
+     * @param[in] kind       Tag kind
+     * @param[in] type       Tag type
+     * @param[in] datasize   The size of the tag data in bytes
+     * @param[in] next       Next tag (default = FIFFV_NEXT_SEQ)
+     *
+     * @return the pointer to the data part of the staging buffer
+     */
+    char* stage_tag(fiff_int_t kind,
+                    fiff_int_t type,
+                    fiff_int_t datasize,
+                    fiff_int_t next = FIFFV_NEXT_SEQ);
+
+    //=========================================================================================================
+    /**
+     * Converts the staged tag to the byte order of the stream and writes it to the device with a single write.
+     * A staging buffer larger than STAGING_BUFFER_KEEP_SIZE is kept as long as the tags make use of it, e.g. for
+     * recurring high density data blocks, and is only freed after STAGING_BUFFER_SHRINK_TAGS consecutive tags which
+     * used less than half of it.
+     *
+     * @param[in] wordSize   The size in bytes of one data element (2, 4 or 8). Other sizes are written as they are.
+     */
+    void flush_tag(int wordSize);
+
+    //=========================================================================================================
+    /**
+     * Returns the named matrix node which holds a matrix of the given kind, descending one level if necessary.
+     *
+     * @param[in] p_Node     The node of interest
+     * @param[in] matkind    The matrix kind to look for
+     *
+     * @return the named matrix node, a null pointer if there is none
+     */
+    FiffDirNode::SPtr find_named_matrix(const FiffDirNode::SPtr& p_Node, fiff_int_t matkind) const;
+
+    //=========================================================================================================
+    /**
+     * Reads the header and the dimensions of a dense float matrix tag without reading its data.
+     *
+     * @param[in] p_Node     The node holding the matrix tag
+     * @param[in] matkind    The matrix kind
+     * @param[out] nrow      Number of rows
+     * @param[out] ncol      Number of columns
+     * @param[out] dataPos   File position of the first matrix element. The matrix is stored row by row.
+     *
+     * @return true if succeeded, false if the matrix is missing or not a two-dimensional dense float matrix
+     */
+    bool read_dense_float_matrix_layout(const FiffDirNode::SPtr& p_Node,
+                                        fiff_int_t matkind,
+                                        fiff_int_t& nrow,
+                                        fiff_int_t& ncol,
+                                        fiff_long_t& dataPos);
+
 private:
 
 //    char         *file_name;    /**< Name of the file */ -> Use streamName() instead
@@ -884,6 +1062,8 @@ private:
     QList<FiffDirEntry::SPtr>   m_dir;  /**< This is the directory. If no directory exists, open automatically scans the file to create one. */
 //    int         nent;           /**< How many entries? */ -> Use nent() instead
     FiffDirNode::SPtr           m_dirtree; /**< Directory compiled into a tree */
+    QByteArray                  m_stagingBuffer; /**< Reusable staging area for tag writes. Its capacity is kept between tags. */
+    int                         m_iSmallTagCount; /**< Number of consecutive tags which used less than half of a staging buffer larger than STAGING_BUFFER_KEEP_SIZE. */
 //    char        *ext_file_name; /**< Name of the file holding the external data */
 //    FILE        *ext_fd;        /**< The file descriptor of the above file if open  */
 
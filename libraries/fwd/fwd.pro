@@ -136,6 +136,12 @@ unix:!macx:!contains(MNECPP_CONFIG, wasm) {
     QMAKE_CXXFLAGS  +=  -fopenmp
     QMAKE_LFLAGS    +=  -fopenmp
 }
+macx|contains(MNECPP_CONFIG, wasm) {
+    QMAKE_CXXFLAGS  +=  -fopenmp-simd
+}
+
+# sqrt does not need to set errno. Otherwise the BEM coefficient kernels in fwd_bem_model.cpp are not vectorized.
+unix: QMAKE_CXXFLAGS += -fno-math-errno
 
 # Deploy library in non-static builds only
 win32:!contains(MNECPP_CONFIG, static) {
@@ -59,6 +59,8 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <functional>
+#include <algorithm>
 
 #include <Eigen/Dense>
 
@@ -838,6 +840,217 @@ out : {
 
 //=============================================================================================================
 
+//============================= fwd_bem_assembly =============================
+
+#define BEM_ROW_TILE_40 32      /* Number of matrix rows computed by one task of the BEM coefficient assembly */
+
+typedef struct {
+    int ntri;                   /* Number of triangles */
+    Eigen::ArrayXf r1[3];       /* Corners, one array per coordinate */
+    Eigen::ArrayXf r2[3];
+    Eigen::ArrayXf r3[3];
+    Eigen::ArrayXf nn[3];       /* Normals */
+    Eigen::ArrayXf area;        /* Areas */
+    Eigen::ArrayXi vert[3];     /* Vertex indices */
+} bemTrianglesRec_40;
+
+static void bem_triangles_40(const MneSurfaceOld* surf, bemTrianglesRec_40& t)
+/*
+ * Copy the triangle data of a surface to a structure of arrays for the vectorized kernels below
+ */
+{
+    int k,c;
+    t.ntri = surf->ntri;
+    for (c = 0; c < 3; c++) {
+        t.r1[c].resize(t.ntri);
+        t.r2[c].resize(t.ntri);
+        t.r3[c].resize(t.ntri);
+        t.nn[c].resize(t.ntri);
+        t.vert[c].resize(t.ntri);
+    }
+    t.area.resize(t.ntri);
+    for (k = 0; k < t.ntri; k++) {
+        const MneTriangle* tri = surf->tris+k;
+        for (c = 0; c < 3; c++) {
+            t.r1[c][k]   = tri->r1[c];
+            t.r2[c][k]   = tri->r2[c];
+            t.r3[c][k]   = tri->r3[c];
+            t.nn[c][k]   = tri->nn[c];
+            t.vert[c][k] = tri->vert[c];
+        }
+        t.area[k] = tri->area;
+    }
+}
+
+static void bem_solid_angles_40(const float *from, const bemTrianglesRec_40& t, double *triple, double *ss, float *res)
+/*
+ * Solid angles (van Oosterom) subtended by all triangles at one point.
+ * Same arithmetic as MneSurfaceOrVolume::solid_angle. The first loop is vectorized by the compiler,
+ * which needs -fno-math-errno for sqrt (see fwd.pro), only atan2 is evaluated one by one.
+ */
+{
+    const float *r1x = t.r1[X_40].data(), *r1y = t.r1[Y_40].data(), *r1z = t.r1[Z_40].data();
+    const float *r2x = t.r2[X_40].data(), *r2y = t.r2[Y_40].data(), *r2z = t.r2[Z_40].data();
+    const float *r3x = t.r3[X_40].data(), *r3y = t.r3[Y_40].data(), *r3z = t.r3[Z_40].data();
+    const float fx = from[X_40], fy = from[Y_40], fz = from[Z_40];
+    int k;
+
+    #pragma omp simd
+    for (k = 0; k < t.ntri; k++) {
+        double v1x = r1x[k]-fx, v1y = r1y[k]-fy, v1z = r1z[k]-fz;
+        double v2x = r2x[k]-fx, v2y = r2y[k]-fy, v2z = r2z[k]-fz;
+        double v3x = r3x[k]-fx, v3y = r3y[k]-fy, v3z = r3z[k]-fz;
+
+        double cx =   v1y*v2z-v2y*v1z;
+        double cy = -(v1x*v2z-v2x*v1z);
+        double cz =   v1x*v2y-v2x*v1y;
+        triple[k] = cx*v3x + cy*v3y + cz*v3z;
+
+        double l1 = sqrt(v1x*v1x + v1y*v1y + v1z*v1z);
+        double l2 = sqrt(v2x*v2x + v2y*v2y + v2z*v2z);
+        double l3 = sqrt(v3x*v3x + v3y*v3y + v3z*v3z);
+        ss[k] = (l1*l2*l3+(v1x*v2x + v1y*v2y + v1z*v2z)*l3+(v1x*v3x + v1y*v3y + v1z*v3z)*l2+(v2x*v3x + v2y*v3y + v2z*v3z)*l1);
+    }
+    for (k = 0; k < t.ntri; k++)
+        res[k] = 2.0*atan2(triple[k],ss[k]);
+}
+
+static void bem_lin_pot_coeff_40(const float *from, const bemTrianglesRec_40& t, Eigen::ArrayXXd& work, Eigen::ArrayXXd& omega)
+/*
+ * Linear potential coefficients of all triangles at one point, see FwdBemModel::lin_pot_coeff.
+ * work has to have ntri rows and 8 columns, omega gets ntri rows and 3 columns.
+ * The corner vectors are recomputed from the float coordinates in each pass, which is cheaper than storing them.
+ * Passes 1 and 3 are vectorized, the omp simd pragmas spare the run-time alias checks between the work columns.
+ */
+{
+    const float *r1x = t.r1[X_40].data(), *r1y = t.r1[Y_40].data(), *r1z = t.r1[Z_40].data();
+    const float *r2x = t.r2[X_40].data(), *r2y = t.r2[Y_40].data(), *r2z = t.r2[Z_40].data();
+    const float *r3x = t.r3[X_40].data(), *r3y = t.r3[Y_40].data(), *r3z = t.r3[Z_40].data();
+    const float *nnx = t.nn[X_40].data(), *nny = t.nn[Y_40].data(), *nnz = t.nn[Z_40].data();
+    const float *area = t.area.data();
+    const float fx = from[X_40], fy = from[Y_40], fz = from[Z_40];
+    static const double solid_eps = 4.0*M_PI/1.0E6;
+    int k;
+
+    double *triple = work.col(0).data();
+    double *ss     = work.col(1).data();
+    double *beta0 = work.col(2).data(), *beta1 = work.col(3).data(), *beta2 = work.col(4).data();
+    double *size0 = work.col(5).data(), *size1 = work.col(6).data(), *size2 = work.col(7).data();
+    double *om0 = omega.col(0).data(), *om1 = omega.col(1).data(), *om2 = omega.col(2).data();
+    /*
+     * Pass 1: triple products, the solid angle denominators, and the arguments of the logarithms in calc_beta
+     */
+    #pragma omp simd
+    for (k = 0; k < t.ntri; k++) {
+        double y1x = r1x[k]-fx, y1y = r1y[k]-fy, y1z = r1z[k]-fz;
+        double y2x = r2x[k]-fx, y2y = r2y[k]-fy, y2z = r2z[k]-fz;
+        double y3x = r3x[k]-fx, y3y = r3y[k]-fy, y3z = r3z[k]-fz;
+
+        double cx =   y1y*y2z-y2y*y1z;
+        double cy = -(y1x*y2z-y2x*y1z);
+        double cz =   y1x*y2y-y2x*y1y;
+        triple[k] = cx*y3x + cy*y3y + cz*y3z;
+
+        double l1 = sqrt(y1x*y1x + y1y*y1y + y1z*y1z);
+        double l2 = sqrt(y2x*y2x + y2y*y2y + y2z*y2z);
+        double l3 = sqrt(y3x*y3x + y3y*y3y + y3z*y3z);
+        ss[k] = (l1*l2*l3+(y1x*y2x + y1y*y2y + y1z*y2z)*l3+(y1x*y3x + y1y*y3y + y1z*y3z)*l2+(y2x*y3x + y2y*y3y + y2z*y3z)*l1);
+
+        double dx,dy,dz,sz;
+        dx = y2x-y1x; dy = y2y-y1y; dz = y2z-y1z;
+        sz = sqrt(dx*dx + dy*dy + dz*dz);
+        size0[k] = sz;
+        beta0[k] = (l1*sz + (y1x*dx + y1y*dy + y1z*dz))/(l2*sz + (y2x*dx + y2y*dy + y2z*dz));
+
+        dx = y3x-y2x; dy = y3y-y2y; dz = y3z-y2z;
+        sz = sqrt(dx*dx + dy*dy + dz*dz);
+        size1[k] = sz;
+        beta1[k] = (l2*sz + (y2x*dx + y2y*dy + y2z*dz))/(l3*sz + (y3x*dx + y3y*dy + y3z*dz));
+
+        dx = y1x-y3x; dy = y1y-y3y; dz = y1z-y3z;
+        sz = sqrt(dx*dx + dy*dy + dz*dz);
+        size2[k] = sz;
+        beta2[k] = (l3*sz + (y3x*dx + y3y*dy + y3z*dz))/(l1*sz + (y1x*dx + y1y*dy + y1z*dz));
+    }
+    /*
+     * Pass 2: the transcendental functions
+     */
+    for (k = 0; k < t.ntri; k++) {
+        ss[k] = 2.0*atan2(triple[k],ss[k]);
+        beta0[k] = log(beta0[k])/size0[k];
+        beta1[k] = log(beta1[k])/size1[k];
+        beta2[k] = log(beta2[k])/size2[k];
+    }
+    /*
+     * Pass 3: put it all together
+     */
+    #pragma omp simd
+    for (k = 0; k < t.ntri; k++) {
+        double y1x = r1x[k]-fx, y1y = r1y[k]-fy, y1z = r1z[k]-fz;
+        double y2x = r2x[k]-fx, y2y = r2y[k]-fy, y2z = r2z[k]-fz;
+        double y3x = r3x[k]-fx, y3y = r3y[k]-fy, y3z = r3z[k]-fz;
+        double solid = ss[k];
+
+        double bb0 = beta2[k] - beta0[k];
+        double bb1 = beta0[k] - beta1[k];
+        double bb2 = beta1[k] - beta2[k];
+        double wx = 0.0 + bb0*y1x + bb1*y2x + bb2*y3x;
+        double wy = 0.0 + bb0*y1y + bb1*y2y + bb2*y3y;
+        double wz = 0.0 + bb0*y1z + bb1*y2z + bb2*y3z;
+
+        double area2 = 2.0*area[k];
+        double n2 = 1.0/(area2*area2);
+        double zx,zy,zz;
+        /*
+         * omega[0] : yy[1] = y2, yy[-1] = y3
+         */
+        zx =   y2y*y3z-y3y*y2z;
+        zy = -(y2x*y3z-y3x*y2z);
+        zz =   y2x*y3y-y3x*y2y;
+        double o0 = n2*(-area2*(zx*nnx[k] + zy*nny[k] + zz*nnz[k])*solid +
+                        triple[k]*((y3x-y2x)*wx + (y3y-y2y)*wy + (y3z-y2z)*wz));
+        /*
+         * omega[1] : yy[2] = y3, yy[0] = y1
+         */
+        zx =   y3y*y1z-y1y*y3z;
+        zy = -(y3x*y1z-y1x*y3z);
+        zz =   y3x*y1y-y1x*y3y;
+        double o1 = n2*(-area2*(zx*nnx[k] + zy*nny[k] + zz*nnz[k])*solid +
+                        triple[k]*((y1x-y3x)*wx + (y1y-y3y)*wy + (y1z-y3z)*wz));
+        /*
+         * omega[2] : yy[3] = y1, yy[1] = y2
+         */
+        zx =   y1y*y2z-y2y*y1z;
+        zy = -(y1x*y2z-y2x*y1z);
+        zz =   y1x*y2y-y2x*y1y;
+        double o2 = n2*(-area2*(zx*nnx[k] + zy*nny[k] + zz*nnz[k])*solid +
+                        triple[k]*((y2x-y1x)*wx + (y2y-y1y)*wy + (y2z-y1z)*wz));
+
+        om0[k] = o0;
+        om1[k] = o1;
+        om2[k] = o2;
+    }
+    /*
+     * Pass 4: no contribution if the solid angle is too small. Kept out of pass 3, a conditional there stops the vectorization
+     */
+    for (k = 0; k < t.ntri; k++)
+        if (std::fabs(ss[k]) < solid_eps)
+            om0[k] = om1[k] = om2[k] = 0.0;
+}
+
+static QList<int> bem_row_tiles_40(int nrow)
+/*
+ * Start rows of the tiles in which the rows of a BEM coefficient block are distributed to the threads
+ */
+{
+    QList<int> tiles;
+    for (int j = 0; j < nrow; j += BEM_ROW_TILE_40)
+        tiles.append(j);
+    return tiles;
+}
+
+//=============================================================================================================
+
 double FwdBemModel::calc_beta(double *rk, double *rk1)
 
 {
@@ -1040,12 +1253,8 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
 {
     float **mat = NULL;
     float **sub_mat = NULL;
-    int   np1,np2,ntri,np_tot,np_max;
-    float **nodes;
-    MneTriangle*   tri;
-    double omega[3];
-    double *row = NULL;
-    int    j,k,p,q,c;
+    int   np1,np2,np_tot,np_max;
+    int    j,p,q;
     int    joff,koff;
     MneSurfaceOld* surf1;
     MneSurfaceOld* surf2;
@@ -1057,45 +1266,54 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
     }
 
     mat = ALLOC_CMATRIX_40(np_tot,np_tot);
-    for (j = 0; j < np_tot; j++)
-        for (k = 0; k < np_tot; k++)
-            mat[j][k] = 0.0;
-    row        = MALLOC_40(np_max,double);
+    Eigen::Map<Eigen::Matrix<float,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> > matCoeff(mat[0],np_tot,np_tot);
+    matCoeff.setZero();
+
     sub_mat = MALLOC_40(np_max,float *);
     for (p = 0, joff = 0; p < surfs.size(); p++, joff = joff + np1) {
         surf1 = surfs[p];
         np1   = surf1->np;
-        nodes = surf1->rr;
+        float **nodes = surf1->rr;
         for (q = 0, koff = 0; q < surfs.size(); q++, koff = koff + np2) {
             surf2 = surfs[q];
             np2   = surf2->np;
-            ntri  = surf2->ntri;
 
             fprintf(stderr,"\t\t%s (%d) -> %s (%d) ... ",
                     fwd_bem_explain_surface(surf1->id).toUtf8().constData(),np1,
                     fwd_bem_explain_surface(surf2->id).toUtf8().constData(),np2);
 
-            for (j = 0; j < np1; j++) {
-                for (k = 0; k < np2; k++)
-                    row[k] = 0.0;
-                for (k = 0, tri = surf2->tris; k < ntri; k++,tri++) {
-                    /*
-               * No contribution from a triangle that
-               * this vertex belongs to
-               */
-                    if (p == q && (tri->vert[0] == j || tri->vert[1] == j || tri->vert[2] == j))
-                        continue;
-                    /*
-               * Otherwise do the hard job
-               */
-                    lin_pot_coeff (nodes[j],tri,omega);
-                    for (c = 0; c < 3; c++)
-                        row[tri->vert[c]] = row[tri->vert[c]] - omega[c];
+            bemTrianglesRec_40 tris;
+            bem_triangles_40(surf2,tris);
+            const bool same = (p == q);
+            /*
+             * Each task computes a tile of rows with its own work space
+             */
+            std::function<void(int&)> computeTile = [&, np1, np2, joff, koff, same](int& jstart) {
+                Eigen::ArrayXXd work(tris.ntri,8);
+                Eigen::ArrayXXd omega(tris.ntri,3);
+                Eigen::VectorXd row(np2);
+                int jend = std::min(jstart + BEM_ROW_TILE_40, np1);
+
+                for (int jj = jstart; jj < jend; jj++) {
+                    bem_lin_pot_coeff_40(nodes[jj],tris,work,omega);
+                    row.setZero();
+                    for (int k = 0; k < tris.ntri; k++) {
+                        /*
+                         * No contribution from a triangle that
+                         * this vertex belongs to
+                         */
+                        if (same && (tris.vert[0][k] == jj || tris.vert[1][k] == jj || tris.vert[2][k] == jj))
+                            continue;
+                        for (int c = 0; c < 3; c++)
+                            row[tris.vert[c][k]] = row[tris.vert[c][k]] - omega(k,c);
+                    }
+                    matCoeff.row(jj+joff).segment(koff,np2) = row.cast<float>().transpose();
                 }
-                for (k = 0; k < np2; k++)
-                    mat[j+joff][k+koff] = row[k];
-            }
-            if (p == q) {
+            };
+            QList<int> tiles = bem_row_tiles_40(np1);
+            QtConcurrent::blockingMap(tiles, computeTile);
+
+            if (same) {
                 for (j = 0; j < np1; j++)
                     sub_mat[j] = mat[j+joff]+koff;
                 correct_auto_elements (surf1,sub_mat);
@@ -1103,7 +1321,6 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
             fprintf(stderr,"[done]\n");
         }
     }
-    FREE_40(row);
     FREE_40(sub_mat);
     return(mat);
 }
@@ -1344,12 +1561,10 @@ float **FwdBemModel::fwd_bem_solid_angles(const QList<MneSurfaceOld*>& surfs)
 {
     MneSurfaceOld* surf1;
     MneSurfaceOld* surf2;
-    MneTriangle* tri;
     int ntri1,ntri2,ntri_tot;
-    int j,k,p,q;
+    int j,p,q;
     int joff,koff;
     float **solids;
-    float result;
     float **sub_solids = NULL;
     float desired;
 
@@ -1358,6 +1573,8 @@ float **FwdBemModel::fwd_bem_solid_angles(const QList<MneSurfaceOld*>& surfs)
 
     sub_solids = MALLOC_40(ntri_tot,float *);
     solids = ALLOC_CMATRIX_40(ntri_tot,ntri_tot);
+    Eigen::Map<Eigen::Matrix<float,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> > matSolids(solids[0],ntri_tot,ntri_tot);
+
     for (p = 0, joff = 0; p < surfs.size(); p++, joff = joff + ntri1) {
         surf1 = surfs[p];
         ntri1 = surf1->ntri;
@@ -1365,14 +1582,28 @@ float **FwdBemModel::fwd_bem_solid_angles(const QList<MneSurfaceOld*>& surfs)
             surf2 = surfs[q];
             ntri2 = surf2->ntri;
             fprintf(stderr,"\t\t%s (%d) -> %s (%d) ... ",fwd_bem_explain_surface(surf1->id).toUtf8().constData(),ntri1,fwd_bem_explain_surface(surf2->id).toUtf8().constData(),ntri2);
-            for (j = 0; j < ntri1; j++)
-                for (k = 0, tri = surf2->tris; k < ntri2; k++, tri++) {
-                    if (p == q && j == k)
-                        result = 0.0;
-                    else
-                        result = MneSurfaceOrVolume::solid_angle (surf1->tris[j].cent,tri);
-                    solids[j+joff][k+koff] = result;
+
+            bemTrianglesRec_40 tris;
+            bem_triangles_40(surf2,tris);
+            const bool same = (p == q);
+            /*
+             * Each task computes a tile of rows with its own work space
+             */
+            std::function<void(int&)> computeTile = [&, ntri1, joff, koff, same](int& jstart) {
+                Eigen::VectorXd triple(tris.ntri);
+                Eigen::VectorXd ss(tris.ntri);
+                int jend = std::min(jstart + BEM_ROW_TILE_40, ntri1);
+
+                for (int jj = jstart; jj < jend; jj++) {
+                    float *res = matSolids.row(jj+joff).data() + koff;
+                    bem_solid_angles_40(surf1->tris[jj].cent,tris,triple.data(),ss.data(),res);
+                    if (same)
+                        res[jj] = 0.0;
                 }
+            };
+            QList<int> tiles = bem_row_tiles_40(ntri1);
+            QtConcurrent::blockingMap(tiles, computeTile);
+
             for (j = 0; j < ntri1; j++)
                 sub_solids[j] = solids[j+joff]+koff;
             fprintf(stderr,"[done]\n");
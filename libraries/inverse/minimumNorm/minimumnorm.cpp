@@ -67,6 +67,7 @@ using namespace FIFFLIB;
 
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, const QString method)
 : m_inverseOperator(p_inverseOperator)
+, m_bSinglePrecision(false)
 , inverseSetup(false)
 {
     this->setRegularization(lambda);
@@ -77,6 +78,7 @@ MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lamb
 
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, bool dSPM, bool sLORETA)
 : m_inverseOperator(p_inverseOperator)
+, m_bSinglePrecision(false)
 , inverseSetup(false)
 {
     this->setRegularization(lambda);
@@ -180,7 +182,13 @@ MNESourceEstimate MinimumNorm::calculateInverse(const FiffEvoked &p_fiffEvoked,
 
 //=============================================================================================================
 
-MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin, float tstep, bool pick_normal) const
+template<typename T>
+MNESourceEstimate MinimumNorm::applyKernel(const Matrix<T, Dynamic, Dynamic> &kernel,
+                                           const SparseMatrix<T> &noiseNorm,
+                                           const Matrix<T, Dynamic, Dynamic> &data,
+                                           float tmin,
+                                           float tstep,
+                                           bool pick_normal) const
 {
     if(!inverseSetup)
     {
@@ -188,37 +196,34 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
         return MNESourceEstimate();
     }
 
-    if(K.cols() != data.rows()) {
-        qWarning() << "MinimumNorm::calculateInverse - Dimension mismatch between K.cols() and data.rows() -" << K.cols() << "and" << data.rows();
+    if(kernel.cols() != data.rows()) {
+        qWarning() << "MinimumNorm::calculateInverse - Dimension mismatch between K.cols() and data.rows() -" << kernel.cols() << "and" << data.rows();
         return MNESourceEstimate();
     }
 
-    MatrixXd sol = K * data; //apply imaging kernel
+    Matrix<T, Dynamic, Dynamic> sol = kernel * data; //apply imaging kernel
 
     if (inv.source_ori == FIFFV_MNE_FREE_ORI && pick_normal == false)
     {
         printf("combining the current components...\n");
 
-        MatrixXd sol1(sol.rows()/3,sol.cols());
+        // The three components of a source are consecutive rows, so each column is a 3 x nsource matrix
+        qint32 nsource = sol.rows()/3;
+        Matrix<T, Dynamic, Dynamic> sol1(nsource,sol.cols());
         for(qint32 i = 0; i < sol.cols(); ++i)
-        {
-            VectorXd* tmp = MNEMath::combine_xyz(sol.col(i));
-            sol1.block(0,i,sol.rows()/3,1) = tmp->cwiseSqrt();
-            delete tmp;
-        }
-        sol.resize(sol1.rows(),sol1.cols());
-        sol = sol1;
+            sol1.col(i) = Map<const Matrix<T, 3, Dynamic> >(sol.col(i).data(), 3, nsource).colwise().norm().transpose();
+        sol.swap(sol1);
     }
 
     if (m_bdSPM)
     {
         printf("(dSPM)...");
-        sol = inv.noisenorm*sol;
+        sol = noiseNorm*sol;
     }
     else if (m_bsLORETA)
     {
         printf("(sLORETA)...");
-        sol = inv.noisenorm*sol;
+        sol = noiseNorm*sol;
     }
     printf("[done]\n");
 
@@ -226,15 +231,28 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
     VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
     p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
 
-//    VectorXi p_vecVertices();
-//    for(qint32 h = 0; h < inv.src.size(); ++h)
-//        t_qListVertices.push_back(inv.src[h].vertno);
-
     return MNESourceEstimate(sol, p_vecVertices, tmin, tstep);
 }
 
 //=============================================================================================================
 
+MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin, float tstep, bool pick_normal) const
+{
+    return applyKernel<double>(K, inv.noisenorm, data, tmin, tstep, pick_normal);
+}
+
+//=============================================================================================================
+
+MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXf &data, float tmin, float tstep, bool pick_normal) const
+{
+    if(!m_bSinglePrecision)
+        return applyKernel<double>(K, inv.noisenorm, data.cast<double>(), tmin, tstep, pick_normal);
+
+    return applyKernel<float>(m_matKernelFloat, m_matNoiseNormFloat, data, tmin, tstep, pick_normal);
+}
+
+//=============================================================================================================
+
 void MinimumNorm::doInverseSetup(qint32 nave, bool pick_normal)
 {
     //
@@ -247,11 +265,26 @@ void MinimumNorm::doInverseSetup(qint32 nave, bool pick_normal)
 
     std::cout << "K " << K.rows() << " x " << K.cols() << std::endl;
 
+    updateSinglePrecisionKernel();
+
     inverseSetup = true;
 }
 
 //=============================================================================================================
 
+void MinimumNorm::updateSinglePrecisionKernel()
+{
+    if(m_bSinglePrecision) {
+        m_matKernelFloat = K.cast<float>();
+        m_matNoiseNormFloat = inv.noisenorm.cast<float>();
+    } else {
+        m_matKernelFloat.resize(0,0);
+        m_matNoiseNormFloat.resize(0,0);
+    }
+}
+
+//=============================================================================================================
+
 const char* MinimumNorm::getName() const
 {
     return "Minimum Norm Estimate";
@@ -314,3 +347,13 @@ void MinimumNorm::setRegularization(float lambda)
 {
     m_fLambda = lambda;
 }
+
+//=============================================================================================================
+
+void MinimumNorm::setSinglePrecision(bool bSinglePrecision)
+{
+    m_bSinglePrecision = bSinglePrecision;
+
+    if(inverseSetup)
+        updateSinglePrecisionKernel();
+}
@@ -114,6 +114,22 @@ public:
 
     virtual MNELIB::MNESourceEstimate calculateInverse(const Eigen::MatrixXd &data, float tmin, float tstep, bool pick_normal = false) const;
 
+    //=========================================================================================================
+    /**
+     * Applies the inverse in single precision. The inverse setup (SVD, whitening, kernel assembly) is done in
+     * double precision by doInverseSetup. The single precision copies of the kernel and of the noise
+     * normalization are only kept when setSinglePrecision was enabled, otherwise the data are widened and the
+     * double precision kernel is applied. Use this for data which arrive as floats, e.g. real-time buffers.
+     *
+     * @param[in] data           Data matrix [n_channels x n_times] in single precision
+     * @param[in] tmin           Time of the first sample
+     * @param[in] tstep          Time between two samples
+     * @param[in] pick_normal    Pick only the normal component of the source currents
+     *
+     * @return the calculated source estimation
+     */
+    MNELIB::MNESourceEstimate calculateInverse(const Eigen::MatrixXf &data, float tmin, float tstep, bool pick_normal = false) const;
+
     //=========================================================================================================
     /**
      * Perform the inverse setup: Prepares this inverse operator and assembles the kernel.
@@ -173,6 +189,15 @@ public:
      */
     void setRegularization(float lambda);
 
+    //=========================================================================================================
+    /**
+     * Keep single precision copies of the kernel and of the noise normalization, which are used by the
+     * single precision calculateInverse. This doubles the memory needed for the kernel. Disabled by default.
+     *
+     * @param[in] bSinglePrecision   Whether to keep the single precision copies
+     */
+    void setSinglePrecision(bool bSinglePrecision);
+
     //=========================================================================================================
     /**
      * Get the assembled kernel
@@ -182,11 +207,41 @@ public:
     inline Eigen::MatrixXd& getKernel();
 
 private:
+    //=========================================================================================================
+    /**
+     * Creates or clears the single precision copies of the kernel and of the noise normalization according
+     * to m_bSinglePrecision.
+     */
+    void updateSinglePrecisionKernel();
+
+    //=========================================================================================================
+    /**
+     * Applies the imaging kernel to the data, combines the current components and applies the noise
+     * normalization in the precision of T.
+     *
+     * @param[in] kernel         Imaging kernel
+     * @param[in] noiseNorm      Noise normalization
+     * @param[in] data           Data matrix [n_channels x n_times]
+     * @param[in] tmin           Time of the first sample
+     * @param[in] tstep          Time between two samples
+     * @param[in] pick_normal    Pick only the normal component of the source currents
+     *
+     * @return the calculated source estimation
+     */
+    template<typename T>
+    MNELIB::MNESourceEstimate applyKernel(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &kernel,
+                                          const Eigen::SparseMatrix<T> &noiseNorm,
+                                          const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &data,
+                                          float tmin,
+                                          float tstep,
+                                          bool pick_normal) const;
+
     MNELIB::MNEInverseOperator m_inverseOperator;   /**< The inverse operator */
     float m_fLambda;                                /**< Regularization parameter */
     QString m_sMethod;                              /**< Selected method */
     bool m_bsLORETA;                                /**< Do sLORETA method */
     bool m_bdSPM;                                   /**< Do dSPM method */
+    bool m_bSinglePrecision;                        /**< Keep single precision copies of the kernel */
 
     bool inverseSetup;                              /**< Inverse Setup Calcluated */
     MNELIB::MNEInverseOperator inv;                 /**< The setup inverse operator */
@@ -194,6 +249,8 @@ private:
     QList<Eigen::VectorXi> vertno;                  /**< The vertices numbers */
     FSLIB::Label label;                             /**< The corresponding labels */
     Eigen::MatrixXd K;                              /**< Imaging kernel */
+    Eigen::MatrixXf m_matKernelFloat;               /**< Single precision copy of the imaging kernel */
+    Eigen::SparseMatrix<float> m_matNoiseNormFloat; /**< Single precision copy of the noise normalization of the setup inverse operator */
 };
 
 //=============================================================================================================
@@ -185,16 +185,15 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
         MatrixXT t_matU_B;
         useFullRank(t_svdProj_Phi_S.matrixU(), t_svdProj_Phi_S.singularValues().asDiagonal(), t_matU_B);
 
-        //Inits
-        VectorXT t_vecRoh(m_iNumLeadFieldCombinations,1);
-        t_vecRoh.setZero();
+        //Inits -> correlations of the current Powell row only, the maximum over all rows is tracked separately
+        VectorXT t_vecRoh(m_iNumGridPoints,1);
 
         //subcorr benchmark
         //Stop the time
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
-        double t_val_roh_k;
+        double t_val_roh_k = -1.0;
 
         //Powell
         int t_iCurrentRow = 2;
@@ -202,6 +201,7 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
         int t_iIdx1 = -1;
         int t_iIdx2 = -1;
 
+        int t_iMaxIdx = -1;
         int t_iMaxIdx_old = -1;
 
         int t_iMaxFound = 0;
@@ -230,12 +230,12 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
                     //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
                     MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
 
-                    int idx1 = m_ppPairIdxCombinations[k]->x1;
-                    int idx2 = m_ppPairIdxCombinations[k]->x2;
+                    int idx1, idx2;
+                    RapMusic::getPointPair(m_iNumGridPoints, k, idx1, idx2);
 
                     RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
 
-                    t_vecRoh(k) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
+                    t_vecRoh(i) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
                 }
             }
 
@@ -257,11 +257,18 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
 
             //Find the maximum of correlation - can't put this in the for loop because it's running in different threads.
 
-            VectorXT::Index t_iMaxIdx;
-
-            t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
+            //Keep the maximum of all rows scanned so far, ties are resolved to the lowest combination index
+            for(int i = 0; i < t_iNumVecElements; ++i)
+            {
+                int k = t_pVecIdxElements(i);
+                if(t_vecRoh(i) > t_val_roh_k || (t_vecRoh(i) == t_val_roh_k && k < t_iMaxIdx))
+                {
+                    t_val_roh_k = t_vecRoh(i);//p_vecCor = ^roh_k
+                    t_iMaxIdx = k;
+                }
+            }
 
-            if((int)t_iMaxIdx == t_iMaxIdx_old)
+            if(t_iMaxIdx == t_iMaxIdx_old)
             {
                 t_iMaxFound = 1;
                 break;
@@ -270,8 +277,7 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
             {
                 t_iMaxIdx_old = t_iMaxIdx;
                 //get positions in sparsed leadfield from index combinations;
-                t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-                t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
+                RapMusic::getPointPair(m_iNumGridPoints, t_iMaxIdx, t_iIdx1, t_iIdx2);
             }
 
             //set new index
@@ -45,6 +45,8 @@
 #include <omp.h>
 #endif
 
+#include <algorithm>
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -64,7 +66,6 @@ RapMusic::RapMusic()
 , m_iNumGridPoints(0)
 , m_iNumChannels(0)
 , m_iNumLeadFieldCombinations(0)
-, m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
@@ -80,7 +81,6 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 , m_iNumGridPoints(0)
 , m_iNumChannels(0)
 , m_iNumLeadFieldCombinations(0)
-, m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
@@ -94,8 +94,6 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 
 RapMusic::~RapMusic()
 {
-    if(m_ppPairIdxCombinations != NULL)
-        free(m_ppPairIdxCombinations);
 }
 
 //=============================================================================================================
@@ -148,19 +146,9 @@ bool RapMusic::init(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, doubl
 
     m_ForwardSolution = p_pFwd;
 
-    //##### Calc lead field combination #####
-
-    std::cout << "Calculate gain matrix combinations. \n";
-
-    m_iNumLeadFieldCombinations = MNEMath::nchoose2(m_iNumGridPoints+1);
-
-    m_ppPairIdxCombinations = (Pair **)malloc(m_iNumLeadFieldCombinations * sizeof(Pair *));
-
-    calcPairCombinations(m_iNumGridPoints, m_iNumLeadFieldCombinations, m_ppPairIdxCombinations);
-
-    std::cout << "Gain matrix combinations calculated. \n\n";
-
-    //##### Calc lead field combination end #####
+    //Lead field combinations are generated on the fly during the scan
+    //64 bit -> the number of combinations overflows int for large grids, like in getPointPair
+    m_iNumLeadFieldCombinations = (qint64)m_iNumGridPoints*(m_iNumGridPoints+1)/2;
 
     std::cout << "Number of grid points: " << m_iNumGridPoints << "\n\n";
 
@@ -459,53 +447,14 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         MatrixXT t_matU_B;
         useFullRank(t_svdProj_Phi_S.matrixU(), t_svdProj_Phi_S.singularValues().asDiagonal(), t_matU_B);
 
-        //Inits
-        VectorXT t_vecRoh(m_iNumLeadFieldCombinations,1);
-        t_vecRoh.setZero();
-
         //subcorr benchmark
         //Stop the time
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
         //Multithreading correlation calculation
-        #ifdef _OPENMP
-        #pragma omp parallel num_threads(m_iMaxNumThreads)
-        #endif
-        {
-        #ifdef _OPENMP
-        #pragma omp for
-        #endif
-            for(int i = 0; i < m_iNumLeadFieldCombinations; i++)
-            {
-                //new Version: calculate matrix multiplication before
-                //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
-
-                int idx1 = m_ppPairIdxCombinations[i]->x1;
-                int idx2 = m_ppPairIdxCombinations[i]->x2;
-
-                RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
-
-                t_vecRoh(i) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
-            }
-        }
-
-//         if(r==0)
-//         {
-//             std::fstream filestr;
-//             std::stringstream filename;
-//             filename << "Roh_gold.txt";
-//
-//             filestr.open ( filename.str().c_str(), std::fstream::out);
-//             for(int i = 0; i < m_iNumLeadFieldCombinations; ++i)
-//             {
-//               filestr << t_vecRoh(i) << "\n";
-//             }
-//             filestr.close();
-//
-//             //exit(0);
-//         }
+        Pair t_pairMaxIdx;
+        double t_val_roh_k = scanPairCombinations(t_matProj_LeadField, t_matU_B, t_pairMaxIdx);//p_vecCor = ^roh_k
 
         //subcorr benchmark
         end_subcorr = clock();
@@ -513,16 +462,8 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         float t_fSubcorrElapsedTime = ( (float)(end_subcorr-start_subcorr) / (float)CLOCKS_PER_SEC ) * 1000.0f;
         std::cout << "Time Elapsed: " << t_fSubcorrElapsedTime << " ms" << std::endl;
 
-        //Find the maximum of correlation - can't put this in the for loop because it's running in different threads.
-        double t_val_roh_k;
-
-        VectorXT::Index t_iMaxIdx;
-
-        t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
-
-        //get positions in sparsed leadfield from index combinations;
-        int t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-        int t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
+        int t_iIdx1 = t_pairMaxIdx.x1;
+        int t_iIdx2 = t_pairMaxIdx.x2;
 
         // (Idx+1) because of MATLAB positions -> starting with 1 not with 0
         std::cout << "Iteration: " << r+1 << " of " << t_iMaxSearch
@@ -737,6 +678,137 @@ double RapMusic::subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vecto
 
 //=============================================================================================================
 
+double RapMusic::subcorr(const Matrix6T& p_matGram, const Matrix6T& p_matCorGram)
+{
+    //The eigenvalues of G^T G are the squared singular values of G (ascending order)
+    Eigen::SelfAdjointEigenSolver<Matrix6T> t_eigGram(p_matGram);
+    const Vector6T& t_vecD = t_eigGram.eigenvalues();
+
+    if(t_vecD(5) <= 0.0)
+        return 0.0;
+
+    //lt. Mosher 1998: Only Retain those Components of U_A that correspond to nonzero singular values (see getRank)
+    //-> U_A = G * V_A * Sigma_A^-1, dropped components stay zero
+    Matrix6T t_matT = Matrix6T::Zero();
+    for(int i = 5; i >= 0; --i)
+    {
+        if(i < 5 && t_vecD(i) <= 0.00001*0.00001)
+            break;
+        t_matT.col(i) = t_eigGram.eigenvectors().col(i) / sqrt(t_vecD(i));
+    }
+
+    //C^T C = U_A^T U_B U_B^T U_A -> the largest eigenvalue is the squared correlation of the first principal components
+    Matrix6T t_matCorSq = t_matT.transpose() * p_matCorGram * t_matT;
+    Eigen::SelfAdjointEigenSolver<Matrix6T> t_eigCor(t_matCorSq, Eigen::EigenvaluesOnly);
+
+    double t_dMaxEig = t_eigCor.eigenvalues()(5);
+
+    return t_dMaxEig > 0.0 ? sqrt(t_dMaxEig) : 0.0;
+}
+
+//=============================================================================================================
+
+double RapMusic::scanPairCombinations(const MatrixXT& p_matProj_LeadField,
+                                      const MatrixXT& p_matU_B,
+                                      Pair& p_pairMaxIdx) const
+{
+    //Per grid point blocks, the pair Gram matrices are assembled from these and the cross products
+    MatrixXT t_matW = p_matU_B.transpose() * p_matProj_LeadField;
+
+    MatrixXT t_matGramDiag(3, 3*m_iNumGridPoints);
+    MatrixXT t_matCorGramDiag(3, 3*m_iNumGridPoints);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for num_threads(m_iMaxNumThreads)
+    #endif
+    for(int i = 0; i < m_iNumGridPoints; ++i)
+    {
+        t_matGramDiag.middleCols<3>(3*i).noalias() = p_matProj_LeadField.middleCols<3>(3*i).transpose() * p_matProj_LeadField.middleCols<3>(3*i);
+        t_matCorGramDiag.middleCols<3>(3*i).noalias() = t_matW.middleCols<3>(3*i).transpose() * t_matW.middleCols<3>(3*i);
+    }
+
+    //The tiles are enumerated in the same upper triangular order as the pairs within the tiles
+    int t_iNumTiles = (m_iNumGridPoints + PAIR_TILE_SIZE - 1) / PAIR_TILE_SIZE;
+    int t_iNumTileCombinations = MNEMath::nchoose2(t_iNumTiles+1);
+
+    double t_dMaxCor = -1.0;
+    qint64 t_iMaxIdx = -1;
+    p_pairMaxIdx.x1 = 0;
+    p_pairMaxIdx.x2 = 0;
+
+    #ifdef _OPENMP
+    #pragma omp parallel num_threads(m_iMaxNumThreads)
+    #endif
+    {
+        //Thread local maximum -> no global correlation vector needed
+        double t_dThreadMaxCor = -1.0;
+        qint64 t_iThreadMaxIdx = -1;
+        Pair t_pairThreadMaxIdx = {0, 0};
+
+        Matrix6T t_matGram;
+        Matrix6T t_matCorGram;
+
+    #ifdef _OPENMP
+    #pragma omp for schedule(dynamic)
+    #endif
+        for(int t = 0; t < t_iNumTileCombinations; ++t)
+        {
+            int t_iTile1, t_iTile2;
+            RapMusic::getPointPair(t_iNumTiles, t, t_iTile1, t_iTile2);
+
+            int t_iBegin1 = t_iTile1 * PAIR_TILE_SIZE;
+            int t_iEnd1 = std::min(t_iBegin1 + PAIR_TILE_SIZE, m_iNumGridPoints);
+            int t_iBegin2 = t_iTile2 * PAIR_TILE_SIZE;
+            int t_iEnd2 = std::min(t_iBegin2 + PAIR_TILE_SIZE, m_iNumGridPoints);
+
+            for(int idx1 = t_iBegin1; idx1 < t_iEnd1; ++idx1)
+            {
+                t_matGram.topLeftCorner<3,3>() = t_matGramDiag.middleCols<3>(3*idx1);
+                t_matCorGram.topLeftCorner<3,3>() = t_matCorGramDiag.middleCols<3>(3*idx1);
+
+                for(int idx2 = std::max(idx1, t_iBegin2); idx2 < t_iEnd2; ++idx2)
+                {
+                    t_matGram.bottomRightCorner<3,3>() = t_matGramDiag.middleCols<3>(3*idx2);
+                    t_matGram.topRightCorner<3,3>().noalias() = p_matProj_LeadField.middleCols<3>(3*idx1).transpose() * p_matProj_LeadField.middleCols<3>(3*idx2);
+                    t_matGram.bottomLeftCorner<3,3>() = t_matGram.topRightCorner<3,3>().transpose();
+
+                    t_matCorGram.bottomRightCorner<3,3>() = t_matCorGramDiag.middleCols<3>(3*idx2);
+                    t_matCorGram.topRightCorner<3,3>().noalias() = t_matW.middleCols<3>(3*idx1).transpose() * t_matW.middleCols<3>(3*idx2);
+                    t_matCorGram.bottomLeftCorner<3,3>() = t_matCorGram.topRightCorner<3,3>().transpose();
+
+                    double t_dCor = RapMusic::subcorr(t_matGram, t_matCorGram);
+
+                    //Ties are resolved to the lowest combination index, like the former maxCoeff over all combinations
+                    qint64 t_iIdx = RapMusic::getPairIdx(m_iNumGridPoints, idx1, idx2);
+                    if(t_dCor > t_dThreadMaxCor || (t_dCor == t_dThreadMaxCor && t_iIdx < t_iThreadMaxIdx))
+                    {
+                        t_dThreadMaxCor = t_dCor;
+                        t_iThreadMaxIdx = t_iIdx;
+                        t_pairThreadMaxIdx.x1 = idx1;
+                        t_pairThreadMaxIdx.x2 = idx2;
+                    }
+                }
+            }
+        }
+
+    #ifdef _OPENMP
+    #pragma omp critical
+    #endif
+        {
+            if(t_iThreadMaxIdx >= 0 && (t_dThreadMaxCor > t_dMaxCor || (t_dThreadMaxCor == t_dMaxCor && t_iThreadMaxIdx < t_iMaxIdx)))
+            {
+                t_dMaxCor = t_dThreadMaxCor;
+                t_iMaxIdx = t_iThreadMaxIdx;
+                p_pairMaxIdx = t_pairThreadMaxIdx;
+            }
+        }
+    }
+
+    return t_dMaxCor;
+}
+
+//=============================================================================================================
+
 void RapMusic::calcA_k_1(   const MatrixX6T& p_matG_k_1,
                             const Vector6T& p_matPhi_k_1,
                             const int p_iIdxk_1,
@@ -790,44 +862,16 @@ void RapMusic::calcOrthProj(const MatrixXT& p_matA_k_1, MatrixXT& p_matOrthProj)
 
 //=============================================================================================================
 
-void RapMusic::calcPairCombinations(    const int p_iNumPoints,
-                                        const int p_iNumCombinations,
-                                        Pair** p_ppPairIdxCombinations) const
-{
-    int idx1 = 0;
-    int idx2 = 0;
-
-    //Process Code in {m_max_num_threads} threads -> When compile with Intel Compiler -> probably obsolete
-    #ifdef _OPENMP
-    #pragma omp parallel num_threads(m_iMaxNumThreads) private(idx1, idx2)
-    #endif
-    {
-    #ifdef _OPENMP
-    #pragma omp for
-    #endif
-        for (int i = 0; i < p_iNumCombinations; ++i)
-        {
-            RapMusic::getPointPair(p_iNumPoints, i, idx1, idx2);
-
-            Pair* t_pairCombination = new Pair();
-            t_pairCombination->x1 = idx1;
-            t_pairCombination->x2 = idx2;
-
-            p_ppPairIdxCombinations[i] = t_pairCombination;
-        }
-    }
-}
-
-//=============================================================================================================
-
 void RapMusic::getPointPair(const int p_iPoints, const int p_iCurIdx, int &p_iIdx1, int &p_iIdx2)
 {
-    int ii = p_iPoints*(p_iPoints+1)/2-1-p_iCurIdx;
-    int K = (int)floor((sqrt((double)(8*ii+1))-1)/2);
+    //64 bit intermediates -> the triangular numbers overflow int for large grids
+    qint64 t_iNumCombinations = (qint64)p_iPoints*(p_iPoints+1)/2;
+    qint64 ii = t_iNumCombinations-1-p_iCurIdx;
+    qint64 K = (qint64)floor((sqrt((double)(8*ii+1))-1)/2);
 
-    p_iIdx1 = p_iPoints-1-K;
+    p_iIdx1 = p_iPoints-1-(int)K;
 
-    p_iIdx2 = (p_iCurIdx-p_iPoints*(p_iPoints+1)/2 + (K+1)*(K+2)/2)+p_iIdx1;
+    p_iIdx2 = (int)(p_iCurIdx-t_iNumCombinations + (K+1)*(K+2)/2)+p_iIdx1;
 }
 
 //=============================================================================================================
@@ -58,6 +58,7 @@
 #include <Eigen/Core>
 #include <Eigen/SVD>
 #include <Eigen/LU>
+#include <Eigen/Eigenvalues>
 
 //=============================================================================================================
 // DEFINE NAMESPACE INVERSELIB
@@ -72,6 +73,7 @@ namespace INVERSELIB
 
 #define NOT_TRANSPOSED   0  /**< Defines NOT_TRANSPOSED */
 #define IS_TRANSPOSED   1   /**< Defines IS_TRANSPOSED */
+#define PAIR_TILE_SIZE  32  /**< Grid points per scan tile, the Lead Field columns of two tiles stay in cache */
 
 //=============================================================================================================
 /**
@@ -210,6 +212,35 @@ protected:
      */
     static double subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vector6T& p_vec_phi_k_1);
 
+    //=========================================================================================================
+    /**
+     * Computes the subspace correlation of a Lead Field pair out of its 6 x 6 Gram matrices, without forming the
+     * m x 6 pair matrix and its SVD. With G^T G = V D V^T (restricted to the singular values of G which pass
+     * the rank threshold of getRank) the correlation is the square root of the largest eigenvalue of
+     * D^-1/2 V^T (G^T U_B U_B^T G) V D^-1/2, which equals the largest singular value of U_A^T U_B.
+     *
+     * @param[in] p_matGram      The Gram matrix G^T G of the projected Lead Field combination.
+     * @param[in] p_matCorGram   The Gram matrix (U_B^T G)^T (U_B^T G) of the projected Lead Field combination.
+     * @return   The maximal correlation c_1 of the subspace correlation of the current projected Lead Field
+     *           combination and the projected measurement.
+     */
+    static double subcorr(const Matrix6T& p_matGram, const Matrix6T& p_matCorGram);
+
+    //=========================================================================================================
+    /**
+     * Scans all Lead Field pair combinations for the maximal subspace correlation. The pair combinations are
+     * generated on the fly in tiles of grid points, each thread keeps track of its own maximum and the thread
+     * maxima are merged at the end.
+     *
+     * @param[in] p_matProj_LeadField    The projected Lead Field matrix (m x 3*grid points).
+     * @param[in] p_matU_B               The matrix U is the subspace projection of the orthogonal projected Phi_s.
+     * @param[out] p_pairMaxIdx          The grid point indices of the maximal correlated pair.
+     * @return   The maximal correlation.
+     */
+    double scanPairCombinations(const MatrixXT& p_matProj_LeadField,
+                                const MatrixXT& p_matU_B,
+                                Pair& p_pairMaxIdx) const;
+
     //=========================================================================================================
     /**
      * Calculates the accumulated manifold vectors A_{k1}
@@ -234,21 +265,6 @@ protected:
      */
     void calcOrthProj(const MatrixXT& p_matA_k_1, MatrixXT& p_matOrthProj) const;
 
-    //=========================================================================================================
-    /**
-     * Pre-Calculates the gain matrix index combinations to search for a two dipole independent topography
-     * (IT = source).
-     *
-     * @param[in] p_iNumPoints   The number of Lead Field points -> for dimension check
-     * @param[in] p_iNumCombinations The number of pair index combinations.
-     * @param[out] p_ppPairIdxCombinations   The destination which contains pointer to pointer of index
-     *                                       combinations of Lead Field indices -> Number of pointers =
-     *                                       Combination (number of grid points over 2 = Num + 1 C 2)
-     */
-    void calcPairCombinations(  const int p_iNumPoints,
-                                const int p_iNumCombinations,
-                                Pair** p_ppPairIdxCombinations) const;
-
     //=========================================================================================================
     /**
      * Calculates the combination indices Idx1 and Idx2 of n points.\n
@@ -267,6 +283,18 @@ protected:
      */
     static void getPointPair(const int p_iPoints, const int p_iCurIdx, int &p_iIdx1, int &p_iIdx2);
 
+    //=========================================================================================================
+    /**
+     * Calculates the combination index of the grid point pair (p_iIdx1, p_iIdx2) with p_iIdx1 <= p_iIdx2 of
+     * n points. This is the inverse of getPointPair.
+     *
+     * @param[in] p_iPoints  The number of points n which are combined with each other.
+     * @param[in] p_iIdx1    The index 1.
+     * @param[in] p_iIdx2    The index 2.
+     * @return   The combination index (between 0 and nchoosek(n+1,2)).
+     */
+    static inline qint64 getPairIdx(const int p_iPoints, const int p_iIdx1, const int p_iIdx2);
+
     //=========================================================================================================
     /**
      * Returns a gain matrix pair for the given indices
@@ -304,9 +332,7 @@ protected:
 
     int m_iNumGridPoints;               /**< Number of Grid points. */
     int m_iNumChannels;                 /**< Number of channels */
-    int m_iNumLeadFieldCombinations;    /**< Number of Lead Filed combinations (grid points + 1 over 2)*/
-
-    Pair** m_ppPairIdxCombinations; /**< Index combination vector with grid pair indices. */
+    qint64 m_iNumLeadFieldCombinations; /**< Number of Lead Filed combinations (grid points + 1 over 2)*/
 
     int m_iMaxNumThreads;   /**< Number of available CPU threads. */
 
@@ -388,6 +414,14 @@ inline int RapMusic::useFullRank(   const MatrixXT& p_Mat,
 
 //=============================================================================================================
 
+inline qint64 RapMusic::getPairIdx(const int p_iPoints, const int p_iIdx1, const int p_iIdx2)
+{
+    //Row offset of idx1 in the upper triangle (including the diagonal) plus the position within the row
+    return (qint64)p_iIdx1*p_iPoints - ((qint64)(p_iIdx1-1)*p_iIdx1)/2 + (p_iIdx2 - p_iIdx1);
+}
+
+//=============================================================================================================
+
 inline RapMusic::MatrixXT RapMusic::makeSquareMat(const MatrixXT& p_matF)
 {
     //Make rectangular - p_matF*p_matF^T
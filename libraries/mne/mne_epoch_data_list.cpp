@@ -43,13 +43,23 @@
 
 #include <utils/mnemath.h>
 
+#include <limits>
+#include <algorithm>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
 #include <QPointer>
-#include <QtConcurrent>
 #include <QDebug>
+#include <QVector>
+#include <QtConcurrent>
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_EPOCH_SEGMENT_SAMPLES 20000     /**< Maximum number of samples read at once when extracting epochs. */
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -121,52 +131,114 @@ MNEEpochDataList MNEEpochDataList::readEpochs(const FiffRawData& raw,
         }
     }
 
-    fiff_int_t event_samp, from, to;
-    fiff_int_t dropCount = 0;
-    MatrixXd timesDummy;
-    MatrixXd times;
+    // Create the thresholds of the picked channels once for all epochs
+    VectorXd vecThresholdsAll = makeArtifactThresholds(raw.info, mapReject, lExcludeChs);
+    VectorXd vecThresholds(picksNew.cols());
+    for(int i = 0; i < picksNew.cols(); ++i) {
+        vecThresholds(i) = vecThresholdsAll(picksNew(i));
+    }
 
-    QScopedPointer<MNEEpochData> epoch(Q_NULLPTR);
+    // Sort the events by sample so that neighbouring epochs can be sliced from one raw segment
+    fiff_int_t event_samp;
+    QVector<fiff_int_t> vecFrom(count);
+    QVector<fiff_int_t> vecTo(count);
+    QVector<QPair<fiff_int_t,qint32> > vecOrder(count);
 
     for (p = 0; p < count; ++p) {
-        // Read a data segment
         event_samp = events(selected(p),0);
-        from = event_samp + tmin*raw.info.sfreq;
-        to   = event_samp + floor(tmax*raw.info.sfreq + 0.5);
+        vecFrom[p] = event_samp + tmin*raw.info.sfreq;
+        vecTo[p] = event_samp + floor(tmax*raw.info.sfreq + 0.5);
+        vecOrder[p] = qMakePair(vecFrom[p], p);
+    }
 
-        epoch.reset(new MNEEpochData());
+    std::sort(vecOrder.begin(), vecOrder.end());
 
-        if(raw.read_raw_segment(epoch->epoch, timesDummy, from, to, picksNew)) {
-            if (p == 0) {
-                times.resize(1, to-from+1);
-                for (qint32 i = 0; i < times.cols(); ++i)
-                    times(0, i) = ((float)(from-event_samp+i)) / raw.info.sfreq;
+    fiff_int_t iEpochSamples = vecTo[0] - vecFrom[0] + 1;
+    fiff_int_t segFrom, segTo;
+    MatrixXd timesDummy;
+    MatrixXd matSegment;
+    QVector<MNEEpochData::SPtr> vecEpochs(count);
+    QList<QFuture<void> > lFutures;
+
+    qint32 iFirst = 0;
+    while (iFirst < count) {
+        // Collect all epochs which overlap or are close enough to be read as one segment
+        qint32 iLast = iFirst;
+        segFrom = vecFrom[vecOrder[iFirst].second];
+        segTo = vecTo[vecOrder[iFirst].second];
+
+        while (iLast + 1 < count) {
+            qint32 iNext = vecOrder[iLast + 1].second;
+
+            if(vecFrom[iNext] > segTo + iEpochSamples
+               || vecTo[iNext] - segFrom + 1 > MAX_EPOCH_SEGMENT_SAMPLES) {
+                break;
             }
 
-            epoch->event = event;
-            epoch->tmin = tmin;
-            epoch->tmax = tmax;
+            segTo = qMax(segTo, vecTo[iNext]);
+            ++iLast;
+        }
 
-            epoch->bReject = checkForArtifact(epoch->epoch,
-                                              raw.info,
-                                              mapReject,
-                                              lExcludeChs);
+        // Decode and calibrate the raw buffers of this segment once
+        if(raw.read_raw_segment(matSegment, timesDummy, segFrom, segTo, picksNew)) {
+            // read_raw_segment clamps the segment to the available data
+            segFrom = qMax(segFrom, raw.first_samp);
+            segTo = segFrom + matSegment.cols() - 1;
 
-            if (epoch->bReject) {
-                dropCount++;
-            }
+            QList<MNEEpochData::SPtr> lSegmentEpochs;
 
-            //Check if data block has the same size as the previous one
-            if(!data.isEmpty()) {
-                if(epoch->epoch.size() == data.last()->epoch.size()) {
-                    data.append(MNEEpochData::SPtr(epoch.take()));//List takes ownwership of the pointer - no delete need
+            for (p = iFirst; p <= iLast; ++p) {
+                qint32 iIdx = vecOrder[p].second;
+
+                if(vecFrom[iIdx] < segFrom || vecTo[iIdx] > segTo) {
+                    printf("Epoch %d exceeds the available data. Skipping.\n", iIdx);
+                    continue;
                 }
-            } else {
-                data.append(MNEEpochData::SPtr(epoch.take()));//List takes ownwership of the pointer - no delete need
+
+                MNEEpochData::SPtr pEpoch(new MNEEpochData());
+                pEpoch->epoch = matSegment.middleCols(vecFrom[iIdx] - segFrom, vecTo[iIdx] - vecFrom[iIdx] + 1);
+                pEpoch->event = event;
+                pEpoch->tmin = tmin;
+                pEpoch->tmax = tmax;
+
+                vecEpochs[iIdx] = pEpoch;
+                lSegmentEpochs.append(pEpoch);
             }
+
+            // Check the epochs of this segment for artifacts while the next segment is read
+            lFutures.append(QtConcurrent::run([lSegmentEpochs, vecThresholds]() {
+                for(int i = 0; i < lSegmentEpochs.size(); ++i) {
+                    lSegmentEpochs.at(i)->bReject = checkForArtifact(lSegmentEpochs.at(i)->epoch,
+                                                                     vecThresholds);
+                }
+            }));
         } else {
             printf("Can't read the event data segments\n");
         }
+
+        iFirst = iLast + 1;
+    }
+
+    for(int i = 0; i < lFutures.size(); ++i) {
+        lFutures[i].waitForFinished();
+    }
+
+    // Keep the order of the events
+    fiff_int_t dropCount = 0;
+
+    for (p = 0; p < count; ++p) {
+        if(!vecEpochs[p]) {
+            continue;
+        }
+
+        if (vecEpochs[p]->bReject) {
+            dropCount++;
+        }
+
+        //Check if data block has the same size as the previous one
+        if(data.isEmpty() || vecEpochs[p]->epoch.size() == data.last()->epoch.size()) {
+            data.append(vecEpochs[p]);
+        }
     }
 
     qDebug() << "MNEEpochDataList::readEpochs - Read a total of"<< data.size() <<"epochs of type" << event << "and marked"<< dropCount <<"for rejection";
@@ -233,11 +305,10 @@ FiffEvoked MNEEpochDataList::average(FiffInfo& info, fiff_int_t first, fiff_int_
 
 void MNEEpochDataList::applyBaselineCorrection(QPair<QVariant, QVariant>& baseline)
 {
-    // Run baseline correction
-    QMutableListIterator<MNEEpochData::SPtr> i(*this);
-    while (i.hasNext()) {
-        i.next()->applyBaselineCorrection(baseline);
-    }
+    // Run baseline correction on all epochs in parallel
+    QtConcurrent::blockingMap(*this, [&baseline](MNEEpochData::SPtr& epoch) {
+        epoch->applyBaselineCorrection(baseline);
+    });
 }
 
 //=============================================================================================================
@@ -271,10 +342,56 @@ bool MNEEpochDataList::checkForArtifact(const MatrixXd& data,
 {
     //qDebug() << "MNEEpochDataList::checkForArtifact - Doing artifact reduction for" << mapReject;
 
-    bool bReject = false;
+    return checkForArtifact(data,
+                            makeArtifactThresholds(pFiffInfo,
+                                                   mapReject,
+                                                   lExcludeChs));
+}
+
+//=============================================================================================================
+
+bool MNEEpochDataList::checkForArtifact(const MatrixXd& data,
+                                        const VectorXd& vecThresholds)
+{
+    if(data.cols() == 0 || data.rows() != vecThresholds.rows()) {
+        if(data.rows() != vecThresholds.rows()) {
+            qDebug() << "MNEEpochDataList::checkForArtifact - Number of thresholds" << vecThresholds.rows() << "does not match number of channels" << data.rows() << ". Do not reject. Returning.";
+        }
+
+        return false;
+    }
+
+    // Scan all channels in one pass over the column major data
+    VectorXd vecMin = data.col(0);
+    VectorXd vecMax = data.col(0);
+
+    for(int i = 1; i < data.cols(); ++i) {
+        vecMin = vecMin.cwiseMin(data.col(i));
+        vecMax = vecMax.cwiseMax(data.col(i));
+    }
+
+    // Peak to Peak
+    VectorXd::Index iChIdx;
+    double dExceed = ((vecMax - vecMin) - vecThresholds).maxCoeff(&iChIdx);
+
+    if(dExceed > 0.0) {
+        qDebug() << "MNEEpochDataList::checkForArtifact - Reject trial because of channel index" << iChIdx;
+        return true;
+    }
+
+    return false;
+}
+
+//=============================================================================================================
+
+VectorXd MNEEpochDataList::makeArtifactThresholds(const FiffInfo& pFiffInfo,
+                                                  const QMap<QString,double>& mapReject,
+                                                  const QStringList& lExcludeChs)
+{
+    const double dInf = std::numeric_limits<double>::infinity();
+
+    VectorXd vecThresholds = VectorXd::Constant(pFiffInfo.chs.size(), dInf);
 
-    //Prepare concurrent data handling
-    QList<ArtifactRejectionData> lchData;
     QList<int> lChTypes;
 
     if(mapReject.contains("grad") ||
@@ -291,7 +408,7 @@ bool MNEEpochDataList::checkForArtifact(const MatrixXd& data,
     }
 
     if(lChTypes.isEmpty()) {
-        return bReject;
+        return vecThresholds;
     }
 
     for(int i = 0; i < pFiffInfo.chs.size(); ++i) {
@@ -300,85 +417,25 @@ bool MNEEpochDataList::checkForArtifact(const MatrixXd& data,
            && !pFiffInfo.bads.contains(pFiffInfo.chs.at(i).ch_name)
            && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG
            && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG2) {
-            ArtifactRejectionData tempData;
-            tempData.data = data.row(i);
-
             switch (pFiffInfo.chs.at(i).kind) {
             case FIFFV_MEG_CH:
                 if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T) {
-                    tempData.dThreshold = mapReject["mag"];
+                    vecThresholds(i) = mapReject.value("mag", dInf);
                 } else if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T_M) {
-                    tempData.dThreshold = mapReject["grad"];
+                    vecThresholds(i) = mapReject.value("grad", dInf);
                 }
             break;
 
             case FIFFV_EEG_CH:
-                tempData.dThreshold = mapReject["eeg"];
+                vecThresholds(i) = mapReject.value("eeg", dInf);
             break;
 
             case FIFFV_EOG_CH:
-                tempData.dThreshold = mapReject["eog"];
+                vecThresholds(i) = mapReject.value("eog", dInf);
             break;
             }
-
-            tempData.sChName = pFiffInfo.chs.at(i).ch_name;
-            lchData.append(tempData);
-        }
-    }
-
-    if(lchData.isEmpty()) {
-        qDebug() << "MNEEpochDataList::checkForArtifact - No channels found to scan for artifacts. Do not reject. Returning.";
-
-        return bReject;
-    }
-
-    //qDebug() << "MNEEpochDataList::checkForArtifact - lchData.size()" << lchData.size();
-
-    //Start the concurrent processing
-    QFuture<void> future = QtConcurrent::map(lchData, checkChThreshold);
-    future.waitForFinished();
-
-    for(int i = 0; i < lchData.size(); ++i) {
-        if(lchData.at(i).bRejected) {
-            bReject = true;
-            qDebug() << "MNEEpochDataList::checkForArtifact - Reject trial because of channel"<<lchData.at(i).sChName;
-            break;
         }
     }
 
-    return bReject;
-}
-
-//=============================================================================================================
-
-void MNEEpochDataList::checkChThreshold(ArtifactRejectionData& inputData)
-{
-    RowVectorXd temp = inputData.data;
-
-    // Remove offset
-    //temp = temp.array() - temp(0);
-
-    double min = temp.minCoeff();
-    double max = temp.maxCoeff();
-
-    // Peak to Peak
-    double pp = max - min;
-
-    if(std::fabs(pp) > inputData.dThreshold) {
-        inputData.bRejected = true;
-    } else {
-        inputData.bRejected = false;
-    }
-
-//    qDebug() << "MNEEpochDataList::checkChThreshold - min" << min;
-//    qDebug() << "MNEEpochDataList::checkChThreshold - max" << max;
-//    qDebug() << "MNEEpochDataList::checkChThreshold - pp" << pp;
-//    qDebug() << "MNEEpochDataList::checkChThreshold - inputData.dThreshold" << inputData.dThreshold;
-
-//    //If absolute vaue of min or max if bigger than threshold -> reject
-//    if((std::fabs(min) > inputData.dThreshold) || (std::fabs(max) > inputData.dThreshold)) {
-//        inputData.bRejected = true;
-//    } else {
-//        inputData.bRejected = false;
-//    }
+    return vecThresholds;
 }
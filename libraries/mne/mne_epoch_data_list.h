@@ -62,13 +62,6 @@
 namespace MNELIB
 {
 
-struct ArtifactRejectionData {
-    bool bRejected = false;
-    Eigen::RowVectorXd data;
-    double dThreshold;
-    QString sChName;
-};
-
 //=============================================================================================================
 /**
  * Epoch data list, which corresponds to a set of events
@@ -171,7 +164,34 @@ public:
                                  const QMap<QString,double>& mapReject,
                                  const QStringList &lExcludeChs = QStringList());
 
-    static void checkChThreshold(ArtifactRejectionData& inputData);
+    //=========================================================================================================
+    /**
+     * Checks the givven matrix for peak-to-peak amplitudes beyond the per channel threshold values. Use this
+     * version when scanning many data blocks of the same channel set and create the thresholds once via
+     * makeArtifactThresholds.
+     *
+     * @param[in] data           The data matrix (channels x samples).
+     * @param[in] vecThresholds  The peak-to-peak threshold of each channel (rows of data).
+     *
+     * @return   Whether a threshold artifact was detected.
+     */
+    static bool checkForArtifact(const Eigen::MatrixXd& data,
+                                 const Eigen::VectorXd& vecThresholds);
+
+    //=========================================================================================================
+    /**
+     * Creates the peak-to-peak threshold of each channel. Channels which are not scanned, i.e. channels of other
+     * types, excluded, bad and reference channels, get an infinite threshold.
+     *
+     * @param[in] pFiffInfo      The fiff info.
+     * @param[in] mapReject      The channel data types to scan for. EEG, MEG or EOG.
+     * @param[in] lExcludeChs    List of channel names to exclude.
+     *
+     * @return   The thresholds, one per channel in pFiffInfo.
+     */
+    static Eigen::VectorXd makeArtifactThresholds(const FIFFLIB::FiffInfo& pFiffInfo,
+                                                  const QMap<QString,double>& mapReject,
+                                                  const QStringList &lExcludeChs = QStringList());
 };
 } // NAMESPACE
 
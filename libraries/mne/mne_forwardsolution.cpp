@@ -1194,7 +1194,8 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
                               bool surf_ori,
                               const QStringList& include,
                               const QStringList& exclude,
-                              bool bExcludeBads)
+                              bool bExcludeBads,
+                              const QList<Label>& p_qListLabels)
 {
     FiffStream::SPtr t_pStream(new FiffStream(&p_IODevice));
 
@@ -1251,6 +1252,55 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
         }
     }
 
+    QStringList exclude_bads = exclude;
+    if (bads.size() > 0)
+    {
+        for(qint32 k = 0; k < bads.size(); ++k)
+            if(!exclude_bads.contains(bads[k],Qt::CaseInsensitive))
+                exclude_bads << bads[k];
+    }
+
+    //
+    //   Select the sources within the labels, the same way pick_regions does
+    //
+    VectorXi vecSourceSel;
+    if (p_qListLabels.size() > 0)
+    {
+        qint32 offset = 0;
+        for(qint32 h = 0; h < t_SourceSpace.size(); ++h)
+        {
+            VectorXi selVertices;
+            qint32 iSize = 0;
+            for(qint32 i = 0; i < p_qListLabels.size(); ++i)
+            {
+                if(p_qListLabels[i].hemi == h)
+                {
+                    VectorXi currentSelection;
+                    MNEMath::intersect(t_SourceSpace[h].vertno, p_qListLabels[i].vertices, currentSelection);
+
+                    selVertices.conservativeResize(iSize+currentSelection.size());
+                    selVertices.block(iSize,0,currentSelection.size(),1) = currentSelection;
+                    iSize = selVertices.size();
+                }
+            }
+            MNEMath::sort(selVertices, false);
+
+            vecSourceSel.conservativeResize(vecSourceSel.size() + selVertices.size());
+            vecSourceSel.tail(selVertices.size()) = (selVertices.array() + offset).matrix();
+            offset += t_SourceSpace[h].nuse;
+        }
+
+        if (vecSourceSel.size() == 0)
+        {
+            t_pStream->close();
+            std::cout << "No sources within the labels\n"; // ToDo throw error
+            return false;
+        }
+
+        t_SourceSpace = t_SourceSpace.pick_regions(p_qListLabels);
+        printf("\t%d sources within the labels\n", (int)vecSourceSel.size());
+    }
+
     //
     //   Locate and read the forward solutions
     //
@@ -1277,9 +1327,14 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
         }
     }
 
+    //
+    //   Channels and sources are picked while the solutions are read
+    //
+    bool bPick = include.size() > 0 || exclude_bads.size() > 0;
+
     MNEForwardSolution megfwd;
     QString ori;
-    if (read_one(t_pStream, megnode, megfwd))
+    if (read_one(t_pStream, megnode, megfwd, include, exclude_bads, vecSourceSel))
     {
         if (megfwd.source_ori == FIFFV_MNE_FIXED_ORI)
             ori = QString("fixed");
@@ -1288,7 +1343,7 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
         printf("\tRead MEG forward solution (%d sources, %d channels, %s orientations)\n", megfwd.nsource,megfwd.nchan,ori.toUtf8().constData());
     }
     MNEForwardSolution eegfwd;
-    if (read_one(t_pStream, eegnode, eegfwd))
+    if (read_one(t_pStream, eegnode, eegfwd, include, exclude_bads, vecSourceSel))
     {
         if (eegfwd.source_ori == FIFFV_MNE_FIXED_ORI)
             ori = QString("fixed");
@@ -1297,6 +1352,14 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
         printf("\tRead EEG forward solution (%d sources, %d channels, %s orientations)\n", eegfwd.nsource,eegfwd.nchan,ori.toUtf8().constData());
     }
 
+    if (bPick && megfwd.isEmpty() && eegfwd.isEmpty() && t_pStream->device()->isOpen())
+    {
+        printf("Nothing remains after picking. Returning original forward solution.\n");
+        bPick = false;
+        read_one(t_pStream, megnode, megfwd, defaultQStringList, defaultQStringList, vecSourceSel);
+        read_one(t_pStream, eegnode, eegfwd, defaultQStringList, defaultQStringList, vecSourceSel);
+    }
+
     //
     //   Merge the MEG and EEG solutions together
     //
@@ -1540,19 +1603,33 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
     }
 
     //
-    //   Do the channel selection
+    //   Restrict the channel info to the picked channels
     //
-    QStringList exclude_bads = exclude;
-    if (bads.size() > 0)
+    fwd.surf_ori = surf_ori;
+    if (bPick)
     {
-        for(qint32 k = 0; k < bads.size(); ++k)
-            if(!exclude_bads.contains(bads[k],Qt::CaseInsensitive))
-                exclude_bads << bads[k];
+        QList<FiffChInfo> chs;
+        QStringList ch_names;
+        for(qint32 i = 0; i < fwd.sol->row_names.size(); ++i)
+        {
+            qint32 idx = fwd.info.ch_names.indexOf(fwd.sol->row_names[i]);
+            if(idx >= 0 && idx < fwd.info.chs.size())
+            {
+                chs.append(fwd.info.chs[idx]);
+                ch_names.append(fwd.info.ch_names[idx]);
+            }
+        }
+        fwd.info.chs = chs;
+        fwd.info.ch_names = ch_names;
+        fwd.info.nchan = chs.size();
+
+        QStringList info_bads;
+        for(qint32 i = 0; i < fwd.info.bads.size(); ++i)
+            if(ch_names.contains(fwd.info.bads[i]))
+                info_bads.append(fwd.info.bads[i]);
+        fwd.info.bads = info_bads;
     }
 
-    fwd.surf_ori = surf_ori;
-    fwd = fwd.pick_channels(include, exclude_bads);
-
 //    //
 //    //   Do the channel selection - OLD VERSION
 //    //
@@ -1683,7 +1760,10 @@ bool MNEForwardSolution::read(QIODevice& p_IODevice,
 
 bool MNEForwardSolution::read_one(FiffStream::SPtr& p_pStream,
                                   const FiffDirNode::SPtr& p_Node,
-                                  MNEForwardSolution& one)
+                                  MNEForwardSolution& one,
+                                  const QStringList& include,
+                                  const QStringList& exclude,
+                                  const VectorXi& p_vecSourceSel)
 {
     //
     //   Read all interesting stuff for one forward solution
@@ -1730,9 +1810,12 @@ bool MNEForwardSolution::read_one(FiffStream::SPtr& p_pStream,
 
     one.nchan = *t_pTag->toInt();
 
-    if(p_pStream->read_named_matrix(p_Node, FIFF_MNE_FORWARD_SOLUTION, *one.sol.data()))
-        one.sol->transpose_named_matrix();
-    else
+    //
+    //   Read the names and dimensions first. The solution is stored with one row per source component and one
+    //   column per channel, and is transposed while the selected part is decoded.
+    //
+    FiffNamedMatrix t_solInfo;
+    if(!p_pStream->read_named_matrix_info(p_Node, FIFF_MNE_FORWARD_SOLUTION, t_solInfo))
     {
         p_pStream->close();
         printf("Forward solution data not found ."); //ToDo: throw error.
@@ -1740,29 +1823,110 @@ bool MNEForwardSolution::read_one(FiffStream::SPtr& p_pStream,
         return false;
     }
 
-    if(p_pStream->read_named_matrix(p_Node, FIFF_MNE_FORWARD_SOLUTION_GRAD, *one.sol_grad.data()))
-        one.sol_grad->transpose_named_matrix();
-    else
-        one.sol_grad->clear();
-
-    if (one.sol->data.rows() != one.nchan ||
-            (one.sol->data.cols() != one.nsource && one.sol->data.cols() != 3*one.nsource))
+    if (t_solInfo.ncol != one.nchan ||
+            (t_solInfo.nrow != one.nsource && t_solInfo.nrow != 3*one.nsource))
     {
         p_pStream->close();
         printf("Forward solution matrix has wrong dimensions.\n"); //ToDo: throw error.
         //error(me,'Forward solution matrix has wrong dimensions');
         return false;
     }
-    if (!one.sol_grad->isEmpty())
+
+    FiffNamedMatrix t_solGradInfo;
+    bool bHasGrad = p_pStream->read_named_matrix_info(p_Node, FIFF_MNE_FORWARD_SOLUTION_GRAD, t_solGradInfo);
+    if (bHasGrad)
     {
-        if (one.sol_grad->data.rows() != one.nchan ||
-                (one.sol_grad->data.cols() != 3*one.nsource && one.sol_grad->data.cols() != 3*3*one.nsource))
+        if (t_solGradInfo.ncol != one.nchan ||
+                (t_solGradInfo.nrow != 3*one.nsource && t_solGradInfo.nrow != 3*3*one.nsource))
         {
-            p_pStream->close();
             printf("Forward solution gradient matrix has wrong dimensions.\n"); //ToDo: throw error.
             //error(me,'Forward solution gradient matrix has wrong dimensions');
+            bHasGrad = false;
         }
     }
+
+    //
+    //   Channel selection
+    //
+    VectorXi vecChSel;
+    if (include.size() > 0 || exclude.size() > 0)
+    {
+        vecChSel = FiffInfo::pick_channels(t_solInfo.col_names, include, exclude).transpose();
+
+        if (vecChSel.size() == 0)
+        {
+            one.clear();
+            return false;
+        }
+        printf("\t%d out of %d channels remain after picking\n", (int)vecChSel.size(), one.nchan);
+    }
+
+    //
+    //   Source selection, expanded to the rows of each source
+    //
+    auto sourceRows = [&p_vecSourceSel](qint32 nPerSource) -> VectorXi {
+        VectorXi vecRowSel(p_vecSourceSel.size() * nPerSource);
+        for(qint32 i = 0; i < p_vecSourceSel.size(); ++i)
+            for(qint32 k = 0; k < nPerSource; ++k)
+                vecRowSel[i*nPerSource + k] = p_vecSourceSel[i]*nPerSource + k;
+        return vecRowSel;
+    };
+
+    auto selectNames = [](const QStringList& names, const VectorXi& sel) -> QStringList {
+        if(sel.size() == 0)
+            return names;
+        QStringList selNames;
+        for(qint32 i = 0; i < sel.size(); ++i)
+            if(sel[i] < names.size())
+                selNames << names[sel[i]];
+        return selNames;
+    };
+
+    if (p_vecSourceSel.size() > 0 && p_vecSourceSel.maxCoeff() >= one.nsource)
+    {
+        p_pStream->close();
+        printf("Source selection exceeds the number of sources.\n"); //ToDo: throw error.
+        return false;
+    }
+
+    VectorXi vecRowSel = p_vecSourceSel.size() > 0 ? sourceRows(t_solInfo.nrow / one.nsource) : VectorXi();
+
+    MatrixXf t_matData;
+    if(!p_pStream->read_named_matrix_data(p_Node, FIFF_MNE_FORWARD_SOLUTION, vecRowSel, vecChSel, t_matData))
+    {
+        p_pStream->close();
+        printf("Forward solution data not found ."); //ToDo: throw error.
+        return false;
+    }
+
+    one.sol->data = t_matData.transpose().cast<double>();
+    one.sol->nrow = one.sol->data.rows();
+    one.sol->ncol = one.sol->data.cols();
+    one.sol->row_names = selectNames(t_solInfo.col_names, vecChSel);
+    one.sol->col_names = selectNames(t_solInfo.row_names, vecRowSel);
+
+    if (bHasGrad)
+    {
+        vecRowSel = p_vecSourceSel.size() > 0 ? sourceRows(t_solGradInfo.nrow / one.nsource) : VectorXi();
+
+        if(p_pStream->read_named_matrix_data(p_Node, FIFF_MNE_FORWARD_SOLUTION_GRAD, vecRowSel, vecChSel, t_matData))
+        {
+            one.sol_grad->data = t_matData.transpose().cast<double>();
+            one.sol_grad->nrow = one.sol_grad->data.rows();
+            one.sol_grad->ncol = one.sol_grad->data.cols();
+            one.sol_grad->row_names = selectNames(t_solGradInfo.col_names, vecChSel);
+            one.sol_grad->col_names = selectNames(t_solGradInfo.row_names, vecRowSel);
+        }
+        else
+            one.sol_grad->clear();
+    }
+    else
+        one.sol_grad->clear();
+
+    one.nchan = one.sol->nrow;
+    if (p_vecSourceSel.size() > 0)
+        one.nsource = p_vecSourceSel.size();
+
     return true;
 }
 
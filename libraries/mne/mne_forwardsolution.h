@@ -49,6 +49,7 @@
 #include <utils/kmeans.h>
 
 #include <fs/annotationset.h>
+#include <fs/label.h>
 
 #include <fiff/fiff_constants.h>
 #include <fiff/fiff_coord_trans.h>
@@ -123,7 +124,7 @@ struct RegionData
         // Kmeans Reduction
         RegionDataOut p_RegionDataOut;
 
-        UTILSLIB::KMeans t_kMeans(t_sDistMeasure, QString("sample"), 5);
+        UTILSLIB::KMeans t_kMeans(t_sDistMeasure, QString("plus"), 5, QString("singleton"), false, 100, 0);
 
         if(bUseWhitened)
         {
@@ -221,7 +222,10 @@ public:
     //=========================================================================================================
     /**
      * Cluster the forward solution and stores the result to p_fwdOut.
-     * The clustering is done by using the provided annotations
+     * The clustering is done by using the provided annotations. The regions are clustered with the accelerated
+     * UTILSLIB::KMeans configuration: k-means++ seeding, batch updates only, "singleton" handling of empty clusters
+     * and a fixed seed. The clusters are reproducible, but differ from the ones of earlier versions, which used
+     * random sample seeding, online updates and the "error" empty cluster action.
      *
      * @param[in]    p_AnnotationSet     Annotation set containing the annotation of left & right hemisphere
      * @param[in]    p_iClusterSize      Maximal cluster size per roi
@@ -428,6 +432,10 @@ public:
      * @param[in] include       Include these channels (optional)
      * @param[in] exclude       Exclude these channels (optional)
      * @param[in] bExcludeBads  If true bads are also read; default = false (optional)
+     * @param[in] p_qListLabels Read only the sources within these labels (optional)
+     *
+     * The channel and label selections are applied while the gain matrices are decoded from the file, so only the
+     * selected part of the forward solution is held in memory.
      *
      * @return true if succeeded, false otherwise
      */
@@ -437,7 +445,8 @@ public:
                      bool surf_ori = false,
                      const QStringList& include = FIFFLIB::defaultQStringList,
                      const QStringList& exclude = FIFFLIB::defaultQStringList,
-                     bool bExcludeBads = true);
+                     bool bExcludeBads = true,
+                     const QList<FSLIB::Label>& p_qListLabels = QList<FSLIB::Label>());
 
     //ToDo readFromStream
 
@@ -509,12 +518,18 @@ private:
      * @param[in] p_pStream  The opened fif file to read from
      * @param[in] p_Node     The forward solution node
      * @param[out] one       The read forward solution
+     * @param[in] include    Include these channels (optional)
+     * @param[in] exclude    Exclude these channels (optional)
+     * @param[in] p_vecSourceSel Indices of the sources to read, all sources if empty (optional)
      *
-     * @return True if succeeded, false otherwise
+     * @return True if succeeded, false otherwise. Also false if no channel remains after picking.
      */
     static bool read_one(FIFFLIB::FiffStream::SPtr& p_pStream,
                          const FIFFLIB::FiffDirNode::SPtr& p_Node,
-                         MNEForwardSolution& one);
+                         MNEForwardSolution& one,
+                         const QStringList& include = FIFFLIB::defaultQStringList,
+                         const QStringList& exclude = FIFFLIB::defaultQStringList,
+                         const Eigen::VectorXi& p_vecSourceSel = Eigen::VectorXi());
 
 public:
     FIFFLIB::FiffInfoBase info;                 /**< light weighted measurement info */
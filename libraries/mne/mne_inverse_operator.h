@@ -122,7 +122,7 @@ struct RegionMT
         // Kmeans Reduction
         RegionMTOut p_RegionMTOut;
 
-        UTILSLIB::KMeans t_kMeans(t_sDistMeasure, QString("sample"), 5);
+        UTILSLIB::KMeans t_kMeans(t_sDistMeasure, QString("plus"), 5, QString("singleton"), false, 100, 0);
 
         t_kMeans.calculate(this->matRoiMT, this->nClusters, p_RegionMTOut.roiIdx, p_RegionMTOut.ctrs, p_RegionMTOut.sumd, p_RegionMTOut.D);
 
@@ -228,7 +228,8 @@ public:
 
     //=========================================================================================================
     /**
-     * Clusters the current kernel
+     * Clusters the current kernel. The regions are clustered with the accelerated UTILSLIB::KMeans configuration,
+     * see MNEForwardSolution::cluster_forward_solution for the resulting change of the clusters.
      *
      * @param[in]    p_AnnotationSet     Annotation set containing the annotation of left & right hemisphere
      * @param[in]    p_iClusterSize      Maximal cluster size per roi
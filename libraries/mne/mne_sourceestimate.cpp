@@ -80,6 +80,17 @@ MNESourceEstimate::MNESourceEstimate(const MatrixXd &p_sol, const VectorXi &p_ve
 
 //=============================================================================================================
 
+MNESourceEstimate::MNESourceEstimate(const MatrixXf &p_sol, const VectorXi &p_vertices, float p_tmin, float p_tstep)
+: data(p_sol.cast<double>())
+, vertices(p_vertices)
+, tmin(p_tmin)
+, tstep(p_tstep)
+{
+    this->update_times();
+}
+
+//=============================================================================================================
+
 MNESourceEstimate::MNESourceEstimate(const MNESourceEstimate& p_SourceEstimate)
 : data(p_SourceEstimate.data)
 , vertices(p_SourceEstimate.vertices)
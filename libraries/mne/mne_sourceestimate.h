@@ -104,6 +104,18 @@ public:
      */
     MNESourceEstimate(const Eigen::MatrixXd &p_sol, const Eigen::VectorXi &p_vertices, float p_tmin, float p_tstep);
 
+    //=========================================================================================================
+    /**
+     * Constructs a source estimation from a single precision solution, e.g. the result of
+     * MinimumNorm::calculateInverse(const Eigen::MatrixXf&,...). The solution is widened once on construction.
+     *
+     * @param[in] p_sol
+     * @param[in] p_vertices
+     * @param[in] p_tmin
+     * @param[in] p_tstep
+     */
+    MNESourceEstimate(const Eigen::MatrixXf &p_sol, const Eigen::VectorXi &p_vertices, float p_tmin, float p_tstep);
+
     //=========================================================================================================
     /**
      * Copy constructor.
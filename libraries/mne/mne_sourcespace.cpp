@@ -200,6 +200,14 @@ MNESourceSpace MNESourceSpace::pick_regions(const QList<Label> &p_qListLabels) c
         selectedSrc.m_qListHemispheres[h].nuse = selVertices.size();
         selectedSrc.m_qListHemispheres[h].vertno = newVertno;
 
+        if(this->m_qListHemispheres[h].patch_inds.size() > 0)
+        {
+            VectorXi newPatchInds(selVertices.size());
+            for(qint32 i = 0; i < selVertices.size(); ++i)
+                newPatchInds[i] = this->m_qListHemispheres[h].patch_inds[selVertices[i]];
+            selectedSrc.m_qListHemispheres[h].patch_inds = newPatchInds;
+        }
+
         //
         // Tris
         //
@@ -125,21 +125,35 @@ void RtAveWorker::setAverageNumber(qint32 numAve)
         return;
     }
 
-    if(numAve < m_iNumAverages) {
-        int iDiff = m_iNumAverages - numAve;
-
-        //Do averaging for each trigger type
-        QMutableMapIterator<double,QList<Eigen::MatrixXd> > idx(m_mapStimAve);
+    if(numAve != m_iNumAverages) {
+        //Re-pack the ring buffer of each trigger type, keeping the newest epochs
+        QMutableMapIterator<double,QVector<Eigen::MatrixXd> > idx(m_mapStimAve);
 
         while(idx.hasNext()) {
             idx.next();
 
-            if(idx.value().size() > iDiff) {
-                //Pop data from buffer
-                for(int i = 0; i < iDiff; ++i) {
-                    idx.value().pop_front();
-                }
+            const QVector<MatrixXd> vecOldEpochs = idx.value();
+
+            if(vecOldEpochs.isEmpty()) {
+                continue;
+            }
+
+            int iCount = m_mapStimAveCount.value(idx.key(), 0);
+            int iNewCount = qMin(iCount, numAve);
+            int iOldest = (m_mapStimAveIdx.value(idx.key(), 0) - iNewCount + vecOldEpochs.size()) % vecOldEpochs.size();
+
+            QVector<MatrixXd> vecNewEpochs(numAve);
+            MatrixXd& matSum = m_mapStimAveSum[idx.key()];
+            matSum.setZero();
+
+            for(int i = 0; i < iNewCount; ++i) {
+                vecNewEpochs[i] = vecOldEpochs.at((iOldest + i) % vecOldEpochs.size());
+                matSum += vecNewEpochs.at(i);
             }
+
+            idx.value() = vecNewEpochs;
+            m_mapStimAveCount[idx.key()] = iNewCount;
+            m_mapStimAveIdx[idx.key()] = iNewCount % numAve;
         }
     }
 
@@ -182,6 +196,9 @@ void RtAveWorker::setArtifactReduction(const QMap<QString, double> &mapThreshold
     }
 
     m_mapThresholds = mapThresholds;
+
+    //Invalidate the per channel thresholds. They are recreated with the next epoch.
+    m_vecThresholds.resize(0);
 }
 
 //=============================================================================================================
@@ -230,12 +247,17 @@ void RtAveWorker::setBaselineTo(int toSamp, int toMSec)
 void RtAveWorker::doAveraging(const MatrixXd& rawSegment)
 {
     //Detect trigger
-    QList<QPair<int,double> > lDetectedTriggers = DetectTrigger::detectTriggerFlanksMax(rawSegment, m_iTriggerChIndex, 0, m_fTriggerThreshold, true);
+    if(m_triggerDetector.getTriggerChannels().size() != 1 || m_triggerDetector.getTriggerChannels().first() != m_iTriggerChIndex) {
+        m_triggerDetector.setTriggerChannels(QList<int>() << m_iTriggerChIndex, m_fTriggerThreshold);
+    }
+
+    m_triggerDetector.detectTriggerFlanks(rawSegment);
+    const QVector<TriggerEvent>& lDetectedTriggers = m_triggerDetector.getTriggerEvents();
 
     //TODO: This does not permit the same trigger type twice in one data block
     for(int i = 0; i < lDetectedTriggers.size(); ++i) {
-        if(!m_mapFillingBackBuffer.contains(lDetectedTriggers.at(i).second)) {
-            double dTriggerType = lDetectedTriggers.at(i).second;
+        if(!m_mapFillingBackBuffer.contains(lDetectedTriggers.at(i).dValue)) {
+            double dTriggerType = lDetectedTriggers.at(i).dValue;
 
             //qDebug()<<"Adding dTriggerType"<<dTriggerType;
 
@@ -282,26 +304,22 @@ void RtAveWorker::doAveraging(const MatrixXd& rawSegment)
                 fillFrontBuffer(rawSegment, dTriggerType);
             } else {
                 for(int i = 0; i < lDetectedTriggers.size(); ++i) {
-                    if(dTriggerType == lDetectedTriggers.at(i).second) {
-                        int iTriggerPos = lDetectedTriggers.at(i).first;
+                    if(dTriggerType == lDetectedTriggers.at(i).dValue) {
+                        int iTriggerPos = lDetectedTriggers.at(i).iSample;
 
                         //Do front buffer stuff
-                        MatrixXd tempMat;
-
                         if(iTriggerPos >= m_iPreStimSamples) {
-                            tempMat = rawSegment.block(0,
-                                                       iTriggerPos - m_iPreStimSamples,
-                                                       rawSegment.rows(),
-                                                       m_iPreStimSamples);
+                            fillFrontBuffer(rawSegment,
+                                            dTriggerType,
+                                            iTriggerPos - m_iPreStimSamples,
+                                            m_iPreStimSamples);
                         } else {
-                            tempMat = rawSegment.block(0,
-                                                       0,
-                                                       rawSegment.rows(),
-                                                       iTriggerPos);
+                            fillFrontBuffer(rawSegment,
+                                            dTriggerType,
+                                            0,
+                                            iTriggerPos);
                         }
 
-                        fillFrontBuffer(tempMat, dTriggerType);
-
                         //Do back buffer stuff
                         if(rawSegment.cols() - iTriggerPos >= m_mapDataPost[dTriggerType].cols()) {
                             m_mapDataPost[dTriggerType] = rawSegment.block(0,
@@ -373,57 +391,73 @@ void RtAveWorker::fillBackBuffer(const MatrixXd &data, double dTriggerType)
 
 //=============================================================================================================
 
-void RtAveWorker::fillFrontBuffer(const MatrixXd &data, double dTriggerType)
+void RtAveWorker::fillFrontBuffer(const MatrixXd &data,
+                                  double dTriggerType,
+                                  int iStartCol,
+                                  int iNumberCols)
 {
     //Init m_mapDataPre
     if(!m_mapDataPre.contains(dTriggerType)) {
         if(dTriggerType != -1.0) {
             m_mapDataPre[dTriggerType] = m_mapDataPre[-1.0];
+            m_mapDataPreIdx[dTriggerType] = m_mapDataPreIdx.value(-1.0, 0);
         } else {
             m_mapDataPre[-1.0].resize(m_pFiffInfo->chs.size(), m_iPreStimSamples);
             m_mapDataPre[-1.0].setZero();
+            m_mapDataPreIdx[-1.0] = 0;
         }
     }
 
-    if(m_mapDataPre[dTriggerType].cols() <= data.cols()) {
-        if(m_iPreStimSamples > 0 && data.cols() >= m_iPreStimSamples) {
-            m_mapDataPre[dTriggerType] = data.block(0,
-                                                    data.cols() - m_iPreStimSamples,
-                                                    data.rows(),
-                                                    m_iPreStimSamples);
-        }
-    } else {
-        int residual = m_mapDataPre[dTriggerType].cols() - data.cols();
+    if(iNumberCols < 0) {
+        iNumberCols = data.cols() - iStartCol;
+    }
+
+    MatrixXd& matDataPre = m_mapDataPre[dTriggerType];
+    int iPreStimSamples = matDataPre.cols();
+
+    if(iPreStimSamples == 0 || iNumberCols <= 0 || matDataPre.rows() != data.rows()) {
+        return;
+    }
+
+    //Only the newest samples fit into the buffer
+    if(iNumberCols > iPreStimSamples) {
+        iStartCol += iNumberCols - iPreStimSamples;
+        iNumberCols = iPreStimSamples;
+    }
+
+    //Overwrite the oldest samples, wrapping around at the end of the buffer
+    int& iWriteIdx = m_mapDataPreIdx[dTriggerType];
+    int iFirstPart = qMin(iNumberCols, iPreStimSamples - iWriteIdx);
 
-        //Copy shift data
-        m_mapDataPre[dTriggerType].block(0,
-                                         0,
-                                         m_mapDataPre[dTriggerType].rows(),
-                                         residual) = m_mapDataPre[dTriggerType].block(0,
-                                                                                      m_mapDataPre[dTriggerType].cols() - residual,
-                                                                                      m_mapDataPre[dTriggerType].rows(),
-                                                                                      residual);
+    matDataPre.middleCols(iWriteIdx, iFirstPart) = data.middleCols(iStartCol, iFirstPart);
 
-        //Copy new data in
-        m_mapDataPre[dTriggerType].block(0,
-                                         residual,
-                                         m_mapDataPre[dTriggerType].rows(),
-                                         data.cols()) = data;
+    if(iNumberCols > iFirstPart) {
+        matDataPre.leftCols(iNumberCols - iFirstPart) = data.middleCols(iStartCol + iFirstPart, iNumberCols - iFirstPart);
     }
+
+    iWriteIdx = (iWriteIdx + iNumberCols) % iPreStimSamples;
 }
 
 //=============================================================================================================
 
 void RtAveWorker::mergeData(double dTriggerType)
 {
-    if(m_mapDataPre[dTriggerType].rows() != m_mapDataPost[dTriggerType].rows()) {
-        qDebug() << "RtAveWorker::mergeData - Rows of m_mapDataPre (" << m_mapDataPre[dTriggerType].rows() << ") and m_mapDataPost (" << m_mapDataPost[dTriggerType].rows() << ") are not the same. Returning.";
+    const MatrixXd& matDataPre = m_mapDataPre[dTriggerType];
+    const MatrixXd& matDataPost = m_mapDataPost[dTriggerType];
+
+    if(matDataPre.rows() != matDataPost.rows()) {
+        qDebug() << "RtAveWorker::mergeData - Rows of m_mapDataPre (" << matDataPre.rows() << ") and m_mapDataPost (" << matDataPost.rows() << ") are not the same. Returning.";
         return;
     }
 
-    MatrixXd mergedData(m_mapDataPre[dTriggerType].rows(), m_mapDataPre[dTriggerType].cols() + m_mapDataPost[dTriggerType].cols());
+    int iPreStimSamples = matDataPre.cols();
+    int iReadIdx = m_mapDataPreIdx.value(dTriggerType, 0);
 
-    mergedData << m_mapDataPre[dTriggerType], m_mapDataPost[dTriggerType];
+    //Unroll the circular pre stim buffer into the reused epoch matrix. Resizing is a no-op if the size did not change.
+    m_matEpoch.resize(matDataPre.rows(), iPreStimSamples + matDataPost.cols());
+    m_matEpoch.leftCols(iPreStimSamples - iReadIdx) = matDataPre.rightCols(iPreStimSamples - iReadIdx);
+    m_matEpoch.middleCols(iPreStimSamples - iReadIdx, iReadIdx) = matDataPre.leftCols(iReadIdx);
+    m_matEpoch.rightCols(matDataPost.cols()) = matDataPost;
 
     //Perform artifact threshold
     bool bArtifactDetected = false;
@@ -431,21 +465,56 @@ void RtAveWorker::mergeData(double dTriggerType)
     if(m_bActivateThreshold && m_pFiffInfo) {
         qDebug() << "RtAveWorker::mergeData - Doing artifact reduction for" << m_mapThresholds;
 
-        bArtifactDetected = MNEEpochDataList::checkForArtifact(mergedData,
-                                                               *m_pFiffInfo,
-                                                               m_mapThresholds);
+        //Recreate the per channel thresholds only if the thresholds or the bad channels changed
+        if(m_vecThresholds.rows() != m_matEpoch.rows() || m_lThresholdBads != m_pFiffInfo->bads) {
+            m_vecThresholds = MNEEpochDataList::makeArtifactThresholds(*m_pFiffInfo,
+                                                                       m_mapThresholds);
+            m_lThresholdBads = m_pFiffInfo->bads;
+        }
+
+        bArtifactDetected = MNEEpochDataList::checkForArtifact(m_matEpoch,
+                                                               m_vecThresholds);
     }
 
-    if(!bArtifactDetected) {
-        //Add cut data to average buffer
-        m_mapStimAve[dTriggerType].append(mergedData);
+    if(bArtifactDetected) {
+        return;
+    }
 
-        //Pop data from buffer
-        int iDiff =  m_mapStimAve[dTriggerType].size() - m_iNumAverages;
-        if(iDiff > 0) {
-            for(int i = 0; i < iDiff; ++i) {
-                m_mapStimAve[dTriggerType].pop_front();
-            }
+    //Init the ring buffer and the running sum
+    QVector<MatrixXd>& vecEpochs = m_mapStimAve[dTriggerType];
+    MatrixXd& matSum = m_mapStimAveSum[dTriggerType];
+
+    if(vecEpochs.size() != m_iNumAverages) {
+        vecEpochs.resize(m_iNumAverages);
+    }
+
+    if(matSum.rows() != m_matEpoch.rows() || matSum.cols() != m_matEpoch.cols()) {
+        matSum = MatrixXd::Zero(m_matEpoch.rows(), m_matEpoch.cols());
+        m_mapStimAveIdx[dTriggerType] = 0;
+        m_mapStimAveCount[dTriggerType] = 0;
+    }
+
+    int& iSlot = m_mapStimAveIdx[dTriggerType];
+    int& iCount = m_mapStimAveCount[dTriggerType];
+
+    //Swap the new epoch into its slot. m_matEpoch holds the evicted epoch afterwards and is reused for the next merge.
+    vecEpochs[iSlot].swap(m_matEpoch);
+    matSum += vecEpochs.at(iSlot);
+
+    if(iCount == m_iNumAverages) {
+        matSum -= m_matEpoch;
+    } else {
+        ++iCount;
+    }
+
+    iSlot = (iSlot + 1) % m_iNumAverages;
+
+    //Recompute the sum once per ring cycle so rounding errors of the subtractions do not accumulate
+    if(iSlot == 0) {
+        matSum = vecEpochs.at(0);
+
+        for(int i = 1; i < iCount; ++i) {
+            matSum += vecEpochs.at(i);
         }
     }
 }
@@ -454,7 +523,9 @@ void RtAveWorker::mergeData(double dTriggerType)
 
 void RtAveWorker::generateEvoked(double dTriggerType)
 {
-    if(m_mapStimAve[dTriggerType].isEmpty()) {
+    int iCount = m_mapStimAveCount.value(dTriggerType, 0);
+
+    if(iCount == 0) {
         qDebug() << "RtAveWorker::generateEvoked - m_mapStimAve is empty for type" << dTriggerType << "Returning.";
         return;
     }
@@ -486,16 +557,8 @@ void RtAveWorker::generateEvoked(double dTriggerType)
         evoked.comment = QString::number(dTriggerType);
     }
 
-    // Generate final evoked
-    MatrixXd finalAverage = MatrixXd::Zero(m_mapStimAve[dTriggerType].first().rows(), m_iPreStimSamples+m_iPostStimSamples);
-
-    for(int i = 0; i < m_mapStimAve[dTriggerType].size(); ++i) {
-        finalAverage += m_mapStimAve[dTriggerType].at(i);
-    }
-
-    if(!m_mapStimAve[dTriggerType].isEmpty()) {
-        finalAverage = finalAverage/m_mapStimAve[dTriggerType].size();
-    }
+    // Generate final evoked from the running sum
+    MatrixXd finalAverage = m_mapStimAveSum[dTriggerType] / iCount;
 
     if(m_bDoBaselineCorrection) {
         finalAverage = MNEMath::rescale(finalAverage, evoked.times, m_pairBaselineSec, QString("mean"));
@@ -503,7 +566,7 @@ void RtAveWorker::generateEvoked(double dTriggerType)
 
     evoked.data = finalAverage;
 
-    evoked.nave = m_mapStimAve[dTriggerType].size();
+    evoked.nave = iCount;
 
     //Add new data to evoked data set
     if(iEvokedIdx != -1) {
@@ -523,14 +586,20 @@ void RtAveWorker::reset()
     m_iPreStimSamples = m_iNewPreStimSamples;
     m_iPostStimSamples = m_iNewPostStimSamples;
     m_iTriggerChIndex = m_iNewTriggerIndex;
+    m_triggerDetector.reset();
 
     //Clear all evoked data information
     m_stimEvokedSet.evoked.clear();
 
     //Clear all maps
     m_mapStimAve.clear();
+    m_mapStimAveSum.clear();
+    m_mapStimAveIdx.clear();
+    m_mapStimAveCount.clear();
     m_mapDataPre.clear();
     m_mapDataPre[-1.0] = MatrixXd::Zero(m_pFiffInfo->chs.size(), m_iPreStimSamples);
+    m_mapDataPreIdx.clear();
+    m_mapDataPreIdx[-1.0] = 0;
     m_mapDataPost.clear();
     m_mapMatDataPostIdx.clear();
     m_mapFillingBackBuffer.clear();
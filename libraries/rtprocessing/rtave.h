@@ -44,6 +44,7 @@
 
 #include <fiff/fiff_evoked_set.h>
 #include <fiff/fiff_info.h>
+#include <utils/detecttrigger.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -200,9 +201,17 @@ protected:
 
     //=========================================================================================================
     /**
-     * Prepends incoming data to front/pre stim buffer.
+     * Prepends incoming data to the circular front/pre stim buffer.
+     *
+     * @param[in] data           The incoming data.
+     * @param[in] dTriggerType   The trigger type to fill the buffer for.
+     * @param[in] iStartCol      The first column of data to add. Default is 0.
+     * @param[in] iNumberCols    The number of columns of data to add. Default is -1 which means all columns starting from iStartCol.
      */
-    void fillFrontBuffer(const Eigen::MatrixXd& data, double dTriggerType);
+    void fillFrontBuffer(const Eigen::MatrixXd& data,
+                         double dTriggerType,
+                         int iStartCol = 0,
+                         int iNumberCols = -1);
 
     void emitEvoked(double dTriggerType, QStringList& lResponsibleTriggerTypes);
 
@@ -214,7 +223,8 @@ protected:
 
     //=========================================================================================================
     /**
-     * Packs the buffers togehter as one and calcualtes the current running average and emits the result if number of averages has been reached.
+     * Packs the buffers togehter as one and adds the resulting epoch to the running sum of the trigger type. The oldest epoch
+     * is subtracted once the number of averages has been reached.
      */
     void mergeData(double dTriggerType);
 
@@ -254,12 +264,22 @@ protected:
     FIFFLIB::FiffEvokedSet                          m_stimEvokedSet;            /**< Holds the evoked information. */
 
     QMap<QString,double>                            m_mapThresholds;            /**< Holds the current thresholds for artifact rejection. */
-    QMap<double,QList<Eigen::MatrixXd> >            m_mapStimAve;               /**< the current stimulus average buffer. Holds m_iNumAverages vectors */
-    QMap<double,Eigen::MatrixXd>                    m_mapDataPre;               /**< The matrix holding pre stim data. */
+    QStringList                                     m_lThresholdBads;           /**< The bad channels m_vecThresholds was created for. */
+    Eigen::VectorXd                                 m_vecThresholds;            /**< The cached per channel peak-to-peak thresholds for artifact rejection. */
+    QMap<double,QVector<Eigen::MatrixXd> >          m_mapStimAve;               /**< The ring buffer of stored epochs for each trigger type. Holds m_iNumAverages epoch slots. */
+    QMap<double,Eigen::MatrixXd>                    m_mapStimAveSum;            /**< The running sum of all epochs stored in the ring buffer for each trigger type. */
+    QMap<double,qint32>                             m_mapStimAveIdx;            /**< The ring buffer slot the next epoch is written to for each trigger type. */
+    QMap<double,qint32>                             m_mapStimAveCount;          /**< The number of filled ring buffer slots for each trigger type. */
+    QMap<double,Eigen::MatrixXd>                    m_mapDataPre;               /**< The circular buffer holding pre stim data. */
+    QMap<double,qint32>                             m_mapDataPreIdx;            /**< Column of the oldest sample in the circular pre stim buffer, i.e. the column written to next. */
     QMap<double,Eigen::MatrixXd>                    m_mapDataPost;              /**< The matrix holding post stim data. */
     QMap<double,qint32>                             m_mapMatDataPostIdx;        /**< Current index inside of the matrix m_matDataPost */
     QMap<double,bool>                               m_mapFillingBackBuffer;     /**< Whether the back buffer is currently getting filled. */
 
+    UTILSLIB::DetectTrigger                         m_triggerDetector;          /**< Detects the trigger flanks and carries the trigger channel state over block boundaries. */
+
+    Eigen::MatrixXd                                 m_matEpoch;                 /**< The merged epoch. Swapped with the evicted ring buffer slot, so no memory needs to be allocated per epoch. */
+
 signals:
     //=========================================================================================================
     /**
@@ -41,6 +41,7 @@
 #include <connectivity/connectivitysettings.h>
 #include <connectivity/connectivity.h>
 #include <connectivity/network/network.h>
+#include <connectivity/metrics/abstractmetric.h>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -64,6 +65,13 @@ using namespace CONNECTIVITYLIB;
 // DEFINE MEMBER METHODS RtConnectivityWorker
 //=============================================================================================================
 
+RtConnectivityWorker::RtConnectivityWorker()
+: m_iNumberEvictedTrials(0)
+{
+}
+
+//=============================================================================================================
+
 void RtConnectivityWorker::doWork(const ConnectivitySettings &connectivitySettings)
 {
     if(this->thread()->isInterruptionRequested()) {
@@ -98,6 +106,74 @@ void RtConnectivityWorker::doWork(const ConnectivitySettings &connectivitySettin
     emit resultReady(finalNetworks, connectivitySettingsTemp);
 }
 
+//=============================================================================================================
+
+void RtConnectivityWorker::doIncrementalWork(const ConnectivitySettings &connectivitySettings,
+                                             int iNumberTrials)
+{
+    if(this->thread()->isInterruptionRequested()) {
+        return;
+    }
+
+    if(connectivitySettings.getConnectivityMethods().isEmpty()) {
+        qDebug()<<"RtConnectivityWorker::doIncrementalWork() - Network methods are empty";
+        return;
+    }
+
+    // The intermediate data of each trial must be kept in order to remove it from the sum data later on
+    AbstractMetric::m_bStorageModeIsActive = true;
+
+    // Take over the parameters. The setters clear the intermediate data if the spectra are affected.
+    if(m_connectivitySettings.getSamplingFrequency() != connectivitySettings.getSamplingFrequency()) {
+        m_connectivitySettings.setSamplingFrequency(connectivitySettings.getSamplingFrequency());
+    }
+
+    if(m_connectivitySettings.getFFTSize() != connectivitySettings.getFFTSize()) {
+        m_connectivitySettings.setFFTSize(connectivitySettings.getFFTSize());
+    }
+
+    if(m_connectivitySettings.getWindowType() != connectivitySettings.getWindowType()) {
+        m_connectivitySettings.setWindowType(connectivitySettings.getWindowType());
+    }
+
+    m_connectivitySettings.setConnectivityMethods(connectivitySettings.getConnectivityMethods());
+    m_connectivitySettings.setNodePositions(connectivitySettings.getNodePositions());
+
+    // Start a new window if the trial dimensions changed
+    if(!m_connectivitySettings.isEmpty() && !connectivitySettings.isEmpty()) {
+        if(m_connectivitySettings.at(0).matData.rows() != connectivitySettings.at(0).matData.rows() ||
+           m_connectivitySettings.at(0).matData.cols() != connectivitySettings.at(0).matData.cols()) {
+            m_connectivitySettings.clearAllData();
+            m_iNumberEvictedTrials = 0;
+        }
+    }
+
+    for(int i = 0; i < connectivitySettings.size(); ++i) {
+        m_connectivitySettings.append(connectivitySettings.at(i).matData);
+    }
+
+    // Subtract the evicted trials from the sum data
+    if(m_connectivitySettings.size() > iNumberTrials) {
+        m_iNumberEvictedTrials += m_connectivitySettings.size() - iNumberTrials;
+        m_connectivitySettings.removeFirst(m_connectivitySettings.size() - iNumberTrials);
+    }
+
+    // Recompute the sum data once per window cycle so rounding errors of the subtractions do not accumulate
+    if(m_iNumberEvictedTrials >= iNumberTrials) {
+        m_connectivitySettings.recomputeIntermediateSumData();
+        m_iNumberEvictedTrials = 0;
+    }
+
+    if(m_connectivitySettings.isEmpty()) {
+        return;
+    }
+
+    // Only the new trials are transformed since all other trials already hold their intermediate data
+    QList<Network> finalNetworks = Connectivity::calculate(m_connectivitySettings);
+
+    emit resultReady(finalNetworks, connectivitySettings);
+}
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS RtConnectivity
 //=============================================================================================================
@@ -114,6 +190,9 @@ RtConnectivity::RtConnectivity(QObject *parent)
     connect(this, &RtConnectivity::operate,
             worker, &RtConnectivityWorker::doWork);
 
+    connect(this, &RtConnectivity::operateIncremental,
+            worker, &RtConnectivityWorker::doIncrementalWork);
+
     connect(worker, &RtConnectivityWorker::resultReady,
             this, &RtConnectivity::newConnectivityResultAvailable);
 
@@ -136,6 +215,14 @@ void RtConnectivity::append(const ConnectivitySettings& connectivitySettings)
 
 //=============================================================================================================
 
+void RtConnectivity::append(const ConnectivitySettings& connectivitySettings,
+                            int iNumberTrials)
+{
+    emit operateIncremental(connectivitySettings, iNumberTrials);
+}
+
+//=============================================================================================================
+
 void RtConnectivity::restart()
 {
     stop();
@@ -149,6 +236,9 @@ void RtConnectivity::restart()
     connect(this, &RtConnectivity::operate,
             worker, &RtConnectivityWorker::doWork);
 
+    connect(this, &RtConnectivity::operateIncremental,
+            worker, &RtConnectivityWorker::doIncrementalWork);
+
     connect(worker, &RtConnectivityWorker::resultReady,
             this, &RtConnectivity::newConnectivityResultAvailable);
 
@@ -41,6 +41,8 @@
 
 #include "rtprocessing_global.h"
 
+#include <connectivity/connectivitysettings.h>
+
 //=============================================================================================================
 // EIGEN INCLUDES
 //=============================================================================================================
@@ -61,7 +63,6 @@ namespace FIFFLIB {
 }
 
 namespace CONNECTIVITYLIB {
-    class ConnectivitySettings;
     class Network;
 }
 
@@ -87,6 +88,12 @@ class RTPROCESINGSHARED_EXPORT RtConnectivityWorker : public QObject
     Q_OBJECT
 
 public:
+    //=========================================================================================================
+    /**
+     * Constructs a RtConnectivityWorker.
+     */
+    RtConnectivityWorker();
+
     //=========================================================================================================
     /**
      * Perform actual connectivity estimation.
@@ -95,6 +102,23 @@ public:
      */
     void doWork(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
+    //=========================================================================================================
+    /**
+     * Perform connectivity estimation on a sliding trial window. The new trials are appended to the window kept by
+     * this worker and the oldest trials are removed, so that only the intermediate data (spectra, CSD) of the new
+     * trials need to be computed and the evicted trials are subtracted from the intermediate sum data. Once per window
+     * cycle the sum data is recomputed from the stored trials.
+     *
+     * @param[in] connectivitySettings           The connectivity settings holding the parameters and the new trials only.
+     * @param[in] iNumberTrials                  The number of trials in the sliding window.
+     */
+    void doIncrementalWork(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings,
+                           int iNumberTrials);
+
+protected:
+    CONNECTIVITYLIB::ConnectivitySettings   m_connectivitySettings;     /**< The sliding trial window including the intermediate data of each trial. */
+    int                                     m_iNumberEvictedTrials;     /**< The number of trials removed from the window since the sum data was last recomputed. */
+
 signals:
     void resultReady(const  QList<CONNECTIVITYLIB::Network>& connectivityResults, const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 };
@@ -135,6 +159,16 @@ public:
      */
     void append(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
+    //=========================================================================================================
+    /**
+     * Slot to receive new trials for the sliding trial window. The trials stay with the worker, restart() clears them.
+     *
+     * @param[in] connectivitySettings   The connectivity settings holding the parameters and the new trials only.
+     * @param[in] iNumberTrials          The number of trials in the sliding window.
+     */
+    void append(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings,
+                int iNumberTrials);
+
     //=========================================================================================================
     /**
      * Restarts the thread by interrupting its computation queue, quitting, waiting and then starting it again.
@@ -154,6 +188,9 @@ signals:
     void newConnectivityResultAvailable(const QList<CONNECTIVITYLIB::Network>& connectivityResults, const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
     void operate(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+
+    void operateIncremental(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings,
+                            int iNumberTrials);
 };
 
 //=============================================================================================================
@@ -56,6 +56,7 @@ using namespace RTPROCESSINGLIB;
 using namespace FIFFLIB;
 using namespace Eigen;
 using namespace IOBUFFER;
+using namespace UTILSLIB;
 
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -87,6 +88,11 @@ RtNoise::RtNoise(qint32 p_iMaxSamples,
     //create a hanning window
     m_fWin = hanning(m_iFFTlength,0);
 
+    m_matTaper.resize(1, m_iFFTlength);
+    for (qint32 i = 0; i < m_iFFTlength; ++i) {
+        m_matTaper(0,i) = m_fWin[i];
+    }
+
     qDebug()<<"Hanning window is created.";
 }
 
@@ -210,9 +216,7 @@ void RtNoise::run()
                     FirstStart = false;
                 }
                 //concate blocks
-                for (int i=0; i< m_iSensors; i++)
-                    for (int j=0; j< m_iBlockSize; j++)
-                        m_matCircBuf(i,j+m_iBlockIndex*m_iBlockSize) = block(i,j);
+                m_matCircBuf.block(0, m_iBlockIndex*m_iBlockSize, m_iSensors, m_iBlockSize) = block;
 
                 m_iBlockIndex ++;
                 if (m_iBlockIndex >= m_iNumOfBlocks){
@@ -229,61 +233,27 @@ void RtNoise::run()
                     qDebug()<<"nb"<<nb<<"NumOfBlocks"<<m_iNumOfBlocks<<"BlockSize"<<m_iBlockSize;
                     MatrixXd t_mat(m_iSensors,m_iFFTlength);
                     MatrixXd t_psdx(m_iSensors,m_iFFTlength/2+1);
+
+                    //One sided scaling of the magnitude spectrum
+                    RowVectorXd vecScaling = RowVectorXd::Constant(m_iFFTlength/2+1, 2.0/(m_Fs*m_iFFTlength));
+                    vecScaling(0) = 1.0/(m_Fs*m_iFFTlength);
+                    vecScaling(m_iFFTlength/2) = 1.0/(m_Fs*m_iFFTlength);
+
                     for (int n = 0; n<nb; n++){
-                        //collect a data block with data length of m_iFFTlength;
-                        if(n==nb-1)
-                        {
-                            for(qint32 ii=0; ii<m_iSensors; ii++)
-                            for(qint32 jj=0; jj<m_iFFTlength; jj++)
-                                if(jj+n*m_iFFTlength<m_iNumOfBlocks*m_iBlockSize)
-                                    t_mat(ii,jj) = m_matCircBuf(ii,jj+n*m_iFFTlength);
-                                else
-                                    t_mat(ii,jj) = 0.0;
-
-                        }
-                        else
-                        {
-                            for(qint32 ii=0; ii<m_iSensors; ii++)
-                            for(qint32 jj=0; jj<m_iFFTlength; jj++)
-                                t_mat(ii,jj) = m_matCircBuf(ii,jj+n*m_iFFTlength);
-                        }
-
-                        //FFT calculation by row
-                        for(qint32 i = 0; i < t_mat.rows(); i++){
-                            RowVectorXd data;
-
-                            data = t_mat.row(i);
-
-                            //zero-pad data to m_iFFTlength
-                            RowVectorXd t_dataZeroPad = RowVectorXd::Zero(m_iFFTlength);
-                            t_dataZeroPad.head(data.cols()) = data;
-
-                            for (qint32 lk = 0; lk<m_iFFTlength; lk++)
-                                t_dataZeroPad[lk] = t_dataZeroPad[lk]*m_fWin[lk];
-
-                            //generate fft object
-                            Eigen::FFT<double> fft;
-                            fft.SetFlag(fft.HalfSpectrum);
-
-                            //fft-transform data sequence
-                            RowVectorXcd t_freqData(m_iFFTlength/2+1);
-                            fft.fwd(t_freqData,t_dataZeroPad);
-
-                            // calculate spectrum from FFT
-                            for(qint32 j=0; j<m_iFFTlength/2+1;j++)
-                            {
-                                double mag_abs = sqrt(t_freqData(j).real()* t_freqData(j).real() +  t_freqData(j).imag()*t_freqData(j).imag());
-                                double spower = (1.0/(m_Fs*m_iFFTlength))* mag_abs;
-                                if (j>0&&j<m_iFFTlength/2) spower = 2.0*spower;
-                                sum_psdx(i,j) = sum_psdx(i,j) + spower;
-                            }
-                         }//row computing is done
+                        //collect a data block with data length of m_iFFTlength, zero padded at the end
+                        qint32 iAvailable = qBound(0, m_iNumOfBlocks*m_iBlockSize - n*m_iFFTlength, m_iFFTlength);
+                        t_mat.leftCols(iAvailable) = m_matCircBuf.middleCols(n*m_iFFTlength, iAvailable);
+                        t_mat.rightCols(m_iFFTlength - iAvailable).setZero();
+
+                        //Windowed FFT of all rows at once, reusing the FFT plans and the spectra buffer
+                        Spectral::computeTaperedSpectraTensor(t_mat, m_matTaper, m_iFFTlength, m_matTapSpectra);
+
+                        // calculate spectrum from FFT
+                        sum_psdx += (m_matTapSpectra.cwiseAbs().array().rowwise() * vecScaling.array()).matrix();
                     }//nb
 
                     //DB-calculation
-                    for(qint32 ii=0; ii<m_iSensors; ii++)
-                        for(qint32 jj=0; jj<m_iFFTlength/2+1; jj++)
-                            t_psdx(ii,jj) = 10.0*log10(sum_psdx(ii,jj)/nb);
+                    t_psdx = 10.0 * (sum_psdx.array() / nb).log10();
 
                     qDebug()<<"Send spectrum to Noise Estimator";
                     emit SpecCalculated(t_psdx); //send back the spectrum result
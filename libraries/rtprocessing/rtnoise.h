@@ -45,6 +45,7 @@
 #include <fiff/fiff_cov.h>
 #include <fiff/fiff_info.h>
 #include <utils/generics/circularbuffer.h>
+#include <utils/spectral.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -60,7 +61,6 @@
 //=============================================================================================================
 
 #include <Eigen/Core>
-#include <unsupported/Eigen/FFT>
 
 //=============================================================================================================
 // DEFINE NAMESPACE RTPROCESSINGLIB
@@ -167,6 +167,8 @@ private:
     QSharedPointer<IOBUFFER::CircularBuffer_Matrix_double>       m_pCircularBuffer;      /**< Holds incoming raw data. */
 
     QVector <float> m_fWin;
+    Eigen::MatrixXd m_matTaper;                     /**< The hanning window as a 1 x m_iFFTlength taper matrix. */
+    UTILSLIB::Spectral::RowMajorMatrixXcd m_matTapSpectra;  /**< The reused tapered spectra of the current segment. */
 
     double m_Fs;
 
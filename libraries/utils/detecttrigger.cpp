@@ -46,6 +46,7 @@
 
 #include <QMapIterator>
 #include <QTime>
+#include <QDebug>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -59,8 +60,119 @@ using namespace UTILSLIB;
 //=============================================================================================================
 
 DetectTrigger::DetectTrigger()
+: m_dThreshold(0.5)
+, m_bFalling(false)
+, m_iBurstLengthSamp(100)
+, m_bHasCarry(false)
 {
+    m_vecEvents.reserve(64);
+}
+
+//=============================================================================================================
+
+void DetectTrigger::setTriggerChannels(const QList<int>& lTriggerChannels,
+                                       double dThreshold,
+                                       const QString& type,
+                                       int iBurstLengthSamp)
+{
+    m_lTriggerChannels = lTriggerChannels;
+    m_dThreshold = dThreshold;
+    m_bFalling = (type == "Falling");
+    m_iBurstLengthSamp = iBurstLengthSamp;
+
+    reset();
+}
+
+//=============================================================================================================
+
+void DetectTrigger::reset()
+{
+    m_bHasCarry = false;
+    m_vecCarry = VectorXd::Zero(m_lTriggerChannels.size());
+    m_vecBurstRemaining = VectorXi::Zero(m_lTriggerChannels.size());
+    m_vecEvents.clear();
+}
+
+//=============================================================================================================
+
+int DetectTrigger::detectTriggerFlanks(const MatrixXd& data,
+                                       int iOffsetIndex)
+{
+    //Keeps its capacity
+    m_vecEvents.clear();
+
+    int iNumChs = m_lTriggerChannels.size();
+    int iNumSamples = data.cols();
+
+    if(iNumChs == 0 || iNumSamples == 0) {
+        return 0;
+    }
+
+    //Gather the trigger channels behind the carried sample of the last block. Resizing is a no-op for same sized blocks.
+    m_matStim.resize(iNumChs, iNumSamples + 1);
+
+    for(int i = 0; i < iNumChs; ++i) {
+        int iChIdx = m_lTriggerChannels.at(i);
+
+        if(iChIdx >= data.rows() || iChIdx < 0) {
+            qWarning() << "DetectTrigger::detectTriggerFlanks - Trigger channel index" << iChIdx << "out of bounds. Returning.";
+            return 0;
+        }
+
+        m_matStim.row(i).tail(iNumSamples) = data.row(iChIdx);
+    }
+
+    //Without a previous block no flank can be found at the first sample
+    m_matStim.col(0) = m_bHasCarry ? m_vecCarry : m_matStim.col(1);
+    m_vecCarry = m_matStim.col(iNumSamples);
+    m_bHasCarry = true;
+
+    //Threshold crossings of all channels and samples at once
+    m_matAbove = m_matStim.array() >= m_dThreshold;
+
+    if(m_bFalling) {
+        m_matFlanks = m_matAbove.rightCols(iNumSamples) < m_matAbove.leftCols(iNumSamples);
+    } else {
+        m_matFlanks = m_matAbove.rightCols(iNumSamples) > m_matAbove.leftCols(iNumSamples);
+    }
+
+    //Most blocks do not contain any flank
+    if(!m_matFlanks.any()) {
+        m_vecBurstRemaining = (m_vecBurstRemaining.array() - iNumSamples).max(0);
+        return 0;
+    }
+
+    for(int i = 0; i < iNumChs; ++i) {
+        int j = m_vecBurstRemaining(i);
+        int iNextFree = j;
+
+        for(; j < iNumSamples; ++j) {
+            if(m_matFlanks(i,j)) {
+                TriggerEvent event;
+                event.iChIdx = m_lTriggerChannels.at(i);
+                event.iSample = iOffsetIndex + j;
+                event.dValue = m_matStim(i,j+1);
+
+                //Trigger lines do not switch at the same sample, take the peak of the pulse within the burst window
+                if(!m_bFalling) {
+                    int iWindowEnd = qMin(iNumSamples, j + 1 + m_iBurstLengthSamp);
+
+                    for(int k = j + 2; k <= iWindowEnd && m_matAbove(i,k); ++k) {
+                        event.dValue = qMax(event.dValue, m_matStim(i,k));
+                    }
+                }
+
+                m_vecEvents.append(event);
+
+                j += m_iBurstLengthSamp;
+                iNextFree = j + 1;
+            }
+        }
+
+        m_vecBurstRemaining(i) = qMax(0, iNextFree - iNumSamples);
+    }
 
+    return m_vecEvents.size();
 }
 
 //=============================================================================================================
@@ -46,6 +46,9 @@
 //=============================================================================================================
 
 #include <QSharedPointer>
+#include <QList>
+#include <QVector>
+#include <QString>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -64,6 +67,16 @@ namespace UTILSLIB
 // FORWARD DECLARATIONS
 //=============================================================================================================
 
+//=============================================================================================================
+/**
+ * A trigger flank found by the stateful flank detection of DetectTrigger.
+ */
+struct TriggerEvent {
+    int iChIdx;         /**< The row index of the trigger channel in the data matrix. */
+    int iSample;        /**< The sample index of the flank including the offset index. */
+    double dValue;      /**< The peak value of the pulse for rising flanks, the signal value at the flank for falling flanks. */
+};
+
 //=============================================================================================================
 /**
  * Routines for detecting trigger flanks in a given signal
@@ -79,10 +92,63 @@ public:
 
     //=========================================================================================================
     /**
-     * Destroys the DetectTrigger class.
+     * Constructs the DetectTrigger class.
      */
     DetectTrigger();
 
+    //=========================================================================================================
+    /**
+     * Sets up the stateful flank detection used by detectTriggerFlanks. This also resets the carry-over state.
+     *
+     * @param[in] lTriggerChannels   The row indices of the trigger channels.
+     * @param[in] dThreshold         The signal threshold value which needs to be crossed.
+     * @param[in] type               Detect rising or falling flanks. Use "Rising" or "Falling" as input.
+     * @param[in] iBurstLengthSamp   The number of samples which are skipped after a flank was found on a channel.
+     */
+    void setTriggerChannels(const QList<int>& lTriggerChannels,
+                            double dThreshold,
+                            const QString& type = "Rising",
+                            int iBurstLengthSamp = 100);
+
+    //=========================================================================================================
+    /**
+     * Clears the carry-over state, i.e. the last sample and the remaining burst length of each trigger channel.
+     */
+    void reset();
+
+    //=========================================================================================================
+    /**
+     * Detects threshold crossings on all trigger channels at once. The last sample and the remaining burst length
+     * of each channel are carried over to the next call, so flanks at block boundaries are found exactly once.
+     * The found flanks are written to a preallocated event list, see getTriggerEvents.
+     * The value of a rising flank is the maximum of the pulse while it stays above the threshold within the burst
+     * length. Flanks are reported in the block they occur in, so the maximum of a pulse which continues into the
+     * next block only covers the samples of the current block.
+     *
+     * @param[in] data           The data block (channels x samples). Consecutive calls need to pass consecutive blocks.
+     * @param[in] iOffsetIndex   The offset index which gets added to the found flank indices.
+     *
+     * @return   The number of flanks found in this block.
+     */
+    int detectTriggerFlanks(const Eigen::MatrixXd& data,
+                            int iOffsetIndex = 0);
+
+    //=========================================================================================================
+    /**
+     * Returns the flanks found by the last call of detectTriggerFlanks, sorted by channel and sample.
+     *
+     * @return   The found flanks.
+     */
+    inline const QVector<TriggerEvent>& getTriggerEvents() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the row indices of the trigger channels set by setTriggerChannels.
+     *
+     * @return   The trigger channel indices.
+     */
+    inline const QList<int>& getTriggerChannels() const;
+
     //=========================================================================================================
     /**
      * detectTriggerFlanks detects flanks from a given data matrix in row wise order. This function uses a simple maxCoeff function implemented by eigen to locate the triggers.
@@ -166,12 +232,40 @@ public:
                                                              bool bRemoveOffset,
                                                              const QString& type,
                                                              int iBurstLengthSamp = 100);
+
+private:
+    QList<int>                          m_lTriggerChannels;     /**< The row indices of the trigger channels. */
+    double                              m_dThreshold;           /**< The threshold which needs to be crossed. */
+    bool                                m_bFalling;             /**< Whether falling instead of rising flanks are detected. */
+    int                                 m_iBurstLengthSamp;     /**< The number of samples skipped after a found flank. */
+
+    bool                                m_bHasCarry;            /**< Whether m_vecCarry holds the last sample of a previous block. */
+    Eigen::VectorXd                     m_vecCarry;             /**< The last sample of each trigger channel of the previous block. */
+    Eigen::VectorXi                     m_vecBurstRemaining;    /**< The samples still to be skipped at the start of the next block per trigger channel. */
+
+    Eigen::MatrixXd                     m_matStim;              /**< The gathered trigger channels with the carried sample in the first column. */
+    Eigen::Array<bool,Eigen::Dynamic,Eigen::Dynamic>   m_matAbove;    /**< Whether the samples in m_matStim are above threshold. */
+    Eigen::Array<bool,Eigen::Dynamic,Eigen::Dynamic>   m_matFlanks;   /**< Whether a threshold crossing occured at the sample. */
+
+    QVector<TriggerEvent>               m_vecEvents;            /**< The flanks found in the last block. */
 };
 
 //=============================================================================================================
 // INLINE DEFINITIONS
 //=============================================================================================================
 
+inline const QVector<TriggerEvent>& DetectTrigger::getTriggerEvents() const
+{
+    return m_vecEvents;
+}
+
+//=============================================================================================================
+
+inline const QList<int>& DetectTrigger::getTriggerChannels() const
+{
+    return m_lTriggerChannels;
+}
+
 } // NAMESPACE
 
 #endif // DETECTTRIGGER_H
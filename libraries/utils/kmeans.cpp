@@ -43,6 +43,8 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <functional>
+#include <limits>
 #include <time.h>
 
 //=============================================================================================================
@@ -50,6 +52,8 @@
 //=============================================================================================================
 
 #include <QDebug>
+#include <QVector>
+#include <QtConcurrent>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -58,6 +62,12 @@
 using namespace UTILSLIB;
 using namespace Eigen;
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define KMEANS_ELKAN_MIN_DIM 50     /**< From this dimension on Elkan's bounds pay off over Hamerly's. */
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -67,13 +77,16 @@ KMeans::KMeans(QString distance,
                qint32 replicates,
                QString emptyact,
                bool online,
-               qint32 maxit)
+               qint32 maxit,
+               qint32 seed)
 : m_sDistance(distance)
 , m_sStart(start)
 , m_iReps(replicates)
 , m_sEmptyact(emptyact)
 , m_iMaxit(maxit)
 , m_bOnline(online)
+, m_iSeed(seed)
+, m_iBaseSeed(0)
 , emptyErrCnt(0)
 , iter(0)
 , k(0)
@@ -99,8 +112,12 @@ bool KMeans::calculate(MatrixXd X,
     if (kClusters < 1)
         return false;
 
-    //Init random generator
-    srand ( time(NULL) );
+    //Init random generator seeds
+    m_iBaseSeed = m_iSeed < 0 ? static_cast<quint32>(time(NULL)) : static_cast<quint32>(m_iSeed);
+
+    // Batch updates of "sqeuclidean" and "cityblock" are triangle inequality accelerated
+    if (!m_bOnline && (m_sDistance.compare("sqeuclidean") == 0 || m_sDistance.compare("cityblock") == 0))
+        return calculateAccelerated<double>(X, kClusters, idx, C, sumD, D);
 
 // n points in p dimensional space
     k = kClusters;
@@ -136,191 +153,786 @@ bool KMeans::calculate(MatrixXd X,
 //    }
 
     // Start
-    RowVectorXd Xmins;
-    RowVectorXd Xmaxs;
-    if (m_sStart.compare("uniform") == 0)
+    if (m_sStart.compare("uniform") == 0 && m_sDistance.compare("hamming") == 0)
     {
-        if (m_sDistance.compare("hamming") == 0)
-        {
-            printf("Error: Uniform Start For Hamming\n");
-            return false;
-        }
-        Xmins = X.colwise().minCoeff();
-        Xmaxs = X.colwise().maxCoeff();
+        printf("Error: Uniform Start For Hamming\n");
+        return false;
     }
 
     //
     // Done with input argument processing, begin clustering
     //
+    QVector<Replicate> qVecReplicates(m_iReps);
+    for(qint32 rep = 0; rep < m_iReps; ++rep)
+        qVecReplicates[rep].iRep = rep;
+
+    // Replicates are independent, each one runs on its own copy of the clustering state
+    std::function<void(Replicate&)> runReplicate = [this, &X](Replicate& rep) {
+        KMeans t_kMeans(*this);
+        rep.bValid = t_kMeans.calculateReplicate(X, rep);
+    };
+
+    if (m_iReps > 1)
+        QtConcurrent::blockingMap(qVecReplicates, runReplicate);
+    else
+        qVecReplicates[0].bValid = calculateReplicate(X, qVecReplicates[0]);
+
+    // Save the best solution
+    double totsumDBest = std::numeric_limits<double>::max();
+    qint32 iBest = -1;
+    emptyErrCnt = 0;
+
+    for(qint32 rep = 0; rep < m_iReps; ++rep)
+    {
+        if (!qVecReplicates[rep].bValid)
+        {
+            // If an empty cluster error occurred in one of multiple replicates, move on to next replicate.
+            // Error only when all replicates fail.
+            emptyErrCnt = emptyErrCnt + 1;
+//            printf("Replicate %d terminated: empty cluster created.\n", rep);
+            continue;
+        }
+
+        if (qVecReplicates[rep].totsumD < totsumDBest)
+        {
+            totsumDBest = qVecReplicates[rep].totsumD;
+            iBest = rep;
+        }
+    }
+
+    if (iBest < 0)
+    {
+//        error(message('EmptyClusterAllReps'));
+        return false;
+    }
+
+    // Return the best solution
+    totsumD = totsumDBest;
+    idx = qVecReplicates[iBest].idx;
+    C = qVecReplicates[iBest].C;
+    sumD = qVecReplicates[iBest].sumD;
+    D = qVecReplicates[iBest].D;
+
+//if hadNaNs
+//    idx = statinsertnan(wasnan, idx);
+//end
+    return true;
+}
+
+//=============================================================================================================
+
+bool KMeans::calculate(const MatrixXf& X,
+                       qint32 kClusters,
+                       VectorXi& idx,
+                       MatrixXf& C,
+                       VectorXf& sumD,
+                       MatrixXf& D)
+{
+    if (kClusters < 1)
+        return false;
+
+    m_iBaseSeed = m_iSeed < 0 ? static_cast<quint32>(time(NULL)) : static_cast<quint32>(m_iSeed);
+
+    if (!m_bOnline && (m_sDistance.compare("sqeuclidean") == 0 || m_sDistance.compare("cityblock") == 0))
+        return calculateAccelerated<float>(X, kClusters, idx, C, sumD, D);
+
+    // The MATLAB style online update is only implemented in double precision
+    MatrixXd t_C, t_D;
+    VectorXd t_sumD;
+    if (!calculate(MatrixXd(X.cast<double>()), kClusters, idx, t_C, t_sumD, t_D))
+        return false;
+
+    C = t_C.cast<float>();
+    sumD = t_sumD.cast<float>();
+    D = t_D.cast<float>();
+
+    return true;
+}
+
+//=============================================================================================================
+
+bool KMeans::calculateReplicate(const MatrixXd& X,
+                                Replicate& rep)
+{
+    std::mt19937 t_generator(replicateSeed(rep.iRep));
+
     if (m_bOnline)
     {
         Del = MatrixXd(n,k);
         Del.fill(std::numeric_limits<double>::quiet_NaN());// reassignment criterion
     }
 
-    double totsumDBest = std::numeric_limits<double>::max();
-    emptyErrCnt = 0;
+    VectorXi& idx = rep.idx;
+    MatrixXd& C = rep.C;
+    VectorXd& sumD = rep.sumD;
+    MatrixXd& D = rep.D;
 
-    VectorXi idxBest;
-    MatrixXd Cbest;
-    VectorXd sumDBest;
-    MatrixXd Dbest;
+    if (m_sStart.compare("uniform") == 0)
+    {
+        RowVectorXd Xmins = X.colwise().minCoeff();
+        RowVectorXd Xmaxs = X.colwise().maxCoeff();
 
-    for(qint32 rep = 0; rep < m_iReps; ++rep)
+        C = MatrixXd::Zero(k,p);
+        for(qint32 i = 0; i < k; ++i)
+            for(qint32 j = 0; j < p; ++j)
+                C(i,j) = unifrnd(Xmins[j], Xmaxs[j], t_generator);
+        // For 'cosine' and 'correlation', these are uniform inside a subset
+        // of the unit hypersphere.  Still need to center them for
+        // 'correlation'.  (Re)normalization for 'cosine'/'correlation' is
+        // done at each iteration.
+        if (m_sDistance.compare("correlation") == 0)
+            C.array() -= (C.array().rowwise().sum()/p).replicate(1, p).array();
+    }
+    else
     {
-        if (m_sStart.compare("uniform") == 0)
-        {
-            C = MatrixXd::Zero(k,p);
-            for(qint32 i = 0; i < k; ++i)
-                for(qint32 j = 0; j < p; ++j)
-                    C(i,j) = unifrnd(Xmins[j], Xmaxs[j]);
-            // For 'cosine' and 'correlation', these are uniform inside a subset
-            // of the unit hypersphere.  Still need to center them for
-            // 'correlation'.  (Re)normalization for 'cosine'/'correlation' is
-            // done at each iteration.
-            if (m_sDistance.compare("correlation") == 0)
-                C.array() -= (C.array().rowwise().sum()/p).replicate(1, p).array();
-        }
-        else if (m_sStart.compare("sample") == 0)
-        {
-            C = MatrixXd::Zero(k,p);
-            for(qint32 i = 0; i < k; ++i)
-                C.block(i,0,1,p) = X.block(rand() % n, 0, 1, p);
-            // DEBUG
-//            C.block(0,0,1,p) = X.block(2, 0, 1, p);
-//            C.block(1,0,1,p) = X.block(7, 0, 1, p);
-//            C.block(2,0,1,p) = X.block(17, 0, 1, p);
-        }
-    //    else if (start.compare("cluster") == 0)
-    //    {
-    //        Xsubset = X(randsample(n,floor(.1*n)),:);
-    //        [dum, C] = kmeans(Xsubset, k, varargin{:}, 'start','sample', 'replicates',1);
-    //    }
-    //    else if (start.compare("numeric") == 0)
-    //    {
-    //        C = CC(:,:,rep);
-    //    }
-
-        // Compute the distance from every point to each cluster centroid and the
-        // initial assignment of points to clusters
-        D = distfun(X, C);//, 0);
-        idx = VectorXi::Zero(D.rows());
-        d = VectorXd::Zero(D.rows());
+        MatrixXd Ct;
+        initCentroids<double>(X.transpose(), k, t_generator, Ct);
+        C = Ct.transpose();
+    }
+//    else if (start.compare("cluster") == 0)
+//    {
+//        Xsubset = X(randsample(n,floor(.1*n)),:);
+//        [dum, C] = kmeans(Xsubset, k, varargin{:}, 'start','sample', 'replicates',1);
+//    }
+//    else if (start.compare("numeric") == 0)
+//    {
+//        C = CC(:,:,rep);
+//    }
 
-        for(qint32 i = 0; i < D.rows(); ++i)
-            d[i] = D.row(i).minCoeff(&idx[i]);
+    // Compute the distance from every point to each cluster centroid and the
+    // initial assignment of points to clusters
+    D = distfun(X, C);//, 0);
+    idx = VectorXi::Zero(D.rows());
+    d = VectorXd::Zero(D.rows());
+
+    for(qint32 i = 0; i < D.rows(); ++i)
+        d[i] = D.row(i).minCoeff(&idx[i]);
+
+    m = VectorXi::Zero(k);
+    for(qint32 i = 0; i < k; ++i)
+        for (qint32 j = 0; j < idx.rows(); ++j)
+            if(idx[j] == i)
+                ++ m[i];
+
+    try // catch empty cluster errors and move on to next rep
+    {
+        // Begin phase one:  batch reassignments
+        bool converged = batchUpdate(X, C, idx);
+
+        // Begin phase two:  single reassignments
+        if (m_bOnline)
+            converged = onlineUpdate(X, C, idx);
+
+        if (!converged)
+            printf("Failed To Converge during replicate %d\n", rep.iRep);
+
+        // Calculate cluster-wise sums of distances
+        VectorXi nonempties = VectorXi::Zero(m.rows());
+        quint32 count = 0;
+        for(qint32 i = 0; i < m.rows(); ++i)
+        {
+            if(m[i] > 0)
+            {
+                nonempties[i] = 1;
+                ++count;
+            }
+        }
+        MatrixXd C_tmp(count,C.cols());
+        count = 0;
+        for(qint32 i = 0; i < nonempties.rows(); ++i)
+        {
+            if(nonempties[i])
+            {
+                C_tmp.row(count) = C.row(i);
+                ++count;
+            }
+        }
+
+        MatrixXd D_tmp = distfun(X, C_tmp);//, iter);
+        count = 0;
+        for(qint32 i = 0; i < nonempties.rows(); ++i)
+        {
+            if(nonempties[i])
+            {
+                D.col(i) = D_tmp.col(count);
+                C.row(i) = C_tmp.row(count);
+                ++count;
+            }
+        }
 
-        m = VectorXi::Zero(k);
+        d = VectorXd::Zero(n);
+        for(qint32 i = 0; i < n; ++i)
+            d[i] += D.array()(idx[i]*n+i);//Colum Major
+
+        sumD = VectorXd::Zero(k);
         for(qint32 i = 0; i < k; ++i)
             for (qint32 j = 0; j < idx.rows(); ++j)
                 if(idx[j] == i)
-                    ++ m[i];
+                    sumD[i] += d[j];
+
+        totsumD = sumD.array().sum();
+        rep.totsumD = totsumD;
+
+//        printf("%d iterations, total sum of distances = %f\n", iter, totsumD);
+    }
+    catch (int e)
+    {
+        // An empty cluster error occurred, rethrow an other kind of error.
+        if(e == 0)
+            return false;
+        throw;
+    } // catch
+
+    return true;
+}
+
+//=============================================================================================================
+
+template<typename T>
+bool KMeans::calculateAccelerated(const Matrix<T, Dynamic, Dynamic>& X,
+                                  qint32 kClusters,
+                                  VectorXi& idx,
+                                  Matrix<T, Dynamic, Dynamic>& C,
+                                  Matrix<T, Dynamic, 1>& sumD,
+                                  Matrix<T, Dynamic, Dynamic>& D) const
+{
+    typedef Matrix<T, Dynamic, Dynamic> MatrixT;
+
+    if (X.rows() < kClusters)
+        return false;
+
+    const bool bCityblock = m_sDistance.compare("cityblock") == 0;
+
+    // Points are stored as contiguous columns, so point to centroid distances vectorize
+    const MatrixT Xt = X.transpose();
+
+    struct AcceleratedReplicate
+    {
+        qint32      iRep;
+        MatrixT     Ct;
+        VectorXi    idx;
+        T           totsumD;
+        bool        bValid;
+    };
+
+    QVector<AcceleratedReplicate> qVecReplicates(m_iReps);
+    for(qint32 rep = 0; rep < m_iReps; ++rep)
+        qVecReplicates[rep].iRep = rep;
+
+    std::function<void(AcceleratedReplicate&)> runReplicate = [this, &Xt, kClusters, bCityblock](AcceleratedReplicate& rep) {
+        std::mt19937 t_generator(replicateSeed(rep.iRep));
+        initCentroids<T>(Xt, kClusters, t_generator, rep.Ct);
 
         try // catch empty cluster errors and move on to next rep
         {
-            // Begin phase one:  batch reassignments
-            bool converged = batchUpdate(X, C, idx);
+            bool converged = Xt.rows() < KMEANS_ELKAN_MIN_DIM ? hamerlyUpdate<T>(Xt, rep.Ct, rep.idx)
+                                                              : elkanUpdate<T>(Xt, rep.Ct, rep.idx);
+            if (!converged)
+                printf("Failed To Converge during replicate %d\n", rep.iRep);
+        }
+        catch (int e)
+        {
+            // An empty cluster error occurred, rethrow an other kind of error.
+            if(e != 0)
+                throw;
+            rep.bValid = false;
+            return;
+        }
 
-            // Begin phase two:  single reassignments
-            if (m_bOnline)
-                converged = onlineUpdate(X, C, idx);
+        rep.bValid = true;
 
-            if (!converged)
-                printf("Failed To Converge during replicate %d\n", rep);
+        rep.totsumD = 0;
+        for(qint32 i = 0; i < Xt.cols(); ++i)
+            rep.totsumD += bCityblock ? (Xt.col(i) - rep.Ct.col(rep.idx[i])).cwiseAbs().sum()
+                                      : (Xt.col(i) - rep.Ct.col(rep.idx[i])).squaredNorm();
+    };
+
+    if (m_iReps > 1)
+        QtConcurrent::blockingMap(qVecReplicates, runReplicate);
+    else
+        runReplicate(qVecReplicates[0]);
+
+    // If an empty cluster error occurred in one of multiple replicates, move on to next replicate.
+    // Error only when all replicates fail.
+    qint32 iBest = -1;
+    for(qint32 rep = 0; rep < m_iReps; ++rep)
+        if (qVecReplicates[rep].bValid && (iBest < 0 || qVecReplicates[rep].totsumD < qVecReplicates[iBest].totsumD))
+            iBest = rep;
+
+    if (iBest < 0)
+        return false;
+
+    // Return the best solution
+    const MatrixT& Ct = qVecReplicates[iBest].Ct;
+    idx = qVecReplicates[iBest].idx;
+    C = Ct.transpose();
+
+    if (bCityblock)
+    {
+        D.resize(Xt.cols(), kClusters);
+        for(qint32 j = 0; j < kClusters; ++j)
+            D.col(j) = (Xt.colwise() - Ct.col(j)).cwiseAbs().colwise().sum().transpose();
+    }
+    else
+    {
+        // |x|^2 + |c|^2 - 2 x'c, clamped to suppress negative round off
+        D.noalias() = T(-2) * X * Ct;
+        D.colwise() += X.rowwise().squaredNorm();
+        D.rowwise() += Ct.colwise().squaredNorm();
+        D = D.cwiseMax(T(0));
+    }
+
+    // Dropped clusters have NaN centroids and distances
+    for(qint32 j = 0; j < kClusters; ++j)
+        if (Ct.col(j).hasNaN())
+            D.col(j).setConstant(std::numeric_limits<T>::quiet_NaN());
 
-            // Calculate cluster-wise sums of distances
-            VectorXi nonempties = VectorXi::Zero(m.rows());
-            quint32 count = 0;
-            for(qint32 i = 0; i < m.rows(); ++i)
+    sumD = Matrix<T, Dynamic, 1>::Zero(kClusters);
+    for(qint32 i = 0; i < Xt.cols(); ++i)
+        sumD[idx[i]] += D(i, idx[i]);
+
+    return true;
+}
+
+//=============================================================================================================
+
+template<typename T>
+void KMeans::initCentroids(const Matrix<T, Dynamic, Dynamic>& Xt,
+                           qint32 kClusters,
+                           std::mt19937& generator,
+                           Matrix<T, Dynamic, Dynamic>& Ct) const
+{
+    const qint32 nPoints = Xt.cols();
+    Ct.resize(Xt.rows(), kClusters);
+
+    if (m_sStart.compare("uniform") == 0)
+    {
+        Matrix<T, Dynamic, 1> Xmins = Xt.rowwise().minCoeff();
+        Matrix<T, Dynamic, 1> Xmaxs = Xt.rowwise().maxCoeff();
+        std::uniform_real_distribution<double> t_uniform(0.0, 1.0);
+
+        for(qint32 j = 0; j < kClusters; ++j)
+            for(qint32 i = 0; i < Xt.rows(); ++i)
+                Ct(i,j) = Xmins[i] + T(t_uniform(generator)) * (Xmaxs[i] - Xmins[i]);
+    }
+    else if (m_sStart.compare("plus") == 0)
+    {
+        // k-means++: sample each new centroid with probability proportional to its (squared) distance
+        // to the closest centroid chosen so far
+        const bool bCityblock = m_sDistance.compare("cityblock") == 0;
+        std::uniform_int_distribution<qint32> t_first(0, nPoints - 1);
+        Ct.col(0) = Xt.col(t_first(generator));
+
+        VectorXd t_vecMinDist(nPoints);
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            if (j > 0)
             {
-                if(m[i] > 0)
+                std::uniform_real_distribution<double> t_uniform(0.0, t_vecMinDist.sum());
+                double dTarget = t_uniform(generator);
+                qint32 iNext = nPoints - 1;
+                for(qint32 i = 0; i < nPoints; ++i)
                 {
-                    nonempties[i] = 1;
-                    ++count;
+                    dTarget -= t_vecMinDist[i];
+                    if (dTarget < 0)
+                    {
+                        iNext = i;
+                        break;
+                    }
                 }
+                Ct.col(j) = Xt.col(iNext);
             }
-            MatrixXd C_tmp(count,C.cols());
-            count = 0;
-            for(qint32 i = 0; i < nonempties.rows(); ++i)
+
+            for(qint32 i = 0; i < nPoints; ++i)
             {
-                if(nonempties[i])
-                {
-                    C_tmp.row(count) = C.row(i);
-                    ++count;
-                }
+                double dDist = bCityblock ? double((Xt.col(i) - Ct.col(j)).cwiseAbs().sum())
+                                          : double((Xt.col(i) - Ct.col(j)).squaredNorm());
+                t_vecMinDist[i] = j == 0 ? dDist : std::min(t_vecMinDist[i], dDist);
             }
+        }
+    }
+    else
+    {
+        // "sample": distinct random points, as long as there are enough points
+        std::vector<qint32> t_vecPoints(nPoints);
+        for(qint32 i = 0; i < nPoints; ++i)
+            t_vecPoints[i] = i;
 
-            MatrixXd D_tmp = distfun(X, C_tmp);//, iter);
-            count = 0;
-            for(qint32 i = 0; i < nonempties.rows(); ++i)
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            if (j < nPoints)
             {
-                if(nonempties[i])
-                {
-                    D.col(i) = D_tmp.col(count);
-                    C.row(i) = C_tmp.row(count);
-                    ++count;
-                }
+                std::uniform_int_distribution<qint32> t_pick(j, nPoints - 1);
+                std::swap(t_vecPoints[j], t_vecPoints[t_pick(generator)]);
+                Ct.col(j) = Xt.col(t_vecPoints[j]);
             }
+            else
+            {
+                std::uniform_int_distribution<qint32> t_pick(0, nPoints - 1);
+                Ct.col(j) = Xt.col(t_pick(generator));
+            }
+        }
+    }
+}
 
-            d = VectorXd::Zero(n);
-            for(qint32 i = 0; i < n; ++i)
-                d[i] += D.array()(idx[i]*n+i);//Colum Major
+//=============================================================================================================
 
-            sumD = VectorXd::Zero(k);
-            for(qint32 i = 0; i < k; ++i)
-                for (qint32 j = 0; j < idx.rows(); ++j)
-                    if(idx[j] == i)
-                        sumD[i] += d[j];
+template<typename T>
+void KMeans::updateCentroids(const Matrix<T, Dynamic, Dynamic>& Xt,
+                             VectorXi& idx,
+                             Matrix<T, Dynamic, 1>& upper,
+                             Matrix<T, Dynamic, Dynamic>& Ct,
+                             Matrix<T, Dynamic, 1>& moved,
+                             std::vector<qint32>& reseeded) const
+{
+    const qint32 nPoints = Xt.cols();
+    const qint32 kClusters = Ct.cols();
 
-            totsumD = sumD.array().sum();
+    VectorXi counts = VectorXi::Zero(kClusters);
+    for(qint32 i = 0; i < nPoints; ++i)
+        ++counts[idx[i]];
 
-//            printf("%d iterations, total sum of distances = %f\n", iter, totsumD);
+    const bool bCityblock = m_sDistance.compare("cityblock") == 0;
 
-            // Save the best solution so far
-            if (totsumD < totsumDBest)
+    // Deal with clusters that have lost all their members. Dropped clusters (NaN centroids) stay empty.
+    reseeded.clear();
+    Matrix<T, Dynamic, 1> dist;
+    for(qint32 j = 0; j < kClusters; ++j)
+    {
+        if (counts[j] > 0 || Ct.col(j).hasNaN())
+            continue;
+
+        if (m_sEmptyact.compare("error") == 0)
+        {
+            throw 0;
+        }
+        else if (m_sEmptyact.compare("drop") == 0)
+        {
+            // Remove the empty cluster from any further processing
+            Ct.col(j).setConstant(std::numeric_limits<T>::quiet_NaN());
+        }
+        else if (m_sEmptyact.compare("singleton") == 0)
+        {
+            // The upper bounds are not tight, use the exact distances to the current centroids
+            if (dist.size() == 0)
             {
-                totsumDBest = totsumD;
-                idxBest = idx;
-                Cbest = C;
-                sumDBest = sumD;
-                Dbest = D;
+                dist.resize(nPoints);
+                for(qint32 i = 0; i < nPoints; ++i)
+                    dist[i] = bCityblock ? (Xt.col(i) - Ct.col(idx[i])).cwiseAbs().sum()
+                                         : (Xt.col(i) - Ct.col(idx[i])).norm();
             }
+
+            // Take the point furthest away from its current cluster to create a new singleton cluster
+            qint32 lonely = -1;
+            for(qint32 i = 0; i < nPoints; ++i)
+                if (counts[idx[i]] > 1 && (lonely < 0 || dist[i] > dist[lonely]))
+                    lonely = i;
+
+            if (lonely < 0)
+                break;
+
+            --counts[idx[lonely]];
+            idx[lonely] = j;
+            counts[j] = 1;
+            upper[lonely] = 0;
+            reseeded.push_back(lonely);
         }
-        catch (int e)
+    }
+
+    const Matrix<T, Dynamic, Dynamic> Ct_old = Ct;
+
+    if (bCityblock)
+    {
+        // Component-wise median of the members
+        std::vector<std::vector<qint32> > members(kClusters);
+        for(qint32 i = 0; i < nPoints; ++i)
+            members[idx[i]].push_back(i);
+
+        std::vector<T> values;
+        for(qint32 j = 0; j < kClusters; ++j)
         {
-            if(e == 0)
+            const qint32 count = counts[j];
+            if (count == 0)
+                continue;
+
+            values.resize(count);
+            for(qint32 h = 0; h < Xt.rows(); ++h)
             {
-                // If an empty cluster error occurred in one of multiple replicates, catch
-                // it, warn, and move on to next replicate.  Error only when all replicates
-                // fail.  Rethrow an other kind of error.
-                if (m_iReps == 1)
-                    return false;
+                for(qint32 c = 0; c < count; ++c)
+                    values[c] = Xt(h, members[j][c]);
+
+                const qint32 nn = count / 2;
+                std::nth_element(values.begin(), values.begin() + nn, values.end());
+                if (count % 2 == 0)
+                    Ct(h,j) = T(0.5) * (values[nn] + *std::max_element(values.begin(), values.begin() + nn));
                 else
+                    Ct(h,j) = values[nn];
+            }
+        }
+    }
+    else
+    {
+        // Mean of the members
+        for(qint32 j = 0; j < kClusters; ++j)
+            if (counts[j] > 0)
+                Ct.col(j).setZero();
+
+        for(qint32 i = 0; i < nPoints; ++i)
+            Ct.col(idx[i]) += Xt.col(i);
+
+        for(qint32 j = 0; j < kClusters; ++j)
+            if (counts[j] > 0)
+                Ct.col(j) /= T(counts[j]);
+    }
+
+    moved.resize(kClusters);
+    for(qint32 j = 0; j < kClusters; ++j)
+    {
+        if (Ct.col(j).hasNaN())
+            moved[j] = 0;
+        else
+            moved[j] = bCityblock ? (Ct.col(j) - Ct_old.col(j)).cwiseAbs().sum()
+                                  : (Ct.col(j) - Ct_old.col(j)).norm();
+    }
+}
+
+//=============================================================================================================
+
+template<typename T>
+bool KMeans::hamerlyUpdate(const Matrix<T, Dynamic, Dynamic>& Xt,
+                           Matrix<T, Dynamic, Dynamic>& Ct,
+                           VectorXi& idx) const
+{
+    // Bounds are kept on metric distances, i.e. euclidean instead of squared euclidean distances
+    const bool bCityblock = m_sDistance.compare("cityblock") == 0;
+    const qint32 nPoints = Xt.cols();
+    const qint32 kClusters = Ct.cols();
+
+    auto dist = [&Xt, &Ct, bCityblock](qint32 i, qint32 j) -> T {
+        return bCityblock ? (Xt.col(i) - Ct.col(j)).cwiseAbs().sum() : (Xt.col(i) - Ct.col(j)).norm();
+    };
+
+    Matrix<T, Dynamic, 1> upper(nPoints);   // distance to the assigned centroid
+    Matrix<T, Dynamic, 1> lower(nPoints);   // distance to the second closest centroid
+    Matrix<T, Dynamic, 1> halfSep(kClusters);
+    Matrix<T, Dynamic, 1> moved;
+    std::vector<qint32> reseeded;
+    std::vector<bool> dropped(kClusters, false);
+
+    // Assign every point to its closest centroid
+    auto assign = [&](qint32 i) {
+        T dBest = std::numeric_limits<T>::max();
+        T dSecond = std::numeric_limits<T>::max();
+        qint32 iBest = idx[i];
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            if (dropped[j])
+                continue;
+
+            T dj = dist(i, j);
+            if (dj < dBest || (dj == dBest && j == idx[i]))
+            {
+                dSecond = dBest;
+                dBest = dj;
+                iBest = j;
+            }
+            else if (dj < dSecond)
+                dSecond = dj;
+        }
+        idx[i] = iBest;
+        upper[i] = dBest;
+        lower[i] = dSecond;
+    };
+
+    idx = VectorXi::Zero(nPoints);
+    for(qint32 i = 0; i < nPoints; ++i)
+        assign(i);
+
+    for(qint32 iter = 1; iter <= m_iMaxit; ++iter)
+    {
+        // Move the centroids and loosen the bounds by the distance they moved
+        updateCentroids<T>(Xt, idx, upper, Ct, moved, reseeded);
+        for(size_t r = 0; r < reseeded.size(); ++r)
+            lower[reseeded[r]] = 0;
+        for(qint32 j = 0; j < kClusters; ++j)
+            dropped[j] = Ct.col(j).hasNaN();
+
+        qint32 iFar = 0;
+        for(qint32 j = 1; j < kClusters; ++j)
+            if (moved[j] > moved[iFar])
+                iFar = j;
+        T dSecondFar = 0;
+        for(qint32 j = 0; j < kClusters; ++j)
+            if (j != iFar && moved[j] > dSecondFar)
+                dSecondFar = moved[j];
+
+        for(qint32 i = 0; i < nPoints; ++i)
+        {
+            upper[i] += moved[idx[i]];
+            lower[i] -= idx[i] == iFar ? dSecondFar : moved[iFar];
+        }
+
+        // Half the distance of each centroid to its closest neighbour
+        halfSep.setConstant(std::numeric_limits<T>::max());
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            for(qint32 h = j + 1; h < kClusters; ++h)
+            {
+                if (dropped[j] || dropped[h])
+                    continue;
+
+                T dCC = bCityblock ? (Ct.col(j) - Ct.col(h)).cwiseAbs().sum() : (Ct.col(j) - Ct.col(h)).norm();
+                halfSep[j] = std::min(halfSep[j], T(0.5) * dCC);
+                halfSep[h] = std::min(halfSep[h], T(0.5) * dCC);
+            }
+        }
+
+        // Reassign only points whose bounds do not rule out a closer centroid
+        qint32 nChanged = 0;
+        for(qint32 i = 0; i < nPoints; ++i)
+        {
+            T bound = std::max(halfSep[idx[i]], lower[i]);
+            if (upper[i] <= bound)
+                continue;
+
+            upper[i] = dist(i, idx[i]);
+            if (upper[i] <= bound)
+                continue;
+
+            qint32 iPrev = idx[i];
+            assign(i);
+            if (idx[i] != iPrev)
+                ++nChanged;
+        }
+
+        // The centroids already belong to an unchanged assignment
+        if (nChanged == 0)
+            return true;
+    }
+
+    return false;
+}
+
+//=============================================================================================================
+
+template<typename T>
+bool KMeans::elkanUpdate(const Matrix<T, Dynamic, Dynamic>& Xt,
+                         Matrix<T, Dynamic, Dynamic>& Ct,
+                         VectorXi& idx) const
+{
+    // Bounds are kept on metric distances, i.e. euclidean instead of squared euclidean distances
+    const bool bCityblock = m_sDistance.compare("cityblock") == 0;
+    const qint32 nPoints = Xt.cols();
+    const qint32 kClusters = Ct.cols();
+
+    auto dist = [&Xt, &Ct, bCityblock](qint32 i, qint32 j) -> T {
+        return bCityblock ? (Xt.col(i) - Ct.col(j)).cwiseAbs().sum() : (Xt.col(i) - Ct.col(j)).norm();
+    };
+
+    Matrix<T, Dynamic, 1> upper(nPoints);                   // distance to the assigned centroid
+    Matrix<T, Dynamic, Dynamic> lower(kClusters, nPoints);  // distances to all centroids, one column per point
+    Matrix<T, Dynamic, Dynamic> halfCC(kClusters, kClusters);
+    Matrix<T, Dynamic, 1> halfSep(kClusters);
+    Matrix<T, Dynamic, 1> moved;
+    std::vector<qint32> reseeded;
+
+    // Assign every point to its closest centroid
+    idx = VectorXi::Zero(nPoints);
+    for(qint32 i = 0; i < nPoints; ++i)
+    {
+        for(qint32 j = 0; j < kClusters; ++j)
+            lower(j,i) = dist(i, j);
+        upper[i] = lower.col(i).minCoeff(&idx[i]);
+    }
+
+    for(qint32 iter = 1; iter <= m_iMaxit; ++iter)
+    {
+        // Move the centroids and loosen the bounds by the distance they moved
+        updateCentroids<T>(Xt, idx, upper, Ct, moved, reseeded);
+        for(size_t r = 0; r < reseeded.size(); ++r)
+            lower.col(reseeded[r]).setZero();
+
+        lower = (lower.colwise() - moved).cwiseMax(T(0));
+        for(qint32 i = 0; i < nPoints; ++i)
+            upper[i] += moved[idx[i]];
+
+        // Dropped clusters are ruled out by their lower bounds
+        for(qint32 j = 0; j < kClusters; ++j)
+            if (Ct.col(j).hasNaN())
+                lower.row(j).setConstant(std::numeric_limits<T>::max());
+
+        // Half the centroid to centroid distances
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            halfCC(j,j) = 0;
+            for(qint32 h = j + 1; h < kClusters; ++h)
+            {
+                if (Ct.col(j).hasNaN() || Ct.col(h).hasNaN())
                 {
-                    emptyErrCnt = emptyErrCnt + 1;
-//                    printf("Replicate %d terminated: empty cluster created at iteration %d.\n", rep, iter);
-                    if (emptyErrCnt == m_iReps)
-                    {
-//                        error(message('EmptyClusterAllReps'));
-                        return false;
-                    }
+                    halfCC(j,h) = halfCC(h,j) = std::numeric_limits<T>::max();
+                    continue;
+                }
 
+                T dCC = bCityblock ? (Ct.col(j) - Ct.col(h)).cwiseAbs().sum() : (Ct.col(j) - Ct.col(h)).norm();
+                halfCC(j,h) = halfCC(h,j) = T(0.5) * dCC;
+            }
+        }
+        for(qint32 j = 0; j < kClusters; ++j)
+        {
+            halfSep[j] = std::numeric_limits<T>::max();
+            for(qint32 h = 0; h < kClusters; ++h)
+                if (h != j)
+                    halfSep[j] = std::min(halfSep[j], halfCC(j,h));
+        }
+
+        // Reassign only points whose bounds do not rule out a closer centroid
+        qint32 nChanged = 0;
+        for(qint32 i = 0; i < nPoints; ++i)
+        {
+            if (upper[i] <= halfSep[idx[i]])
+                continue;
+
+            bool bTight = false;
+            qint32 iPrev = idx[i];
+            for(qint32 j = 0; j < kClusters; ++j)
+            {
+                if (j == idx[i] || upper[i] <= lower(j,i) || upper[i] <= halfCC(idx[i],j))
+                    continue;
+
+                if (!bTight)
+                {
+                    upper[i] = dist(i, idx[i]);
+                    lower(idx[i],i) = upper[i];
+                    bTight = true;
+                    if (upper[i] <= lower(j,i) || upper[i] <= halfCC(idx[i],j))
+                        continue;
+                }
+
+                lower(j,i) = dist(i, j);
+                if (lower(j,i) < upper[i])
+                {
+                    idx[i] = j;
+                    upper[i] = lower(j,i);
                 }
             }
-        } // catch
 
-    } // replicates
+            if (idx[i] != iPrev)
+                ++nChanged;
+        }
 
-    // Return the best solution
-    idx = idxBest;
-    C = Cbest;
-    sumD = sumDBest;
-    D = Dbest;
+        // The centroids already belong to an unchanged assignment
+        if (nChanged == 0)
+            return true;
+    }
 
-//if hadNaNs
-//    idx = statinsertnan(wasnan, idx);
-//end
-    return true;
+    return false;
+}
+
+//=============================================================================================================
+
+quint32 KMeans::replicateSeed(qint32 rep) const
+{
+    return m_iBaseSeed + static_cast<quint32>(rep);
 }
 
 //=============================================================================================================
@@ -1001,17 +1613,12 @@ void KMeans::gcentroids(const MatrixXd& X, const VectorXi& index, const VectorXi
 
 //=============================================================================================================
 
-double KMeans::unifrnd(double a, double b)
+double KMeans::unifrnd(double a, double b, std::mt19937& generator)
 {
     if (a > b)
         return std::numeric_limits<double>::quiet_NaN();
 
-    double a2 = a/2.0;
-    double b2 = b/2.0;
-    double mu = a2+b2;
-    double sig = b2-a2;
-
-    double r = mu + sig * (2.0* (rand() % 1000)/1000 -1.0);
+    std::uniform_real_distribution<double> t_uniform(a, b);
 
-    return r;
+    return t_uniform(generator);
 }
@@ -55,6 +55,12 @@
 
 #include <Eigen/Core>
 
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <random>
+
 //=============================================================================================================
 // DEFINE NAMESPACE MNELIB
 //=============================================================================================================
@@ -64,7 +70,11 @@ namespace UTILSLIB
 
 //=============================================================================================================
 /**
- * K-Means Clustering
+ * K-Means Clustering. For large data, use the start option "plus" (k-means++ seeding) together with batch updates
+ * only (online = false) and "sqeuclidean" or "cityblock" distances, which select the triangle inequality
+ * accelerated iterations. A fixed seed makes the clusters reproducible. The forward solution and kernel
+ * clustering use this configuration with the "singleton" empty cluster action, so that a replicate running into
+ * an empty cluster is continued instead of discarded.
  *
  * @brief K-Means Clustering
  */
@@ -75,7 +85,7 @@ public:
     typedef QSharedPointer<const KMeans> ConstSPtr; /**< Const shared pointer type for KMeans. */
 
     //distance {'sqeuclidean','cityblock','cosine','correlation','hamming'};
-    //startNames = {'uniform','sample','cluster'};
+    //startNames = {'uniform','sample','plus','cluster'};
     //emptyactNames = {'error','drop','singleton'};
 
     //=========================================================================================================
@@ -83,22 +93,26 @@ public:
      * Constructs a KMeans algorithm object.
      *
      * @param[in] distance   (optional) K-Means distance measure: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming"
-     * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "cluster"
-     * @param[in] replicates (optional) Number of K-Means replicates, which are generated. Best is returned.
+     * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "plus" (k-means++), "cluster"
+     * @param[in] replicates (optional) Number of K-Means replicates, which are generated in parallel. Best is returned.
      * @param[in] emptyact   (optional) What happens if a cluster wents empty: "error" (default), "drop", "singleton"
      * @param[in] online     (optional) If centroids should be updated during iterations: true (default), false
      * @param[in] maxit      (optional) maximal number of iterations per replicate; 100 by default
+     * @param[in] seed       (optional) Seed of the random initialization. Replicate r is seeded with seed + r, which
+     *                       makes the result reproducible. -1 (default) seeds from the clock.
      */
     explicit KMeans(QString distance = QString("sqeuclidean") ,
                     QString start = QString("sample"),
                     qint32 replicates = 1,
                     QString emptyact = QString("error"),
                     bool online = true,
-                    qint32 maxit = 100);
+                    qint32 maxit = 100,
+                    qint32 seed = -1);
 
     //=========================================================================================================
     /**
-     * Clusters input data X
+     * Clusters input data X. Without online update, "sqeuclidean" and "cityblock" clustering uses triangle
+     * inequality bounds (Hamerly for low, Elkan for high dimensional data) to skip most distance calculations.
      *
      * @param[in] X          Input data (rows = points; cols = p dimensional space)
      * @param[in] kClusters  Number of k clusters
@@ -114,7 +128,153 @@ public:
                     Eigen::VectorXd& sumD,
                     Eigen::MatrixXd& D);
 
+    //=========================================================================================================
+    /**
+     * Clusters input data X in single precision. See calculate for double precision data.
+     *
+     * @param[in] X          Input data (rows = points; cols = p dimensional space)
+     * @param[in] kClusters  Number of k clusters
+     * @param[out] idx       The cluster indeces to which cluster the input points belong to
+     * @param[out] C         Cluster centroids k x p
+     * @param[out] sumD      Summation of the distances to the centroid within one cluster
+     * @param[out] D         Cluster distances to the centroid
+     */
+    bool calculate( const Eigen::MatrixXf& X,
+                    qint32 kClusters,
+                    Eigen::VectorXi& idx,
+                    Eigen::MatrixXf& C,
+                    Eigen::VectorXf& sumD,
+                    Eigen::MatrixXf& D);
+
 private:
+    //=========================================================================================================
+    /**
+     * Result of one K-Means replicate
+     */
+    struct Replicate
+    {
+        qint32              iRep;       /**< Replicate number, used to seed the initialization. */
+        bool                bValid;     /**< Whether the replicate finished without error. */
+        double              totsumD;    /**< Total sum of centroid distances. */
+        Eigen::VectorXi     idx;        /**< Point cluster indeces. */
+        Eigen::MatrixXd     C;          /**< Cluster centroids. */
+        Eigen::VectorXd     sumD;       /**< Sums of the distances to the centroid. */
+        Eigen::MatrixXd     D;          /**< Distances to the centroids. */
+    };
+
+    //=========================================================================================================
+    /**
+     * Runs one replicate of the MATLAB style batch and online update clustering. Works on the member state, so
+     * parallel replicates have to run on copies of this object.
+     *
+     * @param[in] X          Input data (rows = points; cols = p dimensional space)
+     * @param[in, out] rep   The replicate to calculate.
+     *
+     * @return true if successful, false if an empty cluster error occured
+     */
+    bool calculateReplicate(const Eigen::MatrixXd& X,
+                            Replicate& rep);
+
+    //=========================================================================================================
+    /**
+     * Clusters input data X with triangle inequality accelerated Lloyd iterations ("sqeuclidean" and "cityblock"
+     * only). Replicates run in parallel. Replicates running into an empty cluster with m_sEmptyact "error" are
+     * discarded. Dropped clusters have NaN centroids and distances.
+     *
+     * @param[in] X          Input data (rows = points; cols = p dimensional space)
+     * @param[in] kClusters  Number of k clusters
+     * @param[out] idx       The cluster indeces to which cluster the input points belong to
+     * @param[out] C         Cluster centroids k x p
+     * @param[out] sumD      Summation of the distances to the centroid within one cluster
+     * @param[out] D         Cluster distances to the centroid
+     *
+     * @return true if successful, false if all replicates failed
+     */
+    template<typename T>
+    bool calculateAccelerated(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& X,
+                              qint32 kClusters,
+                              Eigen::VectorXi& idx,
+                              Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& C,
+                              Eigen::Matrix<T, Eigen::Dynamic, 1>& sumD,
+                              Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& D) const;
+
+    //=========================================================================================================
+    /**
+     * Initializes the cluster centroids according to m_sStart.
+     *
+     * @param[in] Xt             Transposed input data (rows = p dimensional space; cols = points)
+     * @param[in] kClusters      Number of k clusters
+     * @param[in] generator      Random generator of the replicate.
+     * @param[out] Ct            Transposed cluster centroids p x k
+     */
+    template<typename T>
+    void initCentroids(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Xt,
+                       qint32 kClusters,
+                       std::mt19937& generator,
+                       Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Ct) const;
+
+    //=========================================================================================================
+    /**
+     * Recomputes the centroids (mean for "sqeuclidean", component-wise median for "cityblock") from the cluster
+     * assignments. Empty clusters are handled according to m_sEmptyact: "error" throws 0, "drop" sets the centroid
+     * to NaN and excludes the cluster from further processing, "singleton" moves the point furthest away from its
+     * centroid into the empty cluster.
+     *
+     * @param[in] Xt             Transposed input data (rows = p dimensional space; cols = points)
+     * @param[in, out] idx       The cluster indeces to which cluster the input points belong to
+     * @param[in, out] upper     Upper bounds of the distances to the assigned centroids.
+     * @param[in, out] Ct        Transposed cluster centroids p x k
+     * @param[out] moved         Distance each centroid moved.
+     * @param[out] reseeded      Points which were moved to empty clusters.
+     */
+    template<typename T>
+    void updateCentroids(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Xt,
+                         Eigen::VectorXi& idx,
+                         Eigen::Matrix<T, Eigen::Dynamic, 1>& upper,
+                         Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Ct,
+                         Eigen::Matrix<T, Eigen::Dynamic, 1>& moved,
+                         std::vector<qint32>& reseeded) const;
+
+    //=========================================================================================================
+    /**
+     * Lloyd iterations accelerated with one lower bound per point (Hamerly 2010).
+     *
+     * @param[in] Xt             Transposed input data (rows = p dimensional space; cols = points)
+     * @param[in, out] Ct        Transposed cluster centroids p x k
+     * @param[out] idx           The cluster indeces to which cluster the input points belong to
+     *
+     * @return true if converged, false otherwise
+     */
+    template<typename T>
+    bool hamerlyUpdate(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Xt,
+                       Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Ct,
+                       Eigen::VectorXi& idx) const;
+
+    //=========================================================================================================
+    /**
+     * Lloyd iterations accelerated with one lower bound per point and centroid (Elkan 2003).
+     *
+     * @param[in] Xt             Transposed input data (rows = p dimensional space; cols = points)
+     * @param[in, out] Ct        Transposed cluster centroids p x k
+     * @param[out] idx           The cluster indeces to which cluster the input points belong to
+     *
+     * @return true if converged, false otherwise
+     */
+    template<typename T>
+    bool elkanUpdate(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Xt,
+                     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& Ct,
+                     Eigen::VectorXi& idx) const;
+
+    //=========================================================================================================
+    /**
+     * Returns the seed of a replicate.
+     *
+     * @param[in] rep    The replicate number.
+     *
+     * @return the seed
+     */
+    quint32 replicateSeed(qint32 rep) const;
+
     //=========================================================================================================
     /**
      * Calculate point to cluster centroid distances.
@@ -175,12 +335,13 @@ private:
     /**
      * Uniform random generator in the intervall [a, b]
      *
-     * @param[in] a      lower boundary
-     * @param[in] b      upper boundary
+     * @param[in] a          lower boundary
+     * @param[in] b          upper boundary
+     * @param[in] generator  Random generator of the replicate.
      *
      * @return random number
      */
-    double unifrnd(double a, double b);
+    double unifrnd(double a, double b, std::mt19937& generator);
 
     QString m_sDistance;    /**< Distance measurement to use: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming". */
     QString m_sStart;       /**< Initialization to use: "sample" (default), "uniform", "cluster". */
@@ -188,6 +349,8 @@ private:
     QString m_sEmptyact;    /**< What should be done if a cluster wents empty: "error" (default), "drop", "singleton" */
     qint32 m_iMaxit;        /**< Maximal number of iterations per replicate */
     bool m_bOnline;         /**< If online update should be performed */
+    qint32 m_iSeed;         /**< Seed of the random initialization, -1 to seed from the clock */
+    quint32 m_iBaseSeed;    /**< Seed of the first replicate of the current calculation */
 
     qint32 emptyErrCnt;     /**< Counts the occurence of empty errors */
 
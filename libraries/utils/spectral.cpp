@@ -48,6 +48,7 @@
 //=============================================================================================================
 
 #include <unsupported/Eigen/FFT>
+#include <Eigen/Eigenvalues>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -56,6 +57,17 @@
 #include <QtMath>
 #include <QtConcurrent>
 #include <QVector>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_CACHED_TAPERS 32     /**< Maximum number of taper sets kept in the taper cache. */
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -100,69 +112,99 @@ QVector<MatrixXcd> Spectral::computeTaperedSpectraMatrix(const MatrixXd &matData
                                                          const MatrixXd &matTaper,
                                                          int iNfft,
                                                          bool bUseMultithread)
+{
+    QVector<MatrixXcd> finalResult;
+
+    RowMajorMatrixXcd matTapSpectra;
+    if(!computeTaperedSpectraTensor(matData, matTaper, iNfft, matTapSpectra, bUseMultithread)) {
+        return finalResult;
+    }
+
+    int iNTapers = matTaper.rows();
+    finalResult.resize(matData.rows());
+
+    for (int i = 0; i < matData.rows(); ++i) {
+        finalResult[i] = matTapSpectra.middleRows(i * iNTapers, iNTapers);
+    }
+
+    return finalResult;
+}
+
+//=============================================================================================================
+
+bool Spectral::computeTaperedSpectraTensor(const MatrixXd &matData,
+                                           const MatrixXd &matTaper,
+                                           int iNfft,
+                                           RowMajorMatrixXcd &matTapSpectra,
+                                           bool bUseMultithread)
 {
     #ifdef EIGEN_FFTW_DEFAULT
         fftw_make_planner_thread_safe();
     #endif
 
-    QVector<MatrixXcd> finalResult;
+    //Check inputs
+    if (matData.cols() != matTaper.cols() || iNfft < matData.cols()) {
+        return false;
+    }
 
-    if(!bUseMultithread) {
-        // Sequential
-//        QElapsedTimer timer;
-//        int iTime = 0;
-//        int iTimeAll = 0;
-//        timer.start();
-
-        FFT<double> fft;
-        fft.SetFlag(fft.HalfSpectrum);
-
-        RowVectorXd vecInputFFT, rowData;
-        RowVectorXcd vecTmpFreq;
-
-        MatrixXcd matTapSpectrum(matTaper.rows(), int(floor(iNfft / 2.0)) + 1);
-        int j;
-        for (int i = 0; i < matData.rows(); ++i) {
-            rowData = matData.row(i);
-
-            //FFT for freq domain returning the half spectrum
-            for (j = 0; j < matTaper.rows(); j++) {
-                vecInputFFT = rowData.cwiseProduct(matTaper.row(j));
-                fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecTmpFreq;
-            }
-
-            finalResult.append(matTapSpectrum);
-
-//            iTime = timer.elapsed();
-//            qDebug() << QThread::currentThreadId() << "Spectral::computeTaperedSpectraMatrix - Row-wise computation:" << iTime;
-//            iTimeAll += iTime;
-//            timer.restart();
-        }
+    //Resizing is a no-op if the size did not change
+    matTapSpectra.resize(matData.rows() * matTaper.rows(), int(floor(iNfft / 2.0)) + 1);
 
-//        qDebug() << QThread::currentThreadId() << "Spectral::computeTaperedSpectraMatrix - Complete computation:" << iTimeAll;
-    } else {
-        // Parallel
-        QList<TaperedSpectraInputData> lData;
-        TaperedSpectraInputData dataTemp;
-        dataTemp.matTaper = matTaper;
-        dataTemp.iNfft = iNfft;
+    int iNumChunks = bUseMultithread ? qMin(QThread::idealThreadCount(), int(matData.rows())) : 1;
 
-        for (int i = 0; i < matData.rows(); ++i) {
-            dataTemp.vecData = matData.row(i);
-
-            lData.append(dataTemp);
+    if(iNumChunks <= 1) {
+        computeTaperedSpectraChunk(matData, matTaper, iNfft, 0, matData.rows(), matTapSpectra.data());
+    } else {
+        // One chunk of rows per thread, so every thread sets up its FFT plan only once
+        QVector<QPair<int,int> > vecChunks;
+        int iChunkSize = matData.rows() / iNumChunks;
+        int iRowStart = 0;
+
+        for (int i = 0; i < iNumChunks; ++i) {
+            int iRowEnd = (i == iNumChunks - 1) ? matData.rows() : iRowStart + iChunkSize;
+            vecChunks.append(qMakePair(iRowStart, iRowEnd));
+            iRowStart = iRowEnd;
         }
 
-        QFuture<QVector<MatrixXcd> > result = QtConcurrent::mappedReduced(lData,
-                                                                          compute,
-                                                                          reduce,
-                                                                          QtConcurrent::OrderedReduce);
-        result.waitForFinished();
-        finalResult = result.result();
+        std::complex<double>* pTapSpectra = matTapSpectra.data();
+
+        QtConcurrent::blockingMap(vecChunks, [&](const QPair<int,int>& chunk) {
+            computeTaperedSpectraChunk(matData, matTaper, iNfft, chunk.first, chunk.second, pTapSpectra);
+        });
     }
 
-    return finalResult;
+    return true;
+}
+
+//=============================================================================================================
+
+void Spectral::computeTaperedSpectraChunk(const MatrixXd &matData,
+                                          const MatrixXd &matTaper,
+                                          int iNfft,
+                                          int iRowStart,
+                                          int iRowEnd,
+                                          std::complex<double>* pTapSpectra)
+{
+    FFT<double> fft;
+    fft.SetFlag(fft.HalfSpectrum);
+
+    int iNTapers = matTaper.rows();
+    int iNFreqs = int(floor(iNfft / 2.0)) + 1;
+    int iSignalLength = matData.cols();
+
+    //The zero padding stays untouched, only the head is overwritten
+    VectorXd vecInputFFT = VectorXd::Zero(iNfft);
+    VectorXd vecRow;
+
+    for (int i = iRowStart; i < iRowEnd; ++i) {
+        vecRow = matData.row(i).transpose();
+
+        //Real to complex FFT writing the half spectrum directly into the tensor
+        for (int j = 0; j < iNTapers; ++j) {
+            vecInputFFT.head(iSignalLength) = vecRow.cwiseProduct(matTaper.row(j).transpose());
+            fft.fwd(pTapSpectra + (qint64(i) * iNTapers + j) * iNFreqs, vecInputFFT.data(), iNfft);
+        }
+    }
 }
 
 //=============================================================================================================
@@ -280,8 +322,24 @@ VectorXd Spectral::calculateFFTFreqs(int iNfft, double dSampFreq)
 
 //=============================================================================================================
 
-QPair<MatrixXd, VectorXd> Spectral::generateTapers(int iSignalLength, const QString &sWindowType)
+QPair<MatrixXd, VectorXd> Spectral::generateTapers(int iSignalLength,
+                                                   const QString &sWindowType,
+                                                   double dHalfNbw)
 {
+    static QMutex mutex;
+    static QHash<QString, QPair<MatrixXd, VectorXd> > hashTaperCache;
+    static QList<QString> lTaperCacheOrder;     //Least recently used first
+
+    QString sKey = QString("%1_%2_%3").arg(sWindowType).arg(iSignalLength).arg(sWindowType == "dpss" ? dHalfNbw : 0.0);
+
+    QMutexLocker locker(&mutex);
+
+    if(hashTaperCache.contains(sKey)) {
+        lTaperCacheOrder.removeOne(sKey);
+        lTaperCacheOrder.append(sKey);
+        return hashTaperCache.value(sKey);
+    }
+
     QPair<MatrixXd, VectorXd> pairOut;
     if (sWindowType == "hanning") {
         pairOut.first = hanningWindow(iSignalLength);
@@ -289,10 +347,22 @@ QPair<MatrixXd, VectorXd> Spectral::generateTapers(int iSignalLength, const QStr
     } else if (sWindowType == "ones") {
         pairOut.first = MatrixXd::Ones(1, iSignalLength) / double(iSignalLength);
         pairOut.second = VectorXd::Ones(1);
+    } else if (sWindowType == "dpss") {
+        VectorXd vecConcentration;
+        pairOut.first = dpssWindows(iSignalLength, dHalfNbw, vecConcentration);
+        pairOut.second = vecConcentration.cwiseMax(0.0).cwiseSqrt();
     } else {
         pairOut.first = hanningWindow(iSignalLength);
         pairOut.second = VectorXd::Ones(1);
     }
+
+    //Evict the least recently used taper set
+    if(hashTaperCache.size() >= MAX_CACHED_TAPERS) {
+        hashTaperCache.remove(lTaperCacheOrder.takeFirst());
+    }
+    hashTaperCache.insert(sKey, pairOut);
+    lTaperCacheOrder.append(sKey);
+
     return pairOut;
 }
 
@@ -310,3 +380,56 @@ MatrixXd Spectral::hanningWindow(int iSignalLength)
 
     return matHann;
 }
+
+//=============================================================================================================
+
+MatrixXd Spectral::dpssWindows(int iSignalLength,
+                               double dHalfNbw,
+                               VectorXd &vecConcentration)
+{
+    int N = iSignalLength;
+    int K = qBound(1, int(floor(2.0 * dHalfNbw)) - 1, qMax(N, 1));
+    double W = dHalfNbw / double(N);
+
+    if(N < 2) {
+        vecConcentration = VectorXd::Ones(1);
+        return MatrixXd::Ones(1, qMax(N, 1));
+    }
+
+    //The dpss are the eigenvectors of a symmetric tridiagonal matrix, sorted by their eigenvalues
+    VectorXd vecDiag(N);
+    VectorXd vecSubDiag(N - 1);
+    for (int n = 0; n < N; ++n) {
+        vecDiag(n) = pow((N - 1 - 2.0 * n) / 2.0, 2) * cos(2.0 * M_PI * W);
+    }
+    for (int n = 1; n < N; ++n) {
+        vecSubDiag(n - 1) = n * (N - n) / 2.0;
+    }
+
+    SelfAdjointEigenSolver<MatrixXd> eigSolver;
+    eigSolver.computeFromTridiagonal(vecDiag, vecSubDiag, ComputeEigenvectors);
+
+    MatrixXd matTapers(K, N);
+    vecConcentration.resize(K);
+
+    for (int k = 0; k < K; ++k) {
+        //Eigenvalues are sorted in increasing order
+        RowVectorXd vecTaper = eigSolver.eigenvectors().col(N - 1 - k).transpose();
+
+        //Symmetric tapers start with a positive sum, antisymmetric tapers with a positive first lobe
+        if ((k % 2 == 0 && vecTaper.sum() < 0.0) || (k % 2 == 1 && vecTaper.head(N / 2).sum() < 0.0)) {
+            vecTaper = -vecTaper;
+        }
+
+        matTapers.row(k) = vecTaper;
+
+        //Concentration ratio of the taper in the band [-W, W] from its autocorrelation
+        double dConcentration = 2.0 * W * vecTaper.squaredNorm();
+        for (int j = 1; j < N; ++j) {
+            dConcentration += 2.0 * vecTaper.head(N - j).dot(vecTaper.tail(N - j)) * sin(2.0 * M_PI * W * j) / (M_PI * j);
+        }
+        vecConcentration(k) = dConcentration;
+    }
+
+    return matTapers;
+}
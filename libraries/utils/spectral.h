@@ -58,6 +58,7 @@
 #include <QString>
 #include <QPair>
 #include <QSharedPointer>
+#include <QVector>
 
 //=============================================================================================================
 // DEFINE NAMESPACE UTILSLIB
@@ -82,6 +83,8 @@ class UTILSSHARED_EXPORT Spectral
 {
 
 public:
+    typedef Eigen::Matrix<std::complex<double>, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXcd;   /**< Row major complex matrix holding one spectrum per row. */
+
     //=========================================================================================================
     /**
      * deleted default constructor (static class).
@@ -118,6 +121,27 @@ public:
                                                                  int iNfft,
                                                                  bool bUseMultithread = true);
 
+    //=========================================================================================================
+    /**
+     * Calculates the full tapered spectra of a given input matrix data and writes them into one contiguous tensor.
+     * The rows are split into one chunk per thread. Each chunk reuses one FFT plan and one zero padded input
+     * buffer for all of its rows and tapers. The half spectrum of data row i and taper j is written to row
+     * i * matTaper.rows() + j of matTapSpectra. matTapSpectra is only reallocated if its size changes.
+     *
+     * @param[in] matData         input matrix data (time domain), for which the spectrum is computed.
+     * @param[in] matTaper        tapers used to compute the spectra.
+     * @param[in] iNfft           FFT length.
+     * @param[out] matTapSpectra  the tapered spectra ((rows * tapers) x (iNfft / 2 + 1)).
+     * @param[in] bUseMultithread Whether to use multiple threads.
+     *
+     * @return whether the spectra were computed.
+     */
+    static bool computeTaperedSpectraTensor(const Eigen::MatrixXd &matData,
+                                            const Eigen::MatrixXd &matTaper,
+                                            int iNfft,
+                                            RowMajorMatrixXcd &matTapSpectra,
+                                            bool bUseMultithread = true);
+
     //=========================================================================================================
     /**
      * Computes the tapered spectra for a row vector. This function gets called in parallel.
@@ -187,15 +211,21 @@ public:
 
     //=========================================================================================================
     /**
-     * Calculates a hanning window of given length
+     * Calculates the tapers of given length. The tapers are cached by window type, length and bandwidth, so
+     * repeated calls with the same parameters do not recompute them. If the cache is full, the least recently
+     * used taper set is evicted.
      *
-     * @param[in] iSignalLength    length of the hanning window
-     * @param[in] sWindowType      type of the window function used to compute tapered spectra
+     * @param[in] iSignalLength    length of the tapers
+     * @param[in] sWindowType      type of the window function used to compute tapered spectra. "hanning", "ones" or
+     *                             "dpss" (discrete prolate spheroidal sequences for multitaper estimation).
+     * @param[in] dHalfNbw         time half bandwidth product NW of the dpss tapers. floor(2 * NW) - 1 tapers are
+     *                             generated. Ignored for the other window types.
      *
      * @return Qpair of tapers and taper weights
      */
     static QPair<Eigen::MatrixXd, Eigen::VectorXd> generateTapers(int iSignalLength,
-                                                                  const QString &sWindowType = "hanning");
+                                                                  const QString &sWindowType = "hanning",
+                                                                  double dHalfNbw = 4.0);
 
 private:
     //=========================================================================================================
@@ -207,6 +237,39 @@ private:
      * @return hanning window
      */
     static Eigen::MatrixXd hanningWindow(int iSignalLength);
+
+    //=========================================================================================================
+    /**
+     * Calculates the discrete prolate spheroidal sequences (Slepian tapers) of given length via the tridiagonal
+     * eigenvalue problem and their concentration ratios.
+     *
+     * @param[in] iSignalLength     length of the tapers
+     * @param[in] dHalfNbw          time half bandwidth product NW
+     * @param[out] vecConcentration the spectral concentration ratio of each taper
+     *
+     * @return the dpss tapers (one taper per row)
+     */
+    static Eigen::MatrixXd dpssWindows(int iSignalLength,
+                                       double dHalfNbw,
+                                       Eigen::VectorXd &vecConcentration);
+
+    //=========================================================================================================
+    /**
+     * Computes the tapered spectra of a range of data rows into a contiguous tensor.
+     *
+     * @param[in] matData         input matrix data (time domain).
+     * @param[in] matTaper        tapers used to compute the spectra.
+     * @param[in] iNfft           FFT length.
+     * @param[in] iRowStart       the first data row.
+     * @param[in] iRowEnd         one after the last data row.
+     * @param[out] pTapSpectra    the tensor data, see computeTaperedSpectraTensor.
+     */
+    static void computeTaperedSpectraChunk(const Eigen::MatrixXd &matData,
+                                           const Eigen::MatrixXd &matTaper,
+                                           int iNfft,
+                                           int iRowStart,
+                                           int iRowEnd,
+                                           std::complex<double>* pTapSpectra);
 };
 
 //=============================================================================================================
@@ -0,0 +1,265 @@
+//=============================================================================================================
+/**
+ * @file     test_communication_rt_data_client.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @brief    Test for the tag decoding of the real-time data client
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <communication/rtClient/rtdataclient.h>
+
+#include <fiff/fiff_constants.h>
+#include <fiff/fiff_file.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace COMMUNICATIONLIB;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * Local server which hands the socket of the next connection over to a ChunkedTagWriter.
+ */
+class DescriptorServer : public QTcpServer
+{
+public:
+    DescriptorServer() : m_iSocketDescriptor(-1) {}
+
+    qintptr m_iSocketDescriptor;    /**< Descriptor of the last incoming connection. */
+
+protected:
+    void incomingConnection(qintptr iSocketDescriptor) override
+    {
+        m_iSocketDescriptor = iSocketDescriptor;
+    }
+};
+
+//=============================================================================================================
+/**
+ * Writes the given bytes in small chunks from its own thread, so the client receives the tags in pieces.
+ */
+class ChunkedTagWriter : public QThread
+{
+public:
+    ChunkedTagWriter(qintptr iSocketDescriptor, const QByteArray& baData, int iChunkSize)
+    : m_iSocketDescriptor(iSocketDescriptor)
+    , m_baData(baData)
+    , m_iChunkSize(iChunkSize)
+    {}
+
+protected:
+    void run() override
+    {
+        QTcpSocket socket;
+        if(!socket.setSocketDescriptor(m_iSocketDescriptor)) {
+            return;
+        }
+
+        for(int i = 0; i < m_baData.size(); i += m_iChunkSize) {
+            socket.write(m_baData.mid(i, m_iChunkSize));
+            socket.waitForBytesWritten(1000);
+            msleep(1);
+        }
+
+        //Keep the connection open until the client is done
+        socket.waitForDisconnected(10000);
+    }
+
+private:
+    qintptr     m_iSocketDescriptor;
+    QByteArray  m_baData;
+    int         m_iChunkSize;
+};
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestCommunicationRtDataClient
+ *
+ * @brief The TestCommunicationRtDataClient class tests the decoding of tags which arrive in pieces
+ *
+ */
+class TestCommunicationRtDataClient: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCommunicationRtDataClient();
+
+private slots:
+    void initTestCase();
+    void readChunkedTags_data();
+    void readChunkedTags();
+    void cleanupTestCase();
+
+private:
+    void writeTagHeader(QDataStream& stream, fiff_int_t kind, fiff_int_t type, fiff_int_t size);
+    void writeRawBuffer(QDataStream& stream, const MatrixXf& matData);
+};
+
+//=============================================================================================================
+
+TestCommunicationRtDataClient::TestCommunicationRtDataClient()
+{
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::writeTagHeader(QDataStream& stream, fiff_int_t kind, fiff_int_t type, fiff_int_t size)
+{
+    stream << (qint32)kind << (qint32)type << (qint32)size << (qint32)FIFFV_NEXT_SEQ;
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::writeRawBuffer(QDataStream& stream, const MatrixXf& matData)
+{
+    writeTagHeader(stream, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matData.size());
+
+    //Samples are sent channel after channel for each time point, i.e. column major
+    for(int i = 0; i < matData.size(); ++i) {
+        stream << matData.data()[i];
+    }
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::readChunkedTags_data()
+{
+    //0 sends all tags at once
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("1 byte") << 1;
+    QTest::newRow("7 bytes") << 7;
+    QTest::newRow("header size") << 16;
+    QTest::newRow("whole") << 0;
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::readChunkedTags()
+{
+    QFETCH(int, chunkSize);
+
+    int iNumChannels = 5;
+    MatrixXf matFirst = MatrixXf::Random(iNumChannels, 4);
+    MatrixXf matSecond = MatrixXf::Random(iNumChannels, 9);
+
+    //Client id, two raw buffers of different length and a block end as mne_rt_server sends them
+    QByteArray baData;
+    QDataStream stream(&baData, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    writeTagHeader(stream, FIFF_MNE_RT_CLIENT_ID, FIFFT_INT, 4);
+    stream << (qint32)42;
+    writeRawBuffer(stream, matFirst);
+    writeRawBuffer(stream, matSecond);
+    writeTagHeader(stream, FIFF_BLOCK_END, FIFFT_INT, 4);
+    stream << (qint32)FIFFB_RAW_DATA;
+
+    DescriptorServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    RtDataClient client;
+    client.QTcpSocket::connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected(1000));
+    QVERIFY(server.waitForNewConnection(1000));
+    QVERIFY(server.m_iSocketDescriptor != -1);
+
+    ChunkedTagWriter writer(server.m_iSocketDescriptor, baData, chunkSize > 0 ? chunkSize : baData.size());
+    writer.start();
+
+    QCOMPARE(client.getClientId(), 42);
+
+    MatrixXf matData;
+    fiff_int_t kind;
+
+    client.readRawBuffer(iNumChannels, matData, kind);
+    QCOMPARE(kind, (fiff_int_t)FIFF_DATA_BUFFER);
+    QCOMPARE(matData.rows(), matFirst.rows());
+    QCOMPARE(matData.cols(), matFirst.cols());
+    QVERIFY(matData == matFirst);
+
+    client.readRawBuffer(iNumChannels, matData, kind);
+    QCOMPARE(kind, (fiff_int_t)FIFF_DATA_BUFFER);
+    QCOMPARE(matData.rows(), matSecond.rows());
+    QCOMPARE(matData.cols(), matSecond.cols());
+    QVERIFY(matData == matSecond);
+
+    client.readRawBuffer(iNumChannels, matData, kind);
+    QCOMPARE(kind, (fiff_int_t)FIFF_BLOCK_END);
+
+    client.disconnectFromHost();
+    QVERIFY(writer.wait(10000));
+}
+
+//=============================================================================================================
+
+void TestCommunicationRtDataClient::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestCommunicationRtDataClient)
+#include "test_communication_rt_data_client.moc"
@@ -0,0 +1,335 @@
+//=============================================================================================================
+/**
+ * @file     test_communication_shared_memory.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the shared memory ring used between mne_rt_server and local clients
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <communication/rtSharedMemory/rtsharedmemoryring.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QtConcurrent>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace COMMUNICATIONLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestCommunicationSharedMemory
+ *
+ * @brief The TestCommunicationSharedMemory class provides tests of the shared memory ring
+ *
+ */
+class TestCommunicationSharedMemory: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCommunicationSharedMemory();
+
+private slots:
+    void initTestCase();
+    void writeRead();
+    void ringFull();
+    void redirectOversized();
+    void readTimeout();
+    void closeProducer();
+    void wakeUp();
+    void wakeOnWrite();
+    void wrongToken();
+    void cleanupTestCase();
+
+private:
+    QString newKey();
+
+    qint32 m_iNumSlots;
+    qint32 m_iSlotBytes;
+};
+
+//=============================================================================================================
+
+TestCommunicationSharedMemory::TestCommunicationSharedMemory()
+: m_iNumSlots(4)
+, m_iSlotBytes(64 * 4 * sizeof(float))
+{
+}
+
+//=============================================================================================================
+
+QString TestCommunicationSharedMemory::newKey()
+{
+    return RtSharedMemoryRing::keyForClient(0, RtSharedMemoryRing::createToken());
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::writeRead()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    MatrixXf matFirst = MatrixXf::Random(64, 4);
+    MatrixXf matSecond = MatrixXf::Random(8, 2);
+    QVERIFY(producer.write(matFirst));
+    QVERIFY(producer.write(matSecond));
+
+    MatrixXf matRead;
+    bool bRedirected = true;
+    QVERIFY(consumer.read(matRead, &bRedirected, 1000));
+    QVERIFY(!bRedirected);
+    QVERIFY(matRead == matFirst);
+
+    QVERIFY(consumer.tryRead(matRead));
+    QVERIFY(matRead == matSecond);
+
+    QVERIFY(!consumer.tryRead(matRead));
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::ringFull()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    for(int i = 0; i < m_iNumSlots; ++i) {
+        QVERIFY(producer.write(MatrixXf::Constant(2, 2, i)));
+    }
+
+    //The consumer does not keep up, the buffer is rejected instead of overwriting unread slots
+    QVERIFY(!producer.write(MatrixXf::Constant(2, 2, m_iNumSlots)));
+    QVERIFY(!producer.writeRedirect());
+
+    MatrixXf matRead;
+    QVERIFY(consumer.tryRead(matRead));
+    QVERIFY(matRead == MatrixXf::Constant(2, 2, 0));
+
+    QVERIFY(producer.write(MatrixXf::Constant(2, 2, m_iNumSlots)));
+
+    for(int i = 1; i <= m_iNumSlots; ++i) {
+        QVERIFY(consumer.tryRead(matRead));
+        QVERIFY(matRead == MatrixXf::Constant(2, 2, i));
+    }
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::redirectOversized()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    MatrixXf matSmall = MatrixXf::Random(64, 4);
+    MatrixXf matOversized = MatrixXf::Random(64, 5);
+    QVERIFY(producer.fits(matSmall));
+    QVERIFY(!producer.fits(matOversized));
+    QVERIFY(!producer.write(matOversized));
+
+    //An oversized buffer is sent through the socket, the redirect entry keeps its position
+    QVERIFY(producer.write(matSmall));
+    QVERIFY(producer.writeRedirect());
+    QVERIFY(producer.write(matSmall));
+
+    MatrixXf matRead;
+    bool bRedirected = true;
+    QVERIFY(consumer.tryRead(matRead, &bRedirected));
+    QVERIFY(!bRedirected);
+    QVERIFY(matRead == matSmall);
+
+    QVERIFY(consumer.tryRead(matRead, &bRedirected));
+    QVERIFY(bRedirected);
+
+    QVERIFY(consumer.tryRead(matRead, &bRedirected));
+    QVERIFY(!bRedirected);
+    QVERIFY(matRead == matSmall);
+
+    //Without the flag, redirect entries are skipped
+    QVERIFY(producer.writeRedirect());
+    QVERIFY(producer.write(matSmall));
+    matRead.setZero();
+    QVERIFY(consumer.tryRead(matRead));
+    QVERIFY(matRead == matSmall);
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::readTimeout()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    MatrixXf matRead;
+    QVERIFY(!consumer.read(matRead, Q_NULLPTR, 50));
+    QVERIFY(timer.elapsed() >= 50);
+    QVERIFY(!consumer.waitForData(0));
+    QVERIFY(!consumer.isClosed());
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::closeProducer()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing::SPtr pProducer(new RtSharedMemoryRing(sKey));
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(pProducer->create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    MatrixXf matData = MatrixXf::Random(4, 4);
+    QVERIFY(pProducer->write(matData));
+    pProducer.clear();
+
+    //Buffers written before closing are still delivered, then a waiting read returns without timeout
+    QVERIFY(consumer.isClosed());
+
+    MatrixXf matRead;
+    QVERIFY(consumer.read(matRead));
+    QVERIFY(matRead == matData);
+    QVERIFY(!consumer.read(matRead));
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::wakeUp()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    //Wake up the reader from another thread while it waits without timeout
+    QFuture<void> future = QtConcurrent::run([&consumer]() {
+        QThread::msleep(50);
+        consumer.wakeUp();
+    });
+
+    MatrixXf matRead;
+    QVERIFY(!consumer.read(matRead));
+    future.waitForFinished();
+    QVERIFY(!consumer.waitForData(-1));
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::wakeOnWrite()
+{
+    QString sKey = newKey();
+    RtSharedMemoryRing producer(sKey);
+    RtSharedMemoryRing consumer(sKey);
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+    QVERIFY(consumer.attach());
+
+    //Each write wakes up the reader sleeping without timeout
+    const int iNumBuffers = 100;
+    QFuture<void> future = QtConcurrent::run([&producer, iNumBuffers]() {
+        for(int i = 0; i < iNumBuffers; ++i) {
+            QThread::usleep(500);
+            while(!producer.write(MatrixXf::Constant(2, 2, i))) {
+                QThread::usleep(100);
+            }
+        }
+    });
+
+    MatrixXf matRead;
+    for(int i = 0; i < iNumBuffers; ++i) {
+        QVERIFY(consumer.read(matRead));
+        QVERIFY(matRead == MatrixXf::Constant(2, 2, i));
+    }
+
+    future.waitForFinished();
+    QVERIFY(!consumer.tryRead(matRead));
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::wrongToken()
+{
+    RtSharedMemoryRing producer(newKey());
+    QVERIFY(producer.create(m_iNumSlots, m_iSlotBytes));
+
+    //The client id alone does not give access to the ring
+    RtSharedMemoryRing consumer(newKey());
+    QVERIFY(producer.key() != consumer.key());
+    QVERIFY(!consumer.attach());
+    QVERIFY(!consumer.isValid());
+
+    MatrixXf matRead;
+    QVERIFY(!consumer.read(matRead, Q_NULLPTR, 10));
+}
+
+//=============================================================================================================
+
+void TestCommunicationSharedMemory::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestCommunicationSharedMemory)
+#include "test_communication_shared_memory.moc"
@@ -0,0 +1,257 @@
+//=============================================================================================================
+/**
+ * @file     test_detect_trigger.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the stateful trigger flank detection
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+#include <utils/detecttrigger.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestDetectTrigger
+ *
+ * @brief The TestDetectTrigger class compares the block wise flank detection to a sample by sample reference
+ *
+ */
+class TestDetectTrigger: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestDetectTrigger();
+
+private slots:
+    void initTestCase();
+    void flanksAcrossBlocks();
+    void pulseMaximum();
+    void fallingFlanks();
+    void cleanupTestCase();
+
+private:
+    void addPulse(int iCh, int iStart, int iLength, double dValue);
+    QList<QPair<int,double> > referenceFlanks(int iCh, int iBurstLengthSamp) const;
+    QList<QPair<int,double> > detectInBlocks(DetectTrigger& detector, int iCh, int iBlockSize) const;
+
+    MatrixXd    m_matData;
+    double      m_dThreshold;
+};
+
+//=============================================================================================================
+
+TestDetectTrigger::TestDetectTrigger()
+: m_dThreshold(0.5)
+{
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    //Channel 0 carries data below the threshold, channels 1 and 2 are trigger channels
+    m_matData = MatrixXd::Zero(3, 1000);
+    m_matData.row(0) = 0.4 * RowVectorXd::Random(1000);
+
+    //Flank on the first sample of the second 64 sample block
+    addPulse(1, 64, 5, 1.0);
+    //Pulse inside the burst length of the previous one, which reaches into the next 64 sample block
+    addPulse(1, 120, 5, 2.0);
+    addPulse(1, 130, 5, 3.0);
+    //Flank on the last sample of a 64 sample block
+    addPulse(1, 255, 10, 4.0);
+    addPulse(1, 500, 3, 5.0);
+    addPulse(1, 999, 1, 6.0);
+
+    addPulse(2, 1, 4, 1.0);
+    addPulse(2, 127, 200, 2.0);
+    addPulse(2, 700, 2, 3.0);
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::addPulse(int iCh, int iStart, int iLength, double dValue)
+{
+    m_matData.row(iCh).segment(iStart, iLength).setConstant(dValue);
+}
+
+//=============================================================================================================
+
+QList<QPair<int,double> > TestDetectTrigger::referenceFlanks(int iCh, int iBurstLengthSamp) const
+{
+    QList<QPair<int,double> > lFlanks;
+    int iNextFree = 0;
+
+    for(int j = 1; j < m_matData.cols(); ++j) {
+        if(j >= iNextFree && m_matData(iCh,j) >= m_dThreshold && m_matData(iCh,j-1) < m_dThreshold) {
+            double dValue = m_matData(iCh,j);
+
+            for(int k = j + 1; k < m_matData.cols() && k <= j + iBurstLengthSamp && m_matData(iCh,k) >= m_dThreshold; ++k) {
+                dValue = qMax(dValue, m_matData(iCh,k));
+            }
+
+            lFlanks.append(qMakePair(j, dValue));
+            iNextFree = j + iBurstLengthSamp + 1;
+        }
+    }
+
+    return lFlanks;
+}
+
+//=============================================================================================================
+
+QList<QPair<int,double> > TestDetectTrigger::detectInBlocks(DetectTrigger& detector, int iCh, int iBlockSize) const
+{
+    QList<QPair<int,double> > lFlanks;
+
+    for(int i = 0; i < m_matData.cols(); i += iBlockSize) {
+        int iNumSamples = qMin(iBlockSize, int(m_matData.cols()) - i);
+        detector.detectTriggerFlanks(m_matData.middleCols(i, iNumSamples), i);
+
+        const QVector<TriggerEvent>& vecEvents = detector.getTriggerEvents();
+        for(int j = 0; j < vecEvents.size(); ++j) {
+            if(vecEvents.at(j).iChIdx == iCh) {
+                lFlanks.append(qMakePair(vecEvents.at(j).iSample, vecEvents.at(j).dValue));
+            }
+        }
+    }
+
+    return lFlanks;
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::flanksAcrossBlocks()
+{
+    int iBurstLengthSamp = 20;
+
+    //The pulse at 130 is skipped, the one at 999 is found on the very last sample
+    QList<QPair<int,double> > lReference = referenceFlanks(1, iBurstLengthSamp);
+    QCOMPARE(lReference.size(), 5);
+    QCOMPARE(lReference.at(1).first, 120);
+    QCOMPARE(lReference.at(2).first, 255);
+
+    QList<int> lBlockSizes;
+    lBlockSizes << 1 << 7 << 64 << 100 << int(m_matData.cols());
+
+    DetectTrigger detector;
+
+    for(int i = 0; i < lBlockSizes.size(); ++i) {
+        detector.setTriggerChannels(QList<int>() << 0 << 1 << 2, m_dThreshold, "Rising", iBurstLengthSamp);
+
+        QCOMPARE(detectInBlocks(detector, 1, lBlockSizes.at(i)), lReference);
+
+        detector.reset();
+        QCOMPARE(detectInBlocks(detector, 2, lBlockSizes.at(i)), referenceFlanks(2, iBurstLengthSamp));
+
+        //Channel 0 stays below the threshold
+        detector.reset();
+        QVERIFY(detectInBlocks(detector, 0, lBlockSizes.at(i)).isEmpty());
+    }
+
+    //The burst length is carried over: the pulse at 130 is only found once the burst of the one at 120 is over
+    detector.setTriggerChannels(QList<int>() << 1, m_dThreshold, "Rising", 5);
+    QCOMPARE(detectInBlocks(detector, 1, 64), referenceFlanks(1, 5));
+    QCOMPARE(referenceFlanks(1, 5).size(), 6);
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::pulseMaximum()
+{
+    //Trigger lines which do not switch at the same sample form a staircase
+    RowVectorXd vecStim = RowVectorXd::Zero(40);
+    vecStim.segment(10, 6) << 1.0, 3.0, 7.0, 7.0, 6.0, 0.0;
+    vecStim.segment(30, 3) << 2.0, 0.0, 9.0;
+
+    MatrixXd matData = vecStim;
+
+    DetectTrigger detector;
+    detector.setTriggerChannels(QList<int>() << 0, m_dThreshold, "Rising", 15);
+
+    QCOMPARE(detector.detectTriggerFlanks(matData, 100), 2);
+    const QVector<TriggerEvent>& vecEvents = detector.getTriggerEvents();
+
+    QCOMPARE(vecEvents.at(0).iSample, 110);
+    QCOMPARE(vecEvents.at(0).dValue, 7.0);
+
+    //The peak is only taken while the pulse stays above the threshold
+    QCOMPARE(vecEvents.at(1).iSample, 130);
+    QCOMPARE(vecEvents.at(1).dValue, 2.0);
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::fallingFlanks()
+{
+    DetectTrigger detector;
+    detector.setTriggerChannels(QList<int>() << 2, m_dThreshold, "Falling", 20);
+
+    //Falling flanks at 5, 327 and 702, the pulse ending at 327 spans several 64 sample blocks
+    QList<QPair<int,double> > lFlanks = detectInBlocks(detector, 2, 64);
+    QCOMPARE(lFlanks.size(), 3);
+    QCOMPARE(lFlanks.at(0).first, 5);
+    QCOMPARE(lFlanks.at(1).first, 327);
+    QCOMPARE(lFlanks.at(2).first, 702);
+    QCOMPARE(lFlanks.at(1).second, 0.0);
+}
+
+//=============================================================================================================
+
+void TestDetectTrigger::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestDetectTrigger)
+#include "test_detect_trigger.moc"
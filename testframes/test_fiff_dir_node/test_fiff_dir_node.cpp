@@ -0,0 +1,299 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_dir_node.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @brief    Test for the indexed lookups of FiffDirNode
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_dir_node.h>
+#include <fiff/fiff_tag.h>
+#include <fiff/fiff_file.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffDirNode
+ *
+ * @brief The TestFiffDirNode class compares the indexed tree lookups to the linear scans of an unindexed tree
+ *
+ */
+class TestFiffDirNode: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffDirNode();
+
+private slots:
+    void initTestCase();
+    void compareLookups_data();
+    void compareLookups();
+    void findReturnsCopies();
+    void dirTreeExtent();
+    void cleanupTestCase();
+
+private:
+    FiffDirNode::SPtr cloneUnindexed(const FiffDirNode::SPtr& pNode, const FiffDirNode::SPtr& pParent);
+    void collectKinds(const FiffDirNode::SPtr& pNode, QSet<fiff_int_t>& blockKinds, QSet<fiff_int_t>& tagKinds);
+    void compareNodes(FiffStream* pStream, const FiffDirNode::SPtr& pIndexed, const FiffDirNode::SPtr& pLinear,
+                      const QList<fiff_int_t>& blockKinds, const QList<fiff_int_t>& tagKinds);
+
+    QString m_sRawFile;
+};
+
+//=============================================================================================================
+
+TestFiffDirNode::TestFiffDirNode()
+{
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    m_sRawFile = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif";
+}
+
+//=============================================================================================================
+
+FiffDirNode::SPtr TestFiffDirNode::cloneUnindexed(const FiffDirNode::SPtr& pNode, const FiffDirNode::SPtr& pParent)
+{
+    //A tree which was never indexed uses the linear scans
+    FiffDirNode::SPtr pClone(new FiffDirNode);
+    pClone->type = pNode->type;
+    pClone->id = pNode->id;
+    pClone->dir = pNode->dir;
+    pClone->dir_tree = pNode->dir_tree;
+    pClone->nent_tree = pNode->nent_tree;
+    pClone->parent = pParent;
+    pClone->parent_id = pNode->parent_id;
+
+    for(int k = 0; k < pNode->children.size(); ++k) {
+        pClone->children.append(cloneUnindexed(pNode->children[k], pClone));
+    }
+
+    return pClone;
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::collectKinds(const FiffDirNode::SPtr& pNode, QSet<fiff_int_t>& blockKinds, QSet<fiff_int_t>& tagKinds)
+{
+    blockKinds.insert(pNode->type);
+    for(int p = 0; p < pNode->dir.size(); ++p) {
+        tagKinds.insert(pNode->dir[p]->kind);
+    }
+
+    for(int k = 0; k < pNode->children.size(); ++k) {
+        collectKinds(pNode->children[k], blockKinds, tagKinds);
+    }
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::compareNodes(FiffStream* pStream, const FiffDirNode::SPtr& pIndexed, const FiffDirNode::SPtr& pLinear,
+                                   const QList<fiff_int_t>& blockKinds, const QList<fiff_int_t>& tagKinds)
+{
+    QCOMPARE(pIndexed->type, pLinear->type);
+    QCOMPARE(pIndexed->nchild(), pLinear->nchild());
+
+    for(int i = 0; i < blockKinds.size(); ++i) {
+        QList<FiffDirNode::SPtr> indexedNodes = pIndexed->dir_tree_find(blockKinds[i]);
+        QList<FiffDirNode::SPtr> linearNodes = pLinear->dir_tree_find(blockKinds[i]);
+
+        QCOMPARE(indexedNodes.size(), linearNodes.size());
+        for(int j = 0; j < indexedNodes.size(); ++j) {
+            QCOMPARE(indexedNodes[j]->type, linearNodes[j]->type);
+            QCOMPARE(indexedNodes[j]->nent(), linearNodes[j]->nent());
+            QCOMPARE(indexedNodes[j]->nchild(), linearNodes[j]->nchild());
+            if(indexedNodes[j]->nent() > 0) {
+                QCOMPARE(indexedNodes[j]->dir[0]->pos, linearNodes[j]->dir[0]->pos);
+            }
+        }
+
+        QCOMPARE(pIndexed->has_kind(blockKinds[i]), pLinear->has_kind(blockKinds[i]));
+    }
+
+    for(int i = 0; i < tagKinds.size(); ++i) {
+        QCOMPARE(pIndexed->has_tag(tagKinds[i]), pLinear->has_tag(tagKinds[i]));
+
+        //The large data tags are only compared through has_tag
+        if(tagKinds[i] == FIFF_DATA_BUFFER || !pLinear->has_tag(tagKinds[i])) {
+            continue;
+        }
+
+        FiffTag::SPtr pIndexedTag, pLinearTag;
+        QVERIFY(pIndexed->find_tag(pStream, tagKinds[i], pIndexedTag));
+        QVERIFY(pLinear->find_tag(pStream, tagKinds[i], pLinearTag));
+        QCOMPARE(pIndexedTag->kind, pLinearTag->kind);
+        QCOMPARE(pIndexedTag->type, pLinearTag->type);
+        QVERIFY(*pIndexedTag == *pLinearTag);
+    }
+
+    for(int k = 0; k < pIndexed->children.size(); ++k) {
+        compareNodes(pStream, pIndexed->children[k], pLinear->children[k], blockKinds, tagKinds);
+    }
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::compareLookups_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QTest::newRow("raw") << QString("/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif");
+    QTest::newRow("fwd") << QString("/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    QTest::newRow("inv") << QString("/mne-cpp-test-data/MEG/sample/sample_audvis-meg-eeg-oct-6-meg-eeg-inv.fif");
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::compareLookups()
+{
+    QFETCH(QString, fileName);
+
+    QFile file(QCoreApplication::applicationDirPath() + fileName);
+    if(!file.exists()) {
+        QSKIP(qPrintable(QString("%1 is not part of the test data").arg(fileName)));
+    }
+
+    FiffStream::SPtr pStream(new FiffStream(&file));
+    QVERIFY(pStream->open());
+
+    FiffDirNode::SPtr pIndexed = pStream->dirtree();
+    FiffDirNode::SPtr pLinear = cloneUnindexed(pIndexed, FiffDirNode::SPtr());
+
+    //All kinds of the file plus kinds which do not occur
+    QSet<fiff_int_t> blockKinds, tagKinds;
+    collectKinds(pIndexed, blockKinds, tagKinds);
+    blockKinds.insert(-12345);
+    tagKinds.insert(-12345);
+
+    compareNodes(pStream.data(), pIndexed, pLinear, blockKinds.values(), tagKinds.values());
+
+    //A node whose dir is modified after indexing falls back to the linear scan
+    FiffDirNode::SPtr pModified(new FiffDirNode(pIndexed.data()));
+    FiffDirEntry::SPtr pEntry(new FiffDirEntry);
+    pEntry->kind = -12345;
+    pEntry->type = FIFFT_INT;
+    pEntry->size = 4;
+    pEntry->pos = pIndexed->dir.isEmpty() ? 0 : pIndexed->dir[0]->pos;
+    pModified->dir.prepend(pEntry);
+    QVERIFY(pModified->has_tag(-12345));
+    QVERIFY(!pIndexed->has_tag(-12345));
+
+    pStream->close();
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::findReturnsCopies()
+{
+    QFile file(m_sRawFile);
+    FiffStream::SPtr pStream(new FiffStream(&file));
+    QVERIFY(pStream->open());
+
+    FiffDirNode::SPtr pTree = pStream->dirtree();
+    QList<FiffDirNode::SPtr> nodes = pTree->dir_tree_find(FIFFB_MEAS_INFO);
+    QVERIFY(nodes.size() > 0);
+
+    //Modifying the result must not modify the tree
+    int iNumEntries = nodes[0]->nent();
+    nodes[0]->dir.clear();
+    nodes[0]->type = -1;
+
+    QList<FiffDirNode::SPtr> nodesAgain = pTree->dir_tree_find(FIFFB_MEAS_INFO);
+    QCOMPARE(nodesAgain.size(), nodes.size());
+    QCOMPARE(nodesAgain[0]->nent(), iNumEntries);
+    QCOMPARE(nodesAgain[0]->type, (fiff_int_t)FIFFB_MEAS_INFO);
+
+    pStream->close();
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::dirTreeExtent()
+{
+    QFile file(m_sRawFile);
+    FiffStream::SPtr pStream(new FiffStream(&file));
+    QVERIFY(pStream->open());
+
+    //dir_tree reaches from the block start to the end of the directory, the block itself consists of the first nent_tree entries
+    FiffDirNode::SPtr pTree = pStream->dirtree();
+    const QList<FiffDirEntry::SPtr>& dir = pStream->dir();
+
+    QCOMPARE(pTree->dir_tree.size(), dir.size());
+    QVERIFY(pTree->nchild() > 0);
+
+    for(int k = 0; k < pTree->children.size(); ++k) {
+        const FiffDirNode::SPtr& pNode = pTree->children[k];
+
+        QVERIFY(pNode->nent_tree > 0 && pNode->nent_tree <= pNode->dir_tree.size());
+        QCOMPARE(pNode->dir_tree.first()->kind, (fiff_int_t)FIFF_BLOCK_START);
+        QCOMPARE(pNode->dir_tree[pNode->nent_tree - 1]->kind, (fiff_int_t)FIFF_BLOCK_END);
+        QCOMPARE(pNode->dir_tree.last()->pos, dir.last()->pos);
+    }
+
+    pStream->close();
+}
+
+//=============================================================================================================
+
+void TestFiffDirNode::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffDirNode)
+#include "test_fiff_dir_node.moc"
@@ -0,0 +1,293 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_proj_operator.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the cached low-rank SSP projection operator
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_proj.h>
+#include <fiff/fiff_proj_operator.h>
+#include <fiff/fiff_named_matrix.h>
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_ctf_comp.h>
+#include <fiff/fiff_file.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffProjOperator
+ *
+ * @brief The TestFiffProjOperator class compares the cached low-rank projector to FiffProj::make_projector
+ *
+ */
+class TestFiffProjOperator: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffProjOperator();
+
+private slots:
+    void initTestCase();
+    void compareToMakeProjector();
+    void noActiveProjector();
+    void changedProjectorData();
+    void changedCompensatorData();
+    void cleanupTestCase();
+
+private:
+    FiffProj createProj(const MatrixXd& matVecs, bool bActive);
+    MatrixXd makeProjector(const QList<FiffProj>& projs);
+    void compareOperator(const FiffProjOperator& projOperator, const MatrixXd& matRefProj);
+
+    QStringList m_lChNames;
+    QStringList m_lBads;
+    MatrixXd    m_matData;
+    double      m_dEpsilon;
+};
+
+//=============================================================================================================
+
+TestFiffProjOperator::TestFiffProjOperator()
+: m_dEpsilon(1e-12)
+{
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    for(int i = 0; i < 20; ++i) {
+        m_lChNames << QString("MEG %1").arg(i, 4, 10, QChar('0'));
+    }
+
+    m_lBads << m_lChNames.at(3) << m_lChNames.at(11);
+
+    m_matData = MatrixXd::Random(m_lChNames.size(), 50);
+}
+
+//=============================================================================================================
+
+FiffProj TestFiffProjOperator::createProj(const MatrixXd& matVecs, bool bActive)
+{
+    QStringList lRowNames;
+    for(int i = 0; i < matVecs.rows(); ++i) {
+        lRowNames << QString("PCA-v%1").arg(i + 1);
+    }
+
+    FiffNamedMatrix namedMatrix(matVecs.rows(), matVecs.cols(), lRowNames, m_lChNames, matVecs);
+
+    return FiffProj(FIFFV_PROJ_ITEM_FIELD, bActive, QString("Test projector"), namedMatrix);
+}
+
+//=============================================================================================================
+
+MatrixXd TestFiffProjOperator::makeProjector(const QList<FiffProj>& projs)
+{
+    //The full projector with zeroed bad channel columns, as used before the low-rank operator
+    MatrixXd matProj;
+    FiffProj::make_projector(projs, m_lChNames, matProj, m_lBads);
+
+    for(int i = 0; i < m_lBads.size(); ++i) {
+        matProj.col(m_lChNames.indexOf(m_lBads.at(i))).setZero();
+    }
+
+    return matProj;
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::compareOperator(const FiffProjOperator& projOperator, const MatrixXd& matRefProj)
+{
+    QCOMPARE(projOperator.getNumChannels(), int(m_lChNames.size()));
+
+    MatrixXd matProj = MatrixXd(projOperator.getSparseProjector());
+    QVERIFY((matProj - matRefProj).cwiseAbs().maxCoeff() < m_dEpsilon);
+
+    MatrixXd matOut = projOperator.apply(m_matData, true, false);
+    QVERIFY((matOut - matRefProj * m_matData).cwiseAbs().maxCoeff() < m_dEpsilon);
+
+    //Without compensator the full operator equals the projector
+    MatrixXd matOperator = MatrixXd(projOperator.getSparseOperator());
+    QVERIFY((matOperator - matRefProj).cwiseAbs().maxCoeff() < m_dEpsilon);
+
+    //Projection switched off
+    QVERIFY(projOperator.apply(m_matData, false, false) == m_matData);
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::compareToMakeProjector()
+{
+    QList<FiffProj> projs;
+    projs << createProj(MatrixXd::Random(3, m_lChNames.size()), true);
+    projs << createProj(MatrixXd::Random(2, m_lChNames.size()), true);
+    projs << createProj(MatrixXd::Random(1, m_lChNames.size()), false);
+
+    FiffProjOperator projOperator;
+    QVERIFY(projOperator.updateProjection(projs, m_lChNames, m_lBads));
+    QVERIFY(projOperator.isProjActive());
+    compareOperator(projOperator, makeProjector(projs));
+
+    //Unchanged input keeps the cached projector
+    QVERIFY(!projOperator.updateProjection(projs, m_lChNames, m_lBads));
+
+    //Activating a projector rebuilds it
+    projs[2].active = true;
+    QVERIFY(projOperator.updateProjection(projs, m_lChNames, m_lBads));
+    compareOperator(projOperator, makeProjector(projs));
+
+    //Changed bad channels rebuild it
+    QStringList lBads = m_lBads;
+    m_lBads << m_lChNames.at(0);
+    QVERIFY(projOperator.updateProjection(projs, m_lChNames, m_lBads));
+    compareOperator(projOperator, makeProjector(projs));
+    m_lBads = lBads;
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::noActiveProjector()
+{
+    //The projector still zeroes the bad channels if no projector is active
+    QList<FiffProj> projs;
+    projs << createProj(MatrixXd::Random(3, m_lChNames.size()), false);
+
+    FiffProjOperator projOperator;
+    QVERIFY(projOperator.updateProjection(projs, m_lChNames, m_lBads));
+    QVERIFY(!projOperator.isProjActive());
+    compareOperator(projOperator, makeProjector(projs));
+
+    MatrixXd matOut = projOperator.apply(m_matData, true, false);
+    for(int i = 0; i < m_lBads.size(); ++i) {
+        QVERIFY(matOut.row(m_lChNames.indexOf(m_lBads.at(i))).isZero(0));
+    }
+
+    //Inactive projectors do not change the projector
+    QVERIFY(!projOperator.updateProjection(QList<FiffProj>(), m_lChNames, m_lBads));
+    compareOperator(projOperator, makeProjector(QList<FiffProj>()));
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::changedProjectorData()
+{
+    //Projectors with the same size, description and data sum must not share the cached projector
+    //Integer values, so the sums are exactly the same
+    MatrixXd matVecs = (10.0 * MatrixXd::Random(2, m_lChNames.size())).array().round();
+    matVecs(0,0) = 1.0;
+    matVecs(1,5) = 2.0;
+
+    QList<FiffProj> projs;
+    projs << createProj(matVecs, true);
+
+    FiffProjOperator projOperator;
+    QVERIFY(projOperator.updateProjection(projs, m_lChNames, m_lBads));
+    compareOperator(projOperator, makeProjector(projs));
+
+    MatrixXd matSwapped = matVecs;
+    std::swap(matSwapped(0,0), matSwapped(1,5));
+    QVERIFY(matSwapped.sum() == matVecs.sum());
+
+    QList<FiffProj> projsSwapped;
+    projsSwapped << createProj(matSwapped, true);
+
+    QVERIFY(projOperator.updateProjection(projsSwapped, m_lChNames, m_lBads));
+    compareOperator(projOperator, makeProjector(projsSwapped));
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::changedCompensatorData()
+{
+    //The cached compensator has to be rebuilt if the compensation data changes for the same grade
+    FiffInfo info;
+    for(int i = 0; i < m_lChNames.size(); ++i) {
+        FiffChInfo ch;
+        ch.ch_name = m_lChNames.at(i);
+        info.chs << ch;
+    }
+    info.ch_names = m_lChNames;
+    info.nchan = m_lChNames.size();
+
+    FiffProjOperator projOperator;
+    QVERIFY(projOperator.updateCompensator(info, 0));
+    QVERIFY(!projOperator.isCompActive());
+    QVERIFY(!projOperator.updateCompensator(info, 0));
+
+    FiffCtfComp comp;
+    comp.kind = 1;
+    comp.data = FiffNamedMatrix::SDPtr(new FiffNamedMatrix(2, 2, QStringList() << m_lChNames.at(0) << m_lChNames.at(1), QStringList() << m_lChNames.at(2) << m_lChNames.at(3), MatrixXd::Identity(2, 2)));
+    info.comps << comp;
+    QVERIFY(projOperator.updateCompensator(info, 0));
+    QVERIFY(!projOperator.updateCompensator(info, 0));
+
+    info.comps[0].data->data(0, 1) = 0.5;
+    QVERIFY(projOperator.updateCompensator(info, 0));
+
+    //Changed calibrations rebuild it as well
+    info.chs[5].cal = 2.0f;
+    QVERIFY(projOperator.updateCompensator(info, 0));
+    QVERIFY(!projOperator.updateCompensator(info, 0));
+}
+
+//=============================================================================================================
+
+void TestFiffProjOperator::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffProjOperator)
+#include "test_fiff_proj_operator.moc"
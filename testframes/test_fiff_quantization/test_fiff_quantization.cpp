@@ -0,0 +1,308 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_quantization.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the quantized and delta coded raw buffers
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_tag.h>
+#include <fiff/fiff_info.h>
+
+#include <limits>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffQuantization
+ *
+ * @brief The TestFiffQuantization class provides encode and decode tests of quantized raw buffers
+ *
+ */
+class TestFiffQuantization: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffQuantization();
+
+private slots:
+    void initTestCase();
+    void roundTripShort();
+    void roundTripInt();
+    void roundTripDeltaVarint();
+    void saturation();
+    void negativeDeltas();
+    void invalidInput();
+    void cleanupTestCase();
+
+private:
+    FiffTag::SPtr writeAndRead(const MatrixXd& buf, fiff_int_t dataType);
+    MatrixXi decode(const FiffTag::SPtr& pTag);
+
+    MatrixXd    m_matData;
+    RowVectorXd m_vecCals;
+};
+
+//=============================================================================================================
+
+TestFiffQuantization::TestFiffQuantization()
+{
+}
+
+//=============================================================================================================
+
+FiffTag::SPtr TestFiffQuantization::writeAndRead(const MatrixXd& buf, fiff_int_t dataType)
+{
+    QByteArray baPacket;
+    FiffStream t_FiffStreamOut(&baPacket, QIODevice::WriteOnly);
+    if(!t_FiffStreamOut.write_raw_buffer(buf, m_vecCals, dataType)) {
+        return FiffTag::SPtr();
+    }
+
+    FiffTag::SPtr pTag;
+    FiffStream t_FiffStreamIn(&baPacket, QIODevice::ReadOnly);
+    t_FiffStreamIn.read_tag(pTag);
+
+    return pTag;
+}
+
+//=============================================================================================================
+
+MatrixXi TestFiffQuantization::decode(const FiffTag::SPtr& pTag)
+{
+    MatrixXi matQuant;
+    qint32 nchan = m_vecCals.cols();
+
+    switch(pTag->type) {
+    case FIFFT_SHORT:
+        matQuant = Map<MatrixShort>(pTag->toShort(), nchan, pTag->size() / (2 * nchan)).cast<int>();
+        break;
+    case FIFFT_INT:
+        matQuant = Map<MatrixXi>(pTag->toInt(), nchan, pTag->size() / (4 * nchan));
+        break;
+    case FIFFT_MNE_DELTA_VARINT:
+        if(!FiffStream::decode_delta_varint(pTag->data(), pTag->size(), matQuant)) {
+            matQuant.resize(0, 0);
+        }
+        break;
+    }
+
+    return matQuant;
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    //Signals in the range of a few hundred quantization steps with distinct steps per channel
+    std::srand(42);
+    m_vecCals = (RowVectorXd::Random(8).array().abs() + 0.1) * 1e-12;
+    m_matData = (MatrixXd::Random(8, 100) * 300.0).array().colwise() * m_vecCals.transpose().array();
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::roundTripShort()
+{
+    FiffTag::SPtr pTag = writeAndRead(m_matData, FIFFT_SHORT);
+    QVERIFY(pTag);
+    QCOMPARE(pTag->kind, FIFF_DATA_BUFFER);
+    QCOMPARE(pTag->type, FIFFT_SHORT);
+
+    MatrixXi matExpected;
+    QVERIFY(FiffStream::quantize_raw_buffer(m_matData, m_vecCals, -32768, 32767, matExpected));
+    QVERIFY(decode(pTag) == matExpected);
+
+    //The reconstruction error is at most half a quantization step
+    MatrixXd matRestored = decode(pTag).cast<double>().array().colwise() * m_vecCals.transpose().array();
+    ArrayXXd arrError = ((matRestored - m_matData).array().colwise() / m_vecCals.transpose().array()).abs();
+    QVERIFY(arrError.maxCoeff() <= 0.5 + 1e-9);
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::roundTripInt()
+{
+    FiffTag::SPtr pTag = writeAndRead(m_matData, FIFFT_INT);
+    QVERIFY(pTag);
+    QCOMPARE(pTag->type, FIFFT_INT);
+
+    MatrixXi matExpected;
+    QVERIFY(FiffStream::quantize_raw_buffer(m_matData, m_vecCals, std::numeric_limits<qint32>::min(), std::numeric_limits<qint32>::max(), matExpected));
+    QVERIFY(decode(pTag) == matExpected);
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::roundTripDeltaVarint()
+{
+    FiffTag::SPtr pTag = writeAndRead(m_matData, FIFFT_MNE_DELTA_VARINT);
+    QVERIFY(pTag);
+    QCOMPARE(pTag->type, FIFFT_MNE_DELTA_VARINT);
+
+    //Lossless with respect to the int32 quantization
+    FiffTag::SPtr pTagInt = writeAndRead(m_matData, FIFFT_INT);
+    QVERIFY(pTagInt);
+    QVERIFY(decode(pTag) == decode(pTagInt));
+
+    //Small differences take fewer bytes than plain int32 samples
+    QVERIFY(pTag->size() < pTagInt->size());
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::saturation()
+{
+    MatrixXd matData = m_matData;
+    matData(0, 0) = 40000.0 * m_vecCals(0);
+    matData(1, 1) = -40000.0 * m_vecCals(1);
+    matData(2, 2) = 1e12 * m_vecCals(2);
+
+    MatrixXi matQuant;
+    qint64 iNumSaturated = 0;
+    QVERIFY(FiffStream::quantize_raw_buffer(matData, m_vecCals, -32768, 32767, matQuant, &iNumSaturated));
+    QCOMPARE(iNumSaturated, qint64(3));
+
+    FiffTag::SPtr pTag = writeAndRead(matData, FIFFT_SHORT);
+    QVERIFY(pTag);
+    MatrixXi matDecoded = decode(pTag);
+    QCOMPARE(matDecoded(0, 0), 32767);
+    QCOMPARE(matDecoded(1, 1), -32768);
+    QCOMPARE(matDecoded(2, 2), 32767);
+
+    //int32 saturates only the last sample
+    QVERIFY(FiffStream::quantize_raw_buffer(matData, m_vecCals, std::numeric_limits<qint32>::min(), std::numeric_limits<qint32>::max(), matQuant, &iNumSaturated));
+    QCOMPARE(iNumSaturated, qint64(1));
+
+    pTag = writeAndRead(matData, FIFFT_MNE_DELTA_VARINT);
+    QVERIFY(pTag);
+    matDecoded = decode(pTag);
+    QCOMPARE(matDecoded(0, 0), 40000);
+    QCOMPARE(matDecoded(1, 1), -40000);
+    QCOMPARE(matDecoded(2, 2), std::numeric_limits<qint32>::max());
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::negativeDeltas()
+{
+    //Alternating extremes give the largest positive and negative differences, which wrap around in 32 bit
+    MatrixXi matQuant(3, 6);
+    matQuant << std::numeric_limits<qint32>::max(), std::numeric_limits<qint32>::min(), std::numeric_limits<qint32>::max(), 0, -1, 1,
+                -5, -10, -20, -40, -80, -160,
+                0, 0, 0, 0, 0, 0;
+
+    QByteArray baEncoded;
+    FiffStream::encode_delta_varint(matQuant, baEncoded);
+
+    MatrixXi matDecoded;
+    QVERIFY(FiffStream::decode_delta_varint(baEncoded.constData(), baEncoded.size(), matDecoded));
+    QVERIFY(matDecoded == matQuant);
+
+    //Truncated data is rejected
+    QVERIFY(!FiffStream::decode_delta_varint(baEncoded.constData(), baEncoded.size() - 1, matDecoded));
+    QVERIFY(!FiffStream::decode_delta_varint(baEncoded.constData(), 4, matDecoded));
+
+    //Decreasing signals through write_raw_buffer
+    MatrixXd matData = -m_matData.cwiseAbs();
+    FiffTag::SPtr pTag = writeAndRead(matData, FIFFT_MNE_DELTA_VARINT);
+    QVERIFY(pTag);
+
+    MatrixXi matExpected;
+    QVERIFY(FiffStream::quantize_raw_buffer(matData, m_vecCals, std::numeric_limits<qint32>::min(), std::numeric_limits<qint32>::max(), matExpected));
+    QVERIFY(decode(pTag) == matExpected);
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::invalidInput()
+{
+    MatrixXi matQuant;
+
+    //A zero step would divide by zero
+    RowVectorXd vecCals = m_vecCals;
+    vecCals(3) = 0.0;
+    QVERIFY(!FiffStream::quantize_raw_buffer(m_matData, vecCals, -32768, 32767, matQuant));
+
+    QByteArray baPacket;
+    FiffStream t_FiffStreamOut(&baPacket, QIODevice::WriteOnly);
+    QVERIFY(!t_FiffStreamOut.write_raw_buffer(m_matData, vecCals, FIFFT_SHORT));
+    QVERIFY(baPacket.isEmpty());
+
+    //Samples which are not finite
+    MatrixXd matData = m_matData;
+    matData(4, 4) = std::numeric_limits<double>::quiet_NaN();
+    QVERIFY(!FiffStream::quantize_raw_buffer(matData, m_vecCals, -32768, 32767, matQuant));
+    matData(4, 4) = std::numeric_limits<double>::infinity();
+    QVERIFY(!writeAndRead(matData, FIFFT_INT));
+
+    //Unknown data types
+    QVERIFY(!writeAndRead(m_matData, FIFFT_DOUBLE));
+
+    //Delta coded buffers are not a file format
+    QBuffer t_buffer;
+    RowVectorXd cals;
+    FiffInfo info;
+    QVERIFY(!FiffStream::start_writing_raw(t_buffer, info, cals, defaultMatrixXi, true, FIFFT_MNE_DELTA_VARINT));
+}
+
+//=============================================================================================================
+
+void TestFiffQuantization::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffQuantization)
+#include "test_fiff_quantization.moc"
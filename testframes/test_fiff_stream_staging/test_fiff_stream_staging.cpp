@@ -0,0 +1,287 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_stream_staging.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the staged tag writing of FiffStream
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_file.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/SparseCore>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffStreamStaging
+ *
+ * @brief The TestFiffStreamStaging class compares the staged tag writes to the former element wise QDataStream writes
+ *
+ */
+class TestFiffStreamStaging: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffStreamStaging();
+
+private slots:
+    void initTestCase();
+    void writeTags_data();
+    void writeTags();
+    void oversizedTag();
+    void repeatedOversizedTags();
+    void cleanupTestCase();
+
+private:
+    void writeHeader(QDataStream& stream, fiff_int_t kind, fiff_int_t type, fiff_int_t datasize, fiff_int_t next = FIFFV_NEXT_SEQ);
+    void writeFloats(QDataStream& stream, const MatrixXf& mat);
+
+    MatrixXd        m_matData;
+    RowVectorXd     m_vecCals;
+    VectorXi        m_vecInts;
+    VectorXf        m_vecFloats;
+    VectorXd        m_vecDoubles;
+};
+
+//=============================================================================================================
+
+TestFiffStreamStaging::TestFiffStreamStaging()
+{
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    m_matData = MatrixXd::Random(32, 200) * 1e-9;
+    m_vecCals = (RowVectorXd::Random(32).array().abs() + 0.1).matrix() * 1e-11;
+    m_vecInts = VectorXi::Random(17);
+    m_vecFloats = VectorXf::Random(17);
+    m_vecDoubles = VectorXd::Random(17);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::writeHeader(QDataStream& stream, fiff_int_t kind, fiff_int_t type, fiff_int_t datasize, fiff_int_t next)
+{
+    stream << (qint32)kind;
+    stream << (qint32)type;
+    stream << (qint32)datasize;
+    stream << (qint32)next;
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::writeFloats(QDataStream& stream, const MatrixXf& mat)
+{
+    for(int i = 0; i < mat.size(); ++i) {
+        stream << mat.data()[i];
+    }
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::writeTags_data()
+{
+    QTest::addColumn<int>("byteOrder");
+
+    QTest::newRow("BigEndian") << int(QDataStream::BigEndian);
+    QTest::newRow("LittleEndian") << int(QDataStream::LittleEndian);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::writeTags()
+{
+    QFETCH(int, byteOrder);
+
+    //Staged writes
+    QByteArray baStaged;
+    FiffStream stream(&baStaged, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::ByteOrder(byteOrder));
+
+    stream.write_int(FIFF_NCHAN, m_vecInts.data(), m_vecInts.size());
+    stream.write_int(FIFF_FIRST_SAMPLE, m_vecInts.data(), 1, FIFFV_NEXT_NONE);
+    stream.write_float(FIFF_SFREQ, m_vecFloats.data(), m_vecFloats.size());
+    stream.write_double(FIFF_SFREQ, m_vecDoubles.data(), m_vecDoubles.size());
+    QVERIFY(stream.write_raw_buffer(m_matData));
+    QVERIFY(stream.write_raw_buffer(m_matData, m_vecCals));
+
+    SparseMatrix<double> matMult(m_vecCals.cols(), m_vecCals.cols());
+    for(int i = 0; i < m_vecCals.cols(); ++i) {
+        matMult.insert(i, i) = m_vecCals[i];
+    }
+    QVERIFY(stream.write_raw_buffer(m_matData, matMult));
+
+    //The same tags written element wise through QDataStream as before
+    QByteArray baRef;
+    QDataStream streamRef(&baRef, QIODevice::WriteOnly);
+    streamRef.setByteOrder(QDataStream::ByteOrder(byteOrder));
+    streamRef.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    writeHeader(streamRef, FIFF_NCHAN, FIFFT_INT, 4 * m_vecInts.size());
+    for(int i = 0; i < m_vecInts.size(); ++i) {
+        streamRef << (qint32)m_vecInts[i];
+    }
+
+    writeHeader(streamRef, FIFF_FIRST_SAMPLE, FIFFT_INT, 4, FIFFV_NEXT_NONE);
+    streamRef << (qint32)m_vecInts[0];
+
+    writeHeader(streamRef, FIFF_SFREQ, FIFFT_FLOAT, 4 * m_vecFloats.size());
+    writeFloats(streamRef, m_vecFloats);
+
+    //Doubles are written with double precision, the former path wrote floats despite the declared size
+    writeHeader(streamRef, FIFF_SFREQ, FIFFT_DOUBLE, 8 * m_vecDoubles.size());
+    streamRef.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    for(int i = 0; i < m_vecDoubles.size(); ++i) {
+        streamRef << m_vecDoubles[i];
+    }
+    streamRef.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * m_matData.size());
+    writeFloats(streamRef, m_matData.cast<float>());
+
+    //Calibration through the inverse sparse calibration matrix
+    SparseMatrix<double> matInvCals(m_vecCals.cols(), m_vecCals.cols());
+    for(int i = 0; i < m_vecCals.cols(); ++i) {
+        matInvCals.insert(i, i) = 1.0 / m_vecCals[i];
+    }
+    MatrixXf matCalibrated = (matInvCals * m_matData).cast<float>();
+
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matCalibrated.size());
+    writeFloats(streamRef, matCalibrated);
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matCalibrated.size());
+    writeFloats(streamRef, matCalibrated);
+
+    QCOMPARE(baStaged.size(), baRef.size());
+    QVERIFY(baStaged == baRef);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::oversizedTag()
+{
+    //A tag larger than the kept staging capacity followed by a small one
+    MatrixXd matLarge = MatrixXd::Random(64, STAGING_BUFFER_KEEP_SIZE / (4 * 64) + 1);
+
+    QByteArray baStaged;
+    FiffStream stream(&baStaged, QIODevice::WriteOnly);
+    QVERIFY(stream.write_raw_buffer(matLarge));
+    QVERIFY(stream.write_raw_buffer(m_matData));
+
+    QByteArray baRef;
+    QDataStream streamRef(&baRef, QIODevice::WriteOnly);
+    streamRef.setByteOrder(QDataStream::BigEndian);
+    streamRef.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matLarge.size());
+    writeFloats(streamRef, matLarge.cast<float>());
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * m_matData.size());
+    writeFloats(streamRef, m_matData.cast<float>());
+
+    QCOMPARE(baStaged.size(), baRef.size());
+    QVERIFY(baStaged == baRef);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::repeatedOversizedTags()
+{
+    //Recurring large blocks keep the staging buffer, enough small tags in between free it again
+    MatrixXd matLarge = MatrixXd::Random(64, STAGING_BUFFER_KEEP_SIZE / (4 * 64) + 1);
+
+    QByteArray baStaged;
+    FiffStream stream(&baStaged, QIODevice::WriteOnly);
+    QVERIFY(stream.write_raw_buffer(matLarge));
+    QVERIFY(stream.write_raw_buffer(matLarge));
+    for(int i = 0; i <= STAGING_BUFFER_SHRINK_TAGS; ++i) {
+        QVERIFY(stream.write_raw_buffer(m_matData));
+    }
+    QVERIFY(stream.write_raw_buffer(matLarge));
+
+    QByteArray baRef;
+    QDataStream streamRef(&baRef, QIODevice::WriteOnly);
+    streamRef.setByteOrder(QDataStream::BigEndian);
+    streamRef.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    MatrixXf matLargeFloat = matLarge.cast<float>();
+    for(int i = 0; i < 2; ++i) {
+        writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matLargeFloat.size());
+        writeFloats(streamRef, matLargeFloat);
+    }
+    for(int i = 0; i <= STAGING_BUFFER_SHRINK_TAGS; ++i) {
+        writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * m_matData.size());
+        writeFloats(streamRef, m_matData.cast<float>());
+    }
+    writeHeader(streamRef, FIFF_DATA_BUFFER, FIFFT_FLOAT, 4 * matLargeFloat.size());
+    writeFloats(streamRef, matLargeFloat);
+
+    QCOMPARE(baStaged.size(), baRef.size());
+    QVERIFY(baStaged == baRef);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamStaging::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffStreamStaging)
+#include "test_fiff_stream_staging.moc"
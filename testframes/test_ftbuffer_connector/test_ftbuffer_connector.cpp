@@ -0,0 +1,299 @@
+//=============================================================================================================
+/**
+ * @file     test_ftbuffer_connector.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the FieldTrip buffer connector against a stand-in buffer server
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include "ftconnector.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FTBUFFERPLUGIN;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFtBufferConnector
+ *
+ * @brief The TestFtBufferConnector class feeds crafted buffer responses to FtConnector
+ *
+ */
+class TestFtBufferConnector: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFtBufferConnector();
+
+private slots:
+    void initTestCase();
+    void convertSamples();
+    void receiveData();
+    void rejectMismatchedSize();
+    void cleanupTestCase();
+
+private:
+    bool connectToServer(FtConnector& connector);
+    void writeWaitResponse(qint32 iNumSamples);
+    void writeDataResponse(const datadef_t& datadef, const QByteArray& baPayload);
+    void flushServer();
+
+    QTcpServer      m_server;
+    QTcpSocket*     m_pServerSocket;
+};
+
+//=============================================================================================================
+
+TestFtBufferConnector::TestFtBufferConnector()
+: m_pServerSocket(Q_NULLPTR)
+{
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QVERIFY(m_server.listen(QHostAddress::LocalHost));
+}
+
+//=============================================================================================================
+
+bool TestFtBufferConnector::connectToServer(FtConnector& connector)
+{
+    connector.setAddr("127.0.0.1");
+    connector.setPort(m_server.serverPort());
+
+    if(!connector.connect() || !m_server.waitForNewConnection(RESPONSE_TIMEOUT)) {
+        return false;
+    }
+
+    delete m_pServerSocket;
+    m_pServerSocket = m_server.nextPendingConnection();
+
+    return m_pServerSocket != Q_NULLPTR;
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::writeWaitResponse(qint32 iNumSamples)
+{
+    messagedef_t messagedef;
+    messagedef.version = VERSION;
+    messagedef.command = WAIT_OK;
+    messagedef.bufsize = sizeof (samples_events_t);
+
+    samples_events_t sampevents;
+    sampevents.nsamples = iNumSamples;
+    sampevents.nevents = 0;
+
+    m_pServerSocket->write(reinterpret_cast<const char*>(&messagedef), sizeof (messagedef_t));
+    m_pServerSocket->write(reinterpret_cast<const char*>(&sampevents), sizeof (samples_events_t));
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::writeDataResponse(const datadef_t& datadef, const QByteArray& baPayload)
+{
+    messagedef_t messagedef;
+    messagedef.version = VERSION;
+    messagedef.command = GET_OK;
+    messagedef.bufsize = sizeof (datadef_t) + baPayload.size();
+
+    m_pServerSocket->write(reinterpret_cast<const char*>(&messagedef), sizeof (messagedef_t));
+    m_pServerSocket->write(reinterpret_cast<const char*>(&datadef), sizeof (datadef_t));
+    m_pServerSocket->write(baPayload);
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::flushServer()
+{
+    while(m_pServerSocket->bytesToWrite() > 0) {
+        QVERIFY(m_pServerSocket->waitForBytesWritten(RESPONSE_TIMEOUT));
+    }
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::convertSamples()
+{
+    Matrix<qint16, Dynamic, Dynamic> matInt16 = Matrix<qint16, Dynamic, Dynamic>::Random(4, 7);
+    QByteArray baInt16(reinterpret_cast<const char*>(matInt16.data()), int(matInt16.size() * sizeof(qint16)));
+
+    MatrixXd matData;
+    QVERIFY(FtConnector::convertSamples(baInt16.constData(), baInt16.size(), DATATYPE_INT16, 4, 7, matData));
+    QVERIFY(matData == matInt16.cast<double>());
+
+    //Sizes that do not match the payload are rejected instead of read past its end
+    QVERIFY(!FtConnector::convertSamples(baInt16.constData(), baInt16.size(), DATATYPE_INT16, 4, 8, matData));
+    QVERIFY(!FtConnector::convertSamples(baInt16.constData(), baInt16.size(), DATATYPE_INT32, 4, 7, matData));
+    QVERIFY(!FtConnector::convertSamples(baInt16.constData(), baInt16.size(), DATATYPE_INT16, -4, -7, matData));
+    QVERIFY(!FtConnector::convertSamples(baInt16.constData(), baInt16.size(), DATATYPE_CHAR, 4, 7, matData));
+
+    QCOMPARE(FtConnector::wordSize(DATATYPE_UINT8), 1);
+    QCOMPARE(FtConnector::wordSize(DATATYPE_INT16), 2);
+    QCOMPARE(FtConnector::wordSize(DATATYPE_FLOAT32), 4);
+    QCOMPARE(FtConnector::wordSize(DATATYPE_FLOAT64), 8);
+    QCOMPARE(FtConnector::wordSize(DATATYPE_CHAR), 0);
+    QCOMPARE(FtConnector::wordSize(DATATYPE_FLOAT64 + 1), 0);
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::receiveData()
+{
+    FtConnector connector;
+    QVERIFY(connectToServer(connector));
+
+    //Float block, converted from the payload
+    MatrixXf matFloat = MatrixXf::Random(5, 10);
+    datadef_t datadef;
+    datadef.nchans = 5;
+    datadef.nsamples = 10;
+    datadef.data_type = DATATYPE_FLOAT32;
+    datadef.bufsize = matFloat.size() * sizeof(float);
+
+    writeWaitResponse(10);
+    writeDataResponse(datadef, QByteArray(reinterpret_cast<const char*>(matFloat.data()), datadef.bufsize));
+
+    //Double block, read straight into the matrix. It answers the pipelined WAIT_DAT request.
+    MatrixXd matDouble = MatrixXd::Random(5, 3);
+    datadef.nsamples = 3;
+    datadef.data_type = DATATYPE_FLOAT64;
+    datadef.bufsize = matDouble.size() * sizeof(double);
+
+    writeWaitResponse(13);
+    writeDataResponse(datadef, QByteArray(reinterpret_cast<const char*>(matDouble.data()), datadef.bufsize));
+    flushServer();
+
+    QVERIFY(connector.getData());
+    QVERIFY(connector.newData());
+    QVERIFY(connector.getMatrix() == matFloat.cast<double>());
+    connector.resetEmitData();
+
+    QVERIFY(connector.getData());
+    QVERIFY(connector.newData());
+    QVERIFY(connector.getMatrix() == matDouble);
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::rejectMismatchedSize()
+{
+    FtConnector connector;
+    QVERIFY(connectToServer(connector));
+
+    //The datadef claims more samples than its bufsize holds
+    QByteArray baPayload(4 * 2 * sizeof(float), 0);
+    datadef_t datadef;
+    datadef.nchans = 4;
+    datadef.nsamples = 1000;
+    datadef.data_type = DATATYPE_FLOAT32;
+    datadef.bufsize = baPayload.size();
+
+    writeWaitResponse(1000);
+    writeDataResponse(datadef, baPayload);
+    flushServer();
+
+    QVERIFY(!connector.getData());
+    QVERIFY(!connector.newData());
+
+    //The bufsize does not match the message size
+    datadef.nsamples = 2;
+    datadef.bufsize = 4 * 2000 * sizeof(float);
+
+    writeWaitResponse(1002);
+    writeDataResponse(datadef, baPayload);
+    flushServer();
+
+    QVERIFY(!connector.getData());
+    QVERIFY(!connector.newData());
+
+    //Negative sizes
+    datadef.nchans = -4;
+    datadef.nsamples = -2;
+    datadef.bufsize = baPayload.size();
+
+    writeWaitResponse(1004);
+    writeDataResponse(datadef, baPayload);
+    flushServer();
+
+    QVERIFY(!connector.getData());
+    QVERIFY(!connector.newData());
+
+    //A valid block is received again afterwards
+    MatrixXf matFloat = MatrixXf::Random(4, 2);
+    datadef.nchans = 4;
+    datadef.nsamples = 2;
+    datadef.bufsize = matFloat.size() * sizeof(float);
+
+    writeWaitResponse(1006);
+    writeDataResponse(datadef, QByteArray(reinterpret_cast<const char*>(matFloat.data()), datadef.bufsize));
+    flushServer();
+
+    QVERIFY(connector.getData());
+    QVERIFY(connector.getMatrix() == matFloat.cast<double>());
+}
+
+//=============================================================================================================
+
+void TestFtBufferConnector::cleanupTestCase()
+{
+    delete m_pServerSocket;
+    m_pServerSocket = Q_NULLPTR;
+    m_server.close();
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFtBufferConnector)
+#include "test_ftbuffer_connector.moc"
@@ -0,0 +1,235 @@
+//=============================================================================================================
+/**
+ * @file     test_fwd_bem_model.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the assembly of the BEM solid angle and linear potential coefficient matrices
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fwd/fwd_bem_model.h>
+
+#include <mne/c/mne_surface_old.h>
+#include <mne/c/mne_triangle.h>
+#include <mne/c/mne_surface_or_volume.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FWDLIB;
+using namespace MNELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFwdBemModel
+ *
+ * @brief The TestFwdBemModel class compares the vectorized BEM coefficient assembly with the scalar per triangle
+ *        computation it replaced
+ *
+ */
+class TestFwdBemModel: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFwdBemModel();
+
+private slots:
+    void initTestCase();
+    void solidAngles();
+    void linPotCoeff();
+    void cleanupTestCase();
+
+private:
+    typedef Matrix<float,Dynamic,Dynamic,RowMajor> MatrixRowMajorXf;
+
+    MatrixRowMajorXf toMatrix(float **mat, int nrow, int ncol) const;
+    void compare(const MatrixRowMajorXf& matResult, const MatrixRowMajorXf& matReference) const;
+
+    FwdBemModel*    m_pBemModel;
+    float           m_fEpsilon;
+};
+
+//=============================================================================================================
+
+TestFwdBemModel::TestFwdBemModel()
+: m_pBemModel(Q_NULLPTR)
+, m_fEpsilon(4.0f * std::numeric_limits<float>::epsilon())
+{
+}
+
+//=============================================================================================================
+
+void TestFwdBemModel::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QString sBemName = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/subjects/sample/bem/sample-1280-1280-1280-bem.fif";
+    m_pBemModel = FwdBemModel::fwd_bem_load_three_layer_surfaces(sBemName);
+    QVERIFY(m_pBemModel);
+    QCOMPARE(m_pBemModel->surfs.size(), 3);
+}
+
+//=============================================================================================================
+
+TestFwdBemModel::MatrixRowMajorXf TestFwdBemModel::toMatrix(float **mat, int nrow, int ncol) const
+{
+    //The matrices are allocated in one contiguous block
+    MatrixRowMajorXf matResult = Map<MatrixRowMajorXf>(mat[0], nrow, ncol);
+    free(mat[0]);
+    free(mat);
+
+    return matResult;
+}
+
+//=============================================================================================================
+
+void TestFwdBemModel::compare(const MatrixRowMajorXf& matResult, const MatrixRowMajorXf& matReference) const
+{
+    QCOMPARE(matResult.rows(), matReference.rows());
+    QCOMPARE(matResult.cols(), matReference.cols());
+    QVERIFY(matResult.allFinite());
+
+    //The kernels use the same arithmetic as the reference. Allow a few float ulps, since targets which contract
+    //multiply-adds may round the two code paths differently.
+    float fDiff = (matResult - matReference).cwiseAbs().maxCoeff();
+    float fScale = matReference.cwiseAbs().maxCoeff();
+    qInfo() << "Maximal difference to the reference" << fDiff << "at a maximal magnitude of" << fScale;
+    QVERIFY(fDiff <= m_fEpsilon * fScale);
+}
+
+//=============================================================================================================
+
+void TestFwdBemModel::solidAngles()
+{
+    const QList<MneSurfaceOld*>& surfs = m_pBemModel->surfs;
+
+    int ntri_tot = 0;
+    for (int p = 0; p < surfs.size(); p++)
+        ntri_tot += surfs[p]->ntri;
+
+    float **solids = FwdBemModel::fwd_bem_solid_angles(surfs);
+    QVERIFY(solids);
+    MatrixRowMajorXf matSolids = toMatrix(solids, ntri_tot, ntri_tot);
+
+    //One scalar call per (triangle, triangle) pair as before the vectorization
+    MatrixRowMajorXf matReference(ntri_tot, ntri_tot);
+    for (int p = 0, joff = 0; p < surfs.size(); joff += surfs[p]->ntri, p++) {
+        for (int q = 0, koff = 0; q < surfs.size(); koff += surfs[q]->ntri, q++) {
+            for (int j = 0; j < surfs[p]->ntri; j++) {
+                for (int k = 0; k < surfs[q]->ntri; k++) {
+                    if (p == q && j == k)
+                        matReference(j+joff, k+koff) = 0.0f;
+                    else
+                        matReference(j+joff, k+koff) = MneSurfaceOrVolume::solid_angle(surfs[p]->tris[j].cent, surfs[q]->tris+k);
+                }
+            }
+        }
+    }
+
+    compare(matSolids, matReference);
+}
+
+//=============================================================================================================
+
+void TestFwdBemModel::linPotCoeff()
+{
+    const QList<MneSurfaceOld*>& surfs = m_pBemModel->surfs;
+
+    int np_tot = 0;
+    for (int p = 0; p < surfs.size(); p++)
+        np_tot += surfs[p]->np;
+
+    float **coeff = FwdBemModel::fwd_bem_lin_pot_coeff(surfs);
+    QVERIFY(coeff);
+    MatrixRowMajorXf matCoeff = toMatrix(coeff, np_tot, np_tot);
+
+    //One scalar call per (vertex, triangle) pair as before the vectorization
+    MatrixRowMajorXf matReference = MatrixRowMajorXf::Zero(np_tot, np_tot);
+    QVector<float*> subMat(np_tot);
+    for (int p = 0, joff = 0; p < surfs.size(); joff += surfs[p]->np, p++) {
+        for (int q = 0, koff = 0; q < surfs.size(); koff += surfs[q]->np, q++) {
+            VectorXd row(surfs[q]->np);
+            for (int j = 0; j < surfs[p]->np; j++) {
+                row.setZero();
+                for (int k = 0; k < surfs[q]->ntri; k++) {
+                    MneTriangle* tri = surfs[q]->tris+k;
+                    if (p == q && (tri->vert[0] == j || tri->vert[1] == j || tri->vert[2] == j))
+                        continue;
+                    double omega[3];
+                    FwdBemModel::lin_pot_coeff(surfs[p]->rr[j], tri, omega);
+                    for (int c = 0; c < 3; c++)
+                        row[tri->vert[c]] = row[tri->vert[c]] - omega[c];
+                }
+                matReference.row(j+joff).segment(koff, surfs[q]->np) = row.cast<float>().transpose();
+            }
+            if (p == q) {
+                for (int j = 0; j < surfs[p]->np; j++)
+                    subMat[j] = matReference.row(j+joff).data()+koff;
+                FwdBemModel::correct_auto_elements(surfs[p], subMat.data());
+            }
+        }
+    }
+
+    compare(matCoeff, matReference);
+}
+
+//=============================================================================================================
+
+void TestFwdBemModel::cleanupTestCase()
+{
+    delete m_pBemModel;
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFwdBemModel)
+#include "test_fwd_bem_model.moc"
@@ -0,0 +1,482 @@
+//=============================================================================================================
+/**
+ * @file     test_kmeans.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the triangle inequality accelerated k-means
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+#include <utils/kmeans.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestKMeans
+ *
+ * @brief The TestKMeans class compares the Hamerly and Elkan accelerated k-means to brute force Lloyd iterations
+ *
+ */
+class TestKMeans: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestKMeans();
+
+private slots:
+    void initTestCase();
+    void sqeuclideanHamerly();
+    void sqeuclideanElkan();
+    void cityblockHamerly();
+    void cityblockElkan();
+    void emptyClusterSingleton();
+    void emptyClusterDrop();
+    void emptyClusterError();
+    void cleanupTestCase();
+
+private:
+    MatrixXd createBlobs(int iNDims, int iNBlobs, int iNPointsPerBlob, double dNoise, int iSeed);
+    bool lloyd(const MatrixXd& X,
+               int k,
+               const QString& sDistance,
+               const QString& sStart,
+               const QString& sEmptyact,
+               int iSeed,
+               VectorXi& idx,
+               MatrixXd& C,
+               bool& bEmpty);
+    void compareToLloyd(const MatrixXd& X,
+                        int k,
+                        const QString& sDistance,
+                        const QString& sStart,
+                        const QString& sEmptyact,
+                        int iSeed,
+                        bool& bEmpty);
+    int findEmptyClusterSeed(const MatrixXd& X,
+                             int k,
+                             const QString& sDistance);
+
+    int m_iMaxit;
+};
+
+//=============================================================================================================
+
+TestKMeans::TestKMeans()
+: m_iMaxit(100)
+{
+}
+
+//=============================================================================================================
+
+void TestKMeans::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+}
+
+//=============================================================================================================
+
+MatrixXd TestKMeans::createBlobs(int iNDims, int iNBlobs, int iNPointsPerBlob, double dNoise, int iSeed)
+{
+    std::mt19937 generator(iSeed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    MatrixXd X(iNBlobs * iNPointsPerBlob, iNDims);
+
+    for(int b = 0; b < iNBlobs; ++b) {
+        VectorXd vecCenter(iNDims);
+        for(int h = 0; h < iNDims; ++h) {
+            vecCenter[h] = 4.0 * normal(generator);
+        }
+
+        for(int i = 0; i < iNPointsPerBlob; ++i) {
+            for(int h = 0; h < iNDims; ++h) {
+                X(b * iNPointsPerBlob + i, h) = vecCenter[h] + dNoise * normal(generator);
+            }
+        }
+    }
+
+    return X;
+}
+
+//=============================================================================================================
+
+bool TestKMeans::lloyd(const MatrixXd& X,
+                       int k,
+                       const QString& sDistance,
+                       const QString& sStart,
+                       const QString& sEmptyact,
+                       int iSeed,
+                       VectorXi& idx,
+                       MatrixXd& C,
+                       bool& bEmpty)
+{
+    // Brute force Lloyd iterations with the initialization of a single KMeans replicate
+    const bool bCityblock = sDistance == "cityblock";
+    const int n = X.rows();
+    const int p = X.cols();
+    std::mt19937 generator(iSeed);
+
+    C.resize(k, p);
+
+    if(sStart == "uniform") {
+        RowVectorXd Xmins = X.colwise().minCoeff();
+        RowVectorXd Xmaxs = X.colwise().maxCoeff();
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        for(int j = 0; j < k; ++j) {
+            for(int h = 0; h < p; ++h) {
+                C(j,h) = Xmins[h] + uniform(generator) * (Xmaxs[h] - Xmins[h]);
+            }
+        }
+    } else {
+        std::vector<int> vecPoints(n);
+        for(int i = 0; i < n; ++i) {
+            vecPoints[i] = i;
+        }
+
+        for(int j = 0; j < k; ++j) {
+            std::uniform_int_distribution<int> pick(j, n - 1);
+            std::swap(vecPoints[j], vecPoints[pick(generator)]);
+            C.row(j) = X.row(vecPoints[j]);
+        }
+    }
+
+    auto dist = [&](int i, int j) -> double {
+        return bCityblock ? (X.row(i) - C.row(j)).cwiseAbs().sum() : (X.row(i) - C.row(j)).squaredNorm();
+    };
+
+    // Assign every point to its closest centroid, ties and dropped (NaN) clusters keep the current one
+    auto assign = [&](bool bInit) -> int {
+        int iChanged = 0;
+        for(int i = 0; i < n; ++i) {
+            int iBest = bInit ? -1 : idx[i];
+            double dBest = bInit ? std::numeric_limits<double>::max() : dist(i, iBest);
+            for(int j = 0; j < k; ++j) {
+                double dj = dist(i, j);
+                if(dj < dBest) {
+                    dBest = dj;
+                    iBest = j;
+                }
+            }
+            if(iBest != idx[i]) {
+                idx[i] = iBest;
+                ++iChanged;
+            }
+        }
+        return iChanged;
+    };
+
+    bEmpty = false;
+    idx = VectorXi::Constant(n, -1);
+    assign(true);
+
+    for(int iter = 1; iter <= m_iMaxit; ++iter) {
+        VectorXi counts = VectorXi::Zero(k);
+        for(int i = 0; i < n; ++i) {
+            ++counts[idx[i]];
+        }
+
+        // Empty clusters
+        VectorXd vecDist(n);
+        for(int i = 0; i < n; ++i) {
+            vecDist[i] = dist(i, idx[i]);
+        }
+
+        for(int j = 0; j < k; ++j) {
+            if(counts[j] > 0 || C.row(j).hasNaN()) {
+                continue;
+            }
+
+            bEmpty = true;
+
+            if(sEmptyact == "error") {
+                return false;
+            } else if(sEmptyact == "drop") {
+                C.row(j).setConstant(std::numeric_limits<double>::quiet_NaN());
+            } else {
+                int iLonely = -1;
+                for(int i = 0; i < n; ++i) {
+                    if(counts[idx[i]] > 1 && (iLonely < 0 || vecDist[i] > vecDist[iLonely])) {
+                        iLonely = i;
+                    }
+                }
+                --counts[idx[iLonely]];
+                idx[iLonely] = j;
+                counts[j] = 1;
+            }
+        }
+
+        // Centroids
+        for(int j = 0; j < k; ++j) {
+            if(counts[j] == 0) {
+                continue;
+            }
+
+            if(bCityblock) {
+                for(int h = 0; h < p; ++h) {
+                    std::vector<double> values;
+                    for(int i = 0; i < n; ++i) {
+                        if(idx[i] == j) {
+                            values.push_back(X(i,h));
+                        }
+                    }
+                    std::sort(values.begin(), values.end());
+                    int nn = values.size() / 2;
+                    C(j,h) = values.size() % 2 == 0 ? 0.5 * (values[nn] + values[nn - 1]) : values[nn];
+                }
+            } else {
+                C.row(j).setZero();
+                for(int i = 0; i < n; ++i) {
+                    if(idx[i] == j) {
+                        C.row(j) += X.row(i);
+                    }
+                }
+                C.row(j) /= double(counts[j]);
+            }
+        }
+
+        if(assign(false) == 0) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================================================
+
+void TestKMeans::compareToLloyd(const MatrixXd& X,
+                                int k,
+                                const QString& sDistance,
+                                const QString& sStart,
+                                const QString& sEmptyact,
+                                int iSeed,
+                                bool& bEmpty)
+{
+    VectorXi idxRef;
+    MatrixXd CRef;
+    bool bValidRef = lloyd(X, k, sDistance, sStart, sEmptyact, iSeed, idxRef, CRef, bEmpty);
+
+    KMeans kMeans(sDistance, sStart, 1, sEmptyact, false, m_iMaxit, iSeed);
+    VectorXi idx;
+    MatrixXd C, D;
+    VectorXd sumD;
+    bool bValid = kMeans.calculate(X, k, idx, C, sumD, D);
+
+    QCOMPARE(bValid, bValidRef);
+    if(!bValid) {
+        return;
+    }
+
+    QCOMPARE(idx.size(), idxRef.size());
+    QVERIFY(idx == idxRef);
+
+    QCOMPARE(C.rows(), CRef.rows());
+    QCOMPARE(C.cols(), CRef.cols());
+
+    for(int j = 0; j < k; ++j) {
+        QCOMPARE(bool(C.row(j).hasNaN()), bool(CRef.row(j).hasNaN()));
+
+        if(CRef.row(j).hasNaN()) {
+            QVERIFY(D.col(j).hasNaN());
+            QCOMPARE(sumD[j], 0.0);
+        } else {
+            QVERIFY((C.row(j) - CRef.row(j)).cwiseAbs().maxCoeff() < 1e-10);
+        }
+    }
+}
+
+//=============================================================================================================
+
+int TestKMeans::findEmptyClusterSeed(const MatrixXd& X,
+                                     int k,
+                                     const QString& sDistance)
+{
+    // Random uniform centroids in the bounding box of a few tight blobs regularly lose all their members
+    VectorXi idx;
+    MatrixXd C;
+    bool bEmpty = false;
+
+    for(int iSeed = 0; iSeed < 1000; ++iSeed) {
+        lloyd(X, k, sDistance, "uniform", "error", iSeed, idx, C, bEmpty);
+        if(bEmpty) {
+            return iSeed;
+        }
+    }
+
+    return -1;
+}
+
+//=============================================================================================================
+
+void TestKMeans::sqeuclideanHamerly()
+{
+    // Hamerly bounds are used below 50 dimensions
+    MatrixXd X = createBlobs(3, 5, 40, 1.5, 1);
+    bool bEmpty = false;
+
+    for(int iSeed = 0; iSeed < 10; ++iSeed) {
+        compareToLloyd(X, 5, "sqeuclidean", "sample", "singleton", iSeed, bEmpty);
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::sqeuclideanElkan()
+{
+    // Elkan bounds are used from 50 dimensions on
+    MatrixXd X = createBlobs(60, 5, 40, 3.0, 2);
+    bool bEmpty = false;
+
+    for(int iSeed = 0; iSeed < 10; ++iSeed) {
+        compareToLloyd(X, 5, "sqeuclidean", "sample", "singleton", iSeed, bEmpty);
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::cityblockHamerly()
+{
+    MatrixXd X = createBlobs(3, 5, 40, 1.5, 3);
+    bool bEmpty = false;
+
+    for(int iSeed = 0; iSeed < 10; ++iSeed) {
+        compareToLloyd(X, 5, "cityblock", "sample", "singleton", iSeed, bEmpty);
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::cityblockElkan()
+{
+    MatrixXd X = createBlobs(60, 5, 40, 3.0, 4);
+    bool bEmpty = false;
+
+    for(int iSeed = 0; iSeed < 10; ++iSeed) {
+        compareToLloyd(X, 5, "cityblock", "sample", "singleton", iSeed, bEmpty);
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::emptyClusterSingleton()
+{
+    QStringList lDistances;
+    lDistances << "sqeuclidean" << "cityblock";
+
+    for(int iNDims = 3; iNDims <= 60; iNDims += 57) {
+        MatrixXd X = createBlobs(iNDims, 2, 30, 0.1, 5);
+
+        for(int i = 0; i < lDistances.size(); ++i) {
+            int iSeed = findEmptyClusterSeed(X, 6, lDistances.at(i));
+            QVERIFY(iSeed >= 0);
+
+            bool bEmpty = false;
+            compareToLloyd(X, 6, lDistances.at(i), "uniform", "singleton", iSeed, bEmpty);
+            QVERIFY(bEmpty);
+        }
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::emptyClusterDrop()
+{
+    QStringList lDistances;
+    lDistances << "sqeuclidean" << "cityblock";
+
+    for(int iNDims = 3; iNDims <= 60; iNDims += 57) {
+        MatrixXd X = createBlobs(iNDims, 2, 30, 0.1, 6);
+
+        for(int i = 0; i < lDistances.size(); ++i) {
+            int iSeed = findEmptyClusterSeed(X, 6, lDistances.at(i));
+            QVERIFY(iSeed >= 0);
+
+            bool bEmpty = false;
+            compareToLloyd(X, 6, lDistances.at(i), "uniform", "drop", iSeed, bEmpty);
+            QVERIFY(bEmpty);
+        }
+    }
+}
+
+//=============================================================================================================
+
+void TestKMeans::emptyClusterError()
+{
+    MatrixXd X = createBlobs(3, 2, 30, 0.1, 7);
+    int iSeed = findEmptyClusterSeed(X, 6, "sqeuclidean");
+    QVERIFY(iSeed >= 0);
+
+    // The only replicate fails with an empty cluster
+    bool bEmpty = false;
+    compareToLloyd(X, 6, "sqeuclidean", "uniform", "error", iSeed, bEmpty);
+    QVERIFY(bEmpty);
+
+    KMeans kMeans("sqeuclidean", "uniform", 1, "error", false, m_iMaxit, iSeed);
+    VectorXi idx;
+    MatrixXd C, D;
+    VectorXd sumD;
+    QVERIFY(!kMeans.calculate(X, 6, idx, C, sumD, D));
+}
+
+//=============================================================================================================
+
+void TestKMeans::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestKMeans)
+#include "test_kmeans.moc"
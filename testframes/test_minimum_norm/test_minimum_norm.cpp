@@ -0,0 +1,208 @@
+//=============================================================================================================
+/**
+ * @file     test_minimum_norm.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @brief    Test for the single precision minimum norm
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_evoked.h>
+#include <fiff/fiff_cov.h>
+
+#include <mne/mne_forwardsolution.h>
+#include <mne/mne_inverse_operator.h>
+#include <mne/mne_sourceestimate.h>
+
+#include <inverse/minimumNorm/minimumnorm.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace INVERSELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestMinimumNorm
+ *
+ * @brief The TestMinimumNorm class compares the single precision minimum norm to the double precision one
+ *
+ */
+class TestMinimumNorm: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMinimumNorm();
+
+private slots:
+    void initTestCase();
+    void compareSinglePrecision_data();
+    void compareSinglePrecision();
+    void cleanupTestCase();
+
+private:
+    double relativeError(const MatrixXd& matActual, const MatrixXd& matExpected) const;
+
+    FiffEvoked m_evoked;
+    MNEInverseOperator m_inverseOperator;
+    double dEpsilonSingle;
+    double dEpsilonDouble;
+};
+
+//=============================================================================================================
+
+TestMinimumNorm::TestMinimumNorm()
+: dEpsilonSingle(1.0e-4)
+, dEpsilonDouble(1.0e-6)
+{
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QFile t_fileFwd(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    QFile t_fileCov(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-cov.fif");
+    QFile t_fileEvoked(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif");
+
+    fiff_int_t setno = 0;
+    QPair<QVariant, QVariant> baseline(QVariant(), 0);
+    m_evoked = FiffEvoked(t_fileEvoked, setno, baseline);
+    QVERIFY(!m_evoked.isEmpty());
+
+    MNEForwardSolution t_forwardSolution(t_fileFwd, false, true);
+    QVERIFY(!t_forwardSolution.isEmpty());
+
+    FiffCov noise_cov(t_fileCov);
+    noise_cov = noise_cov.regularize(m_evoked.info, 0.05, 0.05, 0.1, true);
+
+    m_inverseOperator = MNEInverseOperator(m_evoked.info, t_forwardSolution, noise_cov, 0.2f, 0.8f);
+}
+
+//=============================================================================================================
+
+double TestMinimumNorm::relativeError(const MatrixXd& matActual, const MatrixXd& matExpected) const
+{
+    return (matActual - matExpected).norm() / matExpected.norm();
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::compareSinglePrecision_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<bool>("pick_normal");
+
+    QTest::newRow("MNE") << QString("MNE") << false;
+    QTest::newRow("dSPM") << QString("dSPM") << false;
+    QTest::newRow("sLORETA") << QString("sLORETA") << false;
+    QTest::newRow("dSPM normal") << QString("dSPM") << true;
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::compareSinglePrecision()
+{
+    QFETCH(QString, method);
+    QFETCH(bool, pick_normal);
+
+    double snr = 3.0;
+    double lambda2 = 1.0 / pow(snr, 2);
+
+    MinimumNorm minimumNorm(m_inverseOperator, lambda2, method);
+    minimumNorm.doInverseSetup(m_evoked.nave, pick_normal);
+
+    FiffEvoked t_evokedPicked = m_evoked.pick_channels(minimumNorm.getPreparedInverseOperator().noise_cov->names);
+    MatrixXf matDataFloat = t_evokedPicked.data.cast<float>();
+    float tmin = m_evoked.times[0];
+    float tstep = 1.0f / m_evoked.info.sfreq;
+
+    MNESourceEstimate stcDouble = minimumNorm.calculateInverse(t_evokedPicked.data, tmin, tstep, pick_normal);
+    QVERIFY(!stcDouble.isEmpty());
+
+    // Without the single precision kernel the float data are applied to the double precision kernel
+    MNESourceEstimate stcWidened = minimumNorm.calculateInverse(matDataFloat, tmin, tstep, pick_normal);
+    QCOMPARE(stcWidened.data.rows(), stcDouble.data.rows());
+    QCOMPARE(stcWidened.data.cols(), stcDouble.data.cols());
+    QVERIFY(relativeError(stcWidened.data, stcDouble.data) < dEpsilonDouble);
+
+    // The single precision kernel has to match the double precision one up to the float resolution
+    minimumNorm.setSinglePrecision(true);
+    MNESourceEstimate stcFloat = minimumNorm.calculateInverse(matDataFloat, tmin, tstep, pick_normal);
+    QCOMPARE(stcFloat.data.rows(), stcDouble.data.rows());
+    QCOMPARE(stcFloat.data.cols(), stcDouble.data.cols());
+    QVERIFY(relativeError(stcFloat.data, stcDouble.data) < dEpsilonSingle);
+    QCOMPARE(stcFloat.tmin, stcDouble.tmin);
+    QCOMPARE(stcFloat.tstep, stcDouble.tstep);
+    QVERIFY(stcFloat.vertices == stcDouble.vertices);
+
+    // A new setup keeps the single precision kernel up to date
+    minimumNorm.doInverseSetup(1, pick_normal);
+    MNESourceEstimate stcDoubleNave = minimumNorm.calculateInverse(t_evokedPicked.data, tmin, tstep, pick_normal);
+    MNESourceEstimate stcFloatNave = minimumNorm.calculateInverse(matDataFloat, tmin, tstep, pick_normal);
+    QVERIFY(relativeError(stcFloatNave.data, stcDoubleNave.data) < dEpsilonSingle);
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestMinimumNorm)
+#include "test_minimum_norm.moc"
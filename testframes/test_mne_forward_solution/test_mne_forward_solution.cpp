@@ -43,6 +43,7 @@
 #include <fwd/computeFwd/compute_fwd_settings.h>
 #include <fwd/computeFwd/compute_fwd.h>
 #include <mne/mne.h>
+#include <fs/label.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -56,6 +57,8 @@
 
 using namespace FWDLIB;
 using namespace MNELIB;
+using namespace FSLIB;
+using namespace Eigen;
 
 //=============================================================================================================
 /**
@@ -75,6 +78,8 @@ private slots:
     void initTestCase();
     void computeForward();
     void compareForward();
+    void readSelectedChannels();
+    void readSelectedLabels();
     void cleanupTestCase();
 
 private:
@@ -173,6 +178,64 @@ void TestMneForwardSolution::compareForward()
 
 //=============================================================================================================
 
+void TestMneForwardSolution::readSelectedChannels()
+{
+    printf(">>>>>>>>>>>>>>>>>>>>>>>>> Read Forward Solution with Channel Selection >>>>>>>>>>>>>>>>>>>>>>>>>\n");
+
+    // Picking the channels while reading has to give the same result as picking them afterwards
+    QStringList include;
+    for(int i = 0; i < m_pFwdMEGEEGRef->sol->row_names.size(); i += 3) {
+        include << m_pFwdMEGEEGRef->sol->row_names[i];
+    }
+
+    MNEForwardSolution fwdPicked = m_pFwdMEGEEGRef->pick_channels(include);
+
+    QFile fileFwdMEGEEGRef(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    MNEForwardSolution fwdSelected(fileFwdMEGEEGRef, false, false, include);
+
+    QVERIFY(fwdSelected.nchan == fwdPicked.nchan);
+    QVERIFY(fwdSelected.nsource == fwdPicked.nsource);
+    QVERIFY(fwdSelected.sol->row_names == fwdPicked.sol->row_names);
+    QVERIFY(fwdSelected.sol->data == fwdPicked.sol->data);
+    QVERIFY(fwdSelected.info.chs.size() == fwdSelected.nchan);
+
+    printf("<<<<<<<<<<<<<<<<<<<<<<<<< Read Forward Solution with Channel Selection Finished <<<<<<<<<<<<<<<<<<<<<<<<<\n");
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::readSelectedLabels()
+{
+    printf(">>>>>>>>>>>>>>>>>>>>>>>>> Read Forward Solution with Label Selection >>>>>>>>>>>>>>>>>>>>>>>>>\n");
+
+    // Picking the sources while reading has to give the same result as picking the regions afterwards
+    const VectorXi& vertno = m_pFwdMEGEEGRef->src[0].vertno;
+    VectorXi vertices(vertno.size() / 7);
+    for(int i = 0; i < vertices.size(); ++i) {
+        vertices[i] = vertno[7 * i];
+    }
+
+    QList<Label> labels;
+    labels << Label(vertices, MatrixX3f::Zero(vertices.size(), 3), VectorXd::Ones(vertices.size()), 0, "test-lh");
+
+    MNEForwardSolution fwdPicked = m_pFwdMEGEEGRef->pick_regions(labels);
+
+    QFile fileFwdMEGEEGRef(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    MNEForwardSolution fwdSelected;
+    QVERIFY(MNEForwardSolution::read(fileFwdMEGEEGRef, fwdSelected, false, false, FIFFLIB::defaultQStringList, FIFFLIB::defaultQStringList, false, labels));
+
+    QVERIFY(fwdSelected.nsource == vertices.size());
+    QVERIFY(fwdSelected.nsource == fwdPicked.nsource);
+    QVERIFY(fwdSelected.nchan == fwdPicked.nchan);
+    QVERIFY(fwdSelected.sol->data == fwdPicked.sol->data);
+    QVERIFY(fwdSelected.source_rr == fwdPicked.source_rr);
+    QVERIFY(fwdSelected.src[0].vertno == fwdPicked.src[0].vertno);
+
+    printf("<<<<<<<<<<<<<<<<<<<<<<<<< Read Forward Solution with Label Selection Finished <<<<<<<<<<<<<<<<<<<<<<<<<\n");
+}
+
+//=============================================================================================================
+
 void TestMneForwardSolution::cleanupTestCase()
 {
 }
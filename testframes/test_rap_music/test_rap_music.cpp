@@ -0,0 +1,264 @@
+//=============================================================================================================
+/**
+ * @file     test_rap_music.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * @brief    Test for the RAP MUSIC pair scan
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <mne/mne_forwardsolution.h>
+#include <inverse/rapMusic/rapmusic.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace INVERSELIB;
+using namespace MNELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS RapMusicScan
+ *
+ * @brief The RapMusicScan class exposes the pair scan and the subspace correlations of RapMusic
+ *
+ */
+class RapMusicScan : public RapMusic
+{
+public:
+    RapMusicScan(MNEForwardSolution& p_Fwd)
+    : RapMusic(p_Fwd, false, 1, 0.5)
+    {
+    }
+
+    using RapMusic::scanPairCombinations;
+    using RapMusic::subcorr;
+    using RapMusic::getGainMatrixPair;
+    using RapMusic::getPointPair;
+};
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestRapMusic
+ *
+ * @brief The TestRapMusic class compares the Gram matrix based pair scan to the former SVD of every pair
+ *
+ */
+class TestRapMusic : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRapMusic();
+
+private slots:
+    void initTestCase();
+    void scanPairs();
+    void scanProjectedPairs();
+    void cleanupTestCase();
+
+private:
+    void compareScan(const MatrixXd& matLeadField, const MatrixXd& matU_B);
+
+    double dEpsilon;
+
+    int m_iNumGridPoints;
+    int m_iIdx1;
+    int m_iIdx2;
+
+    QSharedPointer<MNEForwardSolution> m_pFwd;
+    QSharedPointer<RapMusicScan> m_pRapMusic;
+
+    MatrixXd m_matU_B;
+    VectorXd m_vecPhi;
+};
+
+//=============================================================================================================
+
+TestRapMusic::TestRapMusic()
+: dEpsilon(1e-6)
+, m_iNumGridPoints(200)
+, m_iIdx1(17)
+, m_iIdx2(123)
+{
+}
+
+//=============================================================================================================
+
+void TestRapMusic::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QFile t_fileFwd(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    m_pFwd = QSharedPointer<MNEForwardSolution>(new MNEForwardSolution(t_fileFwd));
+    QVERIFY(!m_pFwd->isEmpty());
+    QVERIFY(m_pFwd->sol->data.cols() >= 3 * m_iNumGridPoints);
+
+    //The SVD of every pair of the full grid is too slow for a test -> restrict the scan to the first grid points
+    m_pFwd->sol->data = m_pFwd->sol->data.leftCols(3 * m_iNumGridPoints).eval();
+    m_pFwd->sol->ncol = m_pFwd->sol->data.cols();
+
+    m_pRapMusic = QSharedPointer<RapMusicScan>(new RapMusicScan(*m_pFwd));
+
+    //Two correlated dipoles with fixed orientation
+    const MatrixXd& matLeadField = m_pFwd->sol->data;
+    int iNumSamples = 300;
+
+    m_vecPhi = VectorXd(6);
+    m_vecPhi << 0.3, -0.5, 0.8, -0.6, 0.2, 0.4;
+
+    VectorXd vecTime = VectorXd::LinSpaced(iNumSamples, 0.0, 0.3);
+    MatrixXd matSources(6, iNumSamples);
+    for(int i = 0; i < 3; ++i) {
+        matSources.row(i) = m_vecPhi(i) * (2.0 * EIGEN_PI * 10.0 * vecTime).array().sin().matrix().transpose();
+        matSources.row(i + 3) = m_vecPhi(i + 3) * (2.0 * EIGEN_PI * 10.0 * vecTime.array() + 0.5).sin().matrix().transpose();
+    }
+
+    RapMusic::MatrixX6T matG(matLeadField.rows(), 6);
+    RapMusicScan::getGainMatrixPair(matLeadField, matG, m_iIdx1, m_iIdx2);
+
+    MatrixXd matData = matG * matSources;
+    srand(0);
+    matData += 1e-3 * matData.norm() / sqrt(double(matData.size())) * MatrixXd::Random(matData.rows(), matData.cols());
+
+    //Signal subspace of the two sources
+    JacobiSVD<MatrixXd> t_svdData(matData, ComputeThinU);
+    m_matU_B = t_svdData.matrixU().leftCols(2);
+}
+
+//=============================================================================================================
+
+void TestRapMusic::compareScan(const MatrixXd& matLeadField, const MatrixXd& matU_B)
+{
+    //Former path: SVD of every projected pair, ties are resolved to the lowest combination index
+    qint64 iNumCombinations = (qint64)m_iNumGridPoints * (m_iNumGridPoints + 1) / 2;
+
+    RapMusic::MatrixX6T matG(matLeadField.rows(), 6);
+    double dMaxCorSvd = -1.0;
+    Pair pairMaxSvd = {0, 0};
+    double dMaxDiff = 0.0;
+
+    for(qint64 k = 0; k < iNumCombinations; ++k) {
+        int idx1, idx2;
+        RapMusicScan::getPointPair(m_iNumGridPoints, (int)k, idx1, idx2);
+        RapMusicScan::getGainMatrixPair(matLeadField, matG, idx1, idx2);
+
+        double dCorSvd = RapMusicScan::subcorr(matG, matU_B);
+
+        //Gram matrix path for the same pair
+        RapMusic::Matrix6T matGram = matG.transpose() * matG;
+        MatrixXd matW = matU_B.transpose() * matG;
+        RapMusic::Matrix6T matCorGram = matW.transpose() * matW;
+
+        double dCorGram = RapMusicScan::subcorr(matGram, matCorGram);
+        dMaxDiff = std::max(dMaxDiff, std::fabs(dCorGram - dCorSvd));
+
+        if(dCorSvd > dMaxCorSvd) {
+            dMaxCorSvd = dCorSvd;
+            pairMaxSvd.x1 = idx1;
+            pairMaxSvd.x2 = idx2;
+        }
+    }
+
+    QVERIFY2(dMaxDiff < dEpsilon, qPrintable(QString("Maximal correlation difference %1").arg(dMaxDiff)));
+
+    //Scan of the Gram matrices
+    Pair pairMax;
+    double dMaxCor = m_pRapMusic->scanPairCombinations(matLeadField, matU_B, pairMax);
+
+    QCOMPARE(pairMax.x1, pairMaxSvd.x1);
+    QCOMPARE(pairMax.x2, pairMaxSvd.x2);
+    QVERIFY(std::fabs(dMaxCor - dMaxCorSvd) < dEpsilon);
+}
+
+//=============================================================================================================
+
+void TestRapMusic::scanPairs()
+{
+    compareScan(m_pFwd->sol->data, m_matU_B);
+
+    Pair pairMax;
+    m_pRapMusic->scanPairCombinations(m_pFwd->sol->data, m_matU_B, pairMax);
+    QCOMPARE(pairMax.x1, m_iIdx1);
+    QCOMPARE(pairMax.x2, m_iIdx2);
+}
+
+//=============================================================================================================
+
+void TestRapMusic::scanProjectedPairs()
+{
+    //Second RAP MUSIC iteration: the found source is projected out, which leaves pairs close to rank deficient
+    const MatrixXd& matLeadField = m_pFwd->sol->data;
+
+    RapMusic::MatrixX6T matG(matLeadField.rows(), 6);
+    RapMusicScan::getGainMatrixPair(matLeadField, matG, m_iIdx1, m_iIdx2);
+
+    VectorXd vecA = matG * m_vecPhi;
+    MatrixXd matOrthProj = MatrixXd::Identity(matLeadField.rows(), matLeadField.rows()) - vecA * vecA.transpose() / vecA.squaredNorm();
+
+    MatrixXd matProjLeadField = matOrthProj * matLeadField;
+
+    JacobiSVD<MatrixXd> t_svdProj(matOrthProj * m_matU_B, ComputeThinU);
+    MatrixXd matU_B = t_svdProj.matrixU().leftCols(1);
+
+    compareScan(matProjLeadField, matU_B);
+}
+
+//=============================================================================================================
+
+void TestRapMusic::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestRapMusic)
+#include "test_rap_music.moc"
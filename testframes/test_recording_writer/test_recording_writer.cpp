@@ -0,0 +1,250 @@
+//=============================================================================================================
+/**
+ * @file     test_recording_writer.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @version  dev
+ * @date     April, 2020
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2020, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Test for the threaded recording writer of the WriteToFile plugin
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff_raw_data.h>
+#include <fiff/fiff_info.h>
+
+#include "recordingwriter.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace WRITETOFILEPLUGIN;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestRecordingWriter
+ *
+ * @brief The TestRecordingWriter class writes recordings through RecordingWriter and reads them back
+ *
+ */
+class TestRecordingWriter: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRecordingWriter();
+
+private slots:
+    void initTestCase();
+    void writeRecording();
+    void failedStart();
+    void stopDuringRecording();
+    void cleanupTestCase();
+
+private:
+    void record(RecordingWriter& writer, const QString& sFileName);
+    void compareRecording(const QString& sFileName);
+
+    FiffInfo        m_fiffInfo;
+    MatrixXd        m_matData;
+    QTemporaryDir   m_tempDir;
+    int             m_iBlockSize;
+};
+
+//=============================================================================================================
+
+TestRecordingWriter::TestRecordingWriter()
+: m_iBlockSize(100)
+{
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QFile t_fileIn(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif");
+    FiffRawData raw(t_fileIn);
+    QVERIFY(!raw.isEmpty());
+
+    //The plugin always writes the raw data
+    m_fiffInfo = raw.info;
+    for(int i = 0; i < m_fiffInfo.projs.size(); ++i) {
+        m_fiffInfo.projs[i].active = false;
+    }
+
+    m_matData = MatrixXd::Random(m_fiffInfo.nchan, 25 * m_iBlockSize);
+
+    QVERIFY(m_tempDir.isValid());
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::record(RecordingWriter& writer, const QString& sFileName)
+{
+    QVERIFY(writer.startRecording(sFileName, m_fiffInfo));
+    QVERIFY(writer.isRecording());
+
+    for(int i = 0; i < m_matData.cols(); i += m_iBlockSize) {
+        writer.writeRawBuffer(m_matData.middleCols(i, m_iBlockSize));
+    }
+
+    writer.stopRecording();
+    QVERIFY(!writer.isRecording());
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::compareRecording(const QString& sFileName)
+{
+    QFile t_fileIn(sFileName);
+    FiffRawData raw(t_fileIn);
+    QVERIFY(!raw.isEmpty());
+    QCOMPARE(raw.first_samp, 0);
+    QCOMPARE(raw.last_samp, int(m_matData.cols()) - 1);
+
+    MatrixXd matRead, matTimes;
+    QVERIFY(raw.read_raw_segment(matRead, matTimes, raw.first_samp, raw.last_samp));
+    QCOMPARE(matRead.rows(), m_matData.rows());
+    QCOMPARE(matRead.cols(), m_matData.cols());
+
+    //The buffers are written as floats without calibration
+    MatrixXd matExpected = raw.cals.transpose().asDiagonal() * m_matData.cast<float>().cast<double>();
+    QVERIFY((matRead - matExpected).cwiseAbs().maxCoeff() <= 1e-6 * matExpected.cwiseAbs().maxCoeff());
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::writeRecording()
+{
+    //Small staging buffers, so the recording is handed to the writer thread in several parts and buffers are reused
+    RecordingWriter writer(64 * 1024, 2, false);
+    writer.start();
+
+    QString sFileName = m_tempDir.filePath("test_recording_writer_raw.fif");
+    record(writer, sFileName);
+
+    writer.requestInterruption();
+    QVERIFY(writer.wait(10000));
+    QCOMPARE(writer.getQueueDepth(), 0);
+
+    compareRecording(sFileName);
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::failedStart()
+{
+    RecordingWriter writer(64 * 1024, 2, false);
+    QSignalSpy spy(&writer, &RecordingWriter::recordingFailed);
+    writer.start();
+
+    //The directory does not exist, so the writer thread can not create the file
+    QString sFailedFileName = m_tempDir.filePath("missing/test_recording_writer_raw.fif");
+    QVERIFY(writer.startRecording(sFailedFileName, m_fiffInfo));
+
+    QTRY_VERIFY_WITH_TIMEOUT(!writer.isRecording(), 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 10000);
+    QCOMPARE(spy.at(0).at(0).toString(), sFailedFileName);
+
+    //Data of the failed recording is dropped
+    writer.writeRawBuffer(m_matData.leftCols(m_iBlockSize));
+    QVERIFY(!writer.isRecording());
+
+    //The next recording is written as usual
+    QString sFileName = m_tempDir.filePath("test_recording_writer_restart_raw.fif");
+    record(writer, sFileName);
+
+    writer.requestInterruption();
+    QVERIFY(writer.wait(10000));
+    QCOMPARE(spy.count(), 1);
+
+    compareRecording(sFileName);
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::stopDuringRecording()
+{
+    //Staging buffers larger than the recording, so all data is still staged when the thread is stopped
+    RecordingWriter writer(64 * 1024 * 1024, 2, false);
+    writer.start();
+
+    QString sFileName = m_tempDir.filePath("test_recording_writer_stopped_raw.fif");
+    QVERIFY(writer.startRecording(sFileName, m_fiffInfo));
+
+    for(int i = 0; i < m_matData.cols(); i += m_iBlockSize) {
+        writer.writeRawBuffer(m_matData.middleCols(i, m_iBlockSize));
+    }
+
+    writer.requestInterruption();
+    QVERIFY(writer.wait(10000));
+    QVERIFY(!writer.isRecording());
+    QCOMPARE(writer.getQueueDepth(), 0);
+
+    compareRecording(sFileName);
+
+    //A restarted writer accepts a new recording
+    writer.start();
+
+    QString sRestartFileName = m_tempDir.filePath("test_recording_writer_stopped_restart_raw.fif");
+    record(writer, sRestartFileName);
+
+    writer.requestInterruption();
+    QVERIFY(writer.wait(10000));
+
+    compareRecording(sRestartFileName);
+}
+
+//=============================================================================================================
+
+void TestRecordingWriter::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestRecordingWriter)
+#include "test_recording_writer.moc"
@@ -41,6 +41,7 @@
 #include <utils/generics/applicationlogger.h>
 
 #include <utils/ioutils.h>
+#include <utils/spectral.h>
 #include <connectivity/metrics/coherency.h>
 #include <connectivity/metrics/coherence.h>
 #include <connectivity/metrics/imagcoherence.h>
@@ -50,8 +51,12 @@
 #include <connectivity/metrics/weightedphaselagindex.h>
 #include <connectivity/metrics/debiasedsquaredweightedphaselagindex.h>
 #include <connectivity/metrics/crosscorrelation.h>
+#include <connectivity/metrics/metricfusion.h>
 #include <connectivity/connectivitysettings.h>
+#include <connectivity/connectivity.h>
 #include <connectivity/network/network.h>
+#include <connectivity/network/networknode.h>
+#include <connectivity/network/networkedge.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -97,10 +102,22 @@ private slots:
     void spectralConnectivityCoherence();
     void spectralConnectivityImagCoherence();
     void spectralConnectivityXCOR();
+    void networkEdgeViews();
+    void networkEdgeOrder();
+    void dpssTapers();
+    void fusedMetrics();
+    void fusedDispatch();
+    void slidingWindowSums();
     void cleanupTestCase();
 
 private:
     void compareConnectivity();
+    QList<Network> calculateSpectralMetrics(ConnectivitySettings& settings,
+                                            const QStringList& lMethods);
+    void compareSumData(const ConnectivitySettings::IntermediateSumData& sumData,
+                        const ConnectivitySettings::IntermediateSumData& refSumData);
+    void compareNetworks(const QList<Network>& lNetworks,
+                         const QList<Network>& lRefNetworks);
     QList<MatrixXd> readConnectivityData();
     double dEpsilon;
     double m_dConnectivityOutput;
@@ -348,6 +365,455 @@ void TestSpectralConnectivity::spectralConnectivityXCOR()
 
 //=============================================================================================================
 
+void TestSpectralConnectivity::networkEdgeViews()
+{
+    //*********************************************************************************************************
+    // Build the same network from the compact arrays and, as before, from edge objects appended to the nodes
+    //*********************************************************************************************************
+
+    int iNNodes = 6;
+    int iNBins = 4;
+    double dThreshold = 0.5;
+
+    MatrixXd matWeights = MatrixXd::Random(iNBins, iNNodes * iNNodes).cwiseAbs();
+
+    Network network("TEST", dThreshold);
+    QList<NetworkNode::SPtr> lRefNodes;
+
+    for(int i = 0; i < iNNodes; ++i) {
+        network.append(NetworkNode::SPtr(new NetworkNode(i, RowVectorXf::Zero(3))));
+        lRefNodes << NetworkNode::SPtr(new NetworkNode(i, RowVectorXf::Zero(3)));
+    }
+
+    QList<NetworkEdge::SPtr> lRefEdges;
+
+    for(int i = 0; i < iNNodes; ++i) {
+        MatrixXd matRowWeights(iNBins, iNNodes - i);
+
+        for(int j = i; j < iNNodes; ++j) {
+            matRowWeights.col(j - i) = matWeights.col(i * iNNodes + j);
+
+            if(j != i) {
+                NetworkEdge::SPtr pEdge = NetworkEdge::SPtr(new NetworkEdge(i, j, matWeights.col(i * iNNodes + j)));
+                pEdge->setActive(fabs(pEdge->getWeight()) >= dThreshold);
+                lRefNodes.at(i)->append(pEdge);
+                lRefNodes.at(j)->append(pEdge);
+                lRefEdges << pEdge;
+            }
+        }
+
+        network.append(i, VectorXi::LinSpaced(iNNodes - i, i, iNNodes - 1), matRowWeights);
+    }
+
+    //*********************************************************************************************************
+    // Compare the edge and node views
+    //*********************************************************************************************************
+
+    QCOMPARE(network.getFullEdges().size(), lRefEdges.size());
+
+    int iNRefActive = 0;
+
+    for(int i = 0; i < lRefEdges.size(); ++i) {
+        QCOMPARE(network.getFullEdges().at(i)->getStartNodeID(), lRefEdges.at(i)->getStartNodeID());
+        QCOMPARE(network.getFullEdges().at(i)->getEndNodeID(), lRefEdges.at(i)->getEndNodeID());
+        QVERIFY(fabs(network.getFullEdges().at(i)->getWeight() - lRefEdges.at(i)->getWeight()) < dEpsilon);
+        QCOMPARE(network.getFullEdges().at(i)->isActive(), lRefEdges.at(i)->isActive());
+
+        if(lRefEdges.at(i)->isActive()) {
+            iNRefActive++;
+        }
+    }
+
+    QCOMPARE(network.getThresholdedEdges().size(), iNRefActive);
+
+    const QList<NetworkNode::SPtr>& lNodes = network.getNodes();
+    QCOMPARE(lNodes.size(), lRefNodes.size());
+
+    for(int i = 0; i < lNodes.size(); ++i) {
+        QCOMPARE(lNodes.at(i)->getFullEdges().size(), lRefNodes.at(i)->getFullEdges().size());
+        QCOMPARE(lNodes.at(i)->getThresholdedEdges().size(), lRefNodes.at(i)->getThresholdedEdges().size());
+        QCOMPARE(lNodes.at(i)->getFullEdgesIn().size(), lRefNodes.at(i)->getFullEdgesIn().size());
+        QCOMPARE(lNodes.at(i)->getThresholdedEdgesOut().size(), lRefNodes.at(i)->getThresholdedEdgesOut().size());
+
+        for(int j = 0; j < lNodes.at(i)->getFullEdges().size(); ++j) {
+            QCOMPARE(lNodes.at(i)->getFullEdges().at(j)->getStartNodeID(), lRefNodes.at(i)->getFullEdges().at(j)->getStartNodeID());
+            QCOMPARE(lNodes.at(i)->getFullEdges().at(j)->getEndNodeID(), lRefNodes.at(i)->getFullEdges().at(j)->getEndNodeID());
+        }
+
+        QCOMPARE(lNodes.at(i)->getFullDegree(), lRefNodes.at(i)->getFullDegree());
+        QCOMPARE(lNodes.at(i)->getThresholdedDegree(), lRefNodes.at(i)->getThresholdedDegree());
+        QCOMPARE(lNodes.at(i)->getFullIndegree(), lRefNodes.at(i)->getFullIndegree());
+        QCOMPARE(lNodes.at(i)->getThresholdedOutdegree(), lRefNodes.at(i)->getThresholdedOutdegree());
+        QVERIFY(fabs(lNodes.at(i)->getFullStrength() - lRefNodes.at(i)->getFullStrength()) < dEpsilon);
+        QVERIFY(fabs(lNodes.at(i)->getThresholdedStrength() - lRefNodes.at(i)->getThresholdedStrength()) < dEpsilon);
+    }
+
+    //*********************************************************************************************************
+    // The edges handed out by the network are read only views of its arrays
+    //*********************************************************************************************************
+
+    NetworkEdge::SPtr pEdge = network.getFullEdges().first();
+    bool bActive = pEdge->isActive();
+    pEdge->setActive(!bActive);
+    pEdge->setWeight(pEdge->getWeight() + 1.0);
+
+    QCOMPARE(pEdge->isActive(), bActive);
+    QVERIFY(fabs(pEdge->getWeight() - lRefEdges.first()->getWeight()) < dEpsilon);
+    QCOMPARE(network.getThresholdedEdges().size(), iNRefActive);
+
+    //*********************************************************************************************************
+    // Rethresholding updates the node views
+    //*********************************************************************************************************
+
+    network.setThreshold(0.0);
+
+    for(int i = 0; i < network.getNodes().size(); ++i) {
+        QCOMPARE(network.getNodes().at(i)->getThresholdedDegree(), iNNodes - 1);
+        QCOMPARE(network.getNodes().at(i)->getThresholdedEdges().size(), iNNodes - 1);
+    }
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::networkEdgeOrder()
+{
+    //*********************************************************************************************************
+    // The edges computed in parallel are stored in upper-triangular, per start node order
+    //*********************************************************************************************************
+
+    int iNNodes = 8;
+    ConnectivitySettings settings;
+    settings.setFFTSize(m_connectivitySettings.at(0).matData.cols());
+    settings.setWindowType("hanning");
+
+    for(int i = 0; i < 5; ++i) {
+        settings.append(MatrixXd::Random(iNNodes, m_connectivitySettings.at(0).matData.cols()));
+    }
+
+    Network network = Coherence::calculate(settings);
+    MatrixXd matFull = network.getFullConnectivityMatrix(false);
+
+    QCOMPARE(network.getNumberEdges(), iNNodes * (iNNodes - 1) / 2);
+
+    int k = 0;
+
+    for(int i = 0; i < iNNodes; ++i) {
+        for(int j = i + 1; j < iNNodes; ++j, ++k) {
+            QCOMPARE(network.getFullEdges().at(k)->getStartNodeID(), i);
+            QCOMPARE(network.getFullEdges().at(k)->getEndNodeID(), j);
+            QVERIFY(fabs(network.getFullEdges().at(k)->getWeight() - matFull(i,j)) < dEpsilon);
+        }
+    }
+
+    for(int i = 0; i < network.getNodes().size(); ++i) {
+        QCOMPARE(network.getNodes().at(i)->getFullDegree(), iNNodes - 1);
+        QCOMPARE(network.getNodes().at(i)->getFullEdges().size(), iNNodes - 1);
+    }
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::dpssTapers()
+{
+    //*********************************************************************************************************
+    // Compare the dpss tapers to scipy.signal.windows.dpss(16, 2.5, 4, return_ratios=True)
+    //*********************************************************************************************************
+
+    MatrixXd matRefTapers(4, 16);
+    matRefTapers << 0.007082725726011, 0.027520528793146, 0.068780986105098, 0.133982022655282, 0.218457103155104, 0.308759507157408, 0.385571424304741, 0.429871127929585,
+                    0.429871127929585, 0.385571424304741, 0.308759507157408, 0.218457103155104, 0.133982022655282, 0.068780986105098, 0.027520528793146, 0.007082725726011,
+                    0.034321517522878, 0.101861970718628, 0.200158658963963, 0.303617096769254, 0.371985010034999, 0.366779423855718, 0.270772153128077, 0.099908907426294,
+                    -0.099908907426294, -0.270772153128077, -0.366779423855718, -0.371985010035000, -0.303617096769254, -0.200158658963963, -0.101861970718628, -0.034321517522878,
+                    0.110873458378225, 0.237764513448071, 0.345847447890386, 0.370740630055718, 0.276408005644800, 0.083805568565778, -0.130844629656218, -0.271239680667501,
+                    -0.271239680667501, -0.130844629656217, 0.083805568565778, 0.276408005644800, 0.370740630055718, 0.345847447890386, 0.237764513448071, 0.110873458378225,
+                    0.262926886596106, 0.376562721628486, 0.357270203807735, 0.191099172563822, -0.045499964113034, -0.224995171738076, -0.247185338147197, -0.105429650794025,
+                    0.105429650794025, 0.247185338147197, 0.224995171738076, 0.045499964113034, -0.191099172563822, -0.357270203807735, -0.376562721628486, -0.262926886596106;
+
+    VectorXd vecRefConcentration(4);
+    vecRefConcentration << 0.999998413856241, 0.9998936965828714, 0.9970049366432123, 0.9570277890278089;
+
+    QPair<MatrixXd, VectorXd> tapers = Spectral::generateTapers(16, "dpss", 2.5);
+
+    QCOMPARE(int(tapers.first.rows()), 4);
+    QCOMPARE(int(tapers.first.cols()), 16);
+
+    // Orthonormality
+    QVERIFY((tapers.first * tapers.first.transpose() - MatrixXd::Identity(4, 4)).cwiseAbs().maxCoeff() < 1e-12);
+
+    // Tapers and concentration ratios, the taper weights are the square roots of the ratios
+    QVERIFY((tapers.first - matRefTapers).cwiseAbs().maxCoeff() < 1e-12);
+    QVERIFY((tapers.second.cwiseAbs2() - vecRefConcentration).cwiseAbs().maxCoeff() < 1e-12);
+
+    // Cached tapers are the same
+    QPair<MatrixXd, VectorXd> tapersCached = Spectral::generateTapers(16, "dpss", 2.5);
+    QVERIFY(tapersCached.first == tapers.first);
+    QVERIFY(tapersCached.second == tapers.second);
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::fusedMetrics()
+{
+    //*********************************************************************************************************
+    // The intermediate data computed by MetricFusion yield the same networks as the individual metrics
+    //*********************************************************************************************************
+
+    QStringList lMethods;
+    lMethods << "COH" << "IMAGCOH" << "PLI" << "WPLI" << "USPLI" << "DSWPLI" << "PLV";
+
+    // More rows than CSD_TILE_SIZE, so the CSD is computed in several tiles
+    ConnectivitySettings settingsTiled;
+    settingsTiled.setFFTSize(m_connectivitySettings.at(0).matData.cols());
+    settingsTiled.setWindowType("hanning");
+
+    for(int i = 0; i < 3; ++i) {
+        settingsTiled.append(MatrixXd::Random(CSD_TILE_SIZE + 6, m_connectivitySettings.at(0).matData.cols()));
+    }
+
+    QList<ConnectivitySettings> lSettings;
+    lSettings << m_connectivitySettings << settingsTiled;
+
+    for(int i = 0; i < lSettings.size(); ++i) {
+        ConnectivitySettings settingsIndividual = lSettings.at(i);
+        settingsIndividual.setConnectivityMethods(lMethods);
+        QList<Network> lRefNetworks = calculateSpectralMetrics(settingsIndividual, lMethods);
+
+        // Fused, computed twice to also cover the reuse of the sum data of the last call
+        ConnectivitySettings settingsFused = lSettings.at(i);
+        settingsFused.setConnectivityMethods(lMethods);
+
+        for(int j = 0; j < 2; ++j) {
+            QVERIFY(MetricFusion::calculate(settingsFused));
+            settingsFused.setFusedModeActive(true);
+            QList<Network> lNetworks = calculateSpectralMetrics(settingsFused, lMethods);
+
+            // The fused mode belongs to settingsFused, other settings still compute their intermediate data
+            ConnectivitySettings settingsOther = lSettings.at(i);
+            settingsOther.setConnectivityMethods(lMethods);
+            QVERIFY(!settingsOther.isFusedModeActive());
+            compareNetworks(calculateSpectralMetrics(settingsOther, lMethods), lRefNetworks);
+
+            settingsFused.setFusedModeActive(false);
+
+            compareNetworks(lNetworks, lRefNetworks);
+        }
+
+        // Fused in storage mode, which additionally keeps the intermediate data of each trial
+        ConnectivitySettings settingsStorage = lSettings.at(i);
+        settingsStorage.setConnectivityMethods(lMethods);
+
+        AbstractMetric::m_bStorageModeIsActive = true;
+        bool bFused = MetricFusion::calculate(settingsStorage);
+        settingsStorage.setFusedModeActive(true);
+        QList<Network> lNetworks = calculateSpectralMetrics(settingsStorage, lMethods);
+        settingsStorage.setFusedModeActive(false);
+        AbstractMetric::m_bStorageModeIsActive = false;
+
+        QVERIFY(bFused);
+        compareNetworks(lNetworks, lRefNetworks);
+
+        int iNRows = settingsStorage.at(0).matData.rows();
+
+        for(int j = 0; j < settingsStorage.size(); ++j) {
+            QCOMPARE(settingsStorage.at(j).vecPairCsd.size(), iNRows);
+            QCOMPARE(settingsStorage.at(j).vecPairCsdNormalized.size(), iNRows);
+            QCOMPARE(settingsStorage.at(j).vecPairCsdImagSign.size(), iNRows);
+            QCOMPARE(settingsStorage.at(j).vecPairCsdImagAbs.size(), iNRows);
+            QCOMPARE(settingsStorage.at(j).vecPairCsdImagSqrd.size(), iNRows);
+        }
+    }
+
+    // Nothing to fuse for non spectral metrics
+    ConnectivitySettings settingsNonSpectral = m_connectivitySettings;
+    settingsNonSpectral.setConnectivityMethods(QStringList() << "XCOR");
+    QVERIFY(!MetricFusion::calculate(settingsNonSpectral));
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::fusedDispatch()
+{
+    //*********************************************************************************************************
+    // Connectivity::calculate dispatches the spectral metrics through MetricFusion
+    //*********************************************************************************************************
+
+    // In the order Connectivity::calculate computes the metrics
+    QStringList lMethods;
+    lMethods << "WPLI" << "USPLI" << "PLI" << "COH" << "IMAGCOH" << "PLV" << "DSWPLI";
+
+    ConnectivitySettings settingsIndividual = m_connectivitySettings;
+    settingsIndividual.setConnectivityMethods(lMethods);
+    QList<Network> lRefNetworks = calculateSpectralMetrics(settingsIndividual, lMethods);
+
+    ConnectivitySettings settingsFused = m_connectivitySettings;
+    settingsFused.setConnectivityMethods(lMethods);
+    QList<Network> lNetworks = Connectivity::calculate(settingsFused);
+
+    QVERIFY(!settingsFused.isFusedModeActive());
+    compareNetworks(lNetworks, lRefNetworks);
+
+    // Non spectral metrics are computed as before next to the fused ones
+    ConnectivitySettings settingsMixed = m_connectivitySettings;
+    settingsMixed.setConnectivityMethods(QStringList() << "XCOR" << "PLV");
+    lNetworks = Connectivity::calculate(settingsMixed);
+
+    QCOMPARE(lNetworks.size(), 2);
+    QCOMPARE(lNetworks.at(0).getConnectivityMethod(), QString("XCOR"));
+    QVERIFY(!settingsMixed.isFusedModeActive());
+
+    ConnectivitySettings settingsXcor = m_connectivitySettings;
+    settingsXcor.setConnectivityMethods(QStringList() << "XCOR");
+    QVERIFY((lNetworks.at(0).getFullConnectivityMatrix() - CrossCorrelation::calculate(settingsXcor).getFullConnectivityMatrix()).cwiseAbs().maxCoeff() < dEpsilon);
+
+    compareNetworks(QList<Network>() << lNetworks.at(1), QList<Network>() << lRefNetworks.at(5));
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::slidingWindowSums()
+{
+    //*********************************************************************************************************
+    // The sum data of a sliding window equals the sums over the stored trials after they were recomputed
+    //*********************************************************************************************************
+
+    QStringList lMethods;
+    lMethods << "COH" << "IMAGCOH" << "WPLI" << "USPLI" << "DSWPLI" << "PLV";
+
+    int iNumberTrials = 3;
+    int iNumberSamples = m_connectivitySettings.at(0).matData.cols();
+
+    ConnectivitySettings settingsWindow;
+    settingsWindow.setFFTSize(iNumberSamples);
+    settingsWindow.setWindowType("hanning");
+    settingsWindow.setConnectivityMethods(lMethods);
+
+    AbstractMetric::m_bStorageModeIsActive = true;
+
+    // Slide over several window cycles, each update evicts the oldest trial
+    for(int i = 0; i < 4 * iNumberTrials; ++i) {
+        settingsWindow.append(MatrixXd::Random(6, iNumberSamples));
+
+        if(settingsWindow.size() > iNumberTrials) {
+            settingsWindow.removeFirst(settingsWindow.size() - iNumberTrials);
+        }
+
+        QVERIFY(MetricFusion::calculate(settingsWindow));
+    }
+
+    // The same trials computed at once
+    ConnectivitySettings settingsRef;
+    settingsRef.setFFTSize(iNumberSamples);
+    settingsRef.setWindowType("hanning");
+    settingsRef.setConnectivityMethods(lMethods);
+
+    for(int i = 0; i < settingsWindow.size(); ++i) {
+        settingsRef.append(settingsWindow.at(i).matData);
+    }
+
+    QVERIFY(MetricFusion::calculate(settingsRef));
+
+    AbstractMetric::m_bStorageModeIsActive = false;
+
+    compareSumData(settingsWindow.getIntermediateSumData(), settingsRef.getIntermediateSumData());
+
+    settingsWindow.recomputeIntermediateSumData();
+    compareSumData(settingsWindow.getIntermediateSumData(), settingsRef.getIntermediateSumData());
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::compareSumData(const ConnectivitySettings::IntermediateSumData& sumData,
+                                              const ConnectivitySettings::IntermediateSumData& refSumData)
+{
+    QCOMPARE(sumData.matPsdSum.rows(), refSumData.matPsdSum.rows());
+    QCOMPARE(sumData.matPsdSum.cols(), refSumData.matPsdSum.cols());
+    QVERIFY((sumData.matPsdSum - refSumData.matPsdSum).cwiseAbs().maxCoeff() < dEpsilon * qMax(1.0, refSumData.matPsdSum.cwiseAbs().maxCoeff()));
+
+    QCOMPARE(sumData.vecPairCsdSum.size(), refSumData.vecPairCsdSum.size());
+    QCOMPARE(sumData.vecPairCsdNormalizedSum.size(), refSumData.vecPairCsdNormalizedSum.size());
+    QCOMPARE(sumData.vecPairCsdImagSignSum.size(), refSumData.vecPairCsdImagSignSum.size());
+    QCOMPARE(sumData.vecPairCsdImagAbsSum.size(), refSumData.vecPairCsdImagAbsSum.size());
+    QCOMPARE(sumData.vecPairCsdImagSqrdSum.size(), refSumData.vecPairCsdImagSqrdSum.size());
+
+    for(int i = 0; i < refSumData.vecPairCsdSum.size(); ++i) {
+        QVERIFY((sumData.vecPairCsdSum.at(i).second - refSumData.vecPairCsdSum.at(i).second).cwiseAbs().maxCoeff() < dEpsilon * qMax(1.0, refSumData.vecPairCsdSum.at(i).second.cwiseAbs().maxCoeff()));
+    }
+
+    for(int i = 0; i < refSumData.vecPairCsdNormalizedSum.size(); ++i) {
+        QVERIFY((sumData.vecPairCsdNormalizedSum.at(i).second - refSumData.vecPairCsdNormalizedSum.at(i).second).cwiseAbs().maxCoeff() < dEpsilon);
+    }
+
+    for(int i = 0; i < refSumData.vecPairCsdImagSignSum.size(); ++i) {
+        QVERIFY((sumData.vecPairCsdImagSignSum.at(i).second - refSumData.vecPairCsdImagSignSum.at(i).second).cwiseAbs().maxCoeff() < dEpsilon);
+    }
+
+    for(int i = 0; i < refSumData.vecPairCsdImagAbsSum.size(); ++i) {
+        QVERIFY((sumData.vecPairCsdImagAbsSum.at(i).second - refSumData.vecPairCsdImagAbsSum.at(i).second).cwiseAbs().maxCoeff() < dEpsilon * qMax(1.0, refSumData.vecPairCsdImagAbsSum.at(i).second.cwiseAbs().maxCoeff()));
+    }
+
+    for(int i = 0; i < refSumData.vecPairCsdImagSqrdSum.size(); ++i) {
+        QVERIFY((sumData.vecPairCsdImagSqrdSum.at(i).second - refSumData.vecPairCsdImagSqrdSum.at(i).second).cwiseAbs().maxCoeff() < dEpsilon * qMax(1.0, refSumData.vecPairCsdImagSqrdSum.at(i).second.cwiseAbs().maxCoeff()));
+    }
+}
+
+//=============================================================================================================
+
+QList<Network> TestSpectralConnectivity::calculateSpectralMetrics(ConnectivitySettings& settings,
+                                                                  const QStringList& lMethods)
+{
+    QList<Network> lNetworks;
+
+    for(int i = 0; i < lMethods.size(); ++i) {
+        if(lMethods.at(i) == "COH") {
+            lNetworks.append(Coherence::calculate(settings));
+        } else if(lMethods.at(i) == "IMAGCOH") {
+            lNetworks.append(ImagCoherence::calculate(settings));
+        } else if(lMethods.at(i) == "PLI") {
+            lNetworks.append(PhaseLagIndex::calculate(settings));
+        } else if(lMethods.at(i) == "WPLI") {
+            lNetworks.append(WeightedPhaseLagIndex::calculate(settings));
+        } else if(lMethods.at(i) == "USPLI") {
+            lNetworks.append(UnbiasedSquaredPhaseLagIndex::calculate(settings));
+        } else if(lMethods.at(i) == "DSWPLI") {
+            lNetworks.append(DebiasedSquaredWeightedPhaseLagIndex::calculate(settings));
+        } else if(lMethods.at(i) == "PLV") {
+            lNetworks.append(PhaseLockingValue::calculate(settings));
+        }
+    }
+
+    return lNetworks;
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::compareNetworks(const QList<Network>& lNetworks,
+                                               const QList<Network>& lRefNetworks)
+{
+    QCOMPARE(lNetworks.size(), lRefNetworks.size());
+
+    for(int i = 0; i < lNetworks.size(); ++i) {
+        QCOMPARE(lNetworks.at(i).getConnectivityMethod(), lRefNetworks.at(i).getConnectivityMethod());
+        QCOMPARE(lNetworks.at(i).getNumberEdges(), lRefNetworks.at(i).getNumberEdges());
+
+        const QList<QSharedPointer<NetworkEdge> >& lEdges = lNetworks.at(i).getFullEdges();
+        const QList<QSharedPointer<NetworkEdge> >& lRefEdges = lRefNetworks.at(i).getFullEdges();
+
+        for(int j = 0; j < lEdges.size(); ++j) {
+            QCOMPARE(lEdges.at(j)->getStartNodeID(), lRefEdges.at(j)->getStartNodeID());
+            QCOMPARE(lEdges.at(j)->getEndNodeID(), lRefEdges.at(j)->getEndNodeID());
+
+            MatrixXd matWeight = lEdges.at(j)->getMatrixWeight();
+            MatrixXd matRefWeight = lRefEdges.at(j)->getMatrixWeight();
+
+            QCOMPARE(matWeight.rows(), matRefWeight.rows());
+            QCOMPARE(matWeight.cols(), matRefWeight.cols());
+            QVERIFY((matWeight - matRefWeight).cwiseAbs().maxCoeff() < dEpsilon * qMax(1.0, matRefWeight.cwiseAbs().maxCoeff()));
+        }
+    }
+}
+
+//=============================================================================================================
+
 QList<MatrixXd> TestSpectralConnectivity::readConnectivityData()
 {
     MatrixXd inputTrials;
@@ -54,6 +54,19 @@ SUBDIRS += \
     test_mne_forward_solution \
     test_fiff_cov \
     test_fiff_digitizer \
+    test_fiff_quantization \
+    test_fiff_proj_operator \
+    test_fiff_stream_staging \
+    test_ftbuffer_connector \
+    test_recording_writer \
+    test_detect_trigger \
+    test_kmeans \
+    test_communication_shared_memory \
+    test_fwd_bem_model \
+    test_rap_music \
+    test_fiff_dir_node \
+    test_minimum_norm \
+    test_communication_rt_data_client \
     test_mne_msh_display_surface_set \
 
 !contains(MNECPP_CONFIG, minimalVersion) {